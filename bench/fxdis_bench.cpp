@@ -0,0 +1,526 @@
+// Per-stage microbenchmarks: container parsing, chunk lookup, signature parsing, container
+// assembly, compression, token decoding, saving and loading the binary IR, control-flow graph
+// construction, temp liveness, cost estimation, critical paths, uniformity, occupancy, shared
+// memory bank conflicts, buffer access patterns, constant buffer usage, linting, operand decoding by
+// operand type and text formatting, each timed in isolation on one program per shader type and on
+// generated programs of growing size; plus opening and searching a shader pack.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <initializer_list>
+#include "shader_builder.h"
+#include "shader_gen.h"
+#include "ir.h"
+#include "token_codec.h"
+#include "shader_pack.h"
+#include "cfg.h"
+#include "liveness.h"
+#include "cost_model.h"
+#include "critical_path.h"
+#include "uniformity.h"
+#include "lint.h"
+#include "occupancy.h"
+#include "tgsm_banks.h"
+#include "buffer_access.h"
+#include "cbuffer_usage.h"
+#include <sstream>
+
+static uint64_t allocations;
+
+// Counting at the malloc level catches operator new as well as the malloc calls in the dxbc code.
+#if defined(__GLIBC__)
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void* malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+extern "C" void* calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __libc_calloc(count, size);
+}
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+#else
+void* operator new(size_t size)
+{
+    allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+#endif
+
+namespace {
+
+// Discards text through a small buffer, the way a buffered file would take it minus the I/O.
+class null_streambuf : public std::streambuf
+{
+public:
+    null_streambuf() { setp(buffer, buffer + sizeof(buffer)); }
+protected:
+    int_type overflow(int_type c)
+    {
+        setp(buffer, buffer + sizeof(buffer));
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            sputc(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+private:
+    char buffer[4096];
+};
+
+// A program of `count` copies of one instruction, for timing the decode of a single operand form.
+tokens repeat_instruction(D3D10_SB_OPCODE_TYPE opcode, const tokens& body, uint32_t count)
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    for (uint32_t i = 0; i < count; i++)
+        b.op(opcode, body);
+    return b.finish();
+}
+
+struct bench_input
+{
+    std::string name;
+    std::vector<uint32_t> container;     // whole DXBC file, or empty for bare programs
+    std::vector<uint32_t> program;       // shader tokens
+    std::vector<dxbc_chunk_header*> chunks;
+};
+
+bench_input make_input(const std::string& name, const tokens& program, bool shader_model_5)
+{
+    bench_input input;
+    input.name = name;
+    input.program = program;
+    input.container = build_container(program, shader_model_5);
+    dxbc_container* dxbc = dxbc_parse(&input.container[0], (int)(input.container.size() * 4));
+    input.chunks.assign(dxbc->chunks.begin(), dxbc->chunks.end());
+    delete dxbc;
+    return input;
+}
+
+struct options
+{
+    double min_time;
+    bool json;
+    const char* filter;
+};
+
+struct bench_result
+{
+    std::string stage;
+    std::string input;
+    double ns_per_op;
+    double tokens_per_second;
+    double allocations_per_op;
+};
+
+volatile uint64_t sink;
+
+// Runs fn in batches that double until one takes at least min_time, and reports that batch.
+template<typename F>
+bench_result measure(const options& opts, const std::string& stage, const std::string& input, double tokens_per_op, F fn)
+{
+    fn();
+    uint64_t iterations = 1;
+    for (;;)
+    {
+        uint64_t allocations_before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; i++)
+            fn();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t allocated = allocations - allocations_before;
+        if (seconds >= opts.min_time || iterations >= (1ull << 40))
+        {
+            bench_result result;
+            result.stage = stage;
+            result.input = input;
+            result.ns_per_op = seconds * 1e9 / iterations;
+            result.tokens_per_second = tokens_per_op * iterations / seconds;
+            result.allocations_per_op = (double)allocated / iterations;
+            return result;
+        }
+        iterations *= 2;
+    }
+}
+
+void bench_container(const options& opts, const bench_input& input, std::vector<bench_result>& results)
+{
+    const void* data = &input.container[0];
+    int size = (int)(input.container.size() * 4);
+    double tokens = (double)input.container.size();
+    results.push_back(measure(opts, "dxbc_parse", input.name, tokens, [&] {
+        dxbc_container* dxbc = dxbc_parse(data, size);
+        sink += dxbc->chunks.size();
+        delete dxbc;
+    }));
+    results.push_back(measure(opts, "dxbc_find_chunk", input.name, tokens, [&] {
+        sink += (uintptr_t)dxbc_find_shader_bytecode(data, size);
+    }));
+    results.push_back(measure(opts, "dxbc_parse_signature", input.name, tokens, [&] {
+        D3D11_SIGNATURE_PARAMETER_DESC* params;
+        sink += dxbc_parse_signature(dxbc_find_signature(data, size, DXBC_FIND_INPUT_SIGNATURE), &params);
+        free(params);
+    }));
+    std::vector<dxbc_chunk_header*> chunks = input.chunks;
+    results.push_back(measure(opts, "dxbc_assemble", input.name, tokens, [&] {
+        std::pair<void*, size_t> assembled = dxbc_assemble(&chunks[0], (unsigned)chunks.size());
+        sink += assembled.second;
+        free(assembled.first);
+    }));
+    std::vector<char> compressed;
+    results.push_back(measure(opts, "token_compress", input.name, tokens, [&] {
+        compressed.clear();
+        sink += token_compress(data, size, compressed);
+    }));
+    std::vector<char> decompressed(size);
+    fxdis_arena arena;
+    results.push_back(measure(opts, "token_decompress", input.name, tokens, [&] {
+        fxdis_arena_scope scope(arena);
+        sink += token_decompress(&compressed[0], compressed.size(), &decompressed[0], size, &arena);
+    }));
+}
+
+// Opening a pack of `count` small generated shaders and finding every one of them in it. The
+// throughput column counts shaders rather than tokens.
+void bench_pack(const options& opts, uint32_t count, std::vector<bench_result>& results)
+{
+    shader_pack_writer writer;
+    std::vector<uint64_t> hashes;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        shader_gen_options gen = { D3D11_SB_COMPUTE_SHADER, 5, 16, i };
+        tokens container = build_container(shader_gen_program(gen), true);
+        uint64_t hash;
+        if (writer.add(&container[0], container.size() * 4, "", hash) == SHADER_PACK_ADDED)
+            hashes.push_back(hash);
+    }
+    std::ostringstream out;
+    writer.write(out);
+    std::string bytes = out.str();
+    std::vector<uint64_t> file((bytes.size() + 7) / 8);
+    memcpy(&file[0], bytes.data(), bytes.size());
+    std::string name = "pack/" + std::to_string(hashes.size());
+
+    results.push_back(measure(opts, "shader_pack_open", name, (double)hashes.size(), [&] {
+        sink += (uintptr_t)shader_pack_open(&file[0], bytes.size());
+    }));
+    const shader_pack_header* pack = shader_pack_open(&file[0], bytes.size());
+    results.push_back(measure(opts, "shader_pack_find", name, (double)hashes.size(), [&] {
+        for (uint64_t hash : hashes)
+            sink += shader_pack_find(pack, hash)->payload_size;
+    }));
+}
+
+void bench_program(const options& opts, bool decode_only, const bench_input& input, std::vector<bench_result>& results)
+{
+    const uint32_t* program = &input.program[0];
+    uint32_t size = (uint32_t)(input.program.size() * 4);
+    double tokens = (double)input.program.size();
+
+    DecodedOperandPool pool;
+    results.push_back(measure(opts, "decode", input.name, tokens, [&] {
+        TokenDecoder decoder(program, size);
+        decoder.DecodeHeader();
+        DecodedInstruction inst;
+        while (decoder.Next(inst, pool) == DECODE_STATUS::OK)
+        {
+            sink += inst.operandCount;
+            pool.clear();
+        }
+    }));
+    if (decode_only)
+        return;
+
+    // Decode once up front so formatting is timed on its own.
+    std::vector<DecodedInstruction> instructions;
+    DecodedOperandPool operands;
+    TokenDecoder decoder(program, size);
+    decoder.DecodeHeader();
+    DecodedInstruction inst;
+    while (decoder.Next(inst, operands) == DECODE_STATUS::OK)
+        instructions.push_back(inst);
+
+    // Loading saved IR is validation plus whatever the reader does with the records; the walk
+    // here matches what the decode stage does with each instruction.
+    std::vector<char> ir;
+    results.push_back(measure(opts, "ir_encode", input.name, tokens, [&] {
+        ir.clear();
+        sink += (int)ir_encode(program, size, ir);
+    }));
+    results.push_back(measure(opts, "ir_load", input.name, tokens, [&] {
+        const ir_header* header = ir_validate(&ir[0], ir.size());
+        const DecodedInstruction* loaded = ir_instructions(header);
+        for (uint32_t i = 0; i < header->instruction_count; i++)
+            sink += loaded[i].operandCount;
+    }));
+    cfg graph;
+    results.push_back(measure(opts, "cfg_build", input.name, tokens, [&] {
+        sink += cfg_build(instructions.data(), (uint32_t)instructions.size(), operands.data(), graph);
+        sink += graph.blocks.size();
+    }));
+    temp_pressure pressure;
+    results.push_back(measure(opts, "liveness", input.name, tokens, [&] {
+        sink += liveness_analyze(instructions.data(), (uint32_t)instructions.size(), operands.data(), graph, pressure);
+        sink += pressure.peak_temps;
+    }));
+    cost_profile profile;
+    cost_profile_default(profile);
+    cost_estimate cost;
+    results.push_back(measure(opts, "cost_estimate", input.name, tokens, [&] {
+        cost_estimate_program(instructions.data(), (uint32_t)instructions.size(), graph, profile, cost);
+        sink += (size_t)cost.total;
+    }));
+    latency_estimate latency;
+    results.push_back(measure(opts, "latency_estimate", input.name, tokens, [&] {
+        latency_estimate_program(instructions.data(), (uint32_t)instructions.size(), operands.data(), graph, profile, latency);
+        sink += latency.blocks.size();
+    }));
+    uniformity uniform;
+    results.push_back(measure(opts, "uniformity", input.name, tokens, [&] {
+        sink += uniformity_analyze(instructions.data(), (uint32_t)instructions.size(), operands.data(), graph, uniform);
+        sink += uniform.divergent_derivatives.size();
+    }));
+    hardware_profile hardware;
+    hardware_profile_default(hardware);
+    occupancy_estimate occupancy;
+    results.push_back(measure(opts, "occupancy", input.name, tokens, [&] {
+        sink += occupancy_estimate_program(instructions.data(), (uint32_t)instructions.size(), hardware, occupancy);
+    }));
+    tgsm_bank_report banks;
+    results.push_back(measure(opts, "tgsm_banks", input.name, tokens, [&] {
+        sink += tgsm_banks_analyze(instructions.data(), (uint32_t)instructions.size(), operands.data(), graph, hardware, banks);
+        sink += banks.accesses.size();
+    }));
+    buffer_report buffers;
+    results.push_back(measure(opts, "buffer_access", input.name, tokens, [&] {
+        sink += buffer_access_analyze(instructions.data(), (uint32_t)instructions.size(), operands.data(), graph, hardware, buffers);
+        sink += buffers.findings.size();
+    }));
+    std::vector<cbuffer_layout> layouts;
+    cbuffer_report cbuffers;
+    results.push_back(measure(opts, "cbuffer_usage", input.name, tokens, [&] {
+        cbuffer_usage_analyze(instructions.data(), (uint32_t)instructions.size(), operands.data(), layouts, cbuffers);
+        sink += cbuffers.buffers.size();
+    }));
+    // Lint decodes as it checks, as fxdis --lint does.
+    lint_checker checker;
+    results.push_back(measure(opts, "lint", input.name, tokens, [&] {
+        TokenDecoder decoder(program, size);
+        decoder.DecodeHeader();
+        DecodedInstruction inst;
+        lint_begin(checker);
+        while (decoder.Next(inst, pool) == DECODE_STATUS::OK)
+        {
+            lint_instruction(checker, inst, pool.data());
+            pool.clear();
+        }
+        lint_end(checker);
+        sink += checker.findings.size();
+    }));
+
+    null_streambuf discard;
+    std::ostream out(&discard);
+    results.push_back(measure(opts, "format", input.name, tokens, [&] {
+        for (size_t i = 0; i < instructions.size(); i++)
+            TokenParser::FormatInstruction(out, instructions[i], &operands[0], program);
+    }));
+    results.push_back(measure(opts, "disassemble", input.name, tokens, [&] {
+        TokenParser parser(program, size, out);
+        sink += parser.Parse();
+    }));
+    fxdis_arena arena;
+    results.push_back(measure(opts, "disassemble/arena", input.name, tokens, [&] {
+        fxdis_arena_scope scope(arena);
+        TokenParser parser(program, size, out, &arena);
+        sink += parser.Parse();
+    }));
+}
+
+void print_results(const options& opts, const std::vector<bench_result>& results)
+{
+    if (opts.json)
+    {
+        std::cout << "{\"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const bench_result& r = results[i];
+            std::cout << "  {\"stage\": \"" << r.stage << "\", \"input\": \"" << r.input << "\", \"ns_per_op\": " << r.ns_per_op
+                << ", \"tokens_per_second\": " << r.tokens_per_second << ", \"allocations_per_op\": " << r.allocations_per_op
+                << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        std::cout << "]}" << std::endl;
+        return;
+    }
+    char line[256];
+    snprintf(line, sizeof(line), "%-28s %-16s %14s %14s %12s\n", "stage", "input", "ns/op", "Mtokens/s", "allocs/op");
+    std::cout << line;
+    for (const bench_result& r : results)
+    {
+        snprintf(line, sizeof(line), "%-28s %-16s %14.1f %14.2f %12.2f\n", r.stage.c_str(), r.input.c_str(),
+            r.ns_per_op, r.tokens_per_second / 1e6, r.allocations_per_op);
+        std::cout << line;
+    }
+    std::cout.flush();
+}
+
+bool selected(const options& opts, const std::string& name)
+{
+    return !opts.filter || name.find(opts.filter) != std::string::npos;
+}
+
+} // namespace
+
+void usage()
+{
+    std::cerr << "Usage: fxdis_bench [--json] [--min-time MS] [--filter TEXT] [FILE...]\n";
+    std::cerr << "\n";
+    std::cerr << "  --json           print results as JSON\n";
+    std::cerr << "  --min-time MS    shortest measured batch per benchmark (default 200)\n";
+    std::cerr << "  --filter TEXT    only run benchmarks whose stage or input contains TEXT\n";
+    std::cerr << "  FILE             DXBC containers to benchmark besides the built-in programs\n";
+    std::cerr << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    options opts = { 0.2, false, NULL };
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--json"))
+            opts.json = true;
+        else if (!strcmp(argv[i], "--min-time") && hasValue)
+            opts.min_time = atof(argv[++i]) / 1000.0;
+        else if (!strcmp(argv[i], "--filter") && hasValue)
+            opts.filter = argv[++i];
+        else if (argv[i][0] == '-')
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+        else
+            files.push_back(argv[i]);
+    }
+
+    std::vector<bench_input> inputs;
+    const uint32_t repeat = 64;
+    for (uint32_t type = 0; type < ShaderTypeTextCount; type++)
+    {
+        D3D10_SB_TOKENIZED_PROGRAM_TYPE program_type = (D3D10_SB_TOKENIZED_PROGRAM_TYPE)type;
+        tokens program = build_program(program_type, repeat);
+        std::string name = std::string(ShaderTypeText[type]) + (type >= D3D11_SB_HULL_SHADER ? "5_0" : "4_0");
+        inputs.push_back(make_input(name, program, type >= D3D11_SB_HULL_SHADER));
+    }
+    // The same generated shader at growing sizes: tokens/s should stay flat, and any drop
+    // points at work that grows faster than the program.
+    for (uint32_t instructions = 1u << 10; instructions <= 1u << 18; instructions <<= 4)
+    {
+        shader_gen_options gen = { D3D10_SB_PIXEL_SHADER, 5, instructions, 1 };
+        inputs.push_back(make_input("gen_ps_5_0/" + std::to_string(instructions), shader_gen_program(gen), true));
+    }
+    for (const char* file : files)
+    {
+        std::ifstream in(file, std::ios::binary);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (bytes.size() < sizeof(dxbc_container_header) || !dxbc_parse(&bytes[0], (int)bytes.size()))
+        {
+            std::cerr << "Not a DXBC container: " << file << std::endl;
+            return EXIT_FAILURE;
+        }
+        dxbc_chunk_header* shader = dxbc_find_shader_bytecode(&bytes[0], (int)bytes.size());
+        if (!shader || !dxbc_find_signature(&bytes[0], (int)bytes.size(), DXBC_FIND_INPUT_SIGNATURE))
+        {
+            std::cerr << "Container needs a shader and an input signature: " << file << std::endl;
+            return EXIT_FAILURE;
+        }
+        tokens program(bswap_le32(shader->size) / 4);
+        memcpy(&program[0], shader + 1, program.size() * 4);
+        inputs.push_back(make_input(file, program, bswap_le32(shader->fourcc) == FOURCC_SHEX));
+    }
+
+    // One source operand form per program, each in a plain mov so the rest of the work is equal.
+    struct operand_case { const char* name; D3D10_SB_OPCODE_TYPE opcode; tokens source; };
+    operand_case operand_cases[] = {
+        { "temp", D3D10_SB_OPCODE_MOV, src(D3D10_SB_OPERAND_TYPE_TEMP, 1) },
+        { "input", D3D10_SB_OPCODE_MOV, src(D3D10_SB_OPERAND_TYPE_INPUT, 1) },
+        { "select1", D3D10_SB_OPCODE_MOV, select1(D3D10_SB_OPERAND_TYPE_TEMP, 1, 2) },
+        { "constant_buffer", D3D10_SB_OPCODE_MOV, src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 3) },
+        { "immediate32", D3D10_SB_OPCODE_MOV, imm32(1, 2, 3, 4) },
+        { "immediate64", D3D11_SB_OPCODE_DMOV, imm64(1, 2, 3, 4) },
+        { "modifier", D3D10_SB_OPCODE_MOV, negated(src(D3D10_SB_OPERAND_TYPE_TEMP, 1)) },
+        { "relative", D3D10_SB_OPCODE_MOV, relative_src(0, 1, 2) },
+        { "icb_relative", D3D10_SB_OPCODE_MOV, icb_src(0, 2) },
+    };
+
+    // A program that stops decoding early would make every number meaningless.
+    null_streambuf discard;
+    std::ostream out(&discard);
+    for (const bench_input& input : inputs)
+    {
+        TokenParser parser(&input.program[0], (uint32_t)(input.program.size() * 4), out);
+        if (!parser.Parse())
+        {
+            std::cerr << "Malformed program: " << input.name << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<bench_result> results;
+    for (const bench_input& input : inputs)
+    {
+        if (selected(opts, "container " + input.name))
+            bench_container(opts, input, results);
+        if (selected(opts, "program " + input.name))
+            bench_program(opts, false, input, results);
+    }
+    if (selected(opts, "pack"))
+        bench_pack(opts, 4096, results);
+    const uint32_t operand_repeat = 1024;
+    for (const operand_case& c : operand_cases)
+    {
+        bench_input input;
+        input.name = c.name;
+        input.program = repeat_instruction(c.opcode, cat({ dst(D3D10_SB_OPERAND_TYPE_TEMP, 0), c.source }), operand_repeat);
+        if (!selected(opts, std::string("operand ") + c.name))
+            continue;
+        TokenParser parser(&input.program[0], (uint32_t)(input.program.size() * 4), out);
+        if (!parser.Parse())
+        {
+            std::cerr << "Malformed program: " << c.name << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::vector<bench_result> single;
+        bench_program(opts, true, input, single);
+        // Report per instruction, i.e. per source operand of this form plus one temp destination.
+        bench_result result = single[0];
+        result.stage = std::string("operand/") + c.name;
+        result.input = "ps_5_0";
+        result.ns_per_op /= operand_repeat;
+        result.allocations_per_op /= operand_repeat;
+        results.push_back(result);
+    }
+
+    print_results(opts, results);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,398 @@
+// End-to-end benchmark of the fxdis command line over a generated corpus, with a regression gate
+// against a stored baseline.
+//
+// Throughput comes from one `fxdis --list` batch over the whole corpus, best of several runs.
+// Latency is the time fxdis spends on each shader within those batches, from its --timings
+// record, best of the runs per shader; starting a process per shader would mostly measure fork
+// and exec. Peak RSS is the batch process's maximum resident set size.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "shader_gen.h"
+
+namespace {
+
+struct options
+{
+    std::string fxdis;
+    std::string corpus;
+    uint32_t shaders;
+    uint64_t seed;
+    uint32_t runs;
+    const char* baseline;
+    const char* save_baseline;
+    double threshold;           // allowed regression, as a fraction
+};
+
+struct corpus_info
+{
+    std::string list;
+    std::string timings;
+    std::vector<std::string> files;
+    uint64_t bytes;
+};
+
+struct run_result
+{
+    bool ok;
+    double seconds;
+    uint64_t output_bytes;
+    long peak_rss_kb;
+};
+
+struct report
+{
+    uint32_t shaders;
+    uint64_t bytes;
+    uint64_t seed;
+    double shaders_per_second;
+    double mb_per_second;
+    double latency_p50_us;
+    double latency_p99_us;
+    long peak_rss_kb;
+};
+
+// Writes the corpus and its list file. Sizes are spread log-uniformly from a handful of
+// instructions to a few thousand, with the shader types in rotation and SM4 and SM5 mixed. The
+// draws come from shader_gen_random, so the corpus is identical on every platform.
+bool generate_corpus(const options& opts, corpus_info& corpus)
+{
+    if (mkdir(opts.corpus.c_str(), 0755) && errno != EEXIST)
+    {
+        std::cerr << "Could not create corpus directory: " << opts.corpus << std::endl;
+        return false;
+    }
+    shader_gen_random random(opts.seed);
+    corpus.bytes = 0;
+    corpus.list = opts.corpus + "/corpus.txt";
+    corpus.timings = opts.corpus + "/timings.csv";
+    std::ofstream list(corpus.list.c_str());
+    for (uint32_t i = 0; i < opts.shaders; i++)
+    {
+        uint32_t type = i % ShaderTypeTextCount;
+        uint32_t scale = random.below(9);
+        shader_gen_options gen;
+        gen.type = (D3D10_SB_TOKENIZED_PROGRAM_TYPE)type;
+        gen.major_version = 4 + random.below(2);
+        gen.instructions = 10 + random.below(10u << scale);
+        gen.seed = random.next();
+        tokens container = shader_gen_container(gen);
+
+        char name[64];
+        snprintf(name, sizeof(name), "/%05u_%.2s.dxbc", i, ShaderTypeText[type]);
+        std::string path = opts.corpus + name;
+        std::ofstream file(path.c_str(), std::ios::binary);
+        file.write((const char*)&container[0], container.size() * 4);
+        if (!file)
+        {
+            std::cerr << "Could not write " << path << std::endl;
+            return false;
+        }
+        corpus.files.push_back(path);
+        corpus.bytes += container.size() * 4;
+        list << path << "\n";
+    }
+    return (bool)list;
+}
+
+// Runs fxdis with the given arguments, counting and discarding its standard output.
+run_result run_fxdis(const options& opts, const std::vector<std::string>& args)
+{
+    run_result result = { false, 0, 0, 0 };
+    std::vector<char*> argv;
+    argv.push_back((char*)opts.fxdis.c_str());
+    for (const std::string& arg : args)
+        argv.push_back((char*)arg.c_str());
+    argv.push_back(NULL);
+
+    int fds[2];
+    if (pipe(fds))
+        return result;
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return result;
+    }
+    if (pid == 0)
+    {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execv(argv[0], &argv[0]);
+        _exit(127);
+    }
+    close(fds[1]);
+    char buffer[1 << 16];
+    for (;;)
+    {
+        ssize_t got = read(fds[0], buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        result.output_bytes += got;
+    }
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR)
+        ;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.ok = WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+    result.peak_rss_kb = usage.ru_maxrss;
+    return result;
+}
+
+// Reads the --timings record of a batch and keeps each shader's fastest time, in microseconds, in
+// latencies, which is in corpus order.
+bool read_timings(const corpus_info& corpus, std::vector<double>& latencies)
+{
+    std::ifstream file(corpus.timings.c_str());
+    std::string line;
+    if (!std::getline(file, line) || line != "input,nanoseconds")
+        return false;
+    latencies.resize(corpus.files.size(), 0);
+    size_t i = 0;
+    for (; i < corpus.files.size() && std::getline(file, line); i++)
+    {
+        size_t comma = line.rfind(',');
+        if (comma == std::string::npos || line.compare(0, comma, corpus.files[i]))
+            return false;
+        double us = strtod(line.c_str() + comma + 1, NULL) / 1000;
+        if (latencies[i] == 0 || us < latencies[i])
+            latencies[i] = us;
+    }
+    return i == corpus.files.size();
+}
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0;
+    size_t rank = (size_t)(p * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+void write_report(std::ostream& out, const report& r, const std::vector<std::string>& regressions)
+{
+    out << "{\n";
+    out << "  \"corpus\": {\"shaders\": " << r.shaders << ", \"bytes\": " << r.bytes << ", \"seed\": " << r.seed << "},\n";
+    out << "  \"shaders_per_second\": " << r.shaders_per_second << ",\n";
+    out << "  \"mb_per_second\": " << r.mb_per_second << ",\n";
+    out << "  \"latency_p50_us\": " << r.latency_p50_us << ",\n";
+    out << "  \"latency_p99_us\": " << r.latency_p99_us << ",\n";
+    out << "  \"peak_rss_kb\": " << r.peak_rss_kb << ",\n";
+    out << "  \"regressions\": [";
+    for (size_t i = 0; i < regressions.size(); i++)
+        out << (i ? ", " : "") << "\"" << regressions[i] << "\"";
+    out << "]\n";
+    out << "}\n";
+}
+
+// Reads the number after "key": in a report written by write_report.
+bool read_number(const std::string& json, const char* key, double& value)
+{
+    std::string quoted = std::string("\"") + key + "\":";
+    size_t at = json.find(quoted);
+    if (at == std::string::npos)
+        return false;
+    char* end;
+    const char* begin = json.c_str() + at + quoted.size();
+    value = strtod(begin, &end);
+    return end != begin;
+}
+
+// Compares against a baseline report. A metric regresses when it is worse by more than the
+// threshold; improvements never fail.
+bool compare_baseline(const options& opts, const report& r, std::vector<std::string>& regressions)
+{
+    std::ifstream file(opts.baseline);
+    if (!file)
+    {
+        std::cerr << "Could not open baseline: " << opts.baseline << std::endl;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    std::string json = text.str();
+
+    double shaders, bytes;
+    if (!read_number(json, "shaders", shaders) || !read_number(json, "bytes", bytes))
+    {
+        std::cerr << "Not a benchmark report: " << opts.baseline << std::endl;
+        return false;
+    }
+    if ((uint32_t)shaders != r.shaders || (uint64_t)bytes != r.bytes)
+    {
+        std::cerr << "Baseline was recorded on a different corpus" << std::endl;
+        return false;
+    }
+
+    struct metric { const char* key; double current; bool higher_is_better; };
+    metric metrics[] = {
+        { "shaders_per_second", r.shaders_per_second, true },
+        { "mb_per_second", r.mb_per_second, true },
+        { "latency_p50_us", r.latency_p50_us, false },
+        { "latency_p99_us", r.latency_p99_us, false },
+        { "peak_rss_kb", (double)r.peak_rss_kb, false },
+    };
+    for (const metric& m : metrics)
+    {
+        double base;
+        if (!read_number(json, m.key, base) || base <= 0)
+            continue;
+        double change = m.higher_is_better ? (base - m.current) / base : (m.current - base) / base;
+        if (change > opts.threshold)
+        {
+            std::ostringstream message;
+            message << m.key << " " << base << " -> " << m.current;
+            regressions.push_back(message.str());
+            std::cerr << "Regression: " << message.str() << std::endl;
+        }
+    }
+    return true;
+}
+
+std::string default_fxdis(const char* argv0)
+{
+    std::string self = argv0;
+    size_t slash = self.rfind('/');
+    return (slash == std::string::npos ? std::string(".") : self.substr(0, slash)) + "/fxdis";
+}
+
+} // namespace
+
+void usage()
+{
+    std::cerr << "Usage: fxdis_corpus_bench [OPTIONS]\n";
+    std::cerr << "\n";
+    std::cerr << "  --fxdis PATH          fxdis binary to run (default: next to this program)\n";
+    std::cerr << "  --corpus DIR          where to generate the corpus (default fxdis-corpus)\n";
+    std::cerr << "  --shaders N           corpus size (default 500)\n";
+    std::cerr << "  --seed N              corpus seed (default 1)\n";
+    std::cerr << "  --runs N              batch runs, the fastest is reported (default 3)\n";
+    std::cerr << "  --baseline FILE       fail if worse than this earlier report\n";
+    std::cerr << "  --save-baseline FILE  also write the report to FILE\n";
+    std::cerr << "  --threshold PCT       allowed regression against the baseline (default 10)\n";
+    std::cerr << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    options opts;
+    opts.fxdis = default_fxdis(argv[0]);
+    opts.corpus = "fxdis-corpus";
+    opts.shaders = 500;
+    opts.seed = 1;
+    opts.runs = 3;
+    opts.baseline = NULL;
+    opts.save_baseline = NULL;
+    opts.threshold = 0.10;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--fxdis") && hasValue)
+            opts.fxdis = argv[++i];
+        else if (!strcmp(arg, "--corpus") && hasValue)
+            opts.corpus = argv[++i];
+        else if (!strcmp(arg, "--shaders") && hasValue)
+            opts.shaders = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--seed") && hasValue)
+            opts.seed = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(arg, "--runs") && hasValue)
+            opts.runs = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--baseline") && hasValue)
+            opts.baseline = argv[++i];
+        else if (!strcmp(arg, "--save-baseline") && hasValue)
+            opts.save_baseline = argv[++i];
+        else if (!strcmp(arg, "--threshold") && hasValue)
+            opts.threshold = atof(argv[++i]) / 100.0;
+        else
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (!opts.shaders || !opts.runs)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (access(opts.fxdis.c_str(), X_OK))
+    {
+        std::cerr << "fxdis not found at " << opts.fxdis << "; pass --fxdis" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    corpus_info corpus;
+    if (!generate_corpus(opts, corpus))
+        return EXIT_FAILURE;
+
+    double best = 0;
+    long peak_rss_kb = 0;
+    std::vector<double> latencies;
+    for (uint32_t run = 0; run < opts.runs; run++)
+    {
+        run_result batch = run_fxdis(opts, { "--timings", corpus.timings, "--list", corpus.list });
+        if (!batch.ok)
+        {
+            std::cerr << "fxdis failed on the corpus" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!read_timings(corpus, latencies))
+        {
+            std::cerr << "fxdis wrote no timings for the corpus: " << corpus.timings << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!run || batch.seconds < best)
+            best = batch.seconds;
+        peak_rss_kb = std::max(peak_rss_kb, batch.peak_rss_kb);
+    }
+
+    report r;
+    r.shaders = opts.shaders;
+    r.bytes = corpus.bytes;
+    r.seed = opts.seed;
+    r.shaders_per_second = opts.shaders / best;
+    r.mb_per_second = corpus.bytes / best / 1e6;
+    r.latency_p50_us = percentile(latencies, 0.50);
+    r.latency_p99_us = percentile(latencies, 0.99);
+    r.peak_rss_kb = peak_rss_kb;
+
+    std::vector<std::string> regressions;
+    if (opts.baseline && !compare_baseline(opts, r, regressions))
+        return EXIT_FAILURE;
+
+    write_report(std::cout, r, regressions);
+    if (opts.save_baseline)
+    {
+        std::ofstream file(opts.save_baseline);
+        write_report(file, r, std::vector<std::string>());
+        if (!file)
+        {
+            std::cerr << "Could not write " << opts.save_baseline << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return regressions.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
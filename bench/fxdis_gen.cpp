@@ -0,0 +1,125 @@
+// Writes synthetic SM4/5 shaders from shader_gen, as single files, a directory of files, or a
+// stream of containers for `fxdis --stream`.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <iostream>
+#include "shader_gen.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+void usage()
+{
+    std::cerr << "Usage: fxdis_gen [OPTIONS] OUTPUT\n";
+    std::cerr << "\n";
+    std::cerr << "  --type TYPE          ps, vs, gs, hs, ds, cs, or all to rotate through them (default all)\n";
+    std::cerr << "  --sm 4|5             shader model for ps, vs and gs (default 5)\n";
+    std::cerr << "  --instructions N     instructions per shader, at least 10 (default 1000)\n";
+    std::cerr << "  --seed N             seed of the first shader; shader i uses seed + i (default 1)\n";
+    std::cerr << "  --count N            number of shaders; OUTPUT is then a directory (default 1)\n";
+    std::cerr << "  --bare               write bare token streams instead of DXBC containers\n";
+    std::cerr << "  OUTPUT               file or directory, or - to write all shaders to stdout\n";
+    std::cerr << std::endl;
+}
+
+bool write_file(FILE* file, const tokens& data)
+{
+    return fwrite(&data[0], 4, data.size(), file) == data.size();
+}
+
+int main(int argc, char** argv)
+{
+    int type = -1;
+    uint32_t major = 5;
+    uint32_t instructions = 1000;
+    uint64_t seed = 1;
+    uint32_t count = 1;
+    bool bare = false;
+    const char* output = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--type") && hasValue)
+        {
+            const char* name = argv[++i];
+            type = -1;
+            for (uint32_t t = 0; t < ShaderTypeTextCount; t++)
+            {
+                // The table holds version prefixes such as "ps_".
+                if (strlen(name) == 2 && !strncmp(name, ShaderTypeText[t], 2))
+                    type = (int)t;
+            }
+            if (type < 0 && strcmp(name, "all"))
+            {
+                std::cerr << "Unknown shader type: " << name << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!strcmp(arg, "--sm") && hasValue)
+            major = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(arg, "--instructions") && hasValue)
+            instructions = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(arg, "--seed") && hasValue)
+            seed = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(arg, "--count") && hasValue)
+            count = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(arg, "--bare"))
+            bare = true;
+        else if (arg[0] == '-' && arg[1] == '-')
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+        else
+            output = arg;
+    }
+    if (!output || !count || (major != 4 && major != 5))
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    bool to_stdout = !strcmp(output, "-");
+#ifdef _WIN32
+    if (to_stdout)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    for (uint32_t i = 0; i < count; i++)
+    {
+        shader_gen_options options;
+        options.type = (D3D10_SB_TOKENIZED_PROGRAM_TYPE)(type < 0 ? i % ShaderTypeTextCount : (uint32_t)type);
+        options.major_version = major;
+        options.instructions = instructions;
+        options.seed = seed + i;
+        tokens data = bare ? shader_gen_program(options) : shader_gen_container(options);
+
+        std::string path = output;
+        if (count > 1 && !to_stdout)
+        {
+            char name[64];
+            snprintf(name, sizeof(name), "/%05u_%.2s.%s", i, ShaderTypeText[options.type], bare ? "sm" : "dxbc");
+            path += name;
+        }
+        FILE* file = to_stdout ? stdout : fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cerr << "Could not open " << path << std::endl;
+            return EXIT_FAILURE;
+        }
+        bool written = write_file(file, data);
+        if (!to_stdout && fclose(file))
+            written = false;
+        if (!written)
+        {
+            std::cerr << "Failed writing " << path << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return to_stdout && fflush(stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
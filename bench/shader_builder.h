@@ -0,0 +1,337 @@
+#ifndef SHADER_BUILDER_H_
+#define SHADER_BUILDER_H_
+
+// Hand-assembles small SM4/5 programs and DXBC containers for the benchmarks, so they need no
+// compiled shaders.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <utility>
+#include <initializer_list>
+#include "dxbc.h"
+#include "D3D11TokenParser.h"
+
+typedef std::vector<uint32_t> tokens;
+
+inline tokens cat(std::initializer_list<tokens> parts)
+{
+    tokens out;
+    for (const tokens& part : parts)
+        out.insert(out.end(), part.begin(), part.end());
+    return out;
+}
+
+inline uint32_t operand_token(D3D10_SB_OPERAND_TYPE type, D3D10_SB_OPERAND_NUM_COMPONENTS components, uint32_t dims)
+{
+    return ENCODE_D3D10_SB_OPERAND_TYPE(type) | ENCODE_D3D10_SB_OPERAND_NUM_COMPONENTS(components) |
+        ENCODE_D3D10_SB_OPERAND_INDEX_DIMENSION((D3D10_SB_OPERAND_INDEX_DIMENSION)dims);
+}
+
+// Destination register with a write mask.
+inline tokens dst(D3D10_SB_OPERAND_TYPE type, uint32_t index, uint32_t mask = D3D10_SB_OPERAND_4_COMPONENT_MASK_ALL)
+{
+    return { operand_token(type, D3D10_SB_OPERAND_4_COMPONENT, 1) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE) | mask, index };
+}
+
+// Source register with a swizzle.
+inline tokens src(D3D10_SB_OPERAND_TYPE type, uint32_t index, uint32_t swizzle = D3D10_SB_OPERAND_4_COMPONENT_NOSWIZZLE)
+{
+    return { operand_token(type, D3D10_SB_OPERAND_4_COMPONENT, 1) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MODE) | swizzle, index };
+}
+
+// Single component of a register, as flow control and relative indexing use them.
+inline tokens select1(D3D10_SB_OPERAND_TYPE type, uint32_t index, uint32_t component)
+{
+    return { operand_token(type, D3D10_SB_OPERAND_4_COMPONENT, 1) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SELECT_1_MODE) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECT_1(component), index };
+}
+
+inline tokens negated(tokens operand)
+{
+    operand[0] |= ENCODE_D3D10_SB_OPERAND_EXTENDED(1);
+    operand.insert(operand.begin() + 1, ENCODE_D3D10_SB_EXTENDED_OPERAND_TYPE(D3D10_SB_EXTENDED_OPERAND_MODIFIER) |
+        ENCODE_D3D10_SB_EXTENDED_OPERAND_MODIFIER(D3D10_SB_OPERAND_MODIFIER_NEG));
+    return operand;
+}
+
+inline tokens imm32(float x, float y, float z, float w)
+{
+    tokens out = { operand_token(D3D10_SB_OPERAND_TYPE_IMMEDIATE32, D3D10_SB_OPERAND_4_COMPONENT, 0), 0, 0, 0, 0 };
+    float values[] = { x, y, z, w };
+    memcpy(&out[1], values, sizeof(values));
+    return out;
+}
+
+inline tokens imm32_scalar(uint32_t value)
+{
+    return { operand_token(D3D10_SB_OPERAND_TYPE_IMMEDIATE32, D3D10_SB_OPERAND_1_COMPONENT, 0), value };
+}
+
+inline tokens imm64(double x, double y, double z, double w)
+{
+    tokens out(9);
+    out[0] = operand_token(D3D10_SB_OPERAND_TYPE_IMMEDIATE64, D3D10_SB_OPERAND_4_COMPONENT, 0);
+    double values[] = { x, y, z, w };
+    memcpy(&out[1], values, sizeof(values));
+    return out;
+}
+
+// cb#[element] and the like.
+inline tokens src2d(D3D10_SB_OPERAND_TYPE type, uint32_t slot, uint32_t element)
+{
+    return { operand_token(type, D3D10_SB_OPERAND_4_COMPONENT, 2) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MODE) |
+        D3D10_SB_OPERAND_4_COMPONENT_NOSWIZZLE, slot, element };
+}
+
+// x#[r#.x + offset]
+inline tokens relative_src(uint32_t array, uint32_t offset, uint32_t index_register)
+{
+    return cat({ { operand_token(D3D10_SB_OPERAND_TYPE_INDEXABLE_TEMP, D3D10_SB_OPERAND_4_COMPONENT, 2) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MODE) |
+        D3D10_SB_OPERAND_4_COMPONENT_NOSWIZZLE |
+        ENCODE_D3D10_SB_OPERAND_INDEX_REPRESENTATION(1, D3D10_SB_OPERAND_INDEX_IMMEDIATE32_PLUS_RELATIVE), array, offset },
+        select1(D3D10_SB_OPERAND_TYPE_TEMP, index_register, 0) });
+}
+
+// icb[r#.x + offset]
+inline tokens icb_src(uint32_t offset, uint32_t index_register)
+{
+    return cat({ { operand_token(D3D10_SB_OPERAND_TYPE_IMMEDIATE_CONSTANT_BUFFER, D3D10_SB_OPERAND_4_COMPONENT, 1) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MODE) |
+        D3D10_SB_OPERAND_4_COMPONENT_NOSWIZZLE |
+        ENCODE_D3D10_SB_OPERAND_INDEX_REPRESENTATION(0, D3D10_SB_OPERAND_INDEX_IMMEDIATE32_PLUS_RELATIVE), offset },
+        select1(D3D10_SB_OPERAND_TYPE_TEMP, index_register, 0) });
+}
+
+// System value registers such as vThreadID, which have no index.
+inline tokens special_dst(D3D10_SB_OPERAND_TYPE type, D3D10_SB_OPERAND_NUM_COMPONENTS components, uint32_t mask)
+{
+    uint32_t token = operand_token(type, components, 0);
+    if (components == D3D10_SB_OPERAND_4_COMPONENT)
+        token |= ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE) | mask;
+    return { token };
+}
+
+inline tokens special_src(D3D10_SB_OPERAND_TYPE type, uint32_t swizzle)
+{
+    return { operand_token(type, D3D10_SB_OPERAND_4_COMPONENT, 0) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MODE) | swizzle };
+}
+
+inline tokens resource(D3D10_SB_OPERAND_TYPE type, uint32_t index)
+{
+    return { operand_token(type, D3D10_SB_OPERAND_0_COMPONENT, 1), index };
+}
+
+class program_builder
+{
+public:
+    program_builder(D3D10_SB_TOKENIZED_PROGRAM_TYPE type, uint32_t major, uint32_t minor)
+    {
+        program.push_back(ENCODE_D3D10_SB_TOKENIZED_PROGRAM_VERSION_TOKEN(type, major, minor));
+        program.push_back(0);
+    }
+    program_builder& op(D3D10_SB_OPCODE_TYPE opcode, tokens body = tokens(), uint32_t controls = 0)
+    {
+        program.push_back(ENCODE_D3D10_SB_OPCODE_TYPE(opcode) | controls |
+            ENCODE_D3D10_SB_TOKENIZED_INSTRUCTION_LENGTH(body.size() + 1));
+        program.insert(program.end(), body.begin(), body.end());
+        return *this;
+    }
+    program_builder& icb(uint32_t vectors)
+    {
+        program.push_back(ENCODE_D3D10_SB_CUSTOMDATA_CLASS(D3D10_SB_CUSTOMDATA_DCL_IMMEDIATE_CONSTANT_BUFFER));
+        program.push_back(2 + vectors * 4);
+        for (uint32_t i = 0; i < vectors * 4; i++)
+            program.push_back(i);
+        return *this;
+    }
+    void reserve(size_t size) { program.reserve(size); }
+    // Fills in the length token and hands the program over; the builder is empty afterwards.
+    tokens finish()
+    {
+        program[1] = (uint32_t)program.size();
+        return std::move(program);
+    }
+private:
+    tokens program;
+};
+
+// Arithmetic and flow control every stage shares, repeated to make the program a realistic size.
+inline void common_body(program_builder& b, D3D10_SB_OPERAND_TYPE input, uint32_t repeat)
+{
+    for (uint32_t i = 0; i < repeat; i++)
+    {
+        b.op(D3D10_SB_OPCODE_MOV, cat({ dst(D3D10_SB_OPERAND_TYPE_TEMP, 0), src(input, 0) }));
+        b.op(D3D10_SB_OPCODE_MAD, cat({ dst(D3D10_SB_OPERAND_TYPE_TEMP, 1), src(D3D10_SB_OPERAND_TYPE_TEMP, 0),
+            src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 1), imm32(1, 2, 3, 4) }));
+        b.op(D3D10_SB_OPCODE_DP4, cat({ dst(D3D10_SB_OPERAND_TYPE_TEMP, 2, D3D10_SB_OPERAND_4_COMPONENT_MASK_X),
+            src(D3D10_SB_OPERAND_TYPE_TEMP, 1), negated(src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 2)) }));
+        b.op(D3D10_SB_OPCODE_FTOU, cat({ dst(D3D10_SB_OPERAND_TYPE_TEMP, 3, D3D10_SB_OPERAND_4_COMPONENT_MASK_X),
+            select1(D3D10_SB_OPERAND_TYPE_TEMP, 2, 0) }));
+        b.op(D3D10_SB_OPCODE_MOV, cat({ dst(D3D10_SB_OPERAND_TYPE_TEMP, 1), relative_src(0, 1, 3) }));
+        b.op(D3D10_SB_OPCODE_ADD, cat({ dst(D3D10_SB_OPERAND_TYPE_TEMP, 0), src(D3D10_SB_OPERAND_TYPE_TEMP, 1),
+            icb_src(0, 3) }));
+        b.op(D3D10_SB_OPCODE_IF, select1(D3D10_SB_OPERAND_TYPE_TEMP, 3, 0), ENCODE_D3D10_SB_INSTRUCTION_TEST_BOOLEAN(D3D10_SB_INSTRUCTION_TEST_NONZERO));
+        b.op(D3D10_SB_OPCODE_MUL, cat({ dst(D3D10_SB_OPERAND_TYPE_TEMP, 0), src(D3D10_SB_OPERAND_TYPE_TEMP, 0),
+            src(D3D10_SB_OPERAND_TYPE_TEMP, 1, ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE(3, 2, 1, 0)) }));
+        b.op(D3D10_SB_OPCODE_ENDIF);
+    }
+}
+
+inline void common_declarations(program_builder& b)
+{
+    b.op(D3D10_SB_OPCODE_DCL_GLOBAL_FLAGS, tokens(), D3D10_SB_GLOBAL_FLAG_REFACTORING_ALLOWED);
+    b.icb(4);
+    b.op(D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER, src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 4));
+    b.op(D3D10_SB_OPCODE_DCL_TEMPS, { 4 });
+    b.op(D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP, { 0, 8, 4 });
+}
+
+// A program of the given type: the declarations that stage typically has, common_body repeated
+// `repeat` times, and the stage's output instructions. Nine instructions per repeat.
+inline tokens build_program(D3D10_SB_TOKENIZED_PROGRAM_TYPE type, uint32_t repeat)
+{
+    uint32_t return_type = ENCODE_D3D10_SB_RESOURCE_RETURN_TYPE(D3D10_SB_RETURN_TYPE_FLOAT, D3D10_SB_4_COMPONENT_X) |
+        ENCODE_D3D10_SB_RESOURCE_RETURN_TYPE(D3D10_SB_RETURN_TYPE_FLOAT, D3D10_SB_4_COMPONENT_Y) |
+        ENCODE_D3D10_SB_RESOURCE_RETURN_TYPE(D3D10_SB_RETURN_TYPE_FLOAT, D3D10_SB_4_COMPONENT_Z) |
+        ENCODE_D3D10_SB_RESOURCE_RETURN_TYPE(D3D10_SB_RETURN_TYPE_FLOAT, D3D10_SB_4_COMPONENT_W);
+    switch (type)
+    {
+    case D3D10_SB_PIXEL_SHADER:
+    {
+        program_builder b(type, 4, 0);
+        common_declarations(b);
+        b.op(D3D10_SB_OPCODE_DCL_SAMPLER, resource(D3D10_SB_OPERAND_TYPE_SAMPLER, 0));
+        b.op(D3D10_SB_OPCODE_DCL_RESOURCE, cat({ resource(D3D10_SB_OPERAND_TYPE_RESOURCE, 0), { return_type } }),
+            ENCODE_D3D10_SB_RESOURCE_DIMENSION(D3D10_SB_RESOURCE_DIMENSION_TEXTURE2D));
+        b.op(D3D10_SB_OPCODE_DCL_INPUT_PS, dst(D3D10_SB_OPERAND_TYPE_INPUT, 0),
+            ENCODE_D3D10_SB_INPUT_INTERPOLATION_MODE(D3D10_SB_INTERPOLATION_LINEAR));
+        b.op(D3D10_SB_OPCODE_DCL_OUTPUT, dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0));
+        common_body(b, D3D10_SB_OPERAND_TYPE_INPUT, repeat);
+        b.op(D3D10_SB_OPCODE_SAMPLE, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), src(D3D10_SB_OPERAND_TYPE_TEMP, 0),
+            src(D3D10_SB_OPERAND_TYPE_RESOURCE, 0), src(D3D10_SB_OPERAND_TYPE_SAMPLER, 0) }));
+        b.op(D3D10_SB_OPCODE_RET);
+        return b.finish();
+    }
+    case D3D10_SB_VERTEX_SHADER:
+    {
+        program_builder b(type, 4, 0);
+        common_declarations(b);
+        b.op(D3D10_SB_OPCODE_DCL_INPUT, dst(D3D10_SB_OPERAND_TYPE_INPUT, 0));
+        b.op(D3D10_SB_OPCODE_DCL_OUTPUT_SIV, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), { ENCODE_D3D10_SB_NAME(D3D10_SB_NAME_POSITION) } }));
+        common_body(b, D3D10_SB_OPERAND_TYPE_INPUT, repeat);
+        b.op(D3D10_SB_OPCODE_MOV, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), src(D3D10_SB_OPERAND_TYPE_TEMP, 0) }));
+        b.op(D3D10_SB_OPCODE_RET);
+        return b.finish();
+    }
+    case D3D10_SB_GEOMETRY_SHADER:
+    {
+        program_builder b(type, 4, 0);
+        common_declarations(b);
+        b.op(D3D10_SB_OPCODE_DCL_GS_INPUT_PRIMITIVE, tokens(), ENCODE_D3D10_SB_GS_INPUT_PRIMITIVE(D3D10_SB_PRIMITIVE_TRIANGLE));
+        b.op(D3D10_SB_OPCODE_DCL_GS_OUTPUT_PRIMITIVE_TOPOLOGY, tokens(),
+            ENCODE_D3D10_SB_GS_OUTPUT_PRIMITIVE_TOPOLOGY(D3D10_SB_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP));
+        b.op(D3D10_SB_OPCODE_DCL_MAX_OUTPUT_VERTEX_COUNT, { 3 });
+        b.op(D3D10_SB_OPCODE_DCL_OUTPUT, dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0));
+        b.op(D3D10_SB_OPCODE_DCL_INPUT, dst(D3D10_SB_OPERAND_TYPE_INPUT, 0));
+        common_body(b, D3D10_SB_OPERAND_TYPE_INPUT, repeat);
+        b.op(D3D10_SB_OPCODE_MOV, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), src(D3D10_SB_OPERAND_TYPE_TEMP, 0) }));
+        b.op(D3D10_SB_OPCODE_EMIT);
+        b.op(D3D10_SB_OPCODE_CUT);
+        b.op(D3D10_SB_OPCODE_RET);
+        return b.finish();
+    }
+    case D3D11_SB_HULL_SHADER:
+    {
+        program_builder b(type, 5, 0);
+        b.op(D3D11_SB_OPCODE_HS_DECLS);
+        b.op(D3D11_SB_OPCODE_DCL_INPUT_CONTROL_POINT_COUNT, tokens(), ENCODE_D3D11_SB_INPUT_CONTROL_POINT_COUNT(3));
+        b.op(D3D11_SB_OPCODE_DCL_OUTPUT_CONTROL_POINT_COUNT, tokens(), ENCODE_D3D11_SB_OUTPUT_CONTROL_POINT_COUNT(3));
+        b.op(D3D11_SB_OPCODE_DCL_TESS_DOMAIN, tokens(), ENCODE_D3D11_SB_TESS_DOMAIN(D3D11_SB_TESSELLATOR_DOMAIN_TRI));
+        b.op(D3D11_SB_OPCODE_DCL_TESS_PARTITIONING, tokens(), ENCODE_D3D11_SB_TESS_PARTITIONING(D3D11_SB_TESSELLATOR_PARTITIONING_INTEGER));
+        b.op(D3D11_SB_OPCODE_DCL_TESS_OUTPUT_PRIMITIVE, tokens(), ENCODE_D3D11_SB_TESS_OUTPUT_PRIMITIVE(D3D11_SB_TESSELLATOR_OUTPUT_TRIANGLE_CW));
+        float max_factor = 64.0f;
+        uint32_t max_factor_token;
+        memcpy(&max_factor_token, &max_factor, sizeof(max_factor_token));
+        b.op(D3D11_SB_OPCODE_DCL_HS_MAX_TESSFACTOR, { max_factor_token });
+        b.op(D3D11_SB_OPCODE_HS_FORK_PHASE);
+        b.op(D3D11_SB_OPCODE_DCL_HS_FORK_PHASE_INSTANCE_COUNT, { 3 });
+        common_declarations(b);
+        b.op(D3D10_SB_OPCODE_DCL_INPUT, dst(D3D10_SB_OPERAND_TYPE_INPUT, 0));
+        b.op(D3D10_SB_OPCODE_DCL_OUTPUT, dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0));
+        common_body(b, D3D10_SB_OPERAND_TYPE_INPUT, repeat);
+        b.op(D3D10_SB_OPCODE_MOV, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), src(D3D10_SB_OPERAND_TYPE_TEMP, 0) }));
+        b.op(D3D10_SB_OPCODE_RET);
+        return b.finish();
+    }
+    case D3D11_SB_DOMAIN_SHADER:
+    {
+        program_builder b(type, 5, 0);
+        b.op(D3D11_SB_OPCODE_DCL_TESS_DOMAIN, tokens(), ENCODE_D3D11_SB_TESS_DOMAIN(D3D11_SB_TESSELLATOR_DOMAIN_TRI));
+        common_declarations(b);
+        b.op(D3D10_SB_OPCODE_DCL_INPUT, dst(D3D10_SB_OPERAND_TYPE_INPUT, 0));
+        b.op(D3D10_SB_OPCODE_DCL_OUTPUT_SIV, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), { ENCODE_D3D10_SB_NAME(D3D10_SB_NAME_POSITION) } }));
+        common_body(b, D3D10_SB_OPERAND_TYPE_INPUT, repeat);
+        b.op(D3D10_SB_OPCODE_MOV, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), src(D3D10_SB_OPERAND_TYPE_TEMP, 0) }));
+        b.op(D3D10_SB_OPCODE_RET);
+        return b.finish();
+    }
+    case D3D11_SB_COMPUTE_SHADER:
+    default:
+    {
+        program_builder b(D3D11_SB_COMPUTE_SHADER, 5, 0);
+        common_declarations(b);
+        b.op(D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW, resource(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 0));
+        b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_RAW, cat({ resource(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 0), { 1024 } }));
+        b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP, { 64, 1, 1 });
+        common_body(b, D3D10_SB_OPERAND_TYPE_TEMP, repeat);
+        b.op(D3D11_SB_OPCODE_STORE_RAW, cat({ dst(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 0, D3D10_SB_OPERAND_4_COMPONENT_MASK_X),
+            select1(D3D10_SB_OPERAND_TYPE_TEMP, 3, 0), select1(D3D10_SB_OPERAND_TYPE_TEMP, 0, 0) }));
+        b.op(D3D11_SB_OPCODE_SYNC, tokens(), ENCODE_D3D11_SB_SYNC_FLAGS(D3D11_SB_SYNC_THREADS_IN_GROUP));
+        b.op(D3D11_SB_OPCODE_STORE_RAW, cat({ dst(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 0, D3D10_SB_OPERAND_4_COMPONENT_MASK_X),
+            select1(D3D10_SB_OPERAND_TYPE_TEMP, 3, 0), select1(D3D10_SB_OPERAND_TYPE_TEMP, 0, 0) }));
+        b.op(D3D10_SB_OPCODE_RET);
+        return b.finish();
+    }
+    }
+}
+
+// A two-element ISGN chunk.
+inline tokens build_signature()
+{
+    tokens chunk = { FOURCC_ISGN, 0, 2, 8 };
+    const char names[] = "POSITION\0TEXCOORD\0\0\0";
+    uint32_t name_offset = 8 + 2 * 24;
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        tokens element = { name_offset + (i ? 9 : 0), 0, (uint32_t)(i ? 0 : 1), 3 /* float32 */, i, 0x0f0f };
+        chunk.insert(chunk.end(), element.begin(), element.end());
+    }
+    tokens text((sizeof(names) - 1) / 4);
+    memcpy(&text[0], names, text.size() * 4);
+    chunk.insert(chunk.end(), text.begin(), text.end());
+    chunk[1] = (uint32_t)(chunk.size() - 2) * 4;
+    return chunk;
+}
+
+// Wraps a program and an input signature into a DXBC container.
+inline tokens build_container(const tokens& program, bool shader_model_5)
+{
+    tokens shader = cat({ { shader_model_5 ? FOURCC_SHEX : FOURCC_SHDR, (uint32_t)program.size() * 4 }, program });
+    tokens signature = build_signature();
+    dxbc_chunk_header* chunks[] = { (dxbc_chunk_header*)&signature[0], (dxbc_chunk_header*)&shader[0] };
+    std::pair<void*, size_t> assembled = dxbc_assemble(chunks, 2);
+    tokens container(assembled.second / 4);
+    memcpy(&container[0], assembled.first, assembled.second);
+    free(assembled.first);
+    return container;
+}
+
+#endif /* SHADER_BUILDER_H_ */
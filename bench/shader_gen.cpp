@@ -0,0 +1,807 @@
+#include "shader_gen.h"
+#include <algorithm>
+
+namespace {
+
+// Operand letters of an instruction form:
+//   d  temp, output or relatively indexed temp destination    x  single-component temp destination
+//   e  double destination, .xy or .xyzw                         f  float source
+//   i  integer source                                           c  scalar condition
+//   a  scalar address                                           D  double source
+//   v  input register                                           t  texture t0
+//   b  raw buffer t1                                            B  structured buffer t2
+//   s  sampler s0                                               m  stream m0
+//   U  typed UAV u0 source            Y  typed UAV u0 destination
+//   R  raw UAV u1 source              W  raw UAV u1 destination
+//   P  structured UAV u2 source       V  structured UAV u2 destination
+//   g  raw TGSM g0 source             G  raw TGSM g0 destination
+//   h  structured TGSM g1 source      H  structured TGSM g1 destination
+enum form_flags
+{
+    FORM_SATURATE = 1,   // float result that may carry _sat
+    FORM_SAMPLE = 2,     // may carry aoffimmi and, in SM5, resource dimension and return type extended opcodes
+    FORM_PS = 4,         // pixel shaders only
+    FORM_GS = 8,         // geometry shaders only
+    FORM_CS = 16,        // compute shaders only
+    FORM_UAV = 32,       // pixel and compute shaders
+    FORM_SM4 = 64,       // replaced by another form in SM5
+};
+
+struct instruction_form
+{
+    D3D10_SB_OPCODE_TYPE opcode;
+    const char* operands;
+    uint8_t major;
+    uint8_t flags;
+    uint8_t weight;      // relative frequency, roughly as compiled shaders use them
+};
+
+const instruction_form forms[] = {
+    // Float arithmetic
+    { D3D10_SB_OPCODE_MOV, "df", 4, FORM_SATURATE, 12 },
+    { D3D10_SB_OPCODE_ADD, "dff", 4, FORM_SATURATE, 10 },
+    { D3D10_SB_OPCODE_MUL, "dff", 4, FORM_SATURATE, 10 },
+    { D3D10_SB_OPCODE_MAD, "dfff", 4, FORM_SATURATE, 10 },
+    { D3D10_SB_OPCODE_DIV, "dff", 4, FORM_SATURATE, 2 },
+    { D3D10_SB_OPCODE_DP2, "xff", 4, FORM_SATURATE, 2 },
+    { D3D10_SB_OPCODE_DP3, "xff", 4, FORM_SATURATE, 4 },
+    { D3D10_SB_OPCODE_DP4, "xff", 4, FORM_SATURATE, 4 },
+    { D3D10_SB_OPCODE_MIN, "dff", 4, FORM_SATURATE, 2 },
+    { D3D10_SB_OPCODE_MAX, "dff", 4, FORM_SATURATE, 2 },
+    { D3D10_SB_OPCODE_FRC, "df", 4, FORM_SATURATE, 1 },
+    { D3D10_SB_OPCODE_EXP, "df", 4, FORM_SATURATE, 1 },
+    { D3D10_SB_OPCODE_LOG, "df", 4, FORM_SATURATE, 1 },
+    { D3D10_SB_OPCODE_RSQ, "df", 4, FORM_SATURATE, 3 },
+    { D3D10_SB_OPCODE_SQRT, "df", 4, FORM_SATURATE, 1 },
+    { D3D10_SB_OPCODE_ROUND_NE, "df", 4, FORM_SATURATE, 1 },
+    { D3D10_SB_OPCODE_ROUND_NI, "df", 4, FORM_SATURATE, 1 },
+    { D3D10_SB_OPCODE_ROUND_PI, "df", 4, FORM_SATURATE, 1 },
+    { D3D10_SB_OPCODE_ROUND_Z, "df", 4, FORM_SATURATE, 1 },
+    { D3D10_SB_OPCODE_SINCOS, "ddf", 4, FORM_SATURATE, 1 },
+    { D3D10_SB_OPCODE_MOVC, "dcff", 4, FORM_SATURATE, 3 },
+    { D3D10_SB_OPCODE_EQ, "dff", 4, 0, 1 },
+    { D3D10_SB_OPCODE_NE, "dff", 4, 0, 1 },
+    { D3D10_SB_OPCODE_LT, "dff", 4, 0, 2 },
+    { D3D10_SB_OPCODE_GE, "dff", 4, 0, 2 },
+    { D3D10_SB_OPCODE_FTOI, "df", 4, 0, 2 },
+    { D3D10_SB_OPCODE_FTOU, "df", 4, 0, 2 },
+    { D3D10_SB_OPCODE_ITOF, "di", 4, 0, 2 },
+    { D3D10_SB_OPCODE_UTOF, "di", 4, 0, 2 },
+    { D3D10_SB_OPCODE_DERIV_RTX, "df", 4, FORM_SATURATE | FORM_PS, 1 },
+    { D3D10_SB_OPCODE_DERIV_RTY, "df", 4, FORM_SATURATE | FORM_PS, 1 },
+    { D3D11_SB_OPCODE_RCP, "df", 5, FORM_SATURATE, 2 },
+    { D3D11_SB_OPCODE_F32TOF16, "df", 5, 0, 1 },
+    { D3D11_SB_OPCODE_F16TOF32, "di", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DERIV_RTX_COARSE, "df", 5, FORM_SATURATE | FORM_PS, 1 },
+    { D3D11_SB_OPCODE_DERIV_RTX_FINE, "df", 5, FORM_SATURATE | FORM_PS, 1 },
+    { D3D11_SB_OPCODE_DERIV_RTY_COARSE, "df", 5, FORM_SATURATE | FORM_PS, 1 },
+    { D3D11_SB_OPCODE_DERIV_RTY_FINE, "df", 5, FORM_SATURATE | FORM_PS, 1 },
+
+    // Integer arithmetic
+    { D3D10_SB_OPCODE_IADD, "dii", 4, 0, 5 },
+    { D3D10_SB_OPCODE_IMUL, "ddii", 4, 0, 1 },
+    { D3D10_SB_OPCODE_IMAD, "diii", 4, 0, 2 },
+    { D3D10_SB_OPCODE_IMAX, "dii", 4, 0, 1 },
+    { D3D10_SB_OPCODE_IMIN, "dii", 4, 0, 1 },
+    { D3D10_SB_OPCODE_INEG, "di", 4, 0, 1 },
+    { D3D10_SB_OPCODE_ISHL, "dii", 4, 0, 2 },
+    { D3D10_SB_OPCODE_ISHR, "dii", 4, 0, 1 },
+    { D3D10_SB_OPCODE_USHR, "dii", 4, 0, 2 },
+    { D3D10_SB_OPCODE_AND, "dii", 4, 0, 4 },
+    { D3D10_SB_OPCODE_OR, "dii", 4, 0, 2 },
+    { D3D10_SB_OPCODE_XOR, "dii", 4, 0, 1 },
+    { D3D10_SB_OPCODE_NOT, "di", 4, 0, 1 },
+    { D3D10_SB_OPCODE_UDIV, "ddii", 4, 0, 1 },
+    { D3D10_SB_OPCODE_UMUL, "ddii", 4, 0, 1 },
+    { D3D10_SB_OPCODE_UMAD, "diii", 4, 0, 1 },
+    { D3D10_SB_OPCODE_UMAX, "dii", 4, 0, 1 },
+    { D3D10_SB_OPCODE_UMIN, "dii", 4, 0, 1 },
+    { D3D10_SB_OPCODE_IEQ, "dii", 4, 0, 2 },
+    { D3D10_SB_OPCODE_INE, "dii", 4, 0, 2 },
+    { D3D10_SB_OPCODE_ILT, "dii", 4, 0, 2 },
+    { D3D10_SB_OPCODE_IGE, "dii", 4, 0, 2 },
+    { D3D10_SB_OPCODE_ULT, "dii", 4, 0, 2 },
+    { D3D10_SB_OPCODE_UGE, "dii", 4, 0, 2 },
+    { D3D11_SB_OPCODE_UBFE, "diii", 5, 0, 1 },
+    { D3D11_SB_OPCODE_IBFE, "diii", 5, 0, 1 },
+    { D3D11_SB_OPCODE_BFI, "diiii", 5, 0, 1 },
+    { D3D11_SB_OPCODE_BFREV, "di", 5, 0, 1 },
+    { D3D11_SB_OPCODE_COUNTBITS, "di", 5, 0, 1 },
+    { D3D11_SB_OPCODE_FIRSTBIT_HI, "di", 5, 0, 1 },
+    { D3D11_SB_OPCODE_FIRSTBIT_LO, "di", 5, 0, 1 },
+    { D3D11_SB_OPCODE_FIRSTBIT_SHI, "di", 5, 0, 1 },
+    { D3D11_SB_OPCODE_UADDC, "ddii", 5, 0, 1 },
+    { D3D11_SB_OPCODE_USUBB, "ddii", 5, 0, 1 },
+    { D3D11_1_SB_OPCODE_MSAD, "diii", 5, 0, 1 },
+    { D3D11_SB_OPCODE_SWAPC, "ddcff", 5, 0, 1 },
+
+    // Double precision
+    { D3D11_SB_OPCODE_DADD, "eDD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DMUL, "eDD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DMAX, "eDD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DMIN, "eDD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DEQ, "xDD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DGE, "xDD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DLT, "xDD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DNE, "xDD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DMOV, "eD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DMOVC, "ecDD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_DTOF, "xD", 5, 0, 1 },
+    { D3D11_SB_OPCODE_FTOD, "ef", 5, 0, 1 },
+    { D3D11_1_SB_OPCODE_DDIV, "eDD", 5, 0, 1 },
+    { D3D11_1_SB_OPCODE_DFMA, "eDDD", 5, 0, 1 },
+    { D3D11_1_SB_OPCODE_DRCP, "eD", 5, 0, 1 },
+    { D3D11_1_SB_OPCODE_DTOI, "xD", 5, 0, 1 },
+    { D3D11_1_SB_OPCODE_DTOU, "xD", 5, 0, 1 },
+    { D3D11_1_SB_OPCODE_ITOD, "ei", 5, 0, 1 },
+    { D3D11_1_SB_OPCODE_UTOD, "ei", 5, 0, 1 },
+
+    // Textures and buffers
+    { D3D10_SB_OPCODE_SAMPLE, "dfts", 4, FORM_SAMPLE | FORM_PS, 5 },
+    { D3D10_SB_OPCODE_SAMPLE_B, "dftsf", 4, FORM_SAMPLE | FORM_PS, 1 },
+    { D3D10_SB_OPCODE_SAMPLE_C, "xftsf", 4, FORM_SAMPLE | FORM_PS, 1 },
+    { D3D10_SB_OPCODE_SAMPLE_L, "dftsf", 4, FORM_SAMPLE, 2 },
+    { D3D10_SB_OPCODE_SAMPLE_C_LZ, "xftsf", 4, FORM_SAMPLE, 1 },
+    { D3D10_SB_OPCODE_SAMPLE_D, "dftsff", 4, FORM_SAMPLE, 1 },
+    { D3D10_SB_OPCODE_LD, "dit", 4, FORM_SAMPLE, 2 },
+    { D3D10_SB_OPCODE_LD_MS, "dita", 4, FORM_SAMPLE, 1 },
+    { D3D10_SB_OPCODE_RESINFO, "dit", 4, 0, 1 },
+    { D3D10_1_SB_OPCODE_GATHER4, "dfts", 4, FORM_SAMPLE, 1 },
+    { D3D10_1_SB_OPCODE_LOD, "dfts", 4, FORM_PS, 1 },
+    { D3D10_1_SB_OPCODE_SAMPLE_INFO, "dt", 4, 0, 1 },
+    { D3D10_1_SB_OPCODE_SAMPLE_POS, "dta", 4, 0, 1 },
+    { D3D11_SB_OPCODE_GATHER4_C, "dftsf", 5, FORM_SAMPLE, 1 },
+    { D3D11_SB_OPCODE_GATHER4_PO, "dfits", 5, FORM_SAMPLE, 1 },
+    { D3D11_SB_OPCODE_GATHER4_PO_C, "dfitsf", 5, FORM_SAMPLE, 1 },
+    { D3D11_SB_OPCODE_BUFINFO, "db", 5, 0, 1 },
+    { D3D11_SB_OPCODE_LD_RAW, "xab", 5, 0, 2 },
+    { D3D11_SB_OPCODE_LD_STRUCTURED, "xaaB", 5, 0, 2 },
+
+    // Unordered access views
+    { D3D11_SB_OPCODE_LD_UAV_TYPED, "diU", 5, FORM_UAV, 2 },
+    { D3D11_SB_OPCODE_STORE_UAV_TYPED, "Yif", 5, FORM_UAV, 2 },
+    { D3D11_SB_OPCODE_LD_RAW, "xaR", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_STORE_RAW, "Wai", 5, FORM_UAV, 2 },
+    { D3D11_SB_OPCODE_LD_STRUCTURED, "xaaP", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_STORE_STRUCTURED, "Vaai", 5, FORM_UAV, 2 },
+    { D3D11_SB_OPCODE_ATOMIC_AND, "Wai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_ATOMIC_OR, "Wai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_ATOMIC_XOR, "Wai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_ATOMIC_CMP_STORE, "Waii", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_ATOMIC_IADD, "Wai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_ATOMIC_IMAX, "Wai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_ATOMIC_IMIN, "Wai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_ATOMIC_UMAX, "Wai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_ATOMIC_UMIN, "Wai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_IADD, "xWai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_AND, "xWai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_OR, "xWai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_XOR, "xWai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_EXCH, "xWai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_CMP_EXCH, "xWaii", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_IMAX, "xWai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_IMIN, "xWai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_UMAX, "xWai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_UMIN, "xWai", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_ALLOC, "xV", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_CONSUME, "xV", 5, FORM_UAV, 1 },
+    { D3D11_SB_OPCODE_SYNC, "", 5, FORM_UAV, 1 },
+
+    // Thread group shared memory
+    { D3D11_SB_OPCODE_STORE_RAW, "Gai", 5, FORM_CS, 2 },
+    { D3D11_SB_OPCODE_LD_RAW, "xag", 5, FORM_CS, 2 },
+    { D3D11_SB_OPCODE_STORE_STRUCTURED, "Haai", 5, FORM_CS, 2 },
+    { D3D11_SB_OPCODE_LD_STRUCTURED, "xaah", 5, FORM_CS, 2 },
+    { D3D11_SB_OPCODE_ATOMIC_IADD, "Gai", 5, FORM_CS, 1 },
+    { D3D11_SB_OPCODE_ATOMIC_UMAX, "Gai", 5, FORM_CS, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_IADD, "xGai", 5, FORM_CS, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_EXCH, "xGai", 5, FORM_CS, 1 },
+    { D3D11_SB_OPCODE_IMM_ATOMIC_CMP_EXCH, "xGaii", 5, FORM_CS, 1 },
+
+    // Stage specific
+    { D3D10_SB_OPCODE_DISCARD, "c", 4, FORM_PS, 1 },
+    { D3D11_SB_OPCODE_EVAL_CENTROID, "dv", 5, FORM_PS, 1 },
+    { D3D11_SB_OPCODE_EVAL_SNAPPED, "dvi", 5, FORM_PS, 1 },
+    { D3D11_SB_OPCODE_EVAL_SAMPLE_INDEX, "dva", 5, FORM_PS, 1 },
+    { D3D10_SB_OPCODE_EMIT, "", 4, FORM_GS | FORM_SM4, 3 },
+    { D3D10_SB_OPCODE_CUT, "", 4, FORM_GS | FORM_SM4, 1 },
+    { D3D10_SB_OPCODE_EMITTHENCUT, "", 4, FORM_GS | FORM_SM4, 1 },
+    { D3D11_SB_OPCODE_EMIT_STREAM, "m", 5, FORM_GS, 3 },
+    { D3D11_SB_OPCODE_CUT_STREAM, "m", 5, FORM_GS, 1 },
+    { D3D11_SB_OPCODE_EMITTHENCUT_STREAM, "m", 5, FORM_GS, 1 },
+    { D3D10_SB_OPCODE_NOP, "", 4, 0, 1 },
+};
+
+const uint32_t temp_count = 16;
+const uint32_t indexable_size = 16;
+const uint32_t input_count = 4;
+const uint32_t output_count = 2;
+const uint32_t icb_vectors = 16;
+const uint32_t structure_stride = 16;
+
+// Control flow blocks still open in the current body.
+struct open_block
+{
+    D3D10_SB_OPCODE_TYPE opcode;   // IF, LOOP or SWITCH
+    bool alternate;                // else or default already emitted
+    uint32_t cases;
+};
+
+tokens with_extension(tokens operand, uint32_t modifier, uint32_t precision)
+{
+    operand[0] |= ENCODE_D3D10_SB_OPERAND_EXTENDED(1);
+    operand.insert(operand.begin() + 1, ENCODE_D3D10_SB_EXTENDED_OPERAND_TYPE(D3D10_SB_EXTENDED_OPERAND_MODIFIER) |
+        ENCODE_D3D10_SB_EXTENDED_OPERAND_MODIFIER(modifier) | ENCODE_D3D11_SB_OPERAND_MIN_PRECISION(precision));
+    return operand;
+}
+
+tokens imm32_int(uint32_t x, uint32_t y, uint32_t z, uint32_t w)
+{
+    return { operand_token(D3D10_SB_OPERAND_TYPE_IMMEDIATE32, D3D10_SB_OPERAND_4_COMPONENT, 0), x, y, z, w };
+}
+
+// A register with two immediate indices and a write mask, as GS and HS input declarations use.
+tokens dst2d(D3D10_SB_OPERAND_TYPE type, uint32_t index0, uint32_t index1, uint32_t mask)
+{
+    return { operand_token(type, D3D10_SB_OPERAND_4_COMPONENT, 2) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE) | mask, index0, index1 };
+}
+
+// cb#[r#.c + offset]
+tokens cb_relative(uint32_t slot, uint32_t offset, uint32_t index_register, uint32_t component, uint32_t swizzle)
+{
+    return cat({ { operand_token(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, D3D10_SB_OPERAND_4_COMPONENT, 2) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MODE) | swizzle |
+        ENCODE_D3D10_SB_OPERAND_INDEX_REPRESENTATION(1, D3D10_SB_OPERAND_INDEX_IMMEDIATE32_PLUS_RELATIVE), slot, offset },
+        select1(D3D10_SB_OPERAND_TYPE_TEMP, index_register, component) });
+}
+
+// x#[r#.c + offset] as a destination.
+tokens indexable_dst(uint32_t offset, uint32_t index_register, uint32_t component, uint32_t mask)
+{
+    return cat({ { operand_token(D3D10_SB_OPERAND_TYPE_INDEXABLE_TEMP, D3D10_SB_OPERAND_4_COMPONENT, 2) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE) | mask |
+        ENCODE_D3D10_SB_OPERAND_INDEX_REPRESENTATION(1, D3D10_SB_OPERAND_INDEX_IMMEDIATE32_PLUS_RELATIVE), 0, offset },
+        select1(D3D10_SB_OPERAND_TYPE_TEMP, index_register, component) });
+}
+
+class generator
+{
+public:
+    generator(const shader_gen_options& opts)
+        : random(opts.seed), options(opts),
+          b(opts.type, version_major(opts), version_major(opts) == 5 ? 0 : 1)
+    {
+        sm5 = version_major(opts) == 5;
+        for (const instruction_form& form : forms)
+        {
+            if (allowed(form))
+            {
+                for (uint32_t i = 0; i < form.weight; i++)
+                    pool.push_back(&form);
+            }
+        }
+        b.reserve((size_t)opts.instructions * 8 + 256);
+    }
+
+    tokens run()
+    {
+        uint32_t budget = options.instructions < 10 ? 10 : options.instructions;
+        if (options.type == D3D11_SB_HULL_SHADER)
+        {
+            hull_shader(budget - 1);
+            return b.finish();
+        }
+
+        declare_common();
+        declare_stage();
+        declare_temps();
+        // Long programs get a subroutine, so call, callc and label show up too.
+        uint32_t subroutine = budget >= 60 ? budget / 10 : 0;
+        body(budget - subroutine - 1, subroutine != 0);
+        b.op(D3D10_SB_OPCODE_RET);
+        if (subroutine)
+        {
+            b.op(D3D10_SB_OPCODE_LABEL, resource(D3D10_SB_OPERAND_TYPE_LABEL, 0));
+            body(subroutine - 2, false);
+            b.op(D3D10_SB_OPCODE_RET);
+        }
+        return b.finish();
+    }
+
+private:
+    static uint32_t version_major(const shader_gen_options& opts)
+    {
+        return opts.type >= D3D11_SB_HULL_SHADER || opts.major_version >= 5 ? 5 : 4;
+    }
+
+    bool allowed(const instruction_form& form) const
+    {
+        if (form.major > (sm5 ? 5 : 4) || ((form.flags & FORM_SM4) && sm5))
+            return false;
+        if ((form.flags & FORM_PS) && options.type != D3D10_SB_PIXEL_SHADER)
+            return false;
+        if ((form.flags & FORM_GS) && options.type != D3D10_SB_GEOMETRY_SHADER)
+            return false;
+        if ((form.flags & FORM_CS) && options.type != D3D11_SB_COMPUTE_SHADER)
+            return false;
+        if ((form.flags & FORM_UAV) && options.type != D3D10_SB_PIXEL_SHADER && options.type != D3D11_SB_COMPUTE_SHADER)
+            return false;
+        return true;
+    }
+
+    bool has_inputs() const { return options.type != D3D11_SB_COMPUTE_SHADER; }
+    bool has_outputs() const { return options.type != D3D11_SB_COMPUTE_SHADER; }
+
+    uint32_t random_swizzle()
+    {
+        return ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE(random.below(4), random.below(4), random.below(4), random.below(4));
+    }
+    uint32_t random_mask() { return (1 + random.below(15)) << 4; }
+    uint32_t single_mask() { return D3D10_SB_OPERAND_4_COMPONENT_MASK_X << random.below(4); }
+    uint32_t temp() { return random.below(temp_count); }
+
+    // Modifiers go on about one source in seven, minimum precision on a few SM5 operands.
+    tokens decorate(tokens operand, bool allow_abs)
+    {
+        uint32_t modifier = D3D10_SB_OPERAND_MODIFIER_NONE;
+        uint32_t precision = D3D11_SB_OPERAND_MIN_PRECISION_DEFAULT;
+        if (random.percent(14))
+            modifier = allow_abs ? 1 + random.below(3) : (uint32_t)D3D10_SB_OPERAND_MODIFIER_NEG;
+        if (sm5 && random.percent(3))
+            precision = allow_abs ? D3D11_SB_OPERAND_MIN_PRECISION_FLOAT_16 : D3D11_SB_OPERAND_MIN_PRECISION_SINT_16;
+        if (modifier == D3D10_SB_OPERAND_MODIFIER_NONE && precision == D3D11_SB_OPERAND_MIN_PRECISION_DEFAULT)
+            return operand;
+        return with_extension(operand, modifier, precision);
+    }
+
+    tokens input_src()
+    {
+        uint32_t reg = random.below(input_count);
+        switch (options.type)
+        {
+        case D3D10_SB_GEOMETRY_SHADER:
+            return src2d(D3D10_SB_OPERAND_TYPE_INPUT, random.below(3), reg);
+        case D3D11_SB_HULL_SHADER:
+        case D3D11_SB_DOMAIN_SHADER:
+            return src2d(D3D11_SB_OPERAND_TYPE_INPUT_CONTROL_POINT, random.below(3), reg);
+        case D3D11_SB_COMPUTE_SHADER:
+            return special_src(D3D11_SB_OPERAND_TYPE_INPUT_THREAD_ID, random_swizzle());
+        default:
+            return src(D3D10_SB_OPERAND_TYPE_INPUT, reg, random_swizzle());
+        }
+    }
+
+    // Any register a float or integer source can read; immediates are typed by the caller.
+    tokens register_src()
+    {
+        uint32_t roll = random.below(100);
+        if (roll < 50)
+            return src(D3D10_SB_OPERAND_TYPE_TEMP, temp(), random_swizzle());
+        if (roll < 62)
+            return select1(D3D10_SB_OPERAND_TYPE_TEMP, temp(), random.below(4));
+        if (roll < 74)
+            return input_src();
+        if (roll < 84)
+        {
+            tokens operand = src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, random.below(16));
+            operand[0] = (operand[0] & ~D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MASK) | random_swizzle();
+            return operand;
+        }
+        if (roll < 88)
+            return src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 1, random.below(8));
+        if (roll < 93)
+            return cb_relative(0, random.below(8), temp(), random.below(4), random_swizzle());
+        if (roll < 97)
+            return icb_src(random.below(icb_vectors / 2), temp());
+        return relative_src(0, random.below(indexable_size / 2), temp());
+    }
+
+    tokens float_src()
+    {
+        if (random.percent(12))
+        {
+            float values[4];
+            for (float& value : values)
+                value = (float)(int)random.below(2001) / 100.0f - 10.0f;
+            return imm32(values[0], values[1], values[2], values[3]);
+        }
+        return decorate(register_src(), true);
+    }
+
+    tokens int_src()
+    {
+        if (random.percent(20))
+            return imm32_int(random.below(32), random.below(32), random.below(256), random.below(65536));
+        return decorate(register_src(), false);
+    }
+
+    tokens double_src()
+    {
+        if (random.percent(15))
+            return imm64((int)random.below(200) - 100.0, random.below(1000) / 8.0, 0.5, -0.25);
+        tokens operand = src(D3D10_SB_OPERAND_TYPE_TEMP, temp(),
+            random.percent(50) ? ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE(0, 1, 0, 1) : ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE(2, 3, 0, 1));
+        return random.percent(10) ? with_extension(operand, D3D10_SB_OPERAND_MODIFIER_NEG, D3D11_SB_OPERAND_MIN_PRECISION_DEFAULT) : operand;
+    }
+
+    tokens destination()
+    {
+        uint32_t roll = random.below(100);
+        if (roll < 8 && has_outputs())
+            return dst(D3D10_SB_OPERAND_TYPE_OUTPUT, random.below(output_count), random_mask());
+        if (roll < 14)
+            return indexable_dst(random.below(indexable_size / 2), temp(), random.below(4), random_mask());
+        tokens operand = dst(D3D10_SB_OPERAND_TYPE_TEMP, temp(), random_mask());
+        if (sm5 && random.percent(2))
+            return with_extension(operand, D3D10_SB_OPERAND_MODIFIER_NONE, D3D11_SB_OPERAND_MIN_PRECISION_FLOAT_16);
+        return operand;
+    }
+
+    tokens operand(char kind)
+    {
+        switch (kind)
+        {
+        case 'd': return destination();
+        case 'x': return dst(D3D10_SB_OPERAND_TYPE_TEMP, temp(), single_mask());
+        case 'e':
+            return dst(D3D10_SB_OPERAND_TYPE_TEMP, temp(), random.percent(50) ? D3D10_SB_OPERAND_4_COMPONENT_MASK_ALL :
+                D3D10_SB_OPERAND_4_COMPONENT_MASK_X | D3D10_SB_OPERAND_4_COMPONENT_MASK_Y);
+        case 'f': return float_src();
+        case 'i': return int_src();
+        case 'c': return select1(D3D10_SB_OPERAND_TYPE_TEMP, temp(), random.below(4));
+        case 'a':
+            if (random.percent(30))
+                return imm32_scalar(random.below(64) * 4);
+            return select1(D3D10_SB_OPERAND_TYPE_TEMP, temp(), random.below(4));
+        case 'D': return double_src();
+        case 'v': return src(D3D10_SB_OPERAND_TYPE_INPUT, random.below(input_count), random_swizzle());
+        case 't': return src(D3D10_SB_OPERAND_TYPE_RESOURCE, 0, random_swizzle());
+        case 'b': return src(D3D10_SB_OPERAND_TYPE_RESOURCE, 1, random_swizzle());
+        case 'B': return src(D3D10_SB_OPERAND_TYPE_RESOURCE, 2, random_swizzle());
+        case 's': return resource(D3D10_SB_OPERAND_TYPE_SAMPLER, 0);
+        case 'm': return resource(D3D11_SB_OPERAND_TYPE_STREAM, 0);
+        case 'U': return src(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 0, random_swizzle());
+        case 'Y': return dst(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 0);
+        case 'R': return src(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 1, random_swizzle());
+        case 'W': return dst(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 1, single_mask());
+        case 'P': return src(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 2, random_swizzle());
+        case 'V': return dst(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 2, single_mask());
+        case 'g': return src(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 0, random_swizzle());
+        case 'G': return dst(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 0, single_mask());
+        case 'h': return src(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 1, random_swizzle());
+        case 'H': return dst(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 1, single_mask());
+        default: return tokens();
+        }
+    }
+
+    uint32_t test()
+    {
+        return ENCODE_D3D10_SB_INSTRUCTION_TEST_BOOLEAN(random.percent(50) ? D3D10_SB_INSTRUCTION_TEST_NONZERO : D3D10_SB_INSTRUCTION_TEST_ZERO);
+    }
+
+    void instruction()
+    {
+        const instruction_form& form = *pool[random.below((uint32_t)pool.size())];
+        uint32_t controls = 0;
+        tokens body;
+
+        if (form.flags & FORM_SAMPLE)
+        {
+            tokens extended;
+            if (random.percent(25))
+            {
+                extended.push_back(ENCODE_D3D10_SB_EXTENDED_OPCODE_TYPE(D3D10_SB_EXTENDED_OPCODE_SAMPLE_CONTROLS) |
+                    ENCODE_IMMEDIATE_D3D10_SB_ADDRESS_OFFSET(D3D10_SB_IMMEDIATE_ADDRESS_OFFSET_U, random.below(16)) |
+                    ENCODE_IMMEDIATE_D3D10_SB_ADDRESS_OFFSET(D3D10_SB_IMMEDIATE_ADDRESS_OFFSET_V, random.below(16)));
+            }
+            if (sm5)
+            {
+                extended.push_back(ENCODE_D3D10_SB_EXTENDED_OPCODE_TYPE(D3D11_SB_EXTENDED_OPCODE_RESOURCE_DIM) |
+                    ENCODE_D3D11_SB_EXTENDED_RESOURCE_DIMENSION(D3D10_SB_RESOURCE_DIMENSION_TEXTURE2D));
+                uint32_t return_type = ENCODE_D3D10_SB_EXTENDED_OPCODE_TYPE(D3D11_SB_EXTENDED_OPCODE_RESOURCE_RETURN_TYPE);
+                for (uint32_t c = 0; c < 4; c++)
+                    return_type |= ENCODE_D3D11_SB_EXTENDED_RESOURCE_RETURN_TYPE(D3D10_SB_RETURN_TYPE_FLOAT, c);
+                extended.push_back(return_type);
+            }
+            if (!extended.empty())
+            {
+                controls |= ENCODE_D3D10_SB_OPCODE_EXTENDED(1);
+                for (size_t i = 0; i + 1 < extended.size(); i++)
+                    extended[i] |= ENCODE_D3D10_SB_OPCODE_EXTENDED(1);
+                body = extended;
+            }
+        }
+        if ((form.flags & FORM_SATURATE) && random.percent(10))
+            controls |= ENCODE_D3D10_SB_INSTRUCTION_SATURATE(1);
+        if (form.opcode == D3D10_SB_OPCODE_DISCARD)
+            controls |= test();
+        if (form.opcode == D3D11_SB_OPCODE_SYNC)
+        {
+            controls |= options.type == D3D11_SB_COMPUTE_SHADER ?
+                ENCODE_D3D11_SB_SYNC_FLAGS(D3D11_SB_SYNC_THREADS_IN_GROUP | D3D11_SB_SYNC_THREAD_GROUP_SHARED_MEMORY) :
+                ENCODE_D3D11_SB_SYNC_FLAGS(D3D11_SB_SYNC_UNORDERED_ACCESS_VIEW_MEMORY_GLOBAL);
+        }
+
+        for (const char* kind = form.operands; *kind; kind++)
+        {
+            tokens part = operand(*kind);
+            body.insert(body.end(), part.begin(), part.end());
+        }
+        b.op(form.opcode, body, controls);
+    }
+
+    // Emits exactly count instructions with balanced if, loop and switch blocks nested up to
+    // four deep. Instructions needed to close open blocks are reserved as blocks open.
+    void body(uint32_t count, bool calls)
+    {
+        std::vector<open_block> stack;
+        uint32_t emitted = 0;
+        uint32_t closing = 0;
+        while (emitted + closing < count)
+        {
+            uint32_t room = count - emitted - closing;
+            uint32_t roll = random.below(1000);
+            open_block* top = stack.empty() ? NULL : &stack.back();
+            bool in_loop = std::any_of(stack.begin(), stack.end(),
+                [](const open_block& block) { return block.opcode == D3D10_SB_OPCODE_LOOP; });
+
+            if (stack.size() < 4 && roll < 30 && room >= 2)
+            {
+                b.op(D3D10_SB_OPCODE_IF, operand('c'), test());
+                stack.push_back({ D3D10_SB_OPCODE_IF, false, 0 });
+                emitted += 1;
+                closing += 1;
+            }
+            else if (stack.size() < 4 && roll < 45 && room >= 3)
+            {
+                b.op(D3D10_SB_OPCODE_LOOP);
+                stack.push_back({ D3D10_SB_OPCODE_LOOP, false, 0 });
+                emitted += 1;
+                closing += 2;
+            }
+            else if (stack.size() < 4 && roll < 52 && room >= 4)
+            {
+                b.op(D3D10_SB_OPCODE_SWITCH, operand('c'));
+                b.op(D3D10_SB_OPCODE_CASE, imm32_scalar(0));
+                stack.push_back({ D3D10_SB_OPCODE_SWITCH, false, 1 });
+                emitted += 2;
+                closing += 2;
+            }
+            else if (top && roll < 110)
+            {
+                uint32_t cost = close(*top);
+                stack.pop_back();
+                emitted += cost;
+                closing -= cost;
+            }
+            else if (top && top->opcode == D3D10_SB_OPCODE_IF && !top->alternate && roll < 130)
+            {
+                b.op(D3D10_SB_OPCODE_ELSE);
+                top->alternate = true;
+                emitted += 1;
+            }
+            else if (top && top->opcode == D3D10_SB_OPCODE_SWITCH && !top->alternate && roll < 150 && room >= 2)
+            {
+                b.op(D3D10_SB_OPCODE_BREAK);
+                if (random.percent(20))
+                {
+                    b.op(D3D10_SB_OPCODE_DEFAULT);
+                    top->alternate = true;
+                }
+                else
+                    b.op(D3D10_SB_OPCODE_CASE, imm32_scalar(top->cases++));
+                emitted += 2;
+            }
+            else if (in_loop && roll < 165)
+            {
+                b.op(random.percent(70) ? D3D10_SB_OPCODE_BREAKC : D3D10_SB_OPCODE_CONTINUEC, operand('c'), test());
+                emitted += 1;
+            }
+            else if (calls && roll < 175)
+            {
+                if (random.percent(50))
+                    b.op(D3D10_SB_OPCODE_CALL, resource(D3D10_SB_OPERAND_TYPE_LABEL, 0));
+                else
+                    b.op(D3D10_SB_OPCODE_CALLC, cat({ operand('c'), resource(D3D10_SB_OPERAND_TYPE_LABEL, 0) }), test());
+                emitted += 1;
+            }
+            else if (roll < 178)
+            {
+                b.op(D3D10_SB_OPCODE_RETC, operand('c'), test());
+                emitted += 1;
+            }
+            else
+            {
+                instruction();
+                emitted += 1;
+            }
+        }
+        while (!stack.empty())
+        {
+            close(stack.back());
+            stack.pop_back();
+        }
+    }
+
+    uint32_t close(const open_block& block)
+    {
+        switch (block.opcode)
+        {
+        case D3D10_SB_OPCODE_LOOP:
+            b.op(D3D10_SB_OPCODE_BREAKC, operand('c'), test());
+            b.op(D3D10_SB_OPCODE_ENDLOOP);
+            return 2;
+        case D3D10_SB_OPCODE_SWITCH:
+            b.op(D3D10_SB_OPCODE_BREAK);
+            b.op(D3D10_SB_OPCODE_ENDSWITCH);
+            return 2;
+        default:
+            b.op(D3D10_SB_OPCODE_ENDIF);
+            return 1;
+        }
+    }
+
+    void declare_common()
+    {
+        uint32_t flags = D3D10_SB_GLOBAL_FLAG_REFACTORING_ALLOWED;
+        if (sm5)
+            flags |= D3D11_SB_GLOBAL_FLAG_ENABLE_DOUBLE_PRECISION_FLOAT_OPS | D3D11_SB_GLOBAL_FLAG_ENABLE_RAW_AND_STRUCTURED_BUFFERS |
+                D3D11_1_SB_GLOBAL_FLAG_ENABLE_MINIMUM_PRECISION | D3D11_1_SB_GLOBAL_FLAG_ENABLE_DOUBLE_EXTENSIONS;
+        b.op(D3D10_SB_OPCODE_DCL_GLOBAL_FLAGS, tokens(), flags);
+        b.icb(icb_vectors);
+        b.op(D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER, src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 16),
+            ENCODE_D3D10_SB_D3D10_SB_CONSTANT_BUFFER_ACCESS_PATTERN(D3D10_SB_CONSTANT_BUFFER_DYNAMIC_INDEXED));
+        b.op(D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER, src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 1, 8),
+            ENCODE_D3D10_SB_D3D10_SB_CONSTANT_BUFFER_ACCESS_PATTERN(D3D10_SB_CONSTANT_BUFFER_IMMEDIATE_INDEXED));
+        b.op(D3D10_SB_OPCODE_DCL_SAMPLER, resource(D3D10_SB_OPERAND_TYPE_SAMPLER, 0), ENCODE_D3D10_SB_SAMPLER_MODE(D3D10_SB_SAMPLER_MODE_DEFAULT));
+
+        uint32_t return_type = 0;
+        for (uint32_t c = 0; c < 4; c++)
+            return_type |= ENCODE_D3D10_SB_RESOURCE_RETURN_TYPE(D3D10_SB_RETURN_TYPE_FLOAT, c);
+        b.op(D3D10_SB_OPCODE_DCL_RESOURCE, cat({ resource(D3D10_SB_OPERAND_TYPE_RESOURCE, 0), { return_type } }),
+            ENCODE_D3D10_SB_RESOURCE_DIMENSION(D3D10_SB_RESOURCE_DIMENSION_TEXTURE2D));
+        if (!sm5)
+            return;
+        b.op(D3D11_SB_OPCODE_DCL_RESOURCE_RAW, resource(D3D10_SB_OPERAND_TYPE_RESOURCE, 1));
+        b.op(D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED, cat({ resource(D3D10_SB_OPERAND_TYPE_RESOURCE, 2), { structure_stride } }));
+        if (options.type == D3D10_SB_PIXEL_SHADER || options.type == D3D11_SB_COMPUTE_SHADER)
+        {
+            b.op(D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_TYPED, cat({ resource(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 0), { return_type } }),
+                ENCODE_D3D10_SB_RESOURCE_DIMENSION(D3D10_SB_RESOURCE_DIMENSION_TEXTURE2D));
+            b.op(D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW, resource(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 1),
+                D3D11_SB_GLOBALLY_COHERENT_ACCESS);
+            b.op(D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED,
+                cat({ resource(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 2), { structure_stride } }),
+                D3D11_SB_UAV_HAS_ORDER_PRESERVING_COUNTER);
+        }
+        if (options.type == D3D11_SB_COMPUTE_SHADER)
+        {
+            b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_RAW, cat({ resource(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 0), { 1024 } }));
+            b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_STRUCTURED,
+                cat({ resource(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 1), { structure_stride, 64 } }));
+        }
+    }
+
+    void declare_outputs()
+    {
+        for (uint32_t i = 0; i < output_count; i++)
+        {
+            if (i == 0 && options.type != D3D10_SB_PIXEL_SHADER && options.type != D3D11_SB_HULL_SHADER)
+                b.op(D3D10_SB_OPCODE_DCL_OUTPUT_SIV, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), { ENCODE_D3D10_SB_NAME(D3D10_SB_NAME_POSITION) } }));
+            else
+                b.op(D3D10_SB_OPCODE_DCL_OUTPUT, dst(D3D10_SB_OPERAND_TYPE_OUTPUT, i));
+        }
+    }
+
+    void declare_stage()
+    {
+        switch (options.type)
+        {
+        case D3D10_SB_PIXEL_SHADER:
+            for (uint32_t i = 0; i < input_count; i++)
+                b.op(D3D10_SB_OPCODE_DCL_INPUT_PS, dst(D3D10_SB_OPERAND_TYPE_INPUT, i),
+                    ENCODE_D3D10_SB_INPUT_INTERPOLATION_MODE(i ? D3D10_SB_INTERPOLATION_LINEAR : D3D10_SB_INTERPOLATION_CONSTANT));
+            declare_outputs();
+            break;
+        case D3D10_SB_VERTEX_SHADER:
+            for (uint32_t i = 0; i < input_count; i++)
+                b.op(D3D10_SB_OPCODE_DCL_INPUT, dst(D3D10_SB_OPERAND_TYPE_INPUT, i));
+            declare_outputs();
+            break;
+        case D3D10_SB_GEOMETRY_SHADER:
+            b.op(D3D10_SB_OPCODE_DCL_GS_INPUT_PRIMITIVE, tokens(), ENCODE_D3D10_SB_GS_INPUT_PRIMITIVE(D3D10_SB_PRIMITIVE_TRIANGLE));
+            if (sm5)
+                b.op(D3D11_SB_OPCODE_DCL_STREAM, resource(D3D11_SB_OPERAND_TYPE_STREAM, 0));
+            b.op(D3D10_SB_OPCODE_DCL_GS_OUTPUT_PRIMITIVE_TOPOLOGY, tokens(),
+                ENCODE_D3D10_SB_GS_OUTPUT_PRIMITIVE_TOPOLOGY(D3D10_SB_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP));
+            for (uint32_t i = 0; i < input_count; i++)
+                b.op(D3D10_SB_OPCODE_DCL_INPUT, dst2d(D3D10_SB_OPERAND_TYPE_INPUT, 3, i, D3D10_SB_OPERAND_4_COMPONENT_MASK_ALL));
+            declare_outputs();
+            b.op(D3D10_SB_OPCODE_DCL_MAX_OUTPUT_VERTEX_COUNT, { 64 });
+            break;
+        case D3D11_SB_DOMAIN_SHADER:
+            b.op(D3D11_SB_OPCODE_DCL_TESS_DOMAIN, tokens(), ENCODE_D3D11_SB_TESS_DOMAIN(D3D11_SB_TESSELLATOR_DOMAIN_TRI));
+            b.op(D3D11_SB_OPCODE_DCL_INPUT_CONTROL_POINT_COUNT, tokens(), ENCODE_D3D11_SB_INPUT_CONTROL_POINT_COUNT(3));
+            b.op(D3D10_SB_OPCODE_DCL_INPUT, special_dst(D3D11_SB_OPERAND_TYPE_INPUT_DOMAIN_POINT, D3D10_SB_OPERAND_4_COMPONENT,
+                D3D10_SB_OPERAND_4_COMPONENT_MASK_X | D3D10_SB_OPERAND_4_COMPONENT_MASK_Y | D3D10_SB_OPERAND_4_COMPONENT_MASK_Z));
+            for (uint32_t i = 0; i < input_count; i++)
+                b.op(D3D10_SB_OPCODE_DCL_INPUT, dst2d(D3D11_SB_OPERAND_TYPE_INPUT_CONTROL_POINT, 3, i, D3D10_SB_OPERAND_4_COMPONENT_MASK_ALL));
+            declare_outputs();
+            break;
+        case D3D11_SB_COMPUTE_SHADER:
+        default:
+            b.op(D3D10_SB_OPCODE_DCL_INPUT, special_dst(D3D11_SB_OPERAND_TYPE_INPUT_THREAD_ID, D3D10_SB_OPERAND_4_COMPONENT,
+                D3D10_SB_OPERAND_4_COMPONENT_MASK_X | D3D10_SB_OPERAND_4_COMPONENT_MASK_Y | D3D10_SB_OPERAND_4_COMPONENT_MASK_Z));
+            b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP, { 64, 1, 1 });
+            break;
+        }
+    }
+
+    void declare_temps()
+    {
+        b.op(D3D10_SB_OPCODE_DCL_TEMPS, { temp_count });
+        b.op(D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP, { 0, indexable_size, 4 });
+    }
+
+    // hs_decls, then a control point phase, two fork phases and a join phase sharing the budget.
+    // Every phase needs at least its marker and ret.
+    void hull_shader(uint32_t budget)
+    {
+        b.op(D3D11_SB_OPCODE_HS_DECLS);
+        b.op(D3D11_SB_OPCODE_DCL_INPUT_CONTROL_POINT_COUNT, tokens(), ENCODE_D3D11_SB_INPUT_CONTROL_POINT_COUNT(3));
+        b.op(D3D11_SB_OPCODE_DCL_OUTPUT_CONTROL_POINT_COUNT, tokens(), ENCODE_D3D11_SB_OUTPUT_CONTROL_POINT_COUNT(3));
+        b.op(D3D11_SB_OPCODE_DCL_TESS_DOMAIN, tokens(), ENCODE_D3D11_SB_TESS_DOMAIN(D3D11_SB_TESSELLATOR_DOMAIN_TRI));
+        b.op(D3D11_SB_OPCODE_DCL_TESS_PARTITIONING, tokens(), ENCODE_D3D11_SB_TESS_PARTITIONING(D3D11_SB_TESSELLATOR_PARTITIONING_INTEGER));
+        b.op(D3D11_SB_OPCODE_DCL_TESS_OUTPUT_PRIMITIVE, tokens(), ENCODE_D3D11_SB_TESS_OUTPUT_PRIMITIVE(D3D11_SB_TESSELLATOR_OUTPUT_TRIANGLE_CW));
+        float max_factor = 64.0f;
+        uint32_t max_factor_token;
+        memcpy(&max_factor_token, &max_factor, sizeof(max_factor_token));
+        b.op(D3D11_SB_OPCODE_DCL_HS_MAX_TESSFACTOR, { max_factor_token });
+        declare_common();
+
+        uint32_t phases[4] = { std::max(budget / 3, 2u), std::max(budget / 5, 2u), std::max(budget / 5, 2u), 0 };
+        phases[3] = budget - phases[0] - phases[1] - phases[2];
+        D3D10_SB_OPCODE_TYPE markers[4] = { D3D11_SB_OPCODE_HS_CONTROL_POINT_PHASE, D3D11_SB_OPCODE_HS_FORK_PHASE,
+            D3D11_SB_OPCODE_HS_FORK_PHASE, D3D11_SB_OPCODE_HS_JOIN_PHASE };
+        for (uint32_t phase = 0; phase < 4; phase++)
+        {
+            b.op(markers[phase]);
+            if (markers[phase] == D3D11_SB_OPCODE_HS_FORK_PHASE)
+            {
+                b.op(D3D11_SB_OPCODE_DCL_HS_FORK_PHASE_INSTANCE_COUNT, { 3 });
+                b.op(D3D10_SB_OPCODE_DCL_INPUT, special_dst(D3D11_SB_OPERAND_TYPE_INPUT_FORK_INSTANCE_ID, D3D10_SB_OPERAND_1_COMPONENT, 0));
+            }
+            else if (markers[phase] == D3D11_SB_OPCODE_HS_JOIN_PHASE)
+                b.op(D3D11_SB_OPCODE_DCL_HS_JOIN_PHASE_INSTANCE_COUNT, { 1 });
+            else
+            {
+                for (uint32_t i = 0; i < input_count; i++)
+                    b.op(D3D10_SB_OPCODE_DCL_INPUT, dst2d(D3D11_SB_OPERAND_TYPE_INPUT_CONTROL_POINT, 3, i, D3D10_SB_OPERAND_4_COMPONENT_MASK_ALL));
+            }
+            declare_outputs();
+            declare_temps();
+            body(phases[phase] - 2, false);
+            b.op(D3D10_SB_OPCODE_RET);
+        }
+    }
+
+    shader_gen_random random;
+    shader_gen_options options;
+    bool sm5;
+    program_builder b;
+    std::vector<const instruction_form*> pool;
+};
+
+} // namespace
+
+tokens shader_gen_program(const shader_gen_options& options)
+{
+    generator g(options);
+    return g.run();
+}
+
+tokens shader_gen_container(const shader_gen_options& options)
+{
+    return build_container(shader_gen_program(options), options.type >= D3D11_SB_HULL_SHADER || options.major_version >= 5);
+}
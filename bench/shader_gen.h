@@ -0,0 +1,43 @@
+#ifndef SHADER_GEN_H_
+#define SHADER_GEN_H_
+
+// Seeded generator of synthetic SM4/5 programs for scaling and stress runs. Programs are valid
+// token streams with realistic declarations and balanced control flow, and use every opcode class
+// the disassembler decodes.
+
+#include "shader_builder.h"
+
+// xorshift64*: the same sequence on every platform and standard library, which <random>'s
+// distributions do not promise.
+class shader_gen_random
+{
+public:
+    explicit shader_gen_random(uint64_t seed) : state(seed * 0x9e3779b97f4a7c15ull + 0x2545f4914f6cdd1dull) {}
+    uint64_t next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ull;
+    }
+    uint32_t below(uint32_t n) { return (uint32_t)(next() % n); }
+    bool percent(uint32_t p) { return below(100) < p; }
+private:
+    uint64_t state;
+};
+
+struct shader_gen_options
+{
+    D3D10_SB_TOKENIZED_PROGRAM_TYPE type;
+    uint32_t major_version;      // 4 or 5; hull, domain and compute shaders are always 5
+    uint32_t instructions;       // executable instructions, declarations not counted; at least 10
+    uint64_t seed;
+};
+
+// The same options always give the same tokens.
+tokens shader_gen_program(const shader_gen_options& options);
+
+// shader_gen_program wrapped in a DXBC container with an input signature.
+tokens shader_gen_container(const shader_gen_options& options);
+
+#endif /* SHADER_GEN_H_ */
@@ -1,8 +1,13 @@
+#ifndef D3D11TOKENPARSER_H_
+#define D3D11TOKENPARSER_H_
+
 #include <d3d11TokenizedProgramFormat.hpp>
 #include <d3d11shader.h>
 #include <stdint.h>
 #include <iostream>
+#include <vector>
 #include <assert.h>
+#include "arena.h"
 
 // Human readiable texts for SM4/5 tokens
 extern const char* ShaderTypeText[];
@@ -21,6 +26,28 @@ extern const char* PrimitiveText[];
 extern const char* TessDomainText[];
 extern const char* TessPartitionText[];
 extern const char* TessOutputPrimText[];
+// Entry counts of the tables above. Token fields are wider than the tables, so lookups of values
+// read from a program go through TokenText.
+extern const uint32_t ShaderTypeTextCount;
+extern const uint32_t OpcodeTextCount;
+extern const uint32_t OperandTextCount;
+extern const uint32_t ModifierTextCount;
+extern const uint32_t MinPrecisionTextCount;
+extern const uint32_t InterpModeTextCount;
+extern const uint32_t NameTextCount;
+extern const uint32_t ResourceDimTextCount;
+extern const uint32_t CustomDataTextCount;
+extern const uint32_t ReturnTypeTextCount;
+extern const uint32_t SampleModeTextCount;
+extern const uint32_t PrimTopoTextCount;
+extern const uint32_t PrimitiveTextCount;
+extern const uint32_t TessDomainTextCount;
+extern const uint32_t TessPartitionTextCount;
+extern const uint32_t TessOutputPrimTextCount;
+inline const char* TokenText(const char* table[], uint32_t count, uint32_t value)
+{
+	return value < count ? table[value] : "<unknown>";
+}
 // Different opcodes have different requirements for immediate values
 enum class OPCODE_DATA_TYPE {
 	UNKNOWN = 0,
@@ -31,23 +58,147 @@ enum class OPCODE_DATA_TYPE {
 };
 extern const OPCODE_DATA_TYPE OpcodeDataType[];
 
-// Output assembly directly. No intermidiate structure is used in the parser.
-class TokenParser
+// Why decoding stopped. Anything but OK and END means the program is malformed.
+enum class DECODE_STATUS {
+	OK = 0,
+	END = 1,
+	TRUNCATED = 2,
+	INVALID_OPCODE = 3,
+	INVALID_OPERAND = 4,
+	TOO_MUCH_DATA = 5,
+};
+extern const char* DecodeStatusText[];
+
+#define DECODED_NO_OPERAND 0xffffffffu
+#define DECODED_MAX_EXT_OPCODES 3
+#define DECODED_MAX_DATA 8
+#define DECODED_MAX_RELATIVE_DEPTH 4
+
+// One index of a register operand.
+struct DecodedIndex
+{
+	uint32_t representation;	// D3D10_SB_OPERAND_INDEX_REPRESENTATION
+	uint32_t relative;			// operand pool position of the relative register, DECODED_NO_OPERAND if none
+	uint64_t value;				// immediate part; 64-bit forms keep the first token in the high half
+};
+
+struct DecodedOperand
+{
+	uint32_t token;
+	uint32_t extToken;			// 0 if not extended
+	uint8_t type;				// D3D10_SB_OPERAND_TYPE
+	uint8_t numComponents;		// 0, 1 or 4
+	uint8_t selectionMode;		// D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE
+	uint8_t mask;				// bit n set when component n is written, for mask mode
+	uint8_t swizzle[4];			// component read into each position, for swizzle and select-1 modes
+	uint8_t indexDim;
+	uint8_t modifier;			// D3D10_SB_OPERAND_MODIFIER
+	uint8_t minPrecision;		// D3D11_SB_OPERAND_MIN_PRECISION
+	uint8_t immCount;			// tokens in imm
+	DecodedIndex index[3];
+	uint32_t imm[8];			// immediate32 values, or immediate64 values as token pairs
+};
+
+typedef std::vector<DecodedOperand, arena_allocator<DecodedOperand> > DecodedOperandPool;
+
+// Operands are kept in a caller-owned pool: the top-level ones at
+// [firstOperand, firstOperand + operandCount), followed by the relative index registers they use.
+struct DecodedInstruction
+{
+	D3D10_SB_OPCODE_TYPE opcode;
+	uint32_t opcodeToken;
+	uint32_t offset;			// token position of the opcode token, counted from the version token
+	uint32_t length;			// in tokens, including the opcode token
+	uint32_t firstOperand;
+	uint8_t operandCount;
+	uint8_t relativeCount;
+	uint8_t extOpcodeCount;
+	uint8_t dataCount;
+	uint8_t skipped;			// operands present but not decoded
+	uint32_t extOpcodeTokens[DECODED_MAX_EXT_OPCODES];
+	uint32_t data[DECODED_MAX_DATA];	// declaration values stored after (or instead of) operands
+};
+
+// True for dcl_* opcodes and custom data, which describe the program rather than execute.
+bool IsDeclaration(D3D10_SB_OPCODE_TYPE opcode);
+// Declaration values that follow each operand of a declaration, 0 for anything else.
+uint32_t DeclarationDataPerOperand(D3D10_SB_OPCODE_TYPE opcode);
+// Operands at the start of an instruction that it writes: registers, or the memory that stores and
+// atomics write. 0 for declarations and flow control.
+uint32_t DestinationCount(D3D10_SB_OPCODE_TYPE opcode);
+// True for instructions whose result component n is computed from component n of each source,
+// after the swizzle, so the components a source is read in follow the destination's write mask.
+bool IsComponentwise(D3D10_SB_OPCODE_TYPE opcode);
+// Components of a source register that are read at the given swizzle positions (bit n for
+// position n), through the operand's swizzle, select or mask.
+uint32_t ComponentsRead(const DecodedOperand& operand, uint32_t positions);
+// Swizzle positions an instruction reads its sources at: those its destinations write for
+// componentwise instructions, all four for anything else.
+uint32_t SourcePositions(const DecodedInstruction& inst, const DecodedOperand* operands);
+
+// Decodes a SM4/5 token stream one instruction at a time, without producing any text.
+// Every read is bounds checked, so malformed programs end in an error status instead of a crash.
+// A decoder only touches its own state and the caller's pool, so any number may run concurrently.
+class TokenDecoder
 {
 public:
-	TokenParser(uint32_t* tokens, uint32_t sizeInBytes)
+	// Scratch space for relative index registers comes from arena, or the heap without one.
+	TokenDecoder(const uint32_t* tokens, uint32_t sizeInBytes, fxdis_arena* arena = NULL)
+		: relative(arena)
 	{
 		tokenBegin = tokens;
 		tokenCurrent = tokenBegin;
+		tokenEnd = tokenBegin;
 		tokenSize = sizeInBytes / 4;
+		version = 0;
+		declaredSize = 0;
+	}
+	// Reads the version and length tokens.
+	DECODE_STATUS DecodeHeader();
+	// Decodes the next instruction, appending its operands to operands. Returns END after the last one.
+	DECODE_STATUS Next(DecodedInstruction& inst, DecodedOperandPool& operands);
+	uint32_t Version() const { return version; }
+	bool SizeMismatch() const { return tokenSize != declaredSize; }
+	uint32_t Position() const { return (uint32_t)(tokenCurrent - tokenBegin); }
+	const uint32_t* Tokens() const { return tokenBegin; }
+private:
+	DECODE_STATUS DecodeOperand(DecodedOperand& operand, uint32_t depth);
+	DECODE_STATUS DecodeOperands(DecodedInstruction& inst, DecodedOperandPool& operands, uint32_t dataPerOperand, bool once);
+	DECODE_STATUS DecodeData(DecodedInstruction& inst, uint32_t count);
+	const uint32_t* tokenBegin;
+	uint32_t tokenSize;
+	const uint32_t* tokenCurrent;
+	const uint32_t* tokenEnd;
+	const uint32_t* opcodeEnd;
+	uint32_t version;
+	uint32_t declaredSize;
+	DecodedOperandPool relative;
+};
+
+// Output assembly of a token stream, formatted one decoded instruction at a time.
+class TokenParser
+{
+public:
+	// Decoded operands are kept in arena if one is given.
+	TokenParser(const uint32_t* tokens, uint32_t sizeInBytes, std::ostream& output = std::cout, fxdis_arena* arena = NULL)
+		: out(output)
+	{
+		tokenBegin = tokens;
+		tokenSize = sizeInBytes;
+		this->arena = arena;
 	}
 	~TokenParser() { ; };
-	void Parse();
+	// Returns false if the program is malformed; the instructions before the error are still printed.
+	bool Parse();
+	// Writes the shader model line, and a note if the length token disagrees with the program size.
+	static void FormatHeader(std::ostream& out, uint32_t version, bool sizeMismatch);
+	static void FormatInstruction(std::ostream& out, const DecodedInstruction& inst, const DecodedOperand* operands, const uint32_t* tokens);
 private:
-	void ParseOpcode();
-	void ParseOperand(bool firstOperand, D3D10_SB_OPCODE_TYPE opcodeType);
-	uint32_t* tokenBegin;
+	static void FormatOperand(std::ostream& out, const DecodedOperand* operands, uint32_t operand, bool firstOperand, D3D10_SB_OPCODE_TYPE opcodeType);
+	const uint32_t* tokenBegin;
 	uint32_t tokenSize;
-	uint32_t* tokenCurrent;
-	uint32_t* tokenEnd;
-};
\ No newline at end of file
+	std::ostream& out;
+	fxdis_arena* arena;
+};
+
+#endif /* D3D11TOKENPARSER_H_ */
@@ -0,0 +1,101 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+// Bump allocator for everything that lives as long as one shader: the container view, signatures,
+// decoded operands and file data. Nothing is freed on its own; reset() drops it all at once and
+// keeps the memory for the next shader, so a batch settles at zero heap allocations per shader.
+
+#include <stddef.h>
+#include <stdint.h>
+
+class fxdis_arena
+{
+public:
+    explicit fxdis_arena(size_t block_size = 64 << 10);
+    // Starts out in caller-owned memory such as a stack buffer, and only goes to the heap once that
+    // is full.
+    fxdis_arena(void* buffer, size_t size);
+    ~fxdis_arena();
+
+    // Returns NULL only if the heap is exhausted.
+    void* allocate(size_t size, size_t align = sizeof(void*) * 2);
+    template<typename T> T* allocate_array(size_t count)
+    {
+        return (T*)allocate(sizeof(T) * count, alignof(T));
+    }
+
+    // Releases everything at once. When the last shader overflowed into more than one block,
+    // they are replaced by a single block holding the high-water mark.
+    void reset();
+
+    size_t used() const { return retired + (size_t)(current - block_begin); }
+    size_t high_water() const { return peak > used() ? peak : used(); }
+    size_t reserved() const { return heap_bytes; }
+    uint64_t heap_blocks() const { return block_count; }
+
+private:
+    friend class fxdis_arena_scope;
+    struct block
+    {
+        block* next;
+        size_t size;
+    };
+    bool grow(size_t size);
+    void release_blocks();
+
+    char* current;
+    char* limit;
+    char* block_begin;
+    block* blocks;
+    char* initial;
+    size_t initial_size;
+    size_t block_size;
+    size_t retired;             // bytes used in blocks before the current one, waste included
+    size_t peak;
+    size_t heap_bytes;
+    uint64_t block_count;
+    unsigned depth;
+
+    fxdis_arena(const fxdis_arena&);
+    fxdis_arena& operator=(const fxdis_arena&);
+};
+
+// Marks the lifetime of one shader. Scopes nest, as when an archive entry is disassembled inside
+// the handling of its archive; only the outermost one resets the arena.
+class fxdis_arena_scope
+{
+public:
+    explicit fxdis_arena_scope(fxdis_arena& arena) : arena(arena) { arena.depth++; }
+    ~fxdis_arena_scope()
+    {
+        if (!--arena.depth)
+            arena.reset();
+    }
+private:
+    fxdis_arena& arena;
+};
+
+// Standard allocator over an arena, for the containers kept in per-shader data. Without an arena
+// it uses the heap, so the same types serve code that has none.
+template<typename T>
+class arena_allocator
+{
+public:
+    typedef T value_type;
+    arena_allocator(fxdis_arena* arena = NULL) : arena(arena) {}
+    template<typename U> arena_allocator(const arena_allocator<U>& other) : arena(other.arena) {}
+    T* allocate(size_t count)
+    {
+        return arena ? arena->allocate_array<T>(count) : (T*)::operator new(sizeof(T) * count);
+    }
+    void deallocate(T* p, size_t)
+    {
+        if (!arena)
+            ::operator delete(p);
+    }
+    template<typename U> bool operator==(const arena_allocator<U>& other) const { return arena == other.arena; }
+    template<typename U> bool operator!=(const arena_allocator<U>& other) const { return arena != other.arena; }
+    fxdis_arena* arena;
+};
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,65 @@
+#ifndef BUFFER_ACCESS_H_
+#define BUFFER_ACCESS_H_
+
+// Layout and access pattern findings for structured and raw buffers, t# and u#, from their
+// declarations and from every ld_structured, store_structured, ld_raw and store_raw of them.
+//
+// - unaligned_stride: a dcl_resource_structured or dcl_uav_structured stride that is neither a
+//   multiple of 16 bytes nor a divisor of 16, so structures straddle 16-byte boundaries and
+//   loading one takes more memory transactions than its size needs.
+// - partial_load: an ld_structured of a buffer whose loads, all taken together, read only part of
+//   its structure. The rest is fetched along with what is read and thrown away. Loads with an
+//   offset that is not an immediate count as reading the whole structure.
+// - scattered: in a compute shader, an access whose address is not an affine function of the
+//   thread id, as thread_affine.h works it out; lanes read wherever their data says.
+// - strided: in a compute shader, an access whose address is affine in the thread id, but whose
+//   lanes are so far apart that the worst wave of a group uses less than half the bytes of the
+//   cache lines it touches. A uniform constant in the address is taken as 0, so lines are counted
+//   as if the buffer started on one. Accesses with the same address in every lane are broadcasts
+//   and are not reported.
+//
+// Lanes are taken to run in the order of vThreadIDInGroupFlattened. The cache line size and wave
+// width come from the hardware profile. Other shader types have no thread id to relate lanes by,
+// so only their strides and partial loads are checked.
+
+#include <stdint.h>
+#include <vector>
+#include "D3D11TokenParser.h"
+#include "cfg.h"
+#include "occupancy.h"
+#include "thread_affine.h"
+
+enum buffer_finding_kind
+{
+    BUFFER_UNALIGNED_STRIDE,
+    BUFFER_PARTIAL_LOAD,
+    BUFFER_SCATTERED,
+    BUFFER_STRIDED,
+};
+extern const char* buffer_finding_text[];
+
+struct buffer_finding
+{
+    uint32_t kind;                      // buffer_finding_kind
+    uint32_t instruction;               // the declaration for unaligned_stride, the access otherwise
+    uint32_t type;                      // D3D10_SB_OPERAND_TYPE_RESOURCE or UNORDERED_ACCESS_VIEW
+    uint32_t reg;                       // t# or u# as declared
+    uint32_t stride;                    // bytes per structure, 0 for raw buffers
+    uint32_t bytes;                     // bytes each lane reads or writes, 0 for unaligned_stride
+    double efficiency;                  // partial_load: share of the structure the loads read;
+                                        // strided: share of the cache line bytes the worst wave uses
+    thread_affine address;              // strided: the byte address each lane reaches
+};
+
+struct buffer_report
+{
+    std::vector<buffer_finding> findings;   // in program order
+};
+
+// Runs the analysis over a program and the graph cfg_build made of it, reusing result's storage.
+// Takes the time thread_affine_solve does for compute shaders, and for each of their accesses,
+// time linear in the threads of a group. Returns false where thread_affine_solve does.
+bool buffer_access_analyze(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, const hardware_profile& profile, buffer_report& result);
+
+#endif /* BUFFER_ACCESS_H_ */
@@ -0,0 +1,75 @@
+#ifndef CBUFFER_USAGE_H_
+#define CBUFFER_USAGE_H_
+
+// Which bytes of each constant buffer a program reads, against the bytes bound for it.
+//
+// Every cb#[i] source operand of every instruction, and every one used as a relative index, reads
+// the components its swizzle picks at the positions the instruction reads (SourcePositions, or
+// .xy and .xyz for dp2 and dp3) of 16-byte register i. A read indexed by a register, cb#[r#.x + i],
+// may reach any register from i to the end of the buffer, so all of them are counted.
+//
+// Compilers cut the dcl_constantbuffer size down to the last register they read, while the
+// application still uploads the whole buffer the RDEF chunk describes. Where a layout from RDEF
+// names the buffer, its size is taken if larger, and its variables can be checked one by one.
+// Constant buffers only declared in RDEF, not in the program, are not reported.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "D3D11TokenParser.h"
+
+// The largest constant buffer Direct3D binds, in 16-byte registers; sizes are cut to it.
+#define CBUFFER_MAX_REGISTERS 4096u
+#define CBUFFER_NO_LAYOUT 0xffffffffu
+
+struct cbuffer_variable
+{
+    std::string name;
+    uint32_t offset;                    // bytes from the start of the buffer
+    uint32_t size;                      // bytes
+};
+
+// A constant buffer as the RDEF chunk describes it.
+struct cbuffer_layout
+{
+    std::string name;
+    uint32_t reg;                       // cb# it is bound to
+    uint32_t size;                      // bytes
+    std::vector<cbuffer_variable> variables;
+};
+
+// Reads the constant buffers, not tbuffers, of an RDEF chunk of size bytes, data pointing past its
+// chunk header. Returns false, with layouts empty, if an offset or count leaves the chunk or a name
+// is not terminated within it.
+bool cbuffer_layouts_parse(const void* data, uint32_t size, std::vector<cbuffer_layout>& layouts);
+
+struct cbuffer_usage
+{
+    uint32_t reg;                       // cb#
+    uint32_t declaration;               // instruction of its dcl_constantbuffer
+    bool dynamic;                       // declared dynamicIndexed
+    bool relative;                      // some read is indexed by a register
+    uint32_t declared_bytes;            // 16 times the dcl_constantbuffer size
+    uint32_t size_bytes;                // the larger of that and its layout's size
+    uint32_t layout;                    // in the layouts given, CBUFFER_NO_LAYOUT if none names it
+    std::vector<uint8_t> components;    // per 16-byte register of size_bytes, bit n set when component
+                                        // n is read
+    uint32_t read_bytes;
+    uint32_t interior_unused_bytes;     // bytes not read before the last one that is
+    uint32_t trailing_unused_bytes;     // bytes after the last one read; all of them if none is
+};
+
+struct cbuffer_report
+{
+    std::vector<cbuffer_usage> buffers; // in declaration order
+};
+
+// Runs the analysis over a program, with layouts from cbuffer_layouts_parse or empty. Takes time
+// linear in its operands plus the registers of the buffers it declares.
+void cbuffer_usage_analyze(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const std::vector<cbuffer_layout>& layouts, cbuffer_report& result);
+
+// Bytes of [offset, offset + size) that the program reads.
+uint32_t cbuffer_bytes_read(const cbuffer_usage& usage, uint32_t offset, uint32_t size);
+
+#endif /* CBUFFER_USAGE_H_ */
@@ -0,0 +1,128 @@
+#ifndef CFG_H_
+#define CFG_H_
+
+// Control-flow graph of a decoded program, built in one pass over its instructions.
+//
+// SM4/5 flow control is structured: if/else/endif, loop/endloop and switch/case/endswitch nest,
+// break and continue go to the innermost enclosing construct, and subroutines are the code after a
+// label, reached by call and callc. Hull shaders split the program into phases instead of (or as
+// well as) subroutines. The graph follows that structure directly, so building it needs no
+// dominator or interval analysis: a stack of open constructs is enough, and loops come out exact.
+//
+// Blocks, functions, loops and calls are all numbered in program order, and everything refers to
+// everything else by index. The instructions the graph was built from are not kept; every range is
+// of positions in the caller's instruction array.
+
+#include <stdint.h>
+#include <vector>
+#include <iostream>
+#include "D3D11TokenParser.h"
+
+#define CFG_NONE 0xffffffffu
+
+// Control can leave the function at the end of the block: ret, retc, or the function running out.
+#define CFG_BLOCK_EXIT 1u
+
+enum cfg_edge_kind
+{
+    CFG_EDGE_FALLTHROUGH,       // to the next block, also from if into its first branch and from the
+                                // conditional breakc, continuec and retc when they are not taken
+    CFG_EDGE_BRANCH,            // if to its else or endif, else to endif, switch to a case
+    CFG_EDGE_BREAK,             // break and breakc to the end of the loop or switch
+    CFG_EDGE_CONTINUE,          // continue and continuec to the loop header
+    CFG_EDGE_BACK,              // endloop to the loop header
+};
+
+enum cfg_function_kind
+{
+    CFG_FUNCTION_MAIN,          // from the start of the program to the first label or phase
+    CFG_FUNCTION_SUBROUTINE,    // from a label to the next one
+    CFG_FUNCTION_HS_DECLS,
+    CFG_FUNCTION_HS_CONTROL_POINT_PHASE,
+    CFG_FUNCTION_HS_FORK_PHASE,
+    CFG_FUNCTION_HS_JOIN_PHASE,
+};
+extern const char* cfg_function_kind_text[];
+
+struct cfg_edge
+{
+    uint32_t from;
+    uint32_t to;
+    uint32_t kind;              // cfg_edge_kind
+};
+
+struct cfg_block
+{
+    uint32_t first;             // instructions [first, end)
+    uint32_t end;
+    uint32_t function;
+    uint32_t loop;              // innermost loop the block belongs to, CFG_NONE outside any loop
+    uint32_t flags;             // CFG_BLOCK_*
+    uint32_t first_successor;   // cfg::successors[first_successor, first_successor + successor_count)
+    uint32_t successor_count;
+    uint32_t first_predecessor; // cfg::predecessors, likewise
+    uint32_t predecessor_count;
+};
+
+// A loop/endloop pair. Its body is a contiguous run of blocks, from the one after the loop
+// instruction up to and including the one that ends with endloop.
+struct cfg_loop
+{
+    uint32_t header;            // first block of the body, where continue and endloop go
+    uint32_t end;               // the body is blocks [header, end)
+    uint32_t exit;              // block after endloop, where break goes; CFG_NONE if the function ends there
+    uint32_t parent;            // enclosing loop, CFG_NONE for an outermost one
+    uint32_t depth;             // 1 for an outermost loop
+    uint32_t instruction;       // position of the loop instruction
+};
+
+struct cfg_function
+{
+    uint32_t kind;              // cfg_function_kind
+    uint32_t label;             // label number of a subroutine, CFG_NONE for anything else
+    uint32_t first_block;       // blocks [first_block, end_block); the first is the entry
+    uint32_t end_block;
+    uint32_t first_call;        // calls made from the function, cfg::calls[first_call, + call_count)
+    uint32_t call_count;
+};
+
+// call, callc or fcall.
+struct cfg_call
+{
+    uint32_t instruction;
+    uint32_t block;
+    uint32_t caller;            // function
+    uint32_t callee;            // function; CFG_NONE for fcall, whose target is chosen at run time,
+                                // and for labels the program does not define
+};
+
+struct cfg
+{
+    std::vector<cfg_block> blocks;
+    std::vector<cfg_edge> successors;       // grouped by from
+    std::vector<cfg_edge> predecessors;     // the same edges grouped by to
+    std::vector<cfg_loop> loops;            // parents come before the loops they contain
+    std::vector<cfg_function> functions;
+    std::vector<cfg_call> calls;
+    std::vector<uint32_t> block_of;         // block of every instruction
+};
+
+// Builds the graph of count instructions whose operands are in the pool given, the way ir_encode
+// decodes a program. Declarations stay in the blocks they appear in. Takes time linear in the
+// number of instructions, and reuses graph's storage. Returns false if flow control is not
+// properly nested: an else, endif, endloop, case or endswitch that closes nothing, a break or
+// continue outside a loop or switch, or a construct still open where its function ends.
+bool cfg_build(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands, cfg& graph);
+
+// Depth of the loop nest the block is in, 0 outside any loop.
+inline uint32_t cfg_loop_depth(const cfg& graph, uint32_t block)
+{
+    uint32_t loop = graph.blocks[block].loop;
+    return loop == CFG_NONE ? 0 : graph.loops[loop].depth;
+}
+
+// Writes the graph in Graphviz dot syntax as a digraph called name: one cluster per function, a
+// node per block labelled with its instructions, and dotted edges from calls to the callee's entry.
+void cfg_write_dot(const cfg& graph, const DecodedInstruction* instructions, const char* name, std::ostream& out);
+
+#endif /* CFG_H_ */
@@ -0,0 +1,87 @@
+#ifndef COST_MODEL_H_
+#define COST_MODEL_H_
+
+// Static cost estimate of a program: a cost for every opcode, weighted by how often the block it
+// is in runs.
+//
+// Nothing is known about the values a program sees, so how often a block runs is guessed from its
+// structure alone. Every branch of an if or switch is taken, every loop runs the profile's
+// loop_iterations times per level of nesting, a subroutine runs as often as the blocks that call
+// it, and a hull shader fork or join phase runs once per declared instance. The result is meant for
+// comparing builds of the same shader and ranking shaders against each other, not for predicting
+// time on any GPU.
+//
+// The costs come from a profile. The default one is a generic GPU where simple arithmetic costs 1.
+// Profiles for particular hardware are text files that change only what they name:
+//
+//     # comments run to the end of the line
+//     name vendor-x
+//     loop_iterations 16
+//     class texture 6
+//     opcode sample_d 12
+//     latency class texture 400
+//
+// class sets every opcode of a cost class (see cost_class_text), opcode sets one opcode by its name
+// in OpcodeText. Either one after the word latency sets latencies instead of costs. Lines apply in
+// order, so an opcode line after a class line overrides it.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "D3D11TokenParser.h"
+#include "cfg.h"
+
+enum cost_class
+{
+    COST_CLASS_NONE,            // declarations, labels, phase markers and nop: not executed
+    COST_CLASS_ALU,             // float and integer arithmetic, comparisons, conversions, bit ops
+    COST_CLASS_TRANSCENDENTAL,  // exp, log, rcp, rsq, sqrt, sincos and the divisions
+    COST_CLASS_DOUBLE,          // double precision arithmetic and conversions
+    COST_CLASS_TEXTURE,         // sampling, gathers, typed loads from shader resources, resource queries
+    COST_CLASS_MEMORY,          // UAV loads and stores, raw and structured buffers, group shared memory,
+                                // atomics and sync
+    COST_CLASS_FLOW,            // branches, loops, calls, discard and geometry shader emit and cut
+    COST_CLASS_COUNT,
+};
+extern const char* cost_class_text[];
+
+// Cost class of an opcode, COST_CLASS_NONE for values beyond the opcode table.
+uint32_t cost_class_of(D3D10_SB_OPCODE_TYPE opcode);
+
+struct cost_profile
+{
+    std::string name;
+    double loop_iterations;                     // times each loop is assumed to run
+    float opcode_cost[D3D10_SB_NUM_OPCODES];    // cost of one instruction with each opcode
+    float opcode_latency[D3D10_SB_NUM_OPCODES]; // time until its results can be used, in the same units
+};
+
+// The built-in generic profile: ALU 1, transcendental 4, double 8, texture 8, memory 16, flow 2 and
+// loops run 8 times. Latencies are ALU 4, transcendental and double 16, texture and memory 200 and
+// flow 1.
+void cost_profile_default(cost_profile& profile);
+
+// Applies a profile file of size bytes on top of profile. Returns false, with the 1-based number of
+// the offending line in error_line, for an unknown keyword, class or opcode, or a value that is not
+// a non-negative number; lines before it have been applied.
+bool cost_profile_parse(const char* text, size_t size, cost_profile& profile, uint32_t& error_line);
+
+struct cost_estimate
+{
+    double total;                           // the whole program, everything below summed
+    double classes[COST_CLASS_COUNT];       // total split by cost class
+    uint32_t hottest_block;                 // block with the highest cost, CFG_NONE if nothing costs anything
+    std::vector<double> frequency;          // times each block is assumed to run per invocation
+    std::vector<double> instructions;       // opcode cost times the frequency of its block
+    std::vector<double> blocks;             // the block's instructions summed; calls do not include the callee
+    std::vector<double> functions;          // the function's blocks summed
+};
+
+// Estimates the cost of a program of count instructions and the graph cfg_build made of it. Takes
+// one pass over the instructions and one over the calls, and reuses result's storage. Subroutines
+// reached only through fcall, whose targets are chosen at run time, count as never run.
+void cost_estimate_program(const DecodedInstruction* instructions, uint32_t count, const cfg& graph,
+    const cost_profile& profile, cost_estimate& result);
+
+#endif /* COST_MODEL_H_ */
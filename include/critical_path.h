@@ -0,0 +1,56 @@
+#ifndef CRITICAL_PATH_H_
+#define CRITICAL_PATH_H_
+
+// Critical-path latency of each basic block: the longest chain of instructions in it that each wait
+// for a result of the one before.
+//
+// Within a block, an instruction depends on the last earlier instruction that wrote a component it
+// reads. Components are tracked for r# and, per array, for x#. A load from a u# or g# register, or
+// an atomic that returns a value, also depends on the last earlier store or atomic to that
+// register. An instruction starts once everything it depends on has finished, and finishes after
+// its opcode's latency in the cost profile. Values coming into the block are ready at its start,
+// and calls are treated like any other instruction, so the callee adds nothing to the chain.
+//
+// Comparing the latency with the block's issue time, its opcode costs summed, shows how serial the
+// block is. A single slow instruction, such as one sample, is expected to outlast the block around
+// it, and GPUs hide that by running other waves meanwhile. A block is latency bound when its
+// critical path is longer than its issue time plus its slowest instruction: it then holds chains of
+// dependent instructions that keep it waiting. That comparison only means something if the
+// profile's costs and latencies are in the same unit.
+
+#include <stdint.h>
+#include <vector>
+#include "D3D11TokenParser.h"
+#include "cfg.h"
+#include "cost_model.h"
+
+struct block_latency
+{
+    double latency;             // finish time of the last instruction of the critical path
+    double issue;               // the block's opcode costs summed
+    double slowest;             // latency of the block's slowest instruction
+    uint32_t chain_first;       // first and last instructions of the critical path, CFG_NONE if nothing
+    uint32_t chain_last;        // in the block has any latency
+    uint32_t chain_length;      // instructions on the path
+};
+
+inline bool block_latency_bound(const block_latency& block)
+{
+    return block.latency > block.issue + block.slowest;
+}
+
+struct latency_estimate
+{
+    std::vector<block_latency> blocks;
+    std::vector<double> finish;         // finish time of each instruction, from the start of its block
+    std::vector<uint32_t> previous;     // dependency of each one that finished last, CFG_NONE if none
+    std::vector<uint32_t> writer;       // working storage: last writer of each tracked component
+};
+
+// Finds the critical path of every block of a program of count instructions, whose operands are in
+// the pool given, and the graph cfg_build made of it. Takes time linear in the number of operands,
+// and reuses result's storage. Registers numbered 4096 and above are not tracked.
+void latency_estimate_program(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, const cost_profile& profile, latency_estimate& result);
+
+#endif /* CRITICAL_PATH_H_ */
@@ -41,6 +41,7 @@
 #include <map>
 #include <iostream>
 #include "le32.h"
+#include "arena.h"
 
 #define FOURCC(a, b, c, d) ((uint32_t)(uint8_t)(a) | ((uint32_t)(uint8_t)(b) << 8) | ((uint32_t)(uint8_t)(c) << 16) | ((uint32_t)(uint8_t)(d) << 24 ))
 #define FOURCC_DXBC FOURCC('D', 'X', 'B', 'C')
@@ -80,9 +81,11 @@ struct dxbc_chunk_signature : public dxbc_chunk_header
 
 struct dxbc_container
 {
+   dxbc_container(fxdis_arena* arena = 0)
+      : data(0), chunks(arena), chunk_map(std::less<unsigned>(), arena) {}
    const void* data;
-   std::vector<dxbc_chunk_header*> chunks;
-   std::map<unsigned, unsigned> chunk_map;
+   std::vector<dxbc_chunk_header*, arena_allocator<dxbc_chunk_header*> > chunks;
+   std::map<unsigned, unsigned, std::less<unsigned>, arena_allocator<std::pair<const unsigned, unsigned> > > chunk_map;
 };
 
 struct dxbc_container_header
@@ -94,11 +97,17 @@ struct dxbc_container_header
    uint32_t chunk_count;
 };
 
-dxbc_container* dxbc_parse(const void* data, int size);
+/* with an arena, the container lives in it and must not be deleted */
+dxbc_container* dxbc_parse(const void* data, int size, fxdis_arena* arena = 0);
 std::ostream& operator <<(std::ostream& out, const dxbc_container& container);
+/* prints the line operator << prints for chunk i, fourcc in file byte order and size native */
+void dxbc_format_chunk(std::ostream& out, unsigned i, unsigned fourcc, size_t offset, uint32_t size);
 
 dxbc_chunk_header* dxbc_find_chunk(const void* data, int size, unsigned fourcc);
 
+/* returns the number of chunks, or -1 unless data is a container whose chunks all lie within size bytes */
+int dxbc_count_chunks(const void* data, int size);
+
 static inline dxbc_chunk_header* dxbc_find_shader_bytecode(const void* data, int size)
 {
    dxbc_chunk_header* chunk;
@@ -127,8 +136,9 @@ static inline dxbc_chunk_signature* dxbc_find_signature(const void* data, int si
 
 struct _D3D11_SIGNATURE_PARAMETER_DESC;
 typedef struct _D3D11_SIGNATURE_PARAMETER_DESC D3D11_SIGNATURE_PARAMETER_DESC;
-int dxbc_parse_signature(dxbc_chunk_signature* sig, D3D11_SIGNATURE_PARAMETER_DESC** params);
+/* params and the assembled container come from the arena if one is given, and must be freed otherwise */
+int dxbc_parse_signature(dxbc_chunk_signature* sig, D3D11_SIGNATURE_PARAMETER_DESC** params, fxdis_arena* arena = 0);
 
-std::pair<void*, size_t> dxbc_assemble(struct dxbc_chunk_header** chunks, unsigned num_chunks);
+std::pair<void*, size_t> dxbc_assemble(struct dxbc_chunk_header** chunks, unsigned num_chunks, fxdis_arena* arena = 0);
 
 #endif /* DXBC_H_ */
@@ -0,0 +1,114 @@
+#ifndef FXDIS_STATS_H_
+#define FXDIS_STATS_H_
+
+// Per-phase timers and counters behind fxdis --stats. Code is instrumented with FXDIS_STATS_TIME
+// and FXDIS_STATS_ADD, which do nothing unless a thread has installed a fxdis_stats with
+// fxdis_stats_scope, and expand to nothing at all when FXDIS_STATS is not defined.
+
+#include <stdint.h>
+
+enum FXDIS_STATS_PHASE
+{
+    FXDIS_STATS_READ,
+    FXDIS_STATS_PARSE,
+    FXDIS_STATS_FIND_CHUNK,
+    FXDIS_STATS_DECODE,
+    FXDIS_STATS_FORMAT,
+    FXDIS_STATS_WRITE,
+    FXDIS_STATS_PHASE_COUNT
+};
+
+enum FXDIS_STATS_COUNTER
+{
+    FXDIS_STATS_FILES,
+    FXDIS_STATS_INSTRUCTIONS,
+    FXDIS_STATS_OPERANDS,
+    FXDIS_STATS_EXTENDED_TOKENS,    // extended opcode and extended operand tokens
+    FXDIS_STATS_RELATIVE_OPERANDS,  // registers used as a relative index
+    FXDIS_STATS_BYTES_EMITTED,
+    FXDIS_STATS_ALLOCATIONS,
+    FXDIS_STATS_COUNTER_COUNT
+};
+
+extern const char* FxdisStatsPhaseText[];
+extern const char* FxdisStatsCounterText[];
+
+struct fxdis_stats
+{
+    uint64_t ns[FXDIS_STATS_PHASE_COUNT];
+    uint64_t counters[FXDIS_STATS_COUNTER_COUNT];
+    // Memory use, filled in by whoever reports.
+    uint64_t arena_high_water;  // bytes of the largest shader's per-shader data
+    uint64_t arena_reserved;    // bytes the arena holds on to between shaders
+    uint64_t peak_rss_kb;
+};
+
+#ifdef FXDIS_STATS
+
+#include <chrono>
+
+// The statistics of the calling thread, NULL when nobody asked for them.
+extern thread_local fxdis_stats* fxdis_stats_current;
+
+// Installs stats for the calling thread for the lifetime of the scope.
+class fxdis_stats_scope
+{
+public:
+    explicit fxdis_stats_scope(fxdis_stats* stats) : previous(fxdis_stats_current) { fxdis_stats_current = stats; }
+    ~fxdis_stats_scope() { fxdis_stats_current = previous; }
+private:
+    fxdis_stats* previous;
+};
+
+class fxdis_stats_timer;
+
+// The innermost running timer of the calling thread.
+extern thread_local fxdis_stats_timer* fxdis_stats_timing;
+
+// Time spent in a nested timer counts for its phase only, not also for the enclosing one's, so
+// that output written while formatting is write time and the phases add up to the total.
+class fxdis_stats_timer
+{
+public:
+    explicit fxdis_stats_timer(FXDIS_STATS_PHASE phase) : stats(fxdis_stats_current), phase(phase), nested(0)
+    {
+        if (stats)
+        {
+            outer = fxdis_stats_timing;
+            fxdis_stats_timing = this;
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    ~fxdis_stats_timer()
+    {
+        if (stats)
+        {
+            uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            stats->ns[phase] += elapsed - nested;
+            if (outer)
+                outer->nested += elapsed;
+            fxdis_stats_timing = outer;
+        }
+    }
+private:
+    fxdis_stats* stats;
+    FXDIS_STATS_PHASE phase;
+    uint64_t nested;            // ns of timers started inside this one
+    fxdis_stats_timer* outer;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define FXDIS_STATS_CONCAT_(a, b) a##b
+#define FXDIS_STATS_CONCAT(a, b) FXDIS_STATS_CONCAT_(a, b)
+// Adds the time until the end of the enclosing scope, less that of timers nested in it, to phase.
+#define FXDIS_STATS_TIME(phase) fxdis_stats_timer FXDIS_STATS_CONCAT(fxdis_stats_timer_, __LINE__)(phase)
+#define FXDIS_STATS_ADD(counter, n) do { if (fxdis_stats_current) fxdis_stats_current->counters[counter] += (n); } while (0)
+
+#else
+
+#define FXDIS_STATS_TIME(phase)
+#define FXDIS_STATS_ADD(counter, n) do { } while (0)
+
+#endif
+
+#endif /* FXDIS_STATS_H_ */
@@ -0,0 +1,96 @@
+#ifndef IR_H_
+#define IR_H_
+
+// Decoded programs saved in a binary form that is used where it lies, whether read into memory or
+// mapped from a file. The instruction and operand records are the decoder's own structures;
+// everything refers to everything else by index, so the file needs no fixing up after loading.
+//
+// The records are written as they are in memory, so a file is only read back on a host of the
+// byte order that wrote it; ir_validate rejects one whose magic reads byte-swapped. The tokens keep
+// the program's own byte order, as TokenDecoder reads them.
+//
+// Layout, each section 8-byte aligned:
+//   ir_header
+//   DecodedInstruction[instruction_count]
+//   DecodedOperand[operand_count]     one pool for the whole program; DecodedInstruction::firstOperand
+//                                     and DecodedIndex::relative index into it
+//   uint32_t[token_count]             the original tokens, which custom data and immediate constant
+//                                     buffers are formatted from
+//   ir_chunk[chunk_count]             the chunk table of the container the program came from, so
+//                                     that the IR prints the same "# DXBC chunk" lines; none for
+//                                     a bare token stream
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "D3D11TokenParser.h"
+#include "dxbc.h"
+
+#define IR_MAGIC 0x52495846u        // "FXIR"
+#define IR_MAGIC_SWAPPED 0x46584952u // written on a host of the other byte order
+#define IR_VERSION 2u
+
+#define IR_FLAG_SIZE_MISMATCH 1u    // the program's length token disagreed with its size
+
+struct ir_header
+{
+    uint32_t magic;
+    uint32_t version;               // readers reject any version but their own
+    uint32_t header_size;
+    uint32_t record_sizes;          // sizeof(DecodedInstruction) | sizeof(DecodedOperand) << 16
+    uint32_t total_size;            // of the whole file
+    uint32_t flags;
+    uint32_t program_version;       // version token of the program
+    uint32_t instruction_count;
+    uint32_t operand_count;
+    uint32_t token_count;
+    uint32_t instructions_offset;   // offsets are from the start of the header
+    uint32_t operands_offset;
+    uint32_t tokens_offset;
+    uint32_t chunk_count;
+    uint32_t chunks_offset;
+    uint32_t reserved;
+};
+
+struct ir_chunk
+{
+    uint32_t fourcc;                // as the container stores it
+    uint32_t offset;                // of the chunk header in the container
+    uint32_t size;                  // of the chunk data, in bytes
+};
+
+// Decodes a token stream and appends its IR to out, with the chunk table of container if the
+// tokens came from one. Returns the final decode status; out is only written when that is END.
+DECODE_STATUS ir_encode(const uint32_t* tokens, uint32_t sizeInBytes, std::vector<char>& out,
+    const dxbc_container* container = NULL);
+
+// Checks everything readers rely on: header, version, bounds, alignment, and that every operand
+// and token reference stays inside the file. Takes one pass over the records and touches no
+// tokens. Returns NULL if data is not a valid IR file of exactly size bytes.
+const ir_header* ir_validate(const void* data, size_t size);
+
+inline const DecodedInstruction* ir_instructions(const ir_header* ir)
+{
+    return (const DecodedInstruction*)((const char*)ir + ir->instructions_offset);
+}
+
+inline const DecodedOperand* ir_operands(const ir_header* ir)
+{
+    return (const DecodedOperand*)((const char*)ir + ir->operands_offset);
+}
+
+inline const uint32_t* ir_tokens(const ir_header* ir)
+{
+    return (const uint32_t*)((const char*)ir + ir->tokens_offset);
+}
+
+inline const ir_chunk* ir_chunks(const ir_header* ir)
+{
+    return (const ir_chunk*)((const char*)ir + ir->chunks_offset);
+}
+
+// Prints a validated IR program exactly as fxdis prints the input it came from: the chunk table,
+// then what TokenParser::Parse prints.
+void ir_format(const ir_header* ir, std::ostream& out);
+
+#endif /* IR_H_ */
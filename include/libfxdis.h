@@ -0,0 +1,106 @@
+#ifndef LIBFXDIS_H_
+#define LIBFXDIS_H_
+
+/* C interface to the disassembler, for embedding it in other processes.
+ *
+ * Every call works only on the memory passed to it: nothing is allocated on the caller's behalf
+ * that outlives the call, no global state is touched and no exception leaves the library, so
+ * any number of threads may use it at once. Malformed input is reported through fxdis_result
+ * rather than by crashing the host.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32) && defined(FXDIS_SHARED)
+#ifdef FXDIS_BUILDING
+#define FXDIS_API __declspec(dllexport)
+#else
+#define FXDIS_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define FXDIS_API __attribute__((visibility("default")))
+#else
+#define FXDIS_API
+#endif
+
+typedef enum fxdis_result
+{
+    FXDIS_OK = 0,
+    FXDIS_ERROR_INVALID_ARGUMENT,
+    FXDIS_ERROR_INVALID_CONTAINER,   /* not a DXBC container, or one with chunks out of bounds */
+    FXDIS_ERROR_NO_SHADER,           /* the container has no SHDR or SHEX chunk */
+    FXDIS_ERROR_INVALID_PROGRAM,     /* the shader tokens are malformed; output up to the error is kept */
+    FXDIS_ERROR_BUFFER_TOO_SMALL,    /* the output was truncated */
+    FXDIS_ERROR_ABORTED              /* a callback asked to stop */
+} fxdis_result;
+
+/* A container opened in place. It points into the caller's data, which must be 4-byte aligned
+ * and outlive it.
+ */
+typedef struct fxdis_container
+{
+    const void* data;
+    size_t size;
+    const uint32_t* program;     /* shader tokens, starting at the version token */
+    size_t program_size;         /* in bytes */
+    uint32_t chunk_count;
+} fxdis_container;
+
+typedef struct fxdis_program_info
+{
+    uint32_t program_type;               /* D3D10_SB_TOKENIZED_PROGRAM_TYPE: 0 ps, 1 vs, 2 gs, 3 hs, 4 ds, 5 cs */
+    uint32_t major_version;
+    uint32_t minor_version;
+    uint32_t instruction_count;          /* excluding declarations */
+    uint32_t declaration_count;
+    uint32_t temp_registers;             /* from dcl_temps */
+    uint32_t indexable_temp_registers;   /* summed over dcl_indexableTemp */
+    uint32_t thread_group[3];            /* from dcl_thread_group, zero for other stages */
+} fxdis_program_info;
+
+typedef struct fxdis_instruction
+{
+    uint32_t opcode;             /* D3D10_SB_OPCODE_TYPE */
+    const char* name;            /* static text, valid for the life of the library */
+    uint32_t offset;             /* token position within the program */
+    uint32_t length;             /* in tokens */
+    uint32_t operand_count;
+    int is_declaration;
+} fxdis_instruction;
+
+/* Receives disassembly text in pieces. Return nonzero to stop early. */
+typedef int (*fxdis_write_fn)(void* user, const char* text, size_t size);
+
+/* Receives every instruction in program order. Return nonzero to stop early. */
+typedef int (*fxdis_instruction_fn)(void* user, const fxdis_instruction* instruction);
+
+/* Validates a DXBC container and locates its shader program. A bare SM4/5 token stream, as
+ * found in a SHDR/SHEX chunk, is accepted too and opens with chunk_count 0.
+ */
+FXDIS_API fxdis_result fxdis_open(fxdis_container* container, const void* data, size_t size);
+
+/* Disassembles into buffer, always NUL-terminated when buffer_size is nonzero. *needed, if not
+ * NULL, receives the full text length without the terminator, as snprintf would return, so a
+ * caller can retry with a large enough buffer after FXDIS_ERROR_BUFFER_TOO_SMALL.
+ */
+FXDIS_API fxdis_result fxdis_disassemble_to_buffer(const fxdis_container* container, char* buffer, size_t buffer_size, size_t* needed);
+
+/* Disassembles, handing the text to write as it is produced. */
+FXDIS_API fxdis_result fxdis_disassemble_to_callback(const fxdis_container* container, fxdis_write_fn write, void* user);
+
+/* Decodes the program without formatting it. info and callback may each be NULL. */
+FXDIS_API fxdis_result fxdis_analyze(const fxdis_container* container, fxdis_program_info* info, fxdis_instruction_fn callback, void* user);
+
+/* Static description of a result code. */
+FXDIS_API const char* fxdis_result_text(fxdis_result result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBFXDIS_H_ */
@@ -0,0 +1,70 @@
+#ifndef LINT_H_
+#define LINT_H_
+
+// Rules that flag known-slow patterns in a program, checked as it is decoded.
+//
+// Each rule looks at one declaration or instruction at a time, so the checker takes instructions in
+// program order straight from TokenDecoder::Next and keeps nothing of them but its findings. Only
+// the globally coherent rule waits for the end of the program, to see whether anything needed the
+// coherence. Rule IDs and names are stable: rules are only ever added, with new IDs.
+
+#include <stdint.h>
+#include <vector>
+#include "D3D11TokenParser.h"
+
+enum lint_rule
+{
+    LINT_SKIP_OPTIMIZATION,         // FXL0001: compiled with optimizations skipped, a debug build
+    LINT_DOUBLE_PRECISION,          // FXL0002: a double precision instruction
+    LINT_DYNAMIC_CONSTANT_BUFFER,   // FXL0003: a constant buffer declared dynamic indexed
+    LINT_INDEXABLE_TEMP,            // FXL0004: an indexable temp array, usually kept in scratch memory
+    LINT_SAMPLE_RATE_INPUT,         // FXL0005: a pixel shader input interpolated per sample, or
+                                    // SV_SampleIndex, either of which makes it run once per sample
+    LINT_UNNEEDED_COHERENCE,        // FXL0006: a globally coherent UAV in a program that never
+                                    // fences UAV memory across thread groups
+    LINT_RULE_COUNT,
+};
+
+enum lint_level
+{
+    LINT_NOTE,                      // worth knowing, often intended
+    LINT_WARNING,                   // likely to cost performance
+};
+extern const char* lint_level_text[];
+
+struct lint_rule_info
+{
+    const char* id;                 // "FXL0001"
+    const char* name;               // "skip-optimization"
+    lint_level level;
+    const char* description;        // one sentence
+};
+extern const lint_rule_info lint_rules[LINT_RULE_COUNT];
+
+struct lint_finding
+{
+    uint32_t rule;                  // lint_rule
+    uint32_t instruction;           // position of the instruction in the program
+    uint32_t offset;                // token position of its opcode token
+    uint32_t length;                // its length in tokens
+    uint32_t opcode;
+    uint32_t index;                 // register named: cb#, x#, v# or u#; 0 for the other rules
+    uint32_t size;                  // constant buffer or indexable temp size in vectors, 0 otherwise
+};
+
+struct lint_checker
+{
+    std::vector<lint_finding> findings;     // in program order once lint_end has run
+    std::vector<lint_finding> coherent;     // working storage: globally coherent UAV declarations
+    uint32_t instructions;                  // instructions seen
+    bool global_fence;                      // some sync fences UAV memory globally
+};
+
+// Starts a program, reusing checker's storage.
+void lint_begin(lint_checker& checker);
+// Checks the next instruction of the program; operands is the pool the decoder appends to.
+void lint_instruction(lint_checker& checker, const DecodedInstruction& inst, const DecodedOperand* operands);
+// Adds the findings that needed the whole program and sorts them by instruction.
+void lint_end(lint_checker& checker);
+
+#endif /* LINT_H_ */
@@ -0,0 +1,47 @@
+#ifndef LIVENESS_H_
+#define LIVENESS_H_
+
+// Per-component liveness of temporary registers, and the register pressure that follows from it.
+//
+// A component of r# is live between a write and the last read that write can reach. Sources are
+// read in the components their swizzle selects at the positions the instruction uses (see
+// SourcePositions), and destinations kill only the components in their write mask. Indexable
+// temps (x#) are tracked per array and component; as the element written is rarely known, writes
+// never kill them, and an array only counts as live once some path from the function's entry may
+// have written it.
+//
+// Temps are shared between a program and its subroutines, so calls are followed: whatever the
+// callee may read is live before the call, and whatever is live after any call of a subroutine is
+// live where it returns. Calls are assumed to kill nothing. fcall targets are not known, so their
+// bodies see nothing live on return. Hull shader phases do not share temps with each other.
+
+#include <stdint.h>
+#include <vector>
+#include "D3D11TokenParser.h"
+#include "cfg.h"
+
+// Registers the analysis accepts; SM5 allows 4096 temps in all.
+#define LIVENESS_MAX_REGISTERS 4096u
+
+struct temp_pressure
+{
+    uint32_t declared_temps;        // largest dcl_temps of any function or hull shader phase
+    uint32_t declared_indexable;    // largest total size of the dcl_indexableTemp arrays of one
+                                    // function or phase
+    uint32_t peak_temps;            // most r# registers with any component live at one instruction
+    uint32_t peak_components;       // most r# components live at one instruction
+    uint32_t peak_indexable;        // most x# registers live at one instruction, counting whole arrays
+    uint32_t peak_instruction;      // first instruction where peak_temps is reached, CFG_NONE if no
+                                    // temp is ever live
+    // r# registers live at each instruction: the larger of the counts before and after it. Peaks
+    // are taken over these, so declarations, which get 0, never hold one.
+    std::vector<uint16_t> live_temps;
+};
+
+// Runs the analysis over a program and the graph cfg_build made of it. Takes a few passes over the
+// blocks for each level of loop nesting, each linear in the number of blocks times the registers
+// used. Returns false if the program names a register beyond LIVENESS_MAX_REGISTERS.
+bool liveness_analyze(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, temp_pressure& result);
+
+#endif /* LIVENESS_H_ */
@@ -0,0 +1,90 @@
+#ifndef OCCUPANCY_H_
+#define OCCUPANCY_H_
+
+// Occupancy of a compute shader: how many of its waves a GPU can keep resident per SIMD, from what
+// the program declares.
+//
+// A thread group of dcl_thread_group x * y * z threads runs as whole waves, all on one compute
+// unit. Each thread needs registers for dcl_temps, counted as four each, and for the
+// dcl_indexableTemp arrays, counted as size times components; compilers often pack temps tighter,
+// so this is an upper bound. Each group needs the thread group shared memory its dcl_tgsm_raw and
+// dcl_tgsm_structured declarations add up to. A compute unit holds as many groups as its
+// registers, its shared memory and its group limit all allow, and the waves of those groups are
+// spread over its SIMDs.
+//
+// The numbers come from a hardware profile. The default one is a GCN-like GPU. Profiles for other
+// hardware are text files that change only what they name, one setting per line:
+//
+//     # comments run to the end of the line
+//     name rdna-wave32
+//     wave_width 32
+//     max_waves_per_simd 16
+//     registers_per_simd 1024
+//
+// The settings are the members of hardware_profile below.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "D3D11TokenParser.h"
+
+struct hardware_profile
+{
+    std::string name;
+    uint32_t wave_width;                // threads per wave
+    uint32_t simds_per_cu;              // SIMDs in a compute unit
+    uint32_t max_waves_per_simd;        // wave slots of a SIMD
+    uint32_t registers_per_simd;        // 32-bit registers per lane in a SIMD's register file
+    uint32_t register_granularity;      // registers are allocated per thread in multiples of this
+    uint32_t max_registers_per_thread;  // more than this are spilled to memory
+    uint32_t lds_per_cu;                // bytes of shared memory in a compute unit
+    uint32_t lds_granularity;           // shared memory is allocated per group in multiples of this
+    uint32_t max_groups_per_cu;         // thread groups a compute unit can hold at once
+    uint32_t lds_banks;                 // dword banks of shared memory, and lanes served at once
+    uint32_t cache_line_bytes;          // bytes buffer memory is fetched in
+};
+
+// The built-in profile: waves of 64 on 4 SIMDs of 10 wave slots and 256 registers, allocated 4 at a
+// time; 64KB of shared memory in 32 banks, allocated 512 bytes at a time, at most 16 groups per
+// compute unit, and 64-byte cache lines.
+void hardware_profile_default(hardware_profile& profile);
+
+// Applies a profile file of size bytes on top of profile. Returns false, with the 1-based number of
+// the offending line in error_line, for an unknown setting or a value that is not a positive
+// integer; lines before it have been applied.
+bool hardware_profile_parse(const char* text, size_t size, hardware_profile& profile, uint32_t& error_line);
+
+enum occupancy_limit
+{
+    OCCUPANCY_LIMIT_WAVES,              // the SIMDs' wave slots
+    OCCUPANCY_LIMIT_REGISTERS,          // the register file
+    OCCUPANCY_LIMIT_LDS,                // shared memory
+    OCCUPANCY_LIMIT_GROUPS,             // the compute unit's group limit
+};
+extern const char* occupancy_limit_text[];
+
+struct occupancy_estimate
+{
+    uint32_t group[3];                  // dcl_thread_group x, y and z
+    uint64_t threads;                   // threads per group
+    uint64_t waves_per_group;
+    bool partial_wave;                  // threads is not a multiple of the wave width
+    double lane_utilization;            // share of the group's wave lanes that hold a thread
+    uint32_t temps;                     // dcl_temps
+    uint32_t indexable_registers;       // registers of the dcl_indexableTemp arrays
+    uint32_t registers;                 // registers allocated per thread: rounded up to the
+                                        // granularity and capped at max_registers_per_thread
+    uint64_t tgsm_bytes;                // shared memory declared per group
+    uint32_t register_waves;            // waves per SIMD the register file allows
+    uint64_t groups_per_cu;             // groups resident per compute unit, 0 if one does not fit
+    double waves_per_simd;              // waves resident per SIMD
+    double occupancy;                   // waves_per_simd over max_waves_per_simd
+    uint32_t limit;                     // occupancy_limit that sets groups_per_cu
+};
+
+// Estimates the occupancy of a program of count instructions from its declarations. Returns false
+// if it has no dcl_thread_group, so is not a compute shader.
+bool occupancy_estimate_program(const DecodedInstruction* instructions, uint32_t count, const hardware_profile& profile,
+    occupancy_estimate& result);
+
+#endif /* OCCUPANCY_H_ */
@@ -0,0 +1,149 @@
+#ifndef SHADER_PACK_H_
+#define SHADER_PACK_H_
+
+// Many DXBC containers in one file that an engine maps at startup and uses where it lies. Shaders
+// are found by the hash of their contents with a binary search over a sorted array of hashes, and
+// each one comes with what a runtime wants to know before creating it: stage, thread group size,
+// bindings and the hashes of its signatures. Nothing needs parsing or fixing up after loading.
+//
+// Every field is in the byte order of the host that wrote the pack, as the engine reads it in
+// place; that is little-endian on every host Direct3D runs on. shader_pack_open rejects a pack
+// whose magic reads byte-swapped rather than misread it. The payloads are DXBC, little-endian
+// whatever the host.
+//
+// Layout:
+//   shader_pack_header
+//   uint64_t[shader_count]              content hashes, strictly ascending
+//   shader_pack_record[shader_count]    in the same order as the hashes
+//   shader_pack_binding[binding_count]  each record's bindings are a range of these
+//   char[names_size]                    the name each shader was first added under, not terminated
+//   payloads                            the containers as given, each starting on a page boundary
+//                                       so that it can be handed out without copying
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <iostream>
+
+#define SHADER_PACK_MAGIC 0x4b505846u   // "FXPK"
+#define SHADER_PACK_MAGIC_SWAPPED 0x4658504bu // written on a host of the other byte order
+#define SHADER_PACK_VERSION 1u
+#define SHADER_PACK_PAGE_SIZE 4096u
+
+#define SHADER_PACK_BINDING_CONSTANT_BUFFER 0u
+#define SHADER_PACK_BINDING_SAMPLER 1u
+#define SHADER_PACK_BINDING_RESOURCE 2u
+#define SHADER_PACK_BINDING_UAV 3u
+
+struct shader_pack_header
+{
+    uint32_t magic;
+    uint32_t version;                   // readers reject any version but their own
+    uint32_t header_size;
+    uint32_t record_sizes;              // sizeof(shader_pack_record) | sizeof(shader_pack_binding) << 16
+    uint32_t page_size;                 // payloads start on multiples of this
+    uint32_t shader_count;
+    uint32_t binding_count;
+    uint32_t names_size;
+    uint64_t hashes_offset;             // offsets are from the start of the header
+    uint64_t records_offset;
+    uint64_t bindings_offset;
+    uint64_t names_offset;
+    uint64_t total_size;                // of the whole file
+};
+
+struct shader_pack_record
+{
+    uint64_t hash;                      // 64-bit FNV-1a of the payload
+    uint64_t payload_offset;
+    uint32_t payload_size;
+    uint32_t program_version;           // version token: program type in the high half, model below
+    uint32_t thread_group[3];           // from dcl_thread_group, 0 without one
+    uint32_t first_binding;
+    uint32_t binding_count;
+    uint32_t name_offset;
+    uint32_t name_size;
+    uint32_t reserved;
+    uint64_t signature_hashes[3];       // input, output and patch constant signature chunks, 0 if absent
+};
+
+struct shader_pack_binding
+{
+    uint8_t kind;                       // SHADER_PACK_BINDING_*
+    uint8_t dimension;                  // D3D10_SB_RESOURCE_DIMENSION of resources and UAVs, else 0
+    uint16_t reserved;
+    uint32_t slot;                      // register number
+    uint32_t size;                      // constant buffer size in vectors, structure stride in bytes, else 0
+};
+
+// The content hash a pack files shaders under.
+uint64_t shader_pack_hash(const void* data, size_t size);
+
+enum shader_pack_status
+{
+    SHADER_PACK_ADDED,
+    SHADER_PACK_DUPLICATE,              // the same contents were added before, under another name
+    SHADER_PACK_INVALID,                // not a container with a program that decodes to the end
+    SHADER_PACK_COLLISION,              // different contents with the hash of an earlier shader
+};
+
+// Collects containers and lays them out as a pack. Containers are checked with dxbc_parse and
+// their programs decoded once, for the metadata; the payload is stored exactly as given, so the
+// container checksum the runtime verifies survives.
+class shader_pack_writer
+{
+public:
+    // Adds a copy of data under name and sets hash to its content hash, also for duplicates.
+    shader_pack_status add(const void* data, size_t size, const char* name, uint64_t& hash);
+    size_t shader_count() const { return shaders.size(); }
+    // Writes the pack. Returns false if out fails or the pack would exceed the format's limits.
+    bool write(std::ostream& out) const;
+private:
+    struct shader
+    {
+        shader_pack_record record;
+        std::vector<char> payload;
+        std::vector<shader_pack_binding> bindings;
+        std::string name;
+    };
+    std::vector<shader> shaders;
+    std::map<uint64_t, size_t> by_hash;
+};
+
+// Checks everything readers rely on: header, version, record sizes, section bounds and order,
+// that the hashes ascend and match their records, and that every payload, binding range and name
+// lies inside the file. Takes one pass over the records and touches no payload. Returns NULL if
+// data is not a valid pack of exactly size bytes.
+const shader_pack_header* shader_pack_open(const void* data, size_t size);
+
+inline const uint64_t* shader_pack_hashes(const shader_pack_header* pack)
+{
+    return (const uint64_t*)((const char*)pack + pack->hashes_offset);
+}
+
+inline const shader_pack_record* shader_pack_records(const shader_pack_header* pack)
+{
+    return (const shader_pack_record*)((const char*)pack + pack->records_offset);
+}
+
+// Binary search for the shader with the given content hash. Returns NULL if it is not in the pack.
+const shader_pack_record* shader_pack_find(const shader_pack_header* pack, uint64_t hash);
+
+inline const void* shader_pack_payload(const shader_pack_header* pack, const shader_pack_record* record)
+{
+    return (const char*)pack + record->payload_offset;
+}
+
+inline const shader_pack_binding* shader_pack_bindings(const shader_pack_header* pack, const shader_pack_record* record)
+{
+    return (const shader_pack_binding*)((const char*)pack + pack->bindings_offset) + record->first_binding;
+}
+
+inline std::string shader_pack_name(const shader_pack_header* pack, const shader_pack_record* record)
+{
+    return std::string((const char*)pack + pack->names_offset + record->name_offset, record->name_size);
+}
+
+#endif /* SHADER_PACK_H_ */
@@ -0,0 +1,58 @@
+#ifndef TGSM_BANKS_H_
+#define TGSM_BANKS_H_
+
+// Bank conflicts of thread group shared memory accesses in a compute shader.
+//
+// Shared memory is split into banks of one dword each, dword n in bank n % lds_banks. The lanes of
+// a wave are served lds_banks at a time, or the whole wave if it is narrower, and lanes that reach
+// different dwords of the same bank in one go are served one after another. An access takes as
+// many passes as the most distinct dwords any one bank is asked for; lanes reading the same dword
+// share it.
+//
+// Conflicts are only found where the address is an affine function of the thread's position in
+// its group, as thread_affine.h works it out; a uniform constant moves every lane's dword by the
+// same amount, so it is taken as 0. Branches are taken as uniform, as there.
+//
+// ld_structured and store_structured address byte index * stride + offset of a dcl_tgsm_structured
+// g#; ld_raw and store_raw a byte address in a dcl_tgsm_raw g#. Only the first dword each lane
+// reads or writes is counted. Lanes are taken to run in the order of vThreadIDInGroupFlattened.
+
+#include <stdint.h>
+#include <vector>
+#include "D3D11TokenParser.h"
+#include "cfg.h"
+#include "occupancy.h"
+#include "thread_affine.h"
+
+struct tgsm_access
+{
+    uint32_t instruction;
+    uint32_t reg;                       // g#
+    uint32_t element_stride;            // bytes per structure of a dcl_tgsm_structured g#, 0 for raw
+    bool resolved;                      // the address is affine in vThreadIDInGroup
+    bool uniform_offset;                // its constant is uniform but not known, and taken as 0
+    uint32_t offset;                    // constant byte offset
+    uint32_t lane_stride[3];            // bytes per step of vThreadIDInGroup.x, .y and .z; offset and
+                                        // strides wrap as 32-bit integers, as the shader computes them
+    uint32_t ways;                      // passes the worst lanes take, 1 without conflicts; 0 if not
+                                        // resolved
+    uint32_t worst_thread;              // vThreadIDInGroupFlattened of the first of the worst lanes
+};
+
+struct tgsm_bank_report
+{
+    uint32_t group[3];                  // dcl_thread_group x, y and z
+    uint32_t lanes;                     // lanes served together
+    // Every ld_structured, store_structured, ld_raw and store_raw of g# memory, the worst first,
+    // then in program order; unresolved ones last.
+    std::vector<tgsm_access> accesses;
+};
+
+// Runs the analysis over a program and the graph cfg_build made of it, reusing result's storage.
+// Programs without a dcl_thread_group get no accesses. Takes the time thread_affine_solve does,
+// and for each access, time linear in the threads of a group. Returns false where
+// thread_affine_solve does.
+bool tgsm_banks_analyze(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, const hardware_profile& profile, tgsm_bank_report& result);
+
+#endif /* TGSM_BANKS_H_ */
@@ -0,0 +1,74 @@
+#ifndef THREAD_AFFINE_H_
+#define THREAD_AFFINE_H_
+
+// Values as affine functions of a compute shader thread's position in its group: a constant plus a
+// multiple of each of vThreadIDInGroup.x, .y and .z, in wrapping 32-bit integer arithmetic. Memory
+// analyses use it to tell how the addresses of a wave's lanes relate to each other.
+//
+// Every temp component that feeds a value asked for is tracked through mov, iadd, ineg, ishl by a
+// constant, imul and umul by a constant, and imad and umad, from immediates, vThreadIDInGroup,
+// vThreadIDInGroupFlattened (which is x + X*y + X*Y*z for a group of X*Y*Z threads) and vThreadID
+// (vThreadIDInGroup plus a uniform part). Constant buffers, vThreadGroupID, and any other ALU
+// instruction whose sources are all uniform give a uniform value, whose constant is not known but
+// is the same in every lane. Anything else is unknown: values that are not affine, registers read
+// through a relative index, and whatever a call returns.
+//
+// Where control flow joins, a temp that holds the same function of the thread id with different
+// constants, as a loop counter does, keeps its multiples with a uniform constant. That is only
+// right if the lanes of a wave took the same way there, so branches are taken as uniform.
+//
+// Outside compute shaders there is no thread id, and values are only ever uniform or unknown.
+
+#include <stdint.h>
+#include <vector>
+#include "D3D11TokenParser.h"
+#include "cfg.h"
+
+// Registers the analysis accepts, as liveness_analyze.
+#define THREAD_AFFINE_MAX_REGISTERS 4096u
+// Blocks times tracked temp components the analysis accepts; it keeps a value of each per block.
+#define THREAD_AFFINE_MAX_STATE (1u << 22)
+
+// Ordered so that joining two values never goes back down.
+enum thread_affine_kind
+{
+    THREAD_AFFINE_UNREACHED,        // no path reaches the value
+    THREAD_AFFINE_EXACT,            // constant + k . vThreadIDInGroup
+    THREAD_AFFINE_UNIFORM,          // the same with a uniform constant that is not known, kept as 0
+    THREAD_AFFINE_UNKNOWN,          // not affine in vThreadIDInGroup
+};
+
+struct thread_affine
+{
+    uint32_t kind;                  // thread_affine_kind
+    uint32_t constant;
+    uint32_t k[3];                  // multiples of vThreadIDInGroup.x, .y and .z; 0 unless exact or uniform
+};
+
+// A source operand whose value is wanted, read at swizzle position 0, as addresses are.
+struct thread_affine_query
+{
+    uint32_t instruction;
+    uint32_t operand;               // among the instruction's operands
+};
+
+thread_affine thread_affine_make(uint32_t kind, uint32_t constant, uint32_t x, uint32_t y, uint32_t z);
+thread_affine thread_affine_add(const thread_affine& a, const thread_affine& b);
+thread_affine thread_affine_scale(const thread_affine& a, uint32_t factor);
+
+// True for exact and uniform values: those whose lanes' differences are known.
+inline bool thread_affine_known(const thread_affine& value)
+{
+    return value.kind == THREAD_AFFINE_EXACT || value.kind == THREAD_AFFINE_UNIFORM;
+}
+
+// Finds the value of each query, which must be in program order, over a program and the graph
+// cfg_build made of it. group is the dcl_thread_group size, 1 * 1 * 1 outside compute shaders.
+// Takes a few passes over the blocks per level of loop nesting, each linear in the number of
+// blocks times the temp components tracked. Returns false if the program names a register beyond
+// THREAD_AFFINE_MAX_REGISTERS, or tracks more than THREAD_AFFINE_MAX_STATE values.
+bool thread_affine_solve(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, const uint32_t group[3], const std::vector<thread_affine_query>& queries,
+    std::vector<thread_affine>& values);
+
+#endif /* THREAD_AFFINE_H_ */
@@ -0,0 +1,39 @@
+#ifndef TOKEN_CODEC_H_
+#define TOKEN_CODEC_H_
+
+// Lossless compression for shader storage that knows the shape of SM4/5 token streams.
+//
+// The program's tokens are sorted into separate streams by what they are: opcode tokens, extended
+// tokens, operand tokens, register indices, immediates, immediate constant buffer values and the
+// rest. Token values are then coded for their stream: the three kinds of token and the immediates
+// go through a per-file dictionary ordered by frequency, and register indices and constant buffer
+// values are delta coded. The component byte of each operand token goes to one of three streams:
+// write masks, swizzles and selected components. Each stream is finally Huffman coded on its own,
+// with its code lengths packed as in Deflate or, where that is smaller, with one of a few built-in
+// codes that cost no table. The bytes of a container around the program, such as its header and
+// signatures, form one more stream. Version 1 files, without the component split and with plainly
+// listed code lengths, still decompress.
+//
+// Any input round-trips bit for bit, including damaged containers and bare token streams. The
+// split into streams only has to be repeatable, not correct; a program the splitter does not
+// understand costs compression, not correctness.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "arena.h"
+
+#define TOKEN_CODEC_MAGIC 0x5a545846u   // "FXTZ"
+#define TOKEN_CODEC_VERSION 2u
+
+// Appends the compressed form of data to out. Returns false if data is too large (4GB or more).
+bool token_compress(const void* data, size_t size, std::vector<char>& out);
+
+// The size data decompresses to, or 0 if data does not start with a compressed header.
+size_t token_decompressed_size(const void* data, size_t size);
+
+// Decompresses into out, which must hold exactly token_decompressed_size bytes. Scratch memory
+// comes from arena if given. Returns false if data is damaged; out is then undefined.
+bool token_decompress(const void* data, size_t size, void* out, size_t out_size, fxdis_arena* arena = 0);
+
+#endif /* TOKEN_CODEC_H_ */
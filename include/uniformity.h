@@ -0,0 +1,64 @@
+#ifndef UNIFORMITY_H_
+#define UNIFORMITY_H_
+
+// Uniformity of values and branches: whether every lane of a wave sees the same value, or takes the
+// same way through a branch.
+//
+// Immediates, constant buffers, the immediate constant buffer and vThreadGroupID are uniform, as are
+// resource, sampler and memory handles. Every other input register is divergent: vertex and pixel
+// inputs, system values, vThreadID and the rest. Texture and memory loads, atomics that return a
+// value and derivatives give divergent results; resinfo, bufinfo and sampleinfo follow their
+// sources. Any other instruction gives a divergent result in the components that read a divergent
+// component, or a register indexed by one. r# is tracked per component and x# per array and
+// component.
+//
+// Values also turn divergent through control flow: anything written where lanes may disagree about
+// getting there is divergent from then on. That holds inside an if or switch on a divergent value,
+// inside a loop that lanes may leave or restart at different times, after a return that not every
+// lane takes, and in a subroutine called from any such place. A loop is divergent when one of its
+// break, breakc, continue, continuec, ret or retc is divergent, or in divergent flow inside it. The
+// analysis repeats until the divergent places stop growing; in practice two or three passes.
+//
+// Calls are followed: a subroutine starts with whatever is divergent at any of its calls, and its
+// callers continue with whatever is divergent where it returns. fcall targets are not known, so
+// fcall changes nothing. Hull shader phases do not share temps with each other.
+
+#include <stdint.h>
+#include <vector>
+#include "D3D11TokenParser.h"
+#include "cfg.h"
+
+// Registers the analysis accepts, as liveness_analyze.
+#define UNIFORMITY_MAX_REGISTERS 4096u
+
+enum uniformity_branch
+{
+    UNIFORMITY_NOT_A_BRANCH,
+    UNIFORMITY_UNIFORM,
+    UNIFORMITY_DIVERGENT,
+};
+extern const char* uniformity_branch_text[];
+
+struct uniformity
+{
+    // Per instruction: for if, switch, breakc, continuec, retc and callc, whether its condition is
+    // uniform; for loop, whether lanes leave the loop together.
+    std::vector<uint8_t> branches;          // uniformity_branch
+    std::vector<uint8_t> divergent_blocks;  // 1 for blocks that lanes may disagree about reaching
+    // Instructions that take implicit derivatives (deriv_rt*, sample, sample_b, sample_c, lod and
+    // their feedback forms) in divergent blocks, where the derivatives are undefined.
+    std::vector<uint32_t> divergent_derivatives;
+};
+
+// True for opcodes that take derivatives across the lanes of a quad, explicitly or to pick a mip
+// level.
+bool uniformity_takes_derivatives(D3D10_SB_OPCODE_TYPE opcode);
+
+// Runs the analysis over a program and the graph cfg_build made of it, reusing result's storage.
+// Each pass takes a few passes over the blocks per level of loop nesting, each linear in the
+// number of blocks times the registers used. Returns false if the program names a register beyond
+// UNIFORMITY_MAX_REGISTERS.
+bool uniformity_analyze(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, uniformity& result);
+
+#endif /* UNIFORMITY_H_ */
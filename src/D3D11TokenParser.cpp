@@ -1,187 +1,1026 @@
 #include "D3D11TokenParser.h"
-using std::cout;
-using std::endl;
+#include "fxdis_stats.h"
+#include <string.h>
 
-void TokenParser::Parse()
+bool IsDeclaration(D3D10_SB_OPCODE_TYPE opcode)
 {
-	uint32_t version = *tokenCurrent++;
-	cout << ShaderTypeText[DECODE_D3D10_SB_TOKENIZED_PROGRAM_TYPE(version)]
-		<< DECODE_D3D10_SB_TOKENIZED_PROGRAM_MAJOR_VERSION(version) << "_"
-		<< DECODE_D3D10_SB_TOKENIZED_PROGRAM_MINOR_VERSION(version) << endl;
+	return opcode == D3D10_SB_OPCODE_CUSTOMDATA || (opcode < D3D10_SB_NUM_OPCODES && !strncmp(OpcodeText[opcode], "dcl_", 4));
+}
+
+uint32_t DeclarationDataPerOperand(D3D10_SB_OPCODE_TYPE opcode)
+{
+	switch (opcode)
+	{
+	case D3D10_SB_OPCODE_DCL_RESOURCE:
+	case D3D10_SB_OPCODE_DCL_INDEX_RANGE:
+	case D3D10_SB_OPCODE_DCL_INPUT_PS_SIV:
+	case D3D10_SB_OPCODE_DCL_INPUT_SGV:
+	case D3D10_SB_OPCODE_DCL_INPUT_SIV:
+	case D3D10_SB_OPCODE_DCL_INPUT_PS_SGV:
+	case D3D10_SB_OPCODE_DCL_OUTPUT_SGV:
+	case D3D10_SB_OPCODE_DCL_OUTPUT_SIV:
+	case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_TYPED:
+	case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED:
+	case D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_RAW:
+	case D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED:
+		return 1;
+	case D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_STRUCTURED:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+uint32_t DestinationCount(D3D10_SB_OPCODE_TYPE opcode)
+{
+	if (IsDeclaration(opcode))
+	{
+		return 0;
+	}
+	switch (opcode)
+	{
+	case D3D10_SB_OPCODE_BREAK:
+	case D3D10_SB_OPCODE_BREAKC:
+	case D3D10_SB_OPCODE_CALL:
+	case D3D10_SB_OPCODE_CALLC:
+	case D3D10_SB_OPCODE_CASE:
+	case D3D10_SB_OPCODE_CONTINUE:
+	case D3D10_SB_OPCODE_CONTINUEC:
+	case D3D10_SB_OPCODE_CUT:
+	case D3D10_SB_OPCODE_DEFAULT:
+	case D3D10_SB_OPCODE_DISCARD:
+	case D3D10_SB_OPCODE_ELSE:
+	case D3D10_SB_OPCODE_EMIT:
+	case D3D10_SB_OPCODE_EMITTHENCUT:
+	case D3D10_SB_OPCODE_ENDIF:
+	case D3D10_SB_OPCODE_ENDLOOP:
+	case D3D10_SB_OPCODE_ENDSWITCH:
+	case D3D10_SB_OPCODE_IF:
+	case D3D10_SB_OPCODE_LABEL:
+	case D3D10_SB_OPCODE_LOOP:
+	case D3D10_SB_OPCODE_NOP:
+	case D3D10_SB_OPCODE_RET:
+	case D3D10_SB_OPCODE_RETC:
+	case D3D10_SB_OPCODE_SWITCH:
+	case D3D11_SB_OPCODE_HS_DECLS:
+	case D3D11_SB_OPCODE_HS_CONTROL_POINT_PHASE:
+	case D3D11_SB_OPCODE_HS_FORK_PHASE:
+	case D3D11_SB_OPCODE_HS_JOIN_PHASE:
+	case D3D11_SB_OPCODE_EMIT_STREAM:
+	case D3D11_SB_OPCODE_CUT_STREAM:
+	case D3D11_SB_OPCODE_EMITTHENCUT_STREAM:
+	case D3D11_SB_OPCODE_INTERFACE_CALL:
+	case D3D11_SB_OPCODE_SYNC:
+	case D3D11_SB_OPCODE_ABORT:
+	case D3D11_SB_OPCODE_DEBUG_BREAK:
+		return 0;
+	case D3D10_SB_OPCODE_IMUL:
+	case D3D10_SB_OPCODE_UDIV:
+	case D3D10_SB_OPCODE_UMUL:
+	case D3D10_SB_OPCODE_SINCOS:
+	case D3D11_SB_OPCODE_SWAPC:
+	case D3D11_SB_OPCODE_UADDC:
+	case D3D11_SB_OPCODE_USUBB:
+	// Immediate atomics return the old value and write memory; feedback forms also write a status.
+	case D3D11_SB_OPCODE_IMM_ATOMIC_ALLOC:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_CONSUME:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_IADD:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_AND:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_OR:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_XOR:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_EXCH:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_CMP_EXCH:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_IMAX:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_IMIN:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_UMAX:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_UMIN:
+	case D3DWDDM1_3_SB_OPCODE_GATHER4_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_GATHER4_C_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_GATHER4_PO_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_GATHER4_PO_C_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_LD_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_LD_MS_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_LD_UAV_TYPED_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_LD_RAW_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_LD_STRUCTURED_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_L_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_C_LZ_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_CLAMP_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_B_CLAMP_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_D_CLAMP_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_C_CLAMP_FEEDBACK:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+bool IsComponentwise(D3D10_SB_OPCODE_TYPE opcode)
+{
+	switch (opcode)
+	{
+	case D3D10_SB_OPCODE_ADD:
+	case D3D10_SB_OPCODE_AND:
+	case D3D10_SB_OPCODE_DERIV_RTX:
+	case D3D10_SB_OPCODE_DERIV_RTY:
+	case D3D10_SB_OPCODE_DIV:
+	case D3D10_SB_OPCODE_EQ:
+	case D3D10_SB_OPCODE_EXP:
+	case D3D10_SB_OPCODE_FRC:
+	case D3D10_SB_OPCODE_FTOI:
+	case D3D10_SB_OPCODE_FTOU:
+	case D3D10_SB_OPCODE_GE:
+	case D3D10_SB_OPCODE_IADD:
+	case D3D10_SB_OPCODE_IEQ:
+	case D3D10_SB_OPCODE_IGE:
+	case D3D10_SB_OPCODE_ILT:
+	case D3D10_SB_OPCODE_IMAD:
+	case D3D10_SB_OPCODE_IMAX:
+	case D3D10_SB_OPCODE_IMIN:
+	case D3D10_SB_OPCODE_IMUL:
+	case D3D10_SB_OPCODE_INE:
+	case D3D10_SB_OPCODE_INEG:
+	case D3D10_SB_OPCODE_ISHL:
+	case D3D10_SB_OPCODE_ISHR:
+	case D3D10_SB_OPCODE_ITOF:
+	case D3D10_SB_OPCODE_LOG:
+	case D3D10_SB_OPCODE_LT:
+	case D3D10_SB_OPCODE_MAD:
+	case D3D10_SB_OPCODE_MIN:
+	case D3D10_SB_OPCODE_MAX:
+	case D3D10_SB_OPCODE_MOV:
+	case D3D10_SB_OPCODE_MOVC:
+	case D3D10_SB_OPCODE_MUL:
+	case D3D10_SB_OPCODE_NE:
+	case D3D10_SB_OPCODE_NOT:
+	case D3D10_SB_OPCODE_OR:
+	case D3D10_SB_OPCODE_ROUND_NE:
+	case D3D10_SB_OPCODE_ROUND_NI:
+	case D3D10_SB_OPCODE_ROUND_PI:
+	case D3D10_SB_OPCODE_ROUND_Z:
+	case D3D10_SB_OPCODE_RSQ:
+	case D3D10_SB_OPCODE_SQRT:
+	case D3D10_SB_OPCODE_SINCOS:
+	case D3D10_SB_OPCODE_UDIV:
+	case D3D10_SB_OPCODE_ULT:
+	case D3D10_SB_OPCODE_UGE:
+	case D3D10_SB_OPCODE_UMUL:
+	case D3D10_SB_OPCODE_UMAD:
+	case D3D10_SB_OPCODE_UMAX:
+	case D3D10_SB_OPCODE_UMIN:
+	case D3D10_SB_OPCODE_USHR:
+	case D3D10_SB_OPCODE_UTOF:
+	case D3D10_SB_OPCODE_XOR:
+	case D3D11_SB_OPCODE_DERIV_RTX_COARSE:
+	case D3D11_SB_OPCODE_DERIV_RTX_FINE:
+	case D3D11_SB_OPCODE_DERIV_RTY_COARSE:
+	case D3D11_SB_OPCODE_DERIV_RTY_FINE:
+	case D3D11_SB_OPCODE_RCP:
+	case D3D11_SB_OPCODE_F32TOF16:
+	case D3D11_SB_OPCODE_F16TOF32:
+	case D3D11_SB_OPCODE_UADDC:
+	case D3D11_SB_OPCODE_USUBB:
+	case D3D11_SB_OPCODE_COUNTBITS:
+	case D3D11_SB_OPCODE_FIRSTBIT_HI:
+	case D3D11_SB_OPCODE_FIRSTBIT_LO:
+	case D3D11_SB_OPCODE_FIRSTBIT_SHI:
+	case D3D11_SB_OPCODE_UBFE:
+	case D3D11_SB_OPCODE_IBFE:
+	case D3D11_SB_OPCODE_BFI:
+	case D3D11_SB_OPCODE_BFREV:
+	case D3D11_SB_OPCODE_SWAPC:
+	// Doubles take two components each in sources and destination alike.
+	case D3D11_SB_OPCODE_DADD:
+	case D3D11_SB_OPCODE_DMAX:
+	case D3D11_SB_OPCODE_DMIN:
+	case D3D11_SB_OPCODE_DMUL:
+	case D3D11_SB_OPCODE_DMOV:
+	case D3D11_1_SB_OPCODE_DDIV:
+	case D3D11_1_SB_OPCODE_DFMA:
+	case D3D11_1_SB_OPCODE_DRCP:
+	case D3D11_1_SB_OPCODE_MSAD:
+		return true;
+	default:
+		return false;
+	}
+}
+
+uint32_t ComponentsRead(const DecodedOperand& operand, uint32_t positions)
+{
+	if (operand.numComponents == 1)
+	{
+		return 1;
+	}
+	if (operand.numComponents != 4)
+	{
+		return 0;
+	}
+	switch (operand.selectionMode)
+	{
+	case D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE:
+		return operand.mask;
+	case D3D10_SB_OPERAND_4_COMPONENT_SELECT_1_MODE:
+		return 1u << operand.swizzle[0];
+	default:
+	{
+		uint32_t components = 0;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			if (positions & (1u << i))
+			{
+				components |= 1u << operand.swizzle[i];
+			}
+		}
+		return components;
+	}
+	}
+}
+
+uint32_t SourcePositions(const DecodedInstruction& inst, const DecodedOperand* operands)
+{
+	if (!IsComponentwise(inst.opcode))
+	{
+		return 0xf;
+	}
+	uint32_t positions = 0;
+	uint32_t destinations = DestinationCount(inst.opcode);
+	for (uint32_t i = 0; i < destinations && i < inst.operandCount; i++)
+	{
+		const DecodedOperand& dst = operands[inst.firstOperand + i];
+		if (dst.numComponents == 4 && dst.selectionMode == D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE)
+		{
+			positions |= dst.mask;
+		}
+	}
+	// A null destination writes nothing, but its sources are still evaluated.
+	return positions ? positions : 0xf;
+}
+
+DECODE_STATUS TokenDecoder::DecodeHeader()
+{
+	if (tokenSize < 2)
+	{
+		return DECODE_STATUS::TRUNCATED;
+	}
+	version = *tokenCurrent++;
+	declaredSize = *tokenCurrent++;
+	tokenEnd = tokenBegin + (tokenSize > declaredSize ? declaredSize : tokenSize);
+	if (tokenEnd < tokenCurrent)
+	{
+		tokenEnd = tokenCurrent;
+	}
+	return DECODE_STATUS::OK;
+}
+
+DECODE_STATUS TokenDecoder::Next(DecodedInstruction& inst, DecodedOperandPool& operands)
+{
+	if (tokenCurrent >= tokenEnd)
+	{
+		return DECODE_STATUS::END;
+	}
+
+	const uint32_t* opcodeBegin = tokenCurrent;
+	uint32_t opcodeToken = *tokenCurrent++;
+	memset(&inst, 0, sizeof(inst));
+	if ((uint32_t)DECODE_D3D10_SB_OPCODE_TYPE(opcodeToken) >= D3D10_SB_NUM_OPCODES)
+	{
+		tokenCurrent = opcodeBegin;
+		return DECODE_STATUS::INVALID_OPCODE;
+	}
+	inst.opcode = DECODE_D3D10_SB_OPCODE_TYPE(opcodeToken);
+	inst.opcodeToken = opcodeToken;
+	inst.offset = (uint32_t)(opcodeBegin - tokenBegin);
+	inst.firstOperand = (uint32_t)operands.size();
+	relative.clear();
+
+	uint32_t instructLen;
+	if (inst.opcode == D3D10_SB_OPCODE_CUSTOMDATA)
+	{
+		// Custom data stores its length, in tokens and including both header tokens, in the next token.
+		if (tokenCurrent >= tokenEnd)
+		{
+			tokenCurrent = opcodeBegin;
+			return DECODE_STATUS::TRUNCATED;
+		}
+		instructLen = *tokenCurrent++;
+		inst.data[inst.dataCount++] = DECODE_D3D10_SB_CUSTOMDATA_CLASS(opcodeToken);
+		inst.data[inst.dataCount++] = instructLen;
+	}
+	else
+	{
+		instructLen = DECODE_D3D10_SB_TOKENIZED_INSTRUCTION_LENGTH(opcodeToken);
+	}
+	if (instructLen < (uint32_t)(tokenCurrent - opcodeBegin) || instructLen > (uint32_t)(tokenEnd - opcodeBegin))
+	{
+		tokenCurrent = opcodeBegin;
+		return instructLen ? DECODE_STATUS::TRUNCATED : DECODE_STATUS::INVALID_OPCODE;
+	}
+	opcodeEnd = opcodeBegin + instructLen;
+	inst.length = instructLen;
+
+	if (inst.opcode != D3D10_SB_OPCODE_CUSTOMDATA)
+	{
+		uint32_t extOpcodeToken = opcodeToken;
+		while (DECODE_IS_D3D10_SB_OPCODE_EXTENDED(extOpcodeToken))
+		{
+			if (tokenCurrent >= opcodeEnd || inst.extOpcodeCount == DECODED_MAX_EXT_OPCODES)
+			{
+				tokenCurrent = opcodeBegin;
+				return DECODE_STATUS::INVALID_OPCODE;
+			}
+			extOpcodeToken = *tokenCurrent++;
+			inst.extOpcodeTokens[inst.extOpcodeCount++] = extOpcodeToken;
+		}
+	}
+
+	DECODE_STATUS status = DECODE_STATUS::OK;
+	switch (inst.opcode)
+	{
+	case D3D10_SB_OPCODE_CUSTOMDATA:
+		break;
+	case D3D10_SB_OPCODE_DCL_RESOURCE:
+		status = DecodeOperands(inst, operands, 1, true);
+		break;
+	case D3D10_SB_OPCODE_DCL_SAMPLER:
+		status = DecodeOperands(inst, operands, 0, true);
+		break;
+	case D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER:
+	case D3D10_SB_OPCODE_DCL_INPUT_PS:
+	case D3D10_SB_OPCODE_DCL_INPUT:
+	case D3D10_SB_OPCODE_DCL_OUTPUT:
+	case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW:
+	case D3D11_SB_OPCODE_DCL_RESOURCE_RAW:
+		status = DecodeOperands(inst, operands, 0, false);
+		break;
+	case D3D10_SB_OPCODE_DCL_INDEX_RANGE:
+	case D3D10_SB_OPCODE_DCL_INPUT_PS_SIV:
+	case D3D10_SB_OPCODE_DCL_INPUT_SGV:
+	case D3D10_SB_OPCODE_DCL_INPUT_SIV:
+	case D3D10_SB_OPCODE_DCL_INPUT_PS_SGV:
+	case D3D10_SB_OPCODE_DCL_OUTPUT_SGV:
+	case D3D10_SB_OPCODE_DCL_OUTPUT_SIV:
+	case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_TYPED:
+	case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED:
+	case D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_RAW:
+	case D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED:
+		status = DecodeOperands(inst, operands, 1, false);
+		break;
+	case D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_STRUCTURED:
+		status = DecodeOperands(inst, operands, 2, false);
+		break;
+	case D3D10_SB_OPCODE_DCL_GS_OUTPUT_PRIMITIVE_TOPOLOGY:
+	case D3D10_SB_OPCODE_DCL_GS_INPUT_PRIMITIVE:
+	case D3D10_SB_OPCODE_DCL_GLOBAL_FLAGS:
+	case D3D11_SB_OPCODE_DCL_INPUT_CONTROL_POINT_COUNT:
+	case D3D11_SB_OPCODE_DCL_OUTPUT_CONTROL_POINT_COUNT:
+	case D3D11_SB_OPCODE_DCL_TESS_DOMAIN:
+	case D3D11_SB_OPCODE_DCL_TESS_PARTITIONING:
+	case D3D11_SB_OPCODE_DCL_TESS_OUTPUT_PRIMITIVE:
+		break;
+	case D3D10_SB_OPCODE_DCL_MAX_OUTPUT_VERTEX_COUNT:
+	case D3D10_SB_OPCODE_DCL_TEMPS:
+	case D3D11_SB_OPCODE_DCL_HS_MAX_TESSFACTOR:
+	case D3D11_SB_OPCODE_DCL_HS_FORK_PHASE_INSTANCE_COUNT:
+	case D3D11_SB_OPCODE_DCL_HS_JOIN_PHASE_INSTANCE_COUNT:
+	case D3D11_SB_OPCODE_DCL_GS_INSTANCE_COUNT:
+		status = DecodeData(inst, 1);
+		break;
+	case D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP:
+	case D3D11_SB_OPCODE_DCL_THREAD_GROUP:
+		status = DecodeData(inst, 3);
+		break;
+	case D3D11_SB_OPCODE_DCL_STREAM:
+	case D3D11_SB_OPCODE_DCL_FUNCTION_BODY:
+	case D3D11_SB_OPCODE_DCL_FUNCTION_TABLE:
+	case D3D11_SB_OPCODE_DCL_INTERFACE:
+	case D3DWDDM1_3_SB_OPCODE_GATHER4_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_GATHER4_C_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_GATHER4_PO_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_GATHER4_PO_C_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_LD_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_LD_MS_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_LD_UAV_TYPED_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_LD_RAW_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_LD_STRUCTURED_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_L_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_C_LZ_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_CLAMP_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_B_CLAMP_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_D_CLAMP_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_SAMPLE_C_CLAMP_FEEDBACK:
+	case D3DWDDM1_3_SB_OPCODE_CHECK_ACCESS_FULLY_MAPPED:
+		inst.skipped = 1;
+		break;
+	case D3D10_SB_OPCODE_BREAKC:
+	case D3D10_SB_OPCODE_CALLC:
+	case D3D10_SB_OPCODE_CONTINUEC:
+	case D3D10_SB_OPCODE_IF:
+	case D3D10_SB_OPCODE_MOVC:
+	case D3D10_SB_OPCODE_RETC:
+	case D3D11_SB_OPCODE_SWAPC:
+	case D3D10_SB_OPCODE_ADD:
+	case D3D10_SB_OPCODE_AND:
+	case D3D10_SB_OPCODE_BREAK:
+	case D3D10_SB_OPCODE_CALL:
+	case D3D10_SB_OPCODE_CASE:
+	case D3D10_SB_OPCODE_CONTINUE:
+	case D3D10_SB_OPCODE_CUT:
+	case D3D10_SB_OPCODE_DEFAULT:
+	case D3D10_SB_OPCODE_DERIV_RTX:
+	case D3D10_SB_OPCODE_DERIV_RTY:
+	case D3D10_SB_OPCODE_DISCARD:
+	case D3D10_SB_OPCODE_DIV:
+	case D3D10_SB_OPCODE_DP2:
+	case D3D10_SB_OPCODE_DP3:
+	case D3D10_SB_OPCODE_DP4:
+	case D3D10_SB_OPCODE_ELSE:
+	case D3D10_SB_OPCODE_EMIT:
+	case D3D10_SB_OPCODE_EMITTHENCUT:
+	case D3D10_SB_OPCODE_ENDIF:
+	case D3D10_SB_OPCODE_ENDLOOP:
+	case D3D10_SB_OPCODE_ENDSWITCH:
+	case D3D10_SB_OPCODE_EQ:
+	case D3D10_SB_OPCODE_EXP:
+	case D3D10_SB_OPCODE_FRC:
+	case D3D10_SB_OPCODE_FTOI:
+	case D3D10_SB_OPCODE_FTOU:
+	case D3D10_SB_OPCODE_GE:
+	case D3D10_SB_OPCODE_IADD:
+	case D3D10_SB_OPCODE_IEQ:
+	case D3D10_SB_OPCODE_IGE:
+	case D3D10_SB_OPCODE_ILT:
+	case D3D10_SB_OPCODE_IMAD:
+	case D3D10_SB_OPCODE_IMAX:
+	case D3D10_SB_OPCODE_IMIN:
+	case D3D10_SB_OPCODE_IMUL:
+	case D3D10_SB_OPCODE_INE:
+	case D3D10_SB_OPCODE_INEG:
+	case D3D10_SB_OPCODE_ISHL:
+	case D3D10_SB_OPCODE_ISHR:
+	case D3D10_SB_OPCODE_ITOF:
+	case D3D10_SB_OPCODE_LABEL:
+	case D3D10_SB_OPCODE_LD:
+	case D3D10_SB_OPCODE_LD_MS:
+	case D3D10_SB_OPCODE_LOG:
+	case D3D10_SB_OPCODE_LOOP:
+	case D3D10_SB_OPCODE_LT:
+	case D3D10_SB_OPCODE_MAD:
+	case D3D10_SB_OPCODE_MIN:
+	case D3D10_SB_OPCODE_MAX:
+	case D3D10_SB_OPCODE_MOV:
+	case D3D10_SB_OPCODE_MUL:
+	case D3D10_SB_OPCODE_NE:
+	case D3D10_SB_OPCODE_NOP:
+	case D3D10_SB_OPCODE_NOT:
+	case D3D10_SB_OPCODE_OR:
+	case D3D10_SB_OPCODE_RESINFO:
+	case D3D10_SB_OPCODE_RET:
+	case D3D10_SB_OPCODE_ROUND_NE:
+	case D3D10_SB_OPCODE_ROUND_NI:
+	case D3D10_SB_OPCODE_ROUND_PI:
+	case D3D10_SB_OPCODE_ROUND_Z:
+	case D3D10_SB_OPCODE_RSQ:
+	case D3D10_SB_OPCODE_SAMPLE:
+	case D3D10_SB_OPCODE_SAMPLE_C:
+	case D3D10_SB_OPCODE_SAMPLE_C_LZ:
+	case D3D10_SB_OPCODE_SAMPLE_L:
+	case D3D10_SB_OPCODE_SAMPLE_D:
+	case D3D10_SB_OPCODE_SAMPLE_B:
+	case D3D10_SB_OPCODE_SQRT:
+	case D3D10_SB_OPCODE_SWITCH:
+	case D3D10_SB_OPCODE_SINCOS:
+	case D3D10_SB_OPCODE_UDIV:
+	case D3D10_SB_OPCODE_ULT:
+	case D3D10_SB_OPCODE_UGE:
+	case D3D10_SB_OPCODE_UMUL:
+	case D3D10_SB_OPCODE_UMAD:
+	case D3D10_SB_OPCODE_UMAX:
+	case D3D10_SB_OPCODE_UMIN:
+	case D3D10_SB_OPCODE_USHR:
+	case D3D10_SB_OPCODE_UTOF:
+	case D3D10_SB_OPCODE_XOR:
+	case D3D10_1_SB_OPCODE_LOD:
+	case D3D10_1_SB_OPCODE_GATHER4:
+	case D3D10_1_SB_OPCODE_SAMPLE_POS:
+	case D3D10_1_SB_OPCODE_SAMPLE_INFO:
+	case D3D11_SB_OPCODE_HS_DECLS:
+	case D3D11_SB_OPCODE_HS_CONTROL_POINT_PHASE:
+	case D3D11_SB_OPCODE_HS_FORK_PHASE:
+	case D3D11_SB_OPCODE_HS_JOIN_PHASE:
+	case D3D11_SB_OPCODE_EMIT_STREAM:
+	case D3D11_SB_OPCODE_CUT_STREAM:
+	case D3D11_SB_OPCODE_EMITTHENCUT_STREAM:
+	case D3D11_SB_OPCODE_INTERFACE_CALL:
+	case D3D11_SB_OPCODE_BUFINFO:
+	case D3D11_SB_OPCODE_DERIV_RTX_COARSE:
+	case D3D11_SB_OPCODE_DERIV_RTX_FINE:
+	case D3D11_SB_OPCODE_DERIV_RTY_COARSE:
+	case D3D11_SB_OPCODE_DERIV_RTY_FINE:
+	case D3D11_SB_OPCODE_GATHER4_C:
+	case D3D11_SB_OPCODE_GATHER4_PO:
+	case D3D11_SB_OPCODE_GATHER4_PO_C:
+	case D3D11_SB_OPCODE_RCP:
+	case D3D11_SB_OPCODE_F32TOF16:
+	case D3D11_SB_OPCODE_F16TOF32:
+	case D3D11_SB_OPCODE_UADDC:
+	case D3D11_SB_OPCODE_USUBB:
+	case D3D11_SB_OPCODE_COUNTBITS:
+	case D3D11_SB_OPCODE_FIRSTBIT_HI:
+	case D3D11_SB_OPCODE_FIRSTBIT_LO:
+	case D3D11_SB_OPCODE_FIRSTBIT_SHI:
+	case D3D11_SB_OPCODE_UBFE:
+	case D3D11_SB_OPCODE_IBFE:
+	case D3D11_SB_OPCODE_BFI:
+	case D3D11_SB_OPCODE_BFREV:
+	case D3D11_SB_OPCODE_LD_UAV_TYPED:
+	case D3D11_SB_OPCODE_STORE_UAV_TYPED:
+	case D3D11_SB_OPCODE_LD_RAW:
+	case D3D11_SB_OPCODE_STORE_RAW:
+	case D3D11_SB_OPCODE_LD_STRUCTURED:
+	case D3D11_SB_OPCODE_STORE_STRUCTURED:
+	case D3D11_SB_OPCODE_ATOMIC_AND:
+	case D3D11_SB_OPCODE_ATOMIC_OR:
+	case D3D11_SB_OPCODE_ATOMIC_XOR:
+	case D3D11_SB_OPCODE_ATOMIC_CMP_STORE:
+	case D3D11_SB_OPCODE_ATOMIC_IADD:
+	case D3D11_SB_OPCODE_ATOMIC_IMAX:
+	case D3D11_SB_OPCODE_ATOMIC_IMIN:
+	case D3D11_SB_OPCODE_ATOMIC_UMAX:
+	case D3D11_SB_OPCODE_ATOMIC_UMIN:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_ALLOC:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_CONSUME:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_IADD:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_AND:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_OR:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_XOR:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_EXCH:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_CMP_EXCH:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_IMAX:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_IMIN:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_UMAX:
+	case D3D11_SB_OPCODE_IMM_ATOMIC_UMIN:
+	case D3D11_SB_OPCODE_SYNC:
+	case D3D11_SB_OPCODE_DADD:
+	case D3D11_SB_OPCODE_DMAX:
+	case D3D11_SB_OPCODE_DMIN:
+	case D3D11_SB_OPCODE_DMUL:
+	case D3D11_SB_OPCODE_DEQ:
+	case D3D11_SB_OPCODE_DGE:
+	case D3D11_SB_OPCODE_DLT:
+	case D3D11_SB_OPCODE_DNE:
+	case D3D11_SB_OPCODE_DMOV:
+	case D3D11_SB_OPCODE_DMOVC:
+	case D3D11_SB_OPCODE_DTOF:
+	case D3D11_SB_OPCODE_FTOD:
+	case D3D11_SB_OPCODE_EVAL_SNAPPED:
+	case D3D11_SB_OPCODE_EVAL_SAMPLE_INDEX:
+	case D3D11_SB_OPCODE_EVAL_CENTROID:
+	case D3D11_1_SB_OPCODE_DDIV:
+	case D3D11_1_SB_OPCODE_DFMA:
+	case D3D11_1_SB_OPCODE_DRCP:
+	case D3D11_1_SB_OPCODE_MSAD:
+	case D3D11_1_SB_OPCODE_DTOI:
+	case D3D11_1_SB_OPCODE_DTOU:
+	case D3D11_1_SB_OPCODE_ITOD:
+	case D3D11_1_SB_OPCODE_UTOD:
+		status = DecodeOperands(inst, operands, 0, false);
+		break;
+	default:
+		status = DECODE_STATUS::INVALID_OPCODE;
+		break;
+	}
+	if (status == DECODE_STATUS::OK && tokenCurrent > opcodeEnd)
+	{
+		status = DECODE_STATUS::TRUNCATED;
+	}
+	if (status != DECODE_STATUS::OK)
+	{
+		operands.resize(inst.firstOperand);
+		tokenCurrent = opcodeBegin;
+		return status;
+	}
+
+	// Relative index registers were decoded aside; move them behind the top-level operands.
+	uint32_t relativeBase = (uint32_t)operands.size();
+	operands.insert(operands.end(), relative.begin(), relative.end());
+	inst.relativeCount = (uint8_t)relative.size();
+	for (size_t i = inst.firstOperand; i < operands.size(); i++)
+	{
+		for (uint32_t idx = 0; idx < 3; idx++)
+		{
+			if (operands[i].index[idx].relative != DECODED_NO_OPERAND)
+			{
+				operands[i].index[idx].relative += relativeBase;
+			}
+		}
+	}
+	tokenCurrent = opcodeEnd;
+#ifdef FXDIS_STATS
+	if (fxdis_stats_current)
+	{
+		uint64_t extended = inst.extOpcodeCount;
+		for (size_t i = inst.firstOperand; i < operands.size(); i++)
+		{
+			extended += operands[i].extToken != 0;
+		}
+		fxdis_stats_current->counters[FXDIS_STATS_INSTRUCTIONS]++;
+		fxdis_stats_current->counters[FXDIS_STATS_OPERANDS] += inst.operandCount;
+		fxdis_stats_current->counters[FXDIS_STATS_EXTENDED_TOKENS] += extended;
+		fxdis_stats_current->counters[FXDIS_STATS_RELATIVE_OPERANDS] += inst.relativeCount;
+	}
+#endif
+	return DECODE_STATUS::OK;
+}
+
+DECODE_STATUS TokenDecoder::DecodeOperands(DecodedInstruction& inst, DecodedOperandPool& operands, uint32_t dataPerOperand, bool once)
+{
+	do
+	{
+		if (once && tokenCurrent >= opcodeEnd)
+		{
+			return DECODE_STATUS::TRUNCATED;
+		}
+		if (tokenCurrent >= opcodeEnd)
+		{
+			break;
+		}
+		if (inst.operandCount == UINT8_MAX)
+		{
+			return DECODE_STATUS::TOO_MUCH_DATA;
+		}
+		DecodedOperand operand;
+		DECODE_STATUS status = DecodeOperand(operand, 0);
+		if (status != DECODE_STATUS::OK)
+		{
+			return status;
+		}
+		operands.push_back(operand);
+		inst.operandCount++;
+		status = DecodeData(inst, dataPerOperand);
+		if (status != DECODE_STATUS::OK)
+		{
+			return status;
+		}
+	} while (!once);
+	return DECODE_STATUS::OK;
+}
+
+DECODE_STATUS TokenDecoder::DecodeData(DecodedInstruction& inst, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (tokenCurrent >= opcodeEnd)
+		{
+			return DECODE_STATUS::TRUNCATED;
+		}
+		if (inst.dataCount == DECODED_MAX_DATA)
+		{
+			return DECODE_STATUS::TOO_MUCH_DATA;
+		}
+		inst.data[inst.dataCount++] = *tokenCurrent++;
+	}
+	return DECODE_STATUS::OK;
+}
+
+DECODE_STATUS TokenDecoder::DecodeOperand(DecodedOperand& operand, uint32_t depth)
+{
+	memset(&operand, 0, sizeof(operand));
+	for (uint32_t idx = 0; idx < 3; idx++)
+	{
+		operand.index[idx].relative = DECODED_NO_OPERAND;
+	}
+	if (tokenCurrent >= opcodeEnd)
+	{
+		return DECODE_STATUS::TRUNCATED;
+	}
+	uint32_t oprndToken = *tokenCurrent++;
+	operand.token = oprndToken;
+	operand.type = (uint8_t)DECODE_D3D10_SB_OPERAND_TYPE(oprndToken);
+	if (DECODE_IS_D3D10_SB_OPERAND_EXTENDED(oprndToken))
+	{
+		if (tokenCurrent >= opcodeEnd)
+		{
+			return DECODE_STATUS::TRUNCATED;
+		}
+		operand.extToken = *tokenCurrent++;
+		switch ((D3D10_SB_EXTENDED_OPERAND_TYPE)DECODE_D3D10_SB_EXTENDED_OPERAND_TYPE(operand.extToken))
+		{
+		case D3D10_SB_EXTENDED_OPERAND_MODIFIER:
+			operand.modifier = (uint8_t)DECODE_D3D10_SB_OPERAND_MODIFIER(operand.extToken);
+			operand.minPrecision = (uint8_t)DECODE_D3D11_SB_OPERAND_MIN_PRECISION(operand.extToken);
+			break;
+		case D3D10_SB_EXTENDED_OPERAND_EMPTY:
+			break;
+		default:
+			return DECODE_STATUS::INVALID_OPERAND;
+		}
+	}
+
+	switch ((D3D10_SB_OPERAND_NUM_COMPONENTS)DECODE_D3D10_SB_OPERAND_NUM_COMPONENTS(oprndToken))
+	{
+	case D3D10_SB_OPERAND_0_COMPONENT:
+		operand.numComponents = 0;
+		break;
+	case D3D10_SB_OPERAND_1_COMPONENT:
+		operand.numComponents = 1;
+		break;
+	case D3D10_SB_OPERAND_4_COMPONENT:
+		operand.numComponents = 4;
+		break;
+	default:
+		return DECODE_STATUS::INVALID_OPERAND;
+	}
+
+	if (operand.type == D3D10_SB_OPERAND_TYPE_IMMEDIATE32 || operand.type == D3D10_SB_OPERAND_TYPE_IMMEDIATE64)
+	{
+		uint32_t immCount = operand.numComponents * (operand.type == D3D10_SB_OPERAND_TYPE_IMMEDIATE64 ? 2 : 1);
+		if ((uint32_t)(opcodeEnd - tokenCurrent) < immCount)
+		{
+			return DECODE_STATUS::TRUNCATED;
+		}
+		memcpy(operand.imm, tokenCurrent, immCount * sizeof(uint32_t));
+		operand.immCount = (uint8_t)immCount;
+		tokenCurrent += immCount;
+		return DECODE_STATUS::OK;
+	}
+
+	if (operand.numComponents)
+	{
+		operand.selectionMode = (uint8_t)DECODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(oprndToken);
+		switch ((D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE)operand.selectionMode)
+		{
+		case D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE:
+			operand.mask = (uint8_t)(DECODE_D3D10_SB_OPERAND_4_COMPONENT_MASK(oprndToken) >> 4);
+			for (uint32_t compIndex = 0; compIndex < 4; compIndex++)
+			{
+				operand.swizzle[compIndex] = (uint8_t)compIndex;
+			}
+			break;
+		case D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MODE:
+			for (uint32_t compIndex = 0; compIndex < 4; compIndex++)
+			{
+				operand.swizzle[compIndex] = (uint8_t)DECODE_D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_SOURCE(oprndToken, compIndex);
+			}
+			break;
+		case D3D10_SB_OPERAND_4_COMPONENT_SELECT_1_MODE:
+			for (uint32_t compIndex = 0; compIndex < 4; compIndex++)
+			{
+				operand.swizzle[compIndex] = (uint8_t)DECODE_D3D10_SB_OPERAND_4_COMPONENT_SELECT_1(oprndToken);
+			}
+			break;
+		default:
+			return DECODE_STATUS::INVALID_OPERAND;
+		}
+	}
+
+	operand.indexDim = (uint8_t)DECODE_D3D10_SB_OPERAND_INDEX_DIMENSION(oprndToken);
+	for (uint32_t idx = 0; idx < operand.indexDim; idx++)
+	{
+		DecodedIndex& index = operand.index[idx];
+		index.representation = DECODE_D3D10_SB_OPERAND_INDEX_REPRESENTATION(idx, oprndToken);
+		uint32_t immTokens = 0;
+		bool hasRelative = false;
+		switch ((D3D10_SB_OPERAND_INDEX_REPRESENTATION)index.representation)
+		{
+		case D3D10_SB_OPERAND_INDEX_IMMEDIATE32:
+			immTokens = 1;
+			break;
+		case D3D10_SB_OPERAND_INDEX_IMMEDIATE64:
+			immTokens = 2;
+			break;
+		case D3D10_SB_OPERAND_INDEX_RELATIVE:
+			hasRelative = true;
+			break;
+		case D3D10_SB_OPERAND_INDEX_IMMEDIATE32_PLUS_RELATIVE:
+			immTokens = 1;
+			hasRelative = true;
+			break;
+		case D3D10_SB_OPERAND_INDEX_IMMEDIATE64_PLUS_RELATIVE:
+			immTokens = 2;
+			hasRelative = true;
+			break;
+		default:
+			return DECODE_STATUS::INVALID_OPERAND;
+		}
+		if ((uint32_t)(opcodeEnd - tokenCurrent) < immTokens)
+		{
+			return DECODE_STATUS::TRUNCATED;
+		}
+		for (uint32_t i = 0; i < immTokens; i++)
+		{
+			index.value = (index.value << 32) | *tokenCurrent++;
+		}
+		if (hasRelative)
+		{
+			if (depth == DECODED_MAX_RELATIVE_DEPTH || relative.size() == UINT8_MAX)
+			{
+				return DECODE_STATUS::INVALID_OPERAND;
+			}
+			DecodedOperand relativeOperand;
+			DECODE_STATUS status = DecodeOperand(relativeOperand, depth + 1);
+			if (status != DECODE_STATUS::OK)
+			{
+				return status;
+			}
+			index.relative = (uint32_t)relative.size();
+			relative.push_back(relativeOperand);
+		}
+	}
+	return DECODE_STATUS::OK;
+}
 
-	uint32_t size = *tokenCurrent++;
-	tokenEnd = tokenBegin + (tokenSize > size ? size : tokenSize);
-	if (tokenSize != size)
+bool TokenParser::Parse()
+{
+	TokenDecoder decoder(tokenBegin, tokenSize, arena);
+	DECODE_STATUS status = decoder.DecodeHeader();
+	if (status != DECODE_STATUS::OK)
 	{
-		cout << "// Provided token size and actual size mismatch." << endl;
+		out << "// " << DecodeStatusText[(int)status] << '\n';
+		return false;
 	}
+	FormatHeader(out, decoder.Version(), decoder.SizeMismatch());
 
-	while (tokenCurrent != tokenEnd)
+	DecodedInstruction inst;
+	DecodedOperandPool operands(arena);
+	operands.reserve(32);
+	for (;;)
+	{
+		{
+			FXDIS_STATS_TIME(FXDIS_STATS_DECODE);
+			status = decoder.Next(inst, operands);
+		}
+		if (status != DECODE_STATUS::OK)
+		{
+			break;
+		}
+		FXDIS_STATS_TIME(FXDIS_STATS_FORMAT);
+		FormatInstruction(out, inst, operands.data(), tokenBegin);
+		operands.clear();
+	}
+	if (status != DECODE_STATUS::END)
 	{
-		ParseOpcode();
+		out << "// " << DecodeStatusText[(int)status] << " at token " << decoder.Position() << '\n';
+		return false;
 	}
+	return true;
 }
 
-void TokenParser::ParseOpcode()
+void TokenParser::FormatHeader(std::ostream& out, uint32_t version, bool sizeMismatch)
 {
-	uint32_t opcodeToken = *tokenCurrent++;
-	D3D10_SB_OPCODE_TYPE opcodeType = DECODE_D3D10_SB_OPCODE_TYPE(opcodeToken);
-	uint32_t instructLen = DECODE_D3D10_SB_TOKENIZED_INSTRUCTION_LENGTH(opcodeToken);
-	uint32_t remainLen = instructLen - 1;
-
-	uint32_t extOpcodeToken = 0;
-	bool extOpcode = DECODE_IS_D3D10_SB_OPCODE_EXTENDED(opcodeToken) != 0; // It's always zero in custom data.
-	if (extOpcode)
+	out << TokenText(ShaderTypeText, ShaderTypeTextCount, DECODE_D3D10_SB_TOKENIZED_PROGRAM_TYPE(version))
+		<< DECODE_D3D10_SB_TOKENIZED_PROGRAM_MAJOR_VERSION(version) << "_"
+		<< DECODE_D3D10_SB_TOKENIZED_PROGRAM_MINOR_VERSION(version) << '\n';
+	if (sizeMismatch)
 	{
-		extOpcodeToken = *tokenCurrent++; // only one extend opcode is supported currently.
-		assert(!DECODE_IS_D3D10_SB_OPCODE_EXTENDED(extOpcodeToken));
-		remainLen -= 1;
+		out << "// Provided token size and actual size mismatch.\n";
 	}
+}
 
-	uint32_t* opcodeEnd = tokenCurrent + remainLen;
+void TokenParser::FormatInstruction(std::ostream& out, const DecodedInstruction& inst, const DecodedOperand* operands, const uint32_t* tokens)
+{
+	D3D10_SB_OPCODE_TYPE opcodeType = inst.opcode;
+	uint32_t opcodeToken = inst.opcodeToken;
+	const uint32_t* data = inst.data;
 
 	if (opcodeType != D3D10_SB_OPCODE_CUSTOMDATA)
 	{
-		cout << OpcodeText[opcodeType];
+		out << OpcodeText[opcodeType];
 	}
 
-	auto ReturnTypeOut = [](uint32_t returnType)->void {
-		cout << " (" << ReturnTypeText[DECODE_D3D10_SB_RESOURCE_RETURN_TYPE(returnType, D3D10_SB_4_COMPONENT_X)]
-			<< ", " << ReturnTypeText[DECODE_D3D10_SB_RESOURCE_RETURN_TYPE(returnType, D3D10_SB_4_COMPONENT_Y)]
-			<< ", " << ReturnTypeText[DECODE_D3D10_SB_RESOURCE_RETURN_TYPE(returnType, D3D10_SB_4_COMPONENT_Z)]
-			<< ", " << ReturnTypeText[DECODE_D3D10_SB_RESOURCE_RETURN_TYPE(returnType, D3D10_SB_4_COMPONENT_W)] << ")";};
+	auto ReturnTypeOut = [&out](uint32_t returnType)->void {
+		out << " (" << TokenText(ReturnTypeText, ReturnTypeTextCount, DECODE_D3D10_SB_RESOURCE_RETURN_TYPE(returnType, D3D10_SB_4_COMPONENT_X))
+			<< ", " << TokenText(ReturnTypeText, ReturnTypeTextCount, DECODE_D3D10_SB_RESOURCE_RETURN_TYPE(returnType, D3D10_SB_4_COMPONENT_Y))
+			<< ", " << TokenText(ReturnTypeText, ReturnTypeTextCount, DECODE_D3D10_SB_RESOURCE_RETURN_TYPE(returnType, D3D10_SB_4_COMPONENT_Z))
+			<< ", " << TokenText(ReturnTypeText, ReturnTypeTextCount, DECODE_D3D10_SB_RESOURCE_RETURN_TYPE(returnType, D3D10_SB_4_COMPONENT_W)) << ")";};
 
 	switch (opcodeType)
 	{
 	case D3D10_SB_OPCODE_CUSTOMDATA:
 	{
-		D3D10_SB_CUSTOMDATA_CLASS customData = DECODE_D3D10_SB_CUSTOMDATA_CLASS(opcodeToken);
-		uint32_t customDataLen = *tokenCurrent++;
+		uint32_t customData = data[0];
+		uint32_t customDataLen = data[1];
 		if (customData == D3D10_SB_CUSTOMDATA_DCL_IMMEDIATE_CONSTANT_BUFFER)
 		{
-			cout << "dcl_immediate_const_buffer ";
+			out << "dcl_immediate_const_buffer ";
+			const uint32_t* values = tokens + inst.offset + 2;
 			for (uint32_t idx = 0; idx < customDataLen - 2; idx++)
 			{
 				if (idx % 4)
 				{
-					cout << ", ";
+					out << ", ";
 				}
 				else
 				{
-					cout << " ";
+					out << " ";
 				}
-				cout << *tokenCurrent++;
+				out << values[idx];
 			}
 		}
 		else
 		{
-			cout << "// Custom data " << CustomDataText[customData] << "skipped";
-			tokenCurrent = opcodeEnd;
+			out << "// Custom data " << TokenText(CustomDataText, CustomDataTextCount, customData) << "skipped";
 		}
-
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_RESOURCE:
 	{
-		cout << ResourceDimText[DECODE_D3D10_SB_RESOURCE_DIMENSION(opcodeToken)];
+		out << TokenText(ResourceDimText, ResourceDimTextCount, DECODE_D3D10_SB_RESOURCE_DIMENSION(opcodeToken));
 		switch (DECODE_D3D10_SB_RESOURCE_DIMENSION(opcodeToken))
 		{
 		case D3D10_SB_RESOURCE_DIMENSION_TEXTURE2DMS:
 		case D3D10_SB_RESOURCE_DIMENSION_TEXTURE2DMSARRAY:
-			cout << "(" << DECODE_D3D10_SB_RESOURCE_SAMPLE_COUNT(opcodeToken) << ")";
+			out << "(" << DECODE_D3D10_SB_RESOURCE_SAMPLE_COUNT(opcodeToken) << ")";
 			break;
 		default:
 			break;
 		}
-		cout << " ";
-		ParseOperand(true, opcodeType);
-		uint32_t returnType = *tokenCurrent++;
-		ReturnTypeOut(returnType);
+		out << " ";
+		FormatOperand(out, operands, inst.firstOperand, true, opcodeType);
+		ReturnTypeOut(data[0]);
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER:
 	{
 		if (DECODE_D3D10_SB_CONSTANT_BUFFER_ACCESS_PATTERN(opcodeToken))
 		{
-			cout << " dynamic indexed ";
+			out << " dynamic indexed ";
 		}
 		else
 		{
-			cout << " immediate indexed ";
+			out << " immediate indexed ";
 		}
-		while (tokenCurrent < opcodeEnd)
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
 		}
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_SAMPLER:
 	{
-		cout << " " << SampleModeText[DECODE_D3D10_SB_SAMPLER_MODE(opcodeToken)] << " ";
-		ParseOperand(true, opcodeType);
+		out << " " << TokenText(SampleModeText, SampleModeTextCount, DECODE_D3D10_SB_SAMPLER_MODE(opcodeToken)) << " ";
+		FormatOperand(out, operands, inst.firstOperand, true, opcodeType);
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_INDEX_RANGE:
 	{
-		while (tokenCurrent < opcodeEnd)
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
-			cout << "," << *tokenCurrent++;
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
+			out << "," << data[i];
 		}
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_GS_OUTPUT_PRIMITIVE_TOPOLOGY:
 	{
-		cout << " " << PrimTopoText[DECODE_D3D10_SB_GS_OUTPUT_PRIMITIVE_TOPOLOGY(opcodeToken)];
+		out << " " << TokenText(PrimTopoText, PrimTopoTextCount, DECODE_D3D10_SB_GS_OUTPUT_PRIMITIVE_TOPOLOGY(opcodeToken));
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_GS_INPUT_PRIMITIVE:
 	{
-		cout << " " << PrimitiveText[DECODE_D3D10_SB_GS_INPUT_PRIMITIVE(opcodeToken)];
+		out << " " << TokenText(PrimitiveText, PrimitiveTextCount, DECODE_D3D10_SB_GS_INPUT_PRIMITIVE(opcodeToken));
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_MAX_OUTPUT_VERTEX_COUNT:
 	{
-		cout << " " << *tokenCurrent++;
+		out << " " << data[0];
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_INPUT_PS:
-		cout << " " << InterpModeText[DECODE_D3D10_SB_INPUT_INTERPOLATION_MODE(opcodeToken)] << " ";
+		out << " " << TokenText(InterpModeText, InterpModeTextCount, DECODE_D3D10_SB_INPUT_INTERPOLATION_MODE(opcodeToken)) << " ";
 	case D3D10_SB_OPCODE_DCL_INPUT:
 	case D3D10_SB_OPCODE_DCL_OUTPUT:
 	{
-		while (tokenCurrent < opcodeEnd)
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
 		}
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_INPUT_PS_SIV:
-		cout << " " << InterpModeText[DECODE_D3D10_SB_INPUT_INTERPOLATION_MODE(opcodeToken)] << " ";
+		out << " " << TokenText(InterpModeText, InterpModeTextCount, DECODE_D3D10_SB_INPUT_INTERPOLATION_MODE(opcodeToken)) << " ";
 	case D3D10_SB_OPCODE_DCL_INPUT_SGV:
 	case D3D10_SB_OPCODE_DCL_INPUT_SIV:
 	case D3D10_SB_OPCODE_DCL_INPUT_PS_SGV:
 	case D3D10_SB_OPCODE_DCL_OUTPUT_SGV:
 	case D3D10_SB_OPCODE_DCL_OUTPUT_SIV:
 	{
-		while (tokenCurrent < opcodeEnd)
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
-			uint32_t nameToken = *tokenCurrent++;
-			cout << " " << NameText[DECODE_D3D10_SB_NAME(nameToken)];
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
+			out << " " << TokenText(NameText, NameTextCount, DECODE_D3D10_SB_NAME(data[i]));
 		}
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_TEMPS:
 	{
-		cout << " " << *tokenCurrent++;
+		out << " " << data[0];
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP:
 	{
-		cout << " x" << *tokenCurrent++;
-		cout << "[" << *tokenCurrent++ << "]";
-		cout << ", " << *tokenCurrent++;
+		out << " x" << data[0];
+		out << "[" << data[1] << "]";
+		out << ", " << data[2];
 		break;
 	}
 	case D3D10_SB_OPCODE_DCL_GLOBAL_FLAGS:
@@ -190,366 +1029,182 @@ void TokenParser::ParseOpcode()
 		uint32_t separatorIdx = 0;
 		if (opcodeToken & D3D10_SB_GLOBAL_FLAG_REFACTORING_ALLOWED)
 		{
-			cout << " |"[separatorIdx] << "global refactioring allowed";
+			out << " |"[separatorIdx] << "global refactioring allowed";
 			separatorIdx = 1;
 		}
 		if (opcodeToken & D3D11_SB_GLOBAL_FLAG_ENABLE_DOUBLE_PRECISION_FLOAT_OPS)
 		{
-			cout << " |"[separatorIdx] << "enable double precision float";
+			out << " |"[separatorIdx] << "enable double precision float";
 			separatorIdx = 1;
 		}
 		if (opcodeToken & D3D11_SB_GLOBAL_FLAG_FORCE_EARLY_DEPTH_STENCIL)
 		{
-			cout << " |"[separatorIdx] << "force early depth stencil";
+			out << " |"[separatorIdx] << "force early depth stencil";
 			separatorIdx = 1;
 		}
 		if (opcodeToken & D3D11_SB_GLOBAL_FLAG_ENABLE_RAW_AND_STRUCTURED_BUFFERS)
 		{
-			cout << " |"[separatorIdx] << "enable raw and structured buffers";
+			out << " |"[separatorIdx] << "enable raw and structured buffers";
 			separatorIdx = 1;
 		}
 		if (opcodeToken & D3D11_1_SB_GLOBAL_FLAG_SKIP_OPTIMIZATION)
 		{
-			cout << " |"[separatorIdx] << "skip optimization";
+			out << " |"[separatorIdx] << "skip optimization";
 			separatorIdx = 1;
 		}
 		if (opcodeToken & D3D11_1_SB_GLOBAL_FLAG_ENABLE_MINIMUM_PRECISION)
 		{
-			cout << " |"[separatorIdx] << "enable minimum precision";
+			out << " |"[separatorIdx] << "enable minimum precision";
 			separatorIdx = 1;
 		}
 		if (opcodeToken & D3D11_1_SB_GLOBAL_FLAG_ENABLE_DOUBLE_EXTENSIONS)
 		{
-			cout << " |"[separatorIdx] << "enable double extensions";
+			out << " |"[separatorIdx] << "enable double extensions";
 			separatorIdx = 1;
 		}
 		if (opcodeToken & D3D11_1_SB_GLOBAL_FLAG_ENABLE_SHADER_EXTENSIONS)
 		{
-			cout << " |"[separatorIdx] << "enable shader extensions";
+			out << " |"[separatorIdx] << "enable shader extensions";
 			separatorIdx = 1;
 		}
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_STREAM:
 	{
-		cout << "// stream parse skipped";
-		tokenCurrent = opcodeEnd;
+		out << "// stream parse skipped";
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_FUNCTION_BODY:
 	{
-		cout << "// function body skipped";
-		tokenCurrent = opcodeEnd;
+		out << "// function body skipped";
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_FUNCTION_TABLE:
 	{
-		cout << "// function table skipped";
-		tokenCurrent = opcodeEnd;
+		out << "// function table skipped";
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_INTERFACE:
 	{
-		cout << "// interface skipped";
-		tokenCurrent = opcodeEnd;
+		out << "// interface skipped";
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_INPUT_CONTROL_POINT_COUNT:
-		cout << " " << DECODE_D3D11_SB_INPUT_CONTROL_POINT_COUNT(opcodeToken);
+		out << " " << DECODE_D3D11_SB_INPUT_CONTROL_POINT_COUNT(opcodeToken);
 		break;
 	case D3D11_SB_OPCODE_DCL_OUTPUT_CONTROL_POINT_COUNT:
-		cout << " " << DECODE_D3D11_SB_OUTPUT_CONTROL_POINT_COUNT(opcodeToken);
+		out << " " << DECODE_D3D11_SB_OUTPUT_CONTROL_POINT_COUNT(opcodeToken);
 		break;
 	case D3D11_SB_OPCODE_DCL_TESS_DOMAIN:
-		cout << " " << TessDomainText[DECODE_D3D11_SB_TESS_DOMAIN(opcodeToken)];
+		out << " " << TokenText(TessDomainText, TessDomainTextCount, DECODE_D3D11_SB_TESS_DOMAIN(opcodeToken));
 		break;
 	case D3D11_SB_OPCODE_DCL_TESS_PARTITIONING:
-		cout << " " << TessPartitionText[DECODE_D3D11_SB_TESS_PARTITIONING(opcodeToken)];
+		out << " " << TokenText(TessPartitionText, TessPartitionTextCount, DECODE_D3D11_SB_TESS_PARTITIONING(opcodeToken));
 		break;
 	case D3D11_SB_OPCODE_DCL_TESS_OUTPUT_PRIMITIVE:
-		cout << " " << TessOutputPrimText[DECODE_D3D11_SB_TESS_OUTPUT_PRIMITIVE(opcodeToken)];
+		out << " " << TokenText(TessOutputPrimText, TessOutputPrimTextCount, DECODE_D3D11_SB_TESS_OUTPUT_PRIMITIVE(opcodeToken));
 		break;
 	case D3D11_SB_OPCODE_DCL_HS_MAX_TESSFACTOR:
-		cout << " " << *(float*)tokenCurrent;
-		tokenCurrent++;
+	{
+		float maxTessFactor;
+		memcpy(&maxTessFactor, &data[0], sizeof(maxTessFactor));
+		out << " " << maxTessFactor;
 		break;
+	}
 	case D3D11_SB_OPCODE_DCL_HS_FORK_PHASE_INSTANCE_COUNT:
 	case D3D11_SB_OPCODE_DCL_HS_JOIN_PHASE_INSTANCE_COUNT:
-		cout << " " << *tokenCurrent++;
+		out << " " << data[0];
 		break;
 	case D3D11_SB_OPCODE_DCL_THREAD_GROUP:
-		cout << " " << "x:" << *tokenCurrent++;
-		cout << " " << "y:" << *tokenCurrent++;
-		cout << " " << "z:" << *tokenCurrent++;
+		out << " " << "x:" << data[0];
+		out << " " << "y:" << data[1];
+		out << " " << "z:" << data[2];
 		break;
 	case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_TYPED:
 	{
-		cout << ResourceDimText[DECODE_D3D10_SB_RESOURCE_DIMENSION(opcodeToken)];
+		out << TokenText(ResourceDimText, ResourceDimTextCount, DECODE_D3D10_SB_RESOURCE_DIMENSION(opcodeToken));
 		if (opcodeToken & D3D11_SB_GLOBALLY_COHERENT_ACCESS)
 		{
-			cout << " " << "globally coherent access" << " ";
+			out << " " << "globally coherent access" << " ";
 		}
-		while (tokenCurrent < opcodeEnd)
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
-			uint32_t returnType = *tokenCurrent++;
-			ReturnTypeOut(returnType);
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
+			ReturnTypeOut(data[i]);
 		}
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW:
 	{
-		cout << ResourceDimText[DECODE_D3D10_SB_RESOURCE_DIMENSION(opcodeToken)];
+		out << TokenText(ResourceDimText, ResourceDimTextCount, DECODE_D3D10_SB_RESOURCE_DIMENSION(opcodeToken));
 		if (opcodeToken & D3D11_SB_GLOBALLY_COHERENT_ACCESS)
 		{
-			cout << " " << "globally coherent access" << " ";
+			out << " " << "globally coherent access" << " ";
 		}
-		while (tokenCurrent < opcodeEnd)
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
 		}
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED:
 	{
-		cout << ResourceDimText[DECODE_D3D10_SB_RESOURCE_DIMENSION(opcodeToken)];
+		out << TokenText(ResourceDimText, ResourceDimTextCount, DECODE_D3D10_SB_RESOURCE_DIMENSION(opcodeToken));
 		if (opcodeToken & D3D11_SB_GLOBALLY_COHERENT_ACCESS)
 		{
-			cout << " " << "globally coherent access" << " ";
+			out << " " << "globally coherent access" << " ";
 		}
 		if (opcodeToken & D3D11_SB_UAV_HAS_ORDER_PRESERVING_COUNTER)
 		{
-			cout << " " << "order preserving counter" << " ";
+			out << " " << "order preserving counter" << " ";
 		}
-		while (tokenCurrent < opcodeEnd)
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
-			cout << ", stride(" << *tokenCurrent++ << ")";
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
+			out << ", stride(" << data[i] << ")";
 		}
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_RAW:
 	{
-		while (tokenCurrent < opcodeEnd)
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
-			cout << ", count(" << *tokenCurrent++ << ")";
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
+			out << ", count(" << data[i] << ")";
 		}
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_STRUCTURED:
 	{
-		while (tokenCurrent < opcodeEnd)
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
-			cout << ", stride(" << *tokenCurrent++ << ")";
-			cout << ", count(" << *tokenCurrent++ << ")";
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
+			out << ", stride(" << data[2 * i] << ")";
+			out << ", count(" << data[2 * i + 1] << ")";
 		}
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_RESOURCE_RAW:
 	{
-		while (tokenCurrent < opcodeEnd)
+		// The token header file said there're two operands but only one is provided actually.
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
 		}
-		tokenCurrent = opcodeEnd;// The token header file said there're two operands but only one is provided actually.
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED:
 	{
-		while (tokenCurrent < opcodeEnd)
+		for (uint32_t i = 0; i < inst.operandCount; i++)
 		{
-			ParseOperand(true, opcodeType);
-			cout << ", stride(" << *tokenCurrent++ << ")";
+			FormatOperand(out, operands, inst.firstOperand + i, true, opcodeType);
+			out << ", stride(" << data[i] << ")";
 		}
 		break;
 	}
 	case D3D11_SB_OPCODE_DCL_GS_INSTANCE_COUNT:
 	{
-		cout << " " << *tokenCurrent++;
-		break;
-	}
-	case D3D10_SB_OPCODE_BREAKC:
-	case D3D10_SB_OPCODE_CALLC:
-	case D3D10_SB_OPCODE_CONTINUEC:
-	case D3D10_SB_OPCODE_IF:
-	case D3D10_SB_OPCODE_MOVC:
-	case D3D10_SB_OPCODE_RETC:
-	case D3D11_SB_OPCODE_SWAPC:
-		cout << (DECODE_D3D10_SB_INSTRUCTION_TEST_BOOLEAN(opcodeToken) ? "_nz" : "_z");
-	case D3D10_SB_OPCODE_ADD:
-	case D3D10_SB_OPCODE_AND:
-	case D3D10_SB_OPCODE_BREAK:
-	case D3D10_SB_OPCODE_CALL:
-	case D3D10_SB_OPCODE_CASE:
-	case D3D10_SB_OPCODE_CONTINUE:
-	case D3D10_SB_OPCODE_CUT:
-	case D3D10_SB_OPCODE_DEFAULT:
-	case D3D10_SB_OPCODE_DERIV_RTX:
-	case D3D10_SB_OPCODE_DERIV_RTY:
-	case D3D10_SB_OPCODE_DISCARD:
-	case D3D10_SB_OPCODE_DIV:
-	case D3D10_SB_OPCODE_DP2:
-	case D3D10_SB_OPCODE_DP3:
-	case D3D10_SB_OPCODE_DP4:
-	case D3D10_SB_OPCODE_ELSE:
-	case D3D10_SB_OPCODE_EMIT:
-	case D3D10_SB_OPCODE_EMITTHENCUT:
-	case D3D10_SB_OPCODE_ENDIF:
-	case D3D10_SB_OPCODE_ENDLOOP:
-	case D3D10_SB_OPCODE_ENDSWITCH:
-	case D3D10_SB_OPCODE_EQ:
-	case D3D10_SB_OPCODE_EXP:
-	case D3D10_SB_OPCODE_FRC:
-	case D3D10_SB_OPCODE_FTOI:
-	case D3D10_SB_OPCODE_FTOU:
-	case D3D10_SB_OPCODE_GE:
-	case D3D10_SB_OPCODE_IADD:
-	case D3D10_SB_OPCODE_IEQ:
-	case D3D10_SB_OPCODE_IGE:
-	case D3D10_SB_OPCODE_ILT:
-	case D3D10_SB_OPCODE_IMAD:
-	case D3D10_SB_OPCODE_IMAX:
-	case D3D10_SB_OPCODE_IMIN:
-	case D3D10_SB_OPCODE_IMUL:
-	case D3D10_SB_OPCODE_INE:
-	case D3D10_SB_OPCODE_INEG:
-	case D3D10_SB_OPCODE_ISHL:
-	case D3D10_SB_OPCODE_ISHR:
-	case D3D10_SB_OPCODE_ITOF:
-	case D3D10_SB_OPCODE_LABEL:
-	case D3D10_SB_OPCODE_LD:
-	case D3D10_SB_OPCODE_LD_MS:
-	case D3D10_SB_OPCODE_LOG:
-	case D3D10_SB_OPCODE_LOOP:
-	case D3D10_SB_OPCODE_LT:
-	case D3D10_SB_OPCODE_MAD:
-	case D3D10_SB_OPCODE_MIN:
-	case D3D10_SB_OPCODE_MAX:
-	case D3D10_SB_OPCODE_MOV:
-	case D3D10_SB_OPCODE_MUL:
-	case D3D10_SB_OPCODE_NE:
-	case D3D10_SB_OPCODE_NOP:
-	case D3D10_SB_OPCODE_NOT:
-	case D3D10_SB_OPCODE_OR:
-	case D3D10_SB_OPCODE_RESINFO:
-	case D3D10_SB_OPCODE_RET:
-	case D3D10_SB_OPCODE_ROUND_NE:
-	case D3D10_SB_OPCODE_ROUND_NI:
-	case D3D10_SB_OPCODE_ROUND_PI:
-	case D3D10_SB_OPCODE_ROUND_Z:
-	case D3D10_SB_OPCODE_RSQ:
-	case D3D10_SB_OPCODE_SAMPLE:
-	case D3D10_SB_OPCODE_SAMPLE_C:
-	case D3D10_SB_OPCODE_SAMPLE_C_LZ:
-	case D3D10_SB_OPCODE_SAMPLE_L:
-	case D3D10_SB_OPCODE_SAMPLE_D:
-	case D3D10_SB_OPCODE_SAMPLE_B:
-	case D3D10_SB_OPCODE_SQRT:
-	case D3D10_SB_OPCODE_SWITCH:
-	case D3D10_SB_OPCODE_SINCOS:
-	case D3D10_SB_OPCODE_UDIV:
-	case D3D10_SB_OPCODE_ULT:
-	case D3D10_SB_OPCODE_UGE:
-	case D3D10_SB_OPCODE_UMUL:
-	case D3D10_SB_OPCODE_UMAD:
-	case D3D10_SB_OPCODE_UMAX:
-	case D3D10_SB_OPCODE_UMIN:
-	case D3D10_SB_OPCODE_USHR:
-	case D3D10_SB_OPCODE_UTOF:
-	case D3D10_SB_OPCODE_XOR:
-	case D3D10_1_SB_OPCODE_LOD:
-	case D3D10_1_SB_OPCODE_GATHER4:
-	case D3D10_1_SB_OPCODE_SAMPLE_POS:
-	case D3D10_1_SB_OPCODE_SAMPLE_INFO:
-	case D3D11_SB_OPCODE_HS_DECLS:
-	case D3D11_SB_OPCODE_HS_CONTROL_POINT_PHASE:
-	case D3D11_SB_OPCODE_HS_FORK_PHASE:
-	case D3D11_SB_OPCODE_HS_JOIN_PHASE:
-	case D3D11_SB_OPCODE_EMIT_STREAM:
-	case D3D11_SB_OPCODE_CUT_STREAM:
-	case D3D11_SB_OPCODE_EMITTHENCUT_STREAM:
-	case D3D11_SB_OPCODE_INTERFACE_CALL:
-	case D3D11_SB_OPCODE_BUFINFO:
-	case D3D11_SB_OPCODE_DERIV_RTX_COARSE:
-	case D3D11_SB_OPCODE_DERIV_RTX_FINE:
-	case D3D11_SB_OPCODE_DERIV_RTY_COARSE:
-	case D3D11_SB_OPCODE_DERIV_RTY_FINE:
-	case D3D11_SB_OPCODE_GATHER4_C:
-	case D3D11_SB_OPCODE_GATHER4_PO:
-	case D3D11_SB_OPCODE_GATHER4_PO_C:
-	case D3D11_SB_OPCODE_RCP:
-	case D3D11_SB_OPCODE_F32TOF16:
-	case D3D11_SB_OPCODE_F16TOF32:
-	case D3D11_SB_OPCODE_UADDC:
-	case D3D11_SB_OPCODE_USUBB:
-	case D3D11_SB_OPCODE_COUNTBITS:
-	case D3D11_SB_OPCODE_FIRSTBIT_HI:
-	case D3D11_SB_OPCODE_FIRSTBIT_LO:
-	case D3D11_SB_OPCODE_FIRSTBIT_SHI:
-	case D3D11_SB_OPCODE_UBFE:
-	case D3D11_SB_OPCODE_IBFE:
-	case D3D11_SB_OPCODE_BFI:
-	case D3D11_SB_OPCODE_BFREV:
-	case D3D11_SB_OPCODE_LD_UAV_TYPED:
-	case D3D11_SB_OPCODE_STORE_UAV_TYPED:
-	case D3D11_SB_OPCODE_LD_RAW:
-	case D3D11_SB_OPCODE_STORE_RAW:
-	case D3D11_SB_OPCODE_LD_STRUCTURED:
-	case D3D11_SB_OPCODE_STORE_STRUCTURED:
-	case D3D11_SB_OPCODE_ATOMIC_AND:
-	case D3D11_SB_OPCODE_ATOMIC_OR:
-	case D3D11_SB_OPCODE_ATOMIC_XOR:
-	case D3D11_SB_OPCODE_ATOMIC_CMP_STORE:
-	case D3D11_SB_OPCODE_ATOMIC_IADD:
-	case D3D11_SB_OPCODE_ATOMIC_IMAX:
-	case D3D11_SB_OPCODE_ATOMIC_IMIN:
-	case D3D11_SB_OPCODE_ATOMIC_UMAX:
-	case D3D11_SB_OPCODE_ATOMIC_UMIN:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_ALLOC:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_CONSUME:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_IADD:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_AND:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_OR:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_XOR:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_EXCH:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_CMP_EXCH:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_IMAX:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_IMIN:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_UMAX:
-	case D3D11_SB_OPCODE_IMM_ATOMIC_UMIN:
-	case D3D11_SB_OPCODE_SYNC:
-	case D3D11_SB_OPCODE_DADD:
-	case D3D11_SB_OPCODE_DMAX:
-	case D3D11_SB_OPCODE_DMIN:
-	case D3D11_SB_OPCODE_DMUL:
-	case D3D11_SB_OPCODE_DEQ:
-	case D3D11_SB_OPCODE_DGE:
-	case D3D11_SB_OPCODE_DLT:
-	case D3D11_SB_OPCODE_DNE:
-	case D3D11_SB_OPCODE_DMOV:
-	case D3D11_SB_OPCODE_DMOVC:
-	case D3D11_SB_OPCODE_DTOF:
-	case D3D11_SB_OPCODE_FTOD:
-	case D3D11_SB_OPCODE_EVAL_SNAPPED:
-	case D3D11_SB_OPCODE_EVAL_SAMPLE_INDEX:
-	case D3D11_SB_OPCODE_EVAL_CENTROID:
-	case D3D11_1_SB_OPCODE_DDIV:
-	case D3D11_1_SB_OPCODE_DFMA:
-	case D3D11_1_SB_OPCODE_DRCP:
-	case D3D11_1_SB_OPCODE_MSAD:
-	case D3D11_1_SB_OPCODE_DTOI:
-	case D3D11_1_SB_OPCODE_DTOU:
-	case D3D11_1_SB_OPCODE_ITOD:
-	case D3D11_1_SB_OPCODE_UTOD:
-	{
-		bool firstOprnd = true;
-		while (tokenCurrent < opcodeEnd)
-		{
-			ParseOperand(firstOprnd, opcodeType);
-			firstOprnd = false;
-		}
+		out << " " << data[0];
 		break;
 	}
 	case D3DWDDM1_3_SB_OPCODE_GATHER4_FEEDBACK:
@@ -567,193 +1222,151 @@ void TokenParser::ParseOpcode()
 	case D3DWDDM1_3_SB_OPCODE_SAMPLE_B_CLAMP_FEEDBACK:
 	case D3DWDDM1_3_SB_OPCODE_SAMPLE_D_CLAMP_FEEDBACK:
 	case D3DWDDM1_3_SB_OPCODE_SAMPLE_C_CLAMP_FEEDBACK:
-		cout << " // Donot know how to parse opcode with _feedback suffix.";
-		tokenCurrent = opcodeEnd;
+		out << " // Donot know how to parse opcode with _feedback suffix.";
 		break;
 	case D3DWDDM1_3_SB_OPCODE_CHECK_ACCESS_FULLY_MAPPED:
-		cout << " // skipped";
-		tokenCurrent = opcodeEnd;
+		out << " // skipped";
 		break;
-	case D3D11_SB_OPCODE_ABORT:
-	case D3D11_SB_OPCODE_DEBUG_BREAK:
-	case D3D11_SB_OPCODE_RESERVED0:
-	case D3D10_SB_OPCODE_RESERVED0:
-	case D3D10_1_SB_OPCODE_RESERVED1:
-	case D3D11_1_SB_OPCODE_RESERVED0:
-	case D3DWDDM1_3_SB_OPCODE_RESERVED0:
-	case D3D10_SB_NUM_OPCODES:
+	case D3D10_SB_OPCODE_BREAKC:
+	case D3D10_SB_OPCODE_CALLC:
+	case D3D10_SB_OPCODE_CONTINUEC:
+	case D3D10_SB_OPCODE_IF:
+	case D3D10_SB_OPCODE_MOVC:
+	case D3D10_SB_OPCODE_RETC:
+	case D3D11_SB_OPCODE_SWAPC:
+		out << (DECODE_D3D10_SB_INSTRUCTION_TEST_BOOLEAN(opcodeToken) ? "_nz" : "_z");
 	default:
-		assert(!"Invalid opcode types.");
-		tokenCurrent = opcodeEnd;
+	{
+		// Everything else the decoder accepts is a plain operand list.
+		for (uint32_t i = 0; i < inst.operandCount; i++)
+		{
+			FormatOperand(out, operands, inst.firstOperand + i, i == 0, opcodeType);
+		}
 		break;
 	}
+	}
 
-	cout << endl;
+	out << '\n';
 }
 
-void TokenParser::ParseOperand(bool firstOperand, D3D10_SB_OPCODE_TYPE opcodeType)
+void TokenParser::FormatOperand(std::ostream& out, const DecodedOperand* operands, uint32_t operand, bool firstOperand, D3D10_SB_OPCODE_TYPE opcodeType)
 {
 	if (!firstOperand)
 	{
-		cout << ",";
+		out << ",";
 	}
 
-	auto ReadImm = [](D3D10_SB_OPCODE_TYPE type, uint32_t* ptr)->void {
+	auto ReadImm = [&out](D3D10_SB_OPCODE_TYPE type, const uint32_t* ptr)->void {
 		switch (OpcodeDataType[type])
 		{
 		case OPCODE_DATA_TYPE::UNKNOWN:
-			cout << "// (float is used for unknown opcode data types)";
+			out << "// (float is used for unknown opcode data types)";
 		case OPCODE_DATA_TYPE::FLOAT:
-			cout << *(float*)ptr;
+		{
+			float value;
+			memcpy(&value, ptr, sizeof(value));
+			out << value;
 			break;
+		}
 		case OPCODE_DATA_TYPE::SINT:
-			cout << *(int32_t*)ptr;
+			out << (int32_t)*ptr;
 			break;
 		case OPCODE_DATA_TYPE::UINT:
-			cout << *(uint32_t*)ptr;
+			out << *ptr;
 			break;
 		case OPCODE_DATA_TYPE::DOUBLE:
-			cout << *(double*)ptr;
+		{
+			double value;
+			memcpy(&value, ptr, sizeof(value));
+			out << value;
 			break;
+		}
 		default:
 			assert(!"It should never be reached.");
 			break;
 		}
 	};
-	uint32_t oprndToken = *tokenCurrent++;
-	D3D10_SB_OPERAND_TYPE oprndType = DECODE_D3D10_SB_OPERAND_TYPE(oprndToken);
-	cout << " " << OperandText[oprndType];
-	bool extOprnd = DECODE_IS_D3D10_SB_OPERAND_EXTENDED(oprndToken) != 0;
-	uint32_t extOprndToken = 0;
-	if (extOprnd)
-	{
-		extOprndToken = *tokenCurrent++;
-	}
-
-	uint32_t numComp = 0;
-	switch ((D3D10_SB_OPERAND_NUM_COMPONENTS)DECODE_D3D10_SB_OPERAND_NUM_COMPONENTS(oprndToken))
-	{
-	case D3D10_SB_OPERAND_0_COMPONENT:
-		numComp = 0;
-		break;
-	case D3D10_SB_OPERAND_1_COMPONENT:
-		numComp = 1;
-		break;
-	case D3D10_SB_OPERAND_4_COMPONENT:
-		numComp = 4;
-		break;
-	case D3D10_SB_OPERAND_N_COMPONENT:
-		assert(!"This type is not used.");
-	default:
-		break;
-	}
+	const DecodedOperand& oprnd = operands[operand];
+	out << " " << TokenText(OperandText, OperandTextCount, oprnd.type);
 
 	bool compSuffix = true;
-	D3D10_SB_OPERAND_INDEX_DIMENSION indexDim = DECODE_D3D10_SB_OPERAND_INDEX_DIMENSION(oprndToken);
-	if (oprndType == D3D10_SB_OPERAND_TYPE_IMMEDIATE32)
-	{
-		compSuffix = false;
-		cout << "(";
-		for (uint32_t immIdx = 0; immIdx < numComp; immIdx++)
-		{
-			if (immIdx)
-			{
-				cout << ",";
-			}
-			ReadImm(opcodeType, tokenCurrent);
-			tokenCurrent++;
-		}
-		cout << ")";
-	}
-	else if (oprndType == D3D10_SB_OPERAND_TYPE_IMMEDIATE64)
+	if (oprnd.type == D3D10_SB_OPERAND_TYPE_IMMEDIATE32 || oprnd.type == D3D10_SB_OPERAND_TYPE_IMMEDIATE64)
 	{
+		uint32_t stride = oprnd.type == D3D10_SB_OPERAND_TYPE_IMMEDIATE64 ? 2 : 1;
 		compSuffix = false;
-		cout << "(";
-		for (uint32_t immIdx = 0; immIdx < numComp; immIdx++)
+		out << "(";
+		for (uint32_t immIdx = 0; immIdx < oprnd.numComponents; immIdx++)
 		{
 			if (immIdx)
 			{
-				cout << ",";
+				out << ",";
 			}
-			ReadImm(opcodeType, tokenCurrent);
-			tokenCurrent += 2;
+			ReadImm(opcodeType, &oprnd.imm[immIdx * stride]);
 		}
-		cout << ")";
+		out << ")";
 	}
 	else
 	{
-		for (uint32_t idx = 0; idx < (uint32_t)indexDim; idx++)
+		for (uint32_t idx = 0; idx < oprnd.indexDim; idx++)
 		{
+			const DecodedIndex& index = oprnd.index[idx];
 			if (idx)
 			{
-				cout << "[";
+				out << "[";
 			}
 
-			switch ((D3D10_SB_OPERAND_INDEX_REPRESENTATION)(DECODE_D3D10_SB_OPERAND_INDEX_REPRESENTATION(idx, oprndToken)))
+			switch ((D3D10_SB_OPERAND_INDEX_REPRESENTATION)index.representation)
 			{
 			case D3D10_SB_OPERAND_INDEX_IMMEDIATE32:
-				cout << *tokenCurrent++;
-				break;
-			case D3D10_SB_OPERAND_INDEX_IMMEDIATE64:
-				cout << *tokenCurrent++; // 64 HI
-				cout << *tokenCurrent++; // 64 LO
-				break;
-			case D3D10_SB_OPERAND_INDEX_RELATIVE:
-				ParseOperand(true, opcodeType);
-				break;
 			case D3D10_SB_OPERAND_INDEX_IMMEDIATE32_PLUS_RELATIVE:
-				cout << *tokenCurrent++;
-				ParseOperand(true, opcodeType);
+				out << (uint32_t)index.value;
 				break;
+			case D3D10_SB_OPERAND_INDEX_IMMEDIATE64:
 			case D3D10_SB_OPERAND_INDEX_IMMEDIATE64_PLUS_RELATIVE:
-				cout << *tokenCurrent++;
-				cout << *tokenCurrent++;
-				ParseOperand(true, opcodeType);
+				out << (uint32_t)(index.value >> 32); // 64 HI
+				out << (uint32_t)index.value; // 64 LO
 				break;
 			default:
-				assert(!"It should never be reached.");
 				break;
 			}
+			if (index.relative != DECODED_NO_OPERAND)
+			{
+				FormatOperand(out, operands, index.relative, true, opcodeType);
+			}
 
 			if (idx)
 			{
-				cout << "]";
+				out << "]";
 			}
 		}
 	}
 
-	if (numComp && compSuffix)
+	if (oprnd.numComponents && compSuffix)
 	{
-		cout << ".";
-		switch ((D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE)DECODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(oprndToken))
+		out << ".";
+		switch ((D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE)oprnd.selectionMode)
 		{
 		case D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE:
 		{
-			uint32_t compMasks[] = {
-				D3D10_SB_OPERAND_4_COMPONENT_MASK_X,
-				D3D10_SB_OPERAND_4_COMPONENT_MASK_Y,
-				D3D10_SB_OPERAND_4_COMPONENT_MASK_Z,
-				D3D10_SB_OPERAND_4_COMPONENT_MASK_W,
-			};
-			for (uint32_t compIndex = 0;compIndex < numComp;compIndex++)
+			for (uint32_t compIndex = 0;compIndex < oprnd.numComponents;compIndex++)
 			{
-				if (compMasks[compIndex] & ENCODE_D3D10_SB_OPERAND_4_COMPONENT_MASK(oprndToken))
+				if (oprnd.mask & (1 << compIndex))
 				{
-					cout << "xyzw"[compIndex];
+					out << "xyzw"[compIndex];
 				}
 			}
 			break;
 		}
 		case D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MODE:
 		{
-			for (uint32_t compIndex = 0; compIndex < numComp; compIndex++)
+			for (uint32_t compIndex = 0; compIndex < oprnd.numComponents; compIndex++)
 			{
-				cout << "xyzw"[DECODE_D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_SOURCE(oprndToken, compIndex)];
+				out << "xyzw"[oprnd.swizzle[compIndex]];
 			}
 			break;
 		}
 		case D3D10_SB_OPERAND_4_COMPONENT_SELECT_1_MODE:
-			cout << "xyzw"[DECODE_D3D10_SB_OPERAND_4_COMPONENT_SELECT_1(oprndToken)];
+			out << "xyzw"[oprnd.swizzle[0]];
 			break;
 		default:
 			assert(!"It should never be reached.");
@@ -761,21 +1374,9 @@ void TokenParser::ParseOperand(bool firstOperand, D3D10_SB_OPCODE_TYPE opcodeTyp
 		}
 	}
 
-	if (extOprnd)
+	if (oprnd.extToken && DECODE_D3D10_SB_EXTENDED_OPERAND_TYPE(oprnd.extToken) == D3D10_SB_EXTENDED_OPERAND_MODIFIER)
 	{
-		switch ((D3D10_SB_EXTENDED_OPERAND_TYPE)DECODE_D3D10_SB_EXTENDED_OPERAND_TYPE(extOprndToken))
-		{
-		case D3D10_SB_EXTENDED_OPERAND_MODIFIER:
-			cout << ModifierText[DECODE_D3D10_SB_OPERAND_MODIFIER(extOprndToken)];
-			cout << MinPrecisionText[DECODE_D3D11_SB_OPERAND_MIN_PRECISION(extOprndToken)];
-			break;
-		case D3D10_SB_EXTENDED_OPERAND_EMPTY:
-			// nothing
-			break;
-		default:
-			assert(!"It should never be reached.");
-			break;
-		}
+		out << TokenText(ModifierText, ModifierTextCount, oprnd.modifier);
+		out << TokenText(MinPrecisionText, MinPrecisionTextCount, oprnd.minPrecision);
 	}
 }
-
@@ -8,6 +8,7 @@ const char* ShaderTypeText[] = {
 	"ds_",
 	"cs_"
 };
+const uint32_t ShaderTypeTextCount = sizeof(ShaderTypeText) / sizeof(ShaderTypeText[0]);
 
 // Text for D3D10_SB_OPCODE_TYPE and the names are aligned with SM4/5 assembly. 
 const char* OpcodeText[] = {
@@ -254,6 +255,7 @@ const char* OpcodeText[] = {
 	"// EndOfWDDM1_3Text",
 };
 static_assert(D3D10_SB_NUM_OPCODES == sizeof(OpcodeText) / sizeof(OpcodeText[0]), "OpcodeStringMismatch");
+const uint32_t OpcodeTextCount = sizeof(OpcodeText) / sizeof(OpcodeText[0]);
 
 // Text for D3D10_SB_OPERAND_TYPE
 const char* OperandText[] = {
@@ -299,6 +301,7 @@ const char* OperandText[] = {
 	"oDepthLE",
 	"cycleCounter"
 };
+const uint32_t OperandTextCount = sizeof(OperandText) / sizeof(OperandText[0]);
 
 // Text for D3D10_SB_OPERAND_MODIFIER
 const char* ModifierText[] = {
@@ -307,6 +310,7 @@ const char* ModifierText[] = {
 	"(abs)",
 	"(abs-neg)"
 };
+const uint32_t ModifierTextCount = sizeof(ModifierText) / sizeof(ModifierText[0]);
 
 // Text for D3D11_SB_OPERAND_MIN_PRECISION
 const char* MinPrecisionText[] = {
@@ -316,6 +320,7 @@ const char* MinPrecisionText[] = {
 	", {min16sint}",
 	", {min16uint}"
 };
+const uint32_t MinPrecisionTextCount = sizeof(MinPrecisionText) / sizeof(MinPrecisionText[0]);
 
 // Text for D3D10_SB_INTERPOLATION_MODE
 const char* InterpModeText[] = {
@@ -328,6 +333,7 @@ const char* InterpModeText[] = {
 	"linear_sample",
 	"linear_noperspective_sample"
 };
+const uint32_t InterpModeTextCount = sizeof(InterpModeText) / sizeof(InterpModeText[0]);
 
 // Text for D3D10_SB_NAME
 const char* NameText[] = {
@@ -355,6 +361,7 @@ const char* NameText[] = {
 	"finalLineDetailTessFactor",
 	"finalLineDensityTessFactor"
 };
+const uint32_t NameTextCount = sizeof(NameText) / sizeof(NameText[0]);
 
 // Text for D3D10_SB_RESOURCE_DIMENSION
 const char* ResourceDimText[] = {
@@ -372,6 +379,7 @@ const char* ResourceDimText[] = {
 	"_textureRawBuffer",
 	"_textureStructuredBuffer"
 };
+const uint32_t ResourceDimTextCount = sizeof(ResourceDimText) / sizeof(ResourceDimText[0]);
 
 // Text for D3D10_SB_CUSTOMDATA_CLASS
 const char* CustomDataText[] = {
@@ -382,6 +390,7 @@ const char* CustomDataText[] = {
 	"shader message",
 	"clip plane constant mappings for DX9"
 };
+const uint32_t CustomDataTextCount = sizeof(CustomDataText) / sizeof(CustomDataText[0]);
 
 // Text for D3D10_SB_RESOURCE_RETURN_TYPE
 const char* ReturnTypeText[] = {
@@ -396,6 +405,7 @@ const char* ReturnTypeText[] = {
 	"continued",
 	"unused"
 };
+const uint32_t ReturnTypeTextCount = sizeof(ReturnTypeText) / sizeof(ReturnTypeText[0]);
 
 // Text for D3D10_SB_SAMPLE_MODE
 const char* SampleModeText[] = {
@@ -403,6 +413,7 @@ const char* SampleModeText[] = {
 	"mode_comparision",
 	"mode_mono"
 };
+const uint32_t SampleModeTextCount = sizeof(SampleModeText) / sizeof(SampleModeText[0]);
 
 // Text for D3D10_SB_PRIMITIVE_TOPOLOGY
 const char* PrimTopoText[] = {
@@ -421,6 +432,7 @@ const char* PrimTopoText[] = {
 	"triangle list adj",
 	"triangle strip adj"
 };
+const uint32_t PrimTopoTextCount = sizeof(PrimTopoText) / sizeof(PrimTopoText[0]);
 
 // Text for D3D10_SB_PRIMITIVE
 const char* PrimitiveText[] = {
@@ -465,6 +477,7 @@ const char* PrimitiveText[] = {
 	"patch_31_control_point",
 	"patch_32_control_point",
 };
+const uint32_t PrimitiveTextCount = sizeof(PrimitiveText) / sizeof(PrimitiveText[0]);
 
 // Text for D3D11_SB_TESSELLATOR_DOMAIN
 const char* TessDomainText[] = {
@@ -473,6 +486,7 @@ const char* TessDomainText[] = {
 	"tri",
 	"quad"
 };
+const uint32_t TessDomainTextCount = sizeof(TessDomainText) / sizeof(TessDomainText[0]);
 
 // Text for D3D11_SB_TESSELLATOR_PARTITIONING
 const char* TessPartitionText[] = {
@@ -482,6 +496,7 @@ const char* TessPartitionText[] = {
 	"fractional_odd",
 	"fractional_even"
 };
+const uint32_t TessPartitionTextCount = sizeof(TessPartitionText) / sizeof(TessPartitionText[0]);
 
 const char* TessOutputPrimText[] = {
 	"undefined",
@@ -490,6 +505,7 @@ const char* TessOutputPrimText[] = {
 	"triangle_cw",
 	"triangle_ccw"
 };
+const uint32_t TessOutputPrimTextCount = sizeof(TessOutputPrimText) / sizeof(TessOutputPrimText[0]);
 
 const OPCODE_DATA_TYPE OpcodeDataType[] = {
 	OPCODE_DATA_TYPE::FLOAT, //"add",
@@ -729,4 +745,14 @@ const OPCODE_DATA_TYPE OpcodeDataType[] = {
 	OPCODE_DATA_TYPE::UNKNOWN, //"check_access_fully_mapped",
 	OPCODE_DATA_TYPE::UNKNOWN, //"// EndOfWDDM1_3Text",
 };
-static_assert(D3D10_SB_NUM_OPCODES == sizeof(OpcodeDataType) / sizeof(OpcodeDataType[0]), "OpcodeDataType mismatch with opcode numbers");
\ No newline at end of file
+static_assert(D3D10_SB_NUM_OPCODES == sizeof(OpcodeDataType) / sizeof(OpcodeDataType[0]), "OpcodeDataType mismatch with opcode numbers");
+
+// Text for DECODE_STATUS
+const char* DecodeStatusText[] = {
+	"ok",
+	"end of program",
+	"truncated instruction",
+	"invalid opcode",
+	"invalid operand",
+	"too much declaration data",
+};
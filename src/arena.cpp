@@ -0,0 +1,88 @@
+#include "arena.h"
+#include "fxdis_stats.h"
+#include <stdlib.h>
+
+fxdis_arena::fxdis_arena(size_t block_size)
+    : current(NULL), limit(NULL), block_begin(NULL), blocks(NULL), initial(NULL), initial_size(0),
+      block_size(block_size), retired(0), peak(0), heap_bytes(0), block_count(0), depth(0)
+{
+}
+
+fxdis_arena::fxdis_arena(void* buffer, size_t size)
+    : current((char*)buffer), limit((char*)buffer + size), block_begin((char*)buffer), blocks(NULL),
+      initial((char*)buffer), initial_size(size), block_size(64 << 10), retired(0), peak(0),
+      heap_bytes(0), block_count(0), depth(0)
+{
+}
+
+fxdis_arena::~fxdis_arena()
+{
+    release_blocks();
+}
+
+void* fxdis_arena::allocate(size_t size, size_t align)
+{
+    uintptr_t p = ((uintptr_t)current + align - 1) & ~(uintptr_t)(align - 1);
+    if (!current || p > (uintptr_t)limit || size > (size_t)((uintptr_t)limit - p))
+    {
+        if (!grow(size + align))
+            return NULL;
+        p = ((uintptr_t)current + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    current = (char*)p + size;
+    return (void*)p;
+}
+
+bool fxdis_arena::grow(size_t size)
+{
+    size_t bytes = size > block_size ? size : block_size;
+    FXDIS_STATS_ADD(FXDIS_STATS_ALLOCATIONS, 1);
+    block* b = (block*)malloc(sizeof(block) + bytes);
+    if (!b)
+        return false;
+    b->next = blocks;
+    b->size = bytes;
+    blocks = b;
+    heap_bytes += bytes;
+    block_count++;
+    retired += (size_t)(current - block_begin);
+    block_begin = current = (char*)(b + 1);
+    limit = current + bytes;
+    return true;
+}
+
+void fxdis_arena::release_blocks()
+{
+    while (blocks)
+    {
+        block* next = blocks->next;
+        free(blocks);
+        blocks = next;
+    }
+    heap_bytes = 0;
+}
+
+void fxdis_arena::reset()
+{
+    size_t needed = used();
+    if (needed > peak)
+        peak = needed;
+
+    // More than one region in use means the last shader did not fit; make room for it in one.
+    if (blocks && (blocks->next || initial))
+    {
+        release_blocks();
+        block_begin = current = limit = NULL;
+        retired = 0;
+        if (needed > initial_size)
+            grow(needed);
+    }
+    if (blocks)
+        current = block_begin = (char*)(blocks + 1);
+    else
+    {
+        current = block_begin = initial;
+        limit = initial + initial_size;
+    }
+    retired = 0;
+}
@@ -0,0 +1,327 @@
+#include "buffer_access.h"
+#include <string.h>
+#include <algorithm>
+
+const char* buffer_finding_text[] = {
+    "unaligned_stride",
+    "partial_load",
+    "scattered",
+    "strided",
+};
+
+namespace {
+
+#define NO_OPERAND 0xffffffffu
+#define NO_DECLARATION 0xffffffffu
+// The largest thread group Direct3D allows; larger declarations are only counted this far.
+#define MAX_GROUP_THREADS 1024u
+// Direct3D caps structures at 2048 bytes; coverage is not tracked for larger ones.
+#define MAX_STRIDE_DWORDS 512u
+// Strided accesses are reported below this share of fetched bytes used.
+#define MIN_EFFICIENCY 0.5
+
+bool is_access(D3D10_SB_OPCODE_TYPE opcode)
+{
+    return opcode == D3D11_SB_OPCODE_LD_STRUCTURED || opcode == D3D11_SB_OPCODE_STORE_STRUCTURED
+        || opcode == D3D11_SB_OPCODE_LD_RAW || opcode == D3D11_SB_OPCODE_STORE_RAW;
+}
+
+bool is_load(D3D10_SB_OPCODE_TYPE opcode)
+{
+    return opcode == D3D11_SB_OPCODE_LD_STRUCTURED || opcode == D3D11_SB_OPCODE_LD_RAW;
+}
+
+// Where an access's buffer and address operands are.
+struct access_operands
+{
+    uint32_t buffer;
+    uint32_t index;             // byte address for raw accesses
+    uint32_t offset;            // NO_OPERAND for raw accesses
+};
+
+access_operands operands_of(D3D10_SB_OPCODE_TYPE opcode)
+{
+    switch (opcode)
+    {
+    case D3D11_SB_OPCODE_LD_STRUCTURED:
+        return { 3, 1, 2 };
+    case D3D11_SB_OPCODE_STORE_STRUCTURED:
+        return { 0, 1, 2 };
+    case D3D11_SB_OPCODE_LD_RAW:
+        return { 2, 1, NO_OPERAND };
+    default:
+        return { 0, 1, NO_OPERAND };
+    }
+}
+
+uint32_t register_of(const DecodedOperand& operand)
+{
+    return operand.indexDim ? (uint32_t)operand.index[0].value : 0;
+}
+
+uint32_t popcount4(uint32_t mask)
+{
+    return (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1) + (mask >> 3 & 1);
+}
+
+struct buffer_declaration
+{
+    uint32_t instruction;
+    uint32_t type;
+    uint32_t reg;
+    uint32_t stride;            // 0 for raw
+    bool structured;
+    std::vector<uint8_t> read;  // per dword of the structure: some load reads it
+    bool read_all;              // a load reads at an offset that is not known
+};
+
+struct buffer_use
+{
+    uint32_t instruction;
+    uint32_t declaration;
+    uint32_t components;        // dwords from the address on that are read or written
+};
+
+bool by_instruction(const buffer_finding& a, const buffer_finding& b)
+{
+    return a.instruction < b.instruction;
+}
+
+class analysis
+{
+public:
+    analysis(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands, const cfg& graph,
+        const hardware_profile& profile, buffer_report& result)
+        : instructions(instructions), count(count), operands(operands), graph(graph), profile(profile), result(result),
+        compute(false)
+    {
+    }
+
+    bool run()
+    {
+        result.findings.clear();
+        for (uint32_t i = 0; i < count; i++)
+            scan(i, instructions[i]);
+
+        for (buffer_declaration& d : declarations)
+        {
+            if (d.structured && d.stride % 16 && 16 % d.stride)
+                add(BUFFER_UNALIGNED_STRIDE, d.instruction, d, 0);
+        }
+
+        if (compute)
+        {
+            for (const buffer_use& use : uses)
+            {
+                access_operands a = operands_of(instructions[use.instruction].opcode);
+                thread_affine_query q = { use.instruction, a.index };
+                queries.push_back(q);
+                q.operand = a.offset != NO_OPERAND ? a.offset : a.index;
+                queries.push_back(q);
+            }
+            if (!thread_affine_solve(instructions, count, operands, graph, group, queries, values))
+                return false;
+        }
+
+        for (size_t u = 0; u < uses.size(); u++)
+        {
+            const buffer_use& use = uses[u];
+            const buffer_declaration& d = declarations[use.declaration];
+            uint32_t bytes = popcount4(use.components) * 4;
+            if (is_load(instructions[use.instruction].opcode) && d.structured && !d.read_all)
+            {
+                uint32_t read = 0;
+                for (uint8_t r : d.read)
+                    read += r;
+                if (read < d.read.size())
+                    add(BUFFER_PARTIAL_LOAD, use.instruction, d, bytes).efficiency = (double)read / d.read.size();
+            }
+            if (compute)
+                classify(use, d, bytes, values[2 * u], values[2 * u + 1]);
+        }
+        std::stable_sort(result.findings.begin(), result.findings.end(), by_instruction);
+        return true;
+    }
+
+private:
+    void scan(uint32_t i, const DecodedInstruction& inst)
+    {
+        const DecodedOperand* ops = operands + inst.firstOperand;
+        switch (inst.opcode)
+        {
+        case D3D11_SB_OPCODE_DCL_THREAD_GROUP:
+            compute = inst.dataCount == 3 && inst.data[0] && inst.data[1] && inst.data[2];
+            memcpy(group, inst.data, sizeof(group));
+            return;
+        case D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED:
+        case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED:
+        case D3D11_SB_OPCODE_DCL_RESOURCE_RAW:
+        case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW:
+        {
+            bool structured = inst.opcode == D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED
+                || inst.opcode == D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED;
+            if (inst.operandCount < 1 || (structured && (inst.dataCount < 1 || !inst.data[0])))
+                return;
+            declarations.push_back(buffer_declaration());
+            buffer_declaration& d = declarations.back();
+            d.instruction = i;
+            d.type = ops[0].type;
+            d.reg = register_of(ops[0]);
+            d.structured = structured;
+            d.stride = structured ? inst.data[0] : 0;
+            uint32_t dwords = d.stride / 4;
+            d.read_all = dwords == 0 || dwords > MAX_STRIDE_DWORDS;
+            d.read.assign(d.read_all ? 0 : dwords, 0);
+            return;
+        }
+        default:
+            break;
+        }
+        if (!is_access(inst.opcode))
+            return;
+        access_operands a = operands_of(inst.opcode);
+        uint32_t needed = std::max(a.buffer, a.offset != NO_OPERAND ? a.offset : a.index) + 1;
+        if (inst.operandCount < needed)
+            return;
+        const DecodedOperand& buffer = ops[a.buffer];
+        uint32_t declaration = declaration_of(buffer.type, register_of(buffer));
+        if (declaration == NO_DECLARATION || declarations[declaration].structured != (a.offset != NO_OPERAND))
+            return;
+
+        // Loads read the buffer's components their swizzle picks for the destination's mask; stores
+        // write the components of the buffer operand's mask.
+        buffer_use use;
+        use.instruction = i;
+        use.declaration = declaration;
+        use.components = is_load(inst.opcode) ? ComponentsRead(buffer, write_mask(ops[0])) : write_mask(buffer);
+        uses.push_back(use);
+
+        buffer_declaration& d = declarations[declaration];
+        if (!is_load(inst.opcode) || !d.structured || d.read_all)
+            return;
+        const DecodedOperand& offset = ops[a.offset];
+        if (offset.type != D3D10_SB_OPERAND_TYPE_IMMEDIATE32 || offset.modifier != D3D10_SB_OPERAND_MODIFIER_NONE)
+        {
+            d.read_all = true;
+            return;
+        }
+        uint32_t first = offset.imm[0] / 4;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            if ((use.components & (1 << c)) && first + c < d.read.size())
+                d.read[first + c] = 1;
+        }
+    }
+
+    static uint32_t write_mask(const DecodedOperand& operand)
+    {
+        return operand.numComponents == 4 && operand.selectionMode == D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE
+            ? operand.mask & 0xf : 1;
+    }
+
+    uint32_t declaration_of(uint32_t type, uint32_t reg) const
+    {
+        for (uint32_t d = 0; d < declarations.size(); d++)
+        {
+            if (declarations[d].type == type && declarations[d].reg == reg)
+                return d;
+        }
+        return NO_DECLARATION;
+    }
+
+    buffer_finding& add(buffer_finding_kind kind, uint32_t instruction, const buffer_declaration& d, uint32_t bytes)
+    {
+        buffer_finding finding;
+        memset(&finding, 0, sizeof(finding));
+        finding.kind = kind;
+        finding.instruction = instruction;
+        finding.type = d.type;
+        finding.reg = d.reg;
+        finding.stride = d.stride;
+        finding.bytes = bytes;
+        result.findings.push_back(finding);
+        return result.findings.back();
+    }
+
+    void classify(const buffer_use& use, const buffer_declaration& d, uint32_t bytes, const thread_affine& index,
+        const thread_affine& offset)
+    {
+        thread_affine address = d.structured ? thread_affine_add(thread_affine_scale(index, d.stride), offset) : index;
+        if (!thread_affine_known(address))
+        {
+            if (address.kind == THREAD_AFFINE_UNKNOWN)
+                add(BUFFER_SCATTERED, use.instruction, d, bytes);
+            return;
+        }
+        // A dimension the group has one thread in adds nothing.
+        for (uint32_t c = 0; c < 3; c++)
+            address.k[c] = group[c] > 1 ? address.k[c] : 0;
+        if (!address.k[0] && !address.k[1] && !address.k[2])
+            return;
+        double efficiency = worst_efficiency(address, use.components);
+        if (efficiency < MIN_EFFICIENCY)
+        {
+            buffer_finding& finding = add(BUFFER_STRIDED, use.instruction, d, bytes);
+            finding.efficiency = efficiency;
+            finding.address = address;
+        }
+    }
+
+    // Share of the bytes of the cache lines each wave touches that its lanes use, for the worst
+    // wave of the group.
+    double worst_efficiency(const thread_affine& address, uint32_t components)
+    {
+        uint32_t threads = (uint32_t)std::min<uint64_t>((uint64_t)group[0] * group[1] * group[2], MAX_GROUP_THREADS);
+        uint32_t wave = std::min(profile.wave_width, MAX_GROUP_THREADS);
+        uint32_t line_dwords = std::max(profile.cache_line_bytes / 4, 1u);
+        double worst = 1;
+        for (uint32_t first = 0; first < threads; first += wave)
+        {
+            dwords.clear();
+            for (uint32_t t = first; t < first + wave && t < threads; t++)
+            {
+                uint32_t x = t % group[0];
+                uint32_t y = t / group[0] % group[1];
+                uint32_t z = t / group[0] / group[1];
+                uint32_t dword = (address.constant + address.k[0] * x + address.k[1] * y + address.k[2] * z) >> 2;
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    if (components & (1 << c))
+                        dwords.push_back(dword + c);
+                }
+            }
+            std::sort(dwords.begin(), dwords.end());
+            dwords.erase(std::unique(dwords.begin(), dwords.end()), dwords.end());
+            size_t used = dwords.size();
+            for (uint32_t& d : dwords)
+                d /= line_dwords;
+            dwords.erase(std::unique(dwords.begin(), dwords.end()), dwords.end());
+            if (!dwords.empty())
+                worst = std::min(worst, (double)used / ((double)dwords.size() * line_dwords));
+        }
+        return worst;
+    }
+
+    const DecodedInstruction* instructions;
+    uint32_t count;
+    const DecodedOperand* operands;
+    const cfg& graph;
+    const hardware_profile& profile;
+    buffer_report& result;
+    bool compute;
+    uint32_t group[3];
+    std::vector<buffer_declaration> declarations;
+    std::vector<buffer_use> uses;
+    std::vector<thread_affine_query> queries;   // index and offset of each use, or its address twice
+    std::vector<thread_affine> values;
+    std::vector<uint32_t> dwords;
+};
+
+} // namespace
+
+bool buffer_access_analyze(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, const hardware_profile& profile, buffer_report& result)
+{
+    analysis run(instructions, count, operands, graph, profile, result);
+    return run.run();
+}
@@ -0,0 +1,315 @@
+#include "cbuffer_usage.h"
+#include "le32.h"
+#include <string.h>
+#include <algorithm>
+
+namespace {
+
+// RDEF record sizes in bytes. Shader model 5 adds texture and sampler ranges to each variable.
+#define RDEF_HEADER_SIZE 28
+#define RDEF_BINDING_SIZE 32
+#define RDEF_BUFFER_SIZE 24
+#define RDEF_VARIABLE_SIZE 24
+#define RDEF_VARIABLE_SIZE_5_0 40
+// D3D_SIT_CBUFFER and D3D_CT_CBUFFER.
+#define RDEF_CBUFFER 0
+
+// Reads the chunk's little-endian fields, each checked against its size.
+class rdef_reader
+{
+public:
+    rdef_reader(const void* data, uint32_t size) : data((const uint8_t*)data), size(size) {}
+
+    bool dword(uint64_t offset, uint32_t& value) const
+    {
+        if (offset + 4 > size)
+            return false;
+        memcpy(&value, data + offset, 4);
+        value = bswap_le32(value);
+        return true;
+    }
+
+    bool table(uint32_t offset, uint32_t count, uint32_t record) const
+    {
+        return (uint64_t)offset + (uint64_t)count * record <= size;
+    }
+
+    bool string(uint32_t offset, std::string& value) const
+    {
+        if (offset >= size)
+            return false;
+        const void* end = memchr(data + offset, 0, size - offset);
+        if (!end)
+            return false;
+        value.assign((const char*)data + offset, (const char*)end);
+        return true;
+    }
+
+private:
+    const uint8_t* data;
+    uint32_t size;
+};
+
+bool parse_layouts(const rdef_reader& rdef, std::vector<cbuffer_layout>& layouts)
+{
+    uint32_t buffer_count, buffer_offset, binding_count, binding_offset, target;
+    if (!rdef.dword(0, buffer_count) || !rdef.dword(4, buffer_offset) || !rdef.dword(8, binding_count)
+        || !rdef.dword(12, binding_offset) || !rdef.dword(16, target) || !rdef.table(0, 1, RDEF_HEADER_SIZE)
+        || !rdef.table(buffer_offset, buffer_count, RDEF_BUFFER_SIZE)
+        || !rdef.table(binding_offset, binding_count, RDEF_BINDING_SIZE))
+        return false;
+    uint32_t variable_size = (target & 0xffff) >= 0x500 ? RDEF_VARIABLE_SIZE_5_0 : RDEF_VARIABLE_SIZE;
+
+    for (uint32_t b = 0; b < buffer_count; b++)
+    {
+        uint64_t record = buffer_offset + (uint64_t)b * RDEF_BUFFER_SIZE;
+        uint32_t name, variable_count, variable_offset, size, type;
+        rdef.dword(record, name);
+        rdef.dword(record + 4, variable_count);
+        rdef.dword(record + 8, variable_offset);
+        rdef.dword(record + 12, size);
+        rdef.dword(record + 20, type);
+        if (type != RDEF_CBUFFER)
+            continue;
+        layouts.push_back(cbuffer_layout());
+        cbuffer_layout& layout = layouts.back();
+        if (!rdef.string(name, layout.name) || !rdef.table(variable_offset, variable_count, variable_size))
+            return false;
+        layout.reg = CBUFFER_NO_LAYOUT;
+        layout.size = size;
+        layout.variables.resize(variable_count);
+        for (uint32_t v = 0; v < variable_count; v++)
+        {
+            uint64_t entry = variable_offset + (uint64_t)v * variable_size;
+            cbuffer_variable& variable = layout.variables[v];
+            rdef.dword(entry, name);
+            rdef.dword(entry + 4, variable.offset);
+            rdef.dword(entry + 8, variable.size);
+            if (!rdef.string(name, variable.name))
+                return false;
+        }
+    }
+
+    // Constant buffers are bound by name.
+    std::string binding_name;
+    for (uint32_t b = 0; b < binding_count; b++)
+    {
+        uint64_t record = binding_offset + (uint64_t)b * RDEF_BINDING_SIZE;
+        uint32_t name, type, bind_point;
+        rdef.dword(record, name);
+        rdef.dword(record + 4, type);
+        rdef.dword(record + 20, bind_point);
+        if (type != RDEF_CBUFFER)
+            continue;
+        if (!rdef.string(name, binding_name))
+            return false;
+        for (cbuffer_layout& layout : layouts)
+        {
+            if (layout.reg == CBUFFER_NO_LAYOUT && layout.name == binding_name)
+            {
+                layout.reg = bind_point;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+uint32_t register_of(const DecodedOperand& operand)
+{
+    return operand.indexDim ? (uint32_t)operand.index[0].value : 0;
+}
+
+// Swizzle positions an instruction reads its sources at, narrower than SourcePositions for the
+// dot products that read fewer than four.
+uint32_t positions_read(const DecodedInstruction& inst, const DecodedOperand* operands)
+{
+    switch (inst.opcode)
+    {
+    case D3D10_SB_OPCODE_DP2:
+        return 0x3;
+    case D3D10_SB_OPCODE_DP3:
+        return 0x7;
+    default:
+        return SourcePositions(inst, operands);
+    }
+}
+
+class analysis
+{
+public:
+    analysis(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+        const std::vector<cbuffer_layout>& layouts, cbuffer_report& result)
+        : instructions(instructions), count(count), operands(operands), layouts(layouts), result(result)
+    {
+    }
+
+    void run()
+    {
+        result.buffers.clear();
+        relative_from.clear();
+        // Declarations come before the code that uses them.
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const DecodedInstruction& inst = instructions[i];
+            if (inst.opcode == D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER)
+                declare(i, inst);
+            if (result.buffers.empty() || IsDeclaration(inst.opcode))
+                continue;
+            const DecodedOperand* ops = operands + inst.firstOperand;
+            uint32_t end = (uint32_t)inst.operandCount + inst.relativeCount;
+            uint32_t o = 0;
+            while (o < end && ops[o].type != D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER)
+                o++;
+            if (o == end)
+                continue;
+            uint32_t positions = positions_read(inst, operands);
+            for (o = DestinationCount(inst.opcode); o < inst.operandCount; o++)
+                read(ops[o], positions);
+            for (o = inst.operandCount; o < end; o++)
+                read(ops[o], 1);
+        }
+        for (size_t b = 0; b < result.buffers.size(); b++)
+        {
+            cbuffer_usage& usage = result.buffers[b];
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                for (size_t r = relative_from[4 * b + c]; r < usage.components.size(); r++)
+                    usage.components[r] |= (uint8_t)(1 << c);
+            }
+            total(usage);
+        }
+    }
+
+private:
+    void declare(uint32_t i, const DecodedInstruction& inst)
+    {
+        const DecodedOperand* ops = operands + inst.firstOperand;
+        for (uint32_t o = 0; o < inst.operandCount; o++)
+        {
+            uint32_t reg = register_of(ops[o]);
+            if (find(reg))
+                continue;
+            result.buffers.push_back(cbuffer_usage());
+            cbuffer_usage& usage = result.buffers.back();
+            usage.reg = reg;
+            usage.declaration = i;
+            usage.dynamic = DECODE_D3D10_SB_CONSTANT_BUFFER_ACCESS_PATTERN(inst.opcodeToken)
+                == D3D10_SB_CONSTANT_BUFFER_DYNAMIC_INDEXED;
+            usage.relative = false;
+            // Declared as cb#[size].
+            uint64_t registers = ops[o].indexDim == 2 ? ops[o].index[1].value : 0;
+            registers = std::min<uint64_t>(registers, CBUFFER_MAX_REGISTERS);
+            usage.declared_bytes = (uint32_t)registers * 16;
+            usage.layout = CBUFFER_NO_LAYOUT;
+            for (uint32_t l = 0; l < layouts.size(); l++)
+            {
+                if (layouts[l].reg == reg)
+                {
+                    usage.layout = l;
+                    registers = std::max<uint64_t>(registers,
+                        std::min<uint64_t>(((uint64_t)layouts[l].size + 15) / 16, CBUFFER_MAX_REGISTERS));
+                    break;
+                }
+            }
+            usage.size_bytes = (uint32_t)registers * 16;
+            usage.components.assign((size_t)registers, 0);
+            relative_from.insert(relative_from.end(), 4, CBUFFER_MAX_REGISTERS);
+        }
+    }
+
+    cbuffer_usage* find(uint32_t reg)
+    {
+        for (cbuffer_usage& usage : result.buffers)
+        {
+            if (usage.reg == reg)
+                return &usage;
+        }
+        return NULL;
+    }
+
+    void read(const DecodedOperand& operand, uint32_t positions)
+    {
+        if (operand.type != D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER || operand.indexDim != 2)
+            return;
+        cbuffer_usage* usage = find(register_of(operand));
+        if (!usage)
+            return;
+        uint32_t components = ComponentsRead(operand, positions) & 0xf;
+        uint64_t first = operand.index[1].value;
+        if (operand.index[1].relative != DECODED_NO_OPERAND)
+        {
+            // Marked up to the end once all reads are in.
+            usage->relative = true;
+            uint32_t* from = relative_from.data() + 4 * (usage - result.buffers.data());
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                if (components & (1 << c))
+                    from[c] = (uint32_t)std::min<uint64_t>(from[c], first);
+            }
+        }
+        else if (first < usage->components.size())
+        {
+            usage->components[(size_t)first] |= (uint8_t)components;
+        }
+    }
+
+    static void total(cbuffer_usage& usage)
+    {
+        usage.read_bytes = 0;
+        uint32_t last = 0;              // end of the last component read, in bytes
+        for (uint32_t r = 0; r < usage.components.size(); r++)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                if (usage.components[r] & (1 << c))
+                {
+                    usage.read_bytes += 4;
+                    last = r * 16 + c * 4 + 4;
+                }
+            }
+        }
+        usage.interior_unused_bytes = last - usage.read_bytes;
+        usage.trailing_unused_bytes = usage.size_bytes - last;
+    }
+
+    const DecodedInstruction* instructions;
+    uint32_t count;
+    const DecodedOperand* operands;
+    const std::vector<cbuffer_layout>& layouts;
+    cbuffer_report& result;
+    std::vector<uint32_t> relative_from;    // per buffer and component, the lowest register a relative
+                                            // read starts at
+};
+
+} // namespace
+
+bool cbuffer_layouts_parse(const void* data, uint32_t size, std::vector<cbuffer_layout>& layouts)
+{
+    layouts.clear();
+    if (!parse_layouts(rdef_reader(data, size), layouts))
+    {
+        layouts.clear();
+        return false;
+    }
+    return true;
+}
+
+void cbuffer_usage_analyze(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const std::vector<cbuffer_layout>& layouts, cbuffer_report& result)
+{
+    analysis run(instructions, count, operands, layouts, result);
+    run.run();
+}
+
+uint32_t cbuffer_bytes_read(const cbuffer_usage& usage, uint32_t offset, uint32_t size)
+{
+    uint64_t end = std::min<uint64_t>((uint64_t)offset + size, (uint64_t)usage.components.size() * 16);
+    uint32_t read = 0;
+    for (uint64_t byte = offset & ~3u; byte < end; byte += 4)
+    {
+        if (usage.components[(size_t)(byte / 16)] & (1 << (byte / 4 % 4)))
+            read += (uint32_t)(std::min<uint64_t>(byte + 4, end) - std::max<uint64_t>(byte, offset));
+    }
+    return read;
+}
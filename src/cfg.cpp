@@ -0,0 +1,426 @@
+#include "cfg.h"
+#include <algorithm>
+
+const char* cfg_function_kind_text[] = {
+    "main",
+    "subroutine",
+    "hs_decls",
+    "hs_control_point_phase",
+    "hs_fork_phase",
+    "hs_join_phase",
+};
+
+namespace {
+
+// The kind of function an instruction starts, CFG_NONE for instructions that start none.
+uint32_t function_kind(D3D10_SB_OPCODE_TYPE opcode)
+{
+    switch (opcode)
+    {
+    case D3D10_SB_OPCODE_LABEL: return CFG_FUNCTION_SUBROUTINE;
+    case D3D11_SB_OPCODE_HS_DECLS: return CFG_FUNCTION_HS_DECLS;
+    case D3D11_SB_OPCODE_HS_CONTROL_POINT_PHASE: return CFG_FUNCTION_HS_CONTROL_POINT_PHASE;
+    case D3D11_SB_OPCODE_HS_FORK_PHASE: return CFG_FUNCTION_HS_FORK_PHASE;
+    case D3D11_SB_OPCODE_HS_JOIN_PHASE: return CFG_FUNCTION_HS_JOIN_PHASE;
+    default: return CFG_NONE;
+    }
+}
+
+// Instructions that may transfer control elsewhere end their block.
+bool ends_block(D3D10_SB_OPCODE_TYPE opcode)
+{
+    switch (opcode)
+    {
+    case D3D10_SB_OPCODE_IF:
+    case D3D10_SB_OPCODE_ELSE:
+    case D3D10_SB_OPCODE_LOOP:
+    case D3D10_SB_OPCODE_ENDLOOP:
+    case D3D10_SB_OPCODE_SWITCH:
+    case D3D10_SB_OPCODE_BREAK:
+    case D3D10_SB_OPCODE_BREAKC:
+    case D3D10_SB_OPCODE_CONTINUE:
+    case D3D10_SB_OPCODE_CONTINUEC:
+    case D3D10_SB_OPCODE_RET:
+    case D3D10_SB_OPCODE_RETC:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Instructions that control may jump to start one.
+bool starts_block(D3D10_SB_OPCODE_TYPE opcode)
+{
+    switch (opcode)
+    {
+    case D3D10_SB_OPCODE_ENDIF:
+    case D3D10_SB_OPCODE_CASE:
+    case D3D10_SB_OPCODE_DEFAULT:
+    case D3D10_SB_OPCODE_ENDSWITCH:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// An if, loop or switch whose closing instruction has not been seen yet.
+struct open_construct
+{
+    uint32_t opener;            // position of the if, loop or switch
+    uint32_t last;              // else, or the latest case or default; CFG_NONE before any
+    uint32_t breakable;         // position of the innermost open loop or switch, this one included
+    uint32_t loop;              // position of the innermost open loop, CFG_NONE if there is none
+    uint32_t loop_index;        // cfg::loops entry of that loop
+};
+
+// Label number of a label operand, CFG_NONE if the operand is something else.
+uint32_t label_number(const DecodedInstruction& inst, const DecodedOperand* operands, uint32_t operand)
+{
+    if (operand >= inst.operandCount)
+        return CFG_NONE;
+    const DecodedOperand& o = operands[inst.firstOperand + operand];
+    if (o.type != D3D10_SB_OPERAND_TYPE_LABEL || o.indexDim < 1)
+        return CFG_NONE;
+    return (uint32_t)o.index[0].value;
+}
+
+} // namespace
+
+bool cfg_build(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands, cfg& graph)
+{
+    graph.blocks.clear();
+    graph.successors.clear();
+    graph.predecessors.clear();
+    graph.loops.clear();
+    graph.functions.clear();
+    graph.calls.clear();
+    graph.block_of.resize(count);
+
+    // First pass: blocks, functions, loops and calls, and the instruction each flow control
+    // instruction pairs with. match holds the closing instruction of if, else, loop and switch;
+    // link holds the else of an if, the first case of a switch and the next case of a case, and
+    // the construct that a break, continue or endloop refers to.
+    std::vector<uint32_t> match(count, CFG_NONE);
+    std::vector<uint32_t> link(count, CFG_NONE);
+    std::vector<open_construct> stack;
+    std::vector<std::pair<uint32_t, uint32_t> > labels;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const DecodedInstruction& inst = instructions[i];
+        uint32_t kind = function_kind(inst.opcode);
+        if (i == 0 || kind != CFG_NONE)
+        {
+            if (!stack.empty())
+                return false;
+            if (!graph.functions.empty())
+                graph.functions.back().end_block = (uint32_t)graph.blocks.size();
+            cfg_function function;
+            function.kind = kind == CFG_NONE ? (uint32_t)CFG_FUNCTION_MAIN : kind;
+            function.label = kind == CFG_FUNCTION_SUBROUTINE ? label_number(inst, operands, 0) : CFG_NONE;
+            function.first_block = (uint32_t)graph.blocks.size();
+            function.end_block = function.first_block;
+            function.first_call = (uint32_t)graph.calls.size();
+            function.call_count = 0;
+            if (function.label != CFG_NONE)
+                labels.push_back(std::make_pair(function.label, (uint32_t)graph.functions.size()));
+            graph.functions.push_back(function);
+        }
+        if (i == 0 || kind != CFG_NONE || starts_block(inst.opcode) || ends_block(instructions[i - 1].opcode))
+        {
+            if (!graph.blocks.empty())
+                graph.blocks.back().end = i;
+            cfg_block block;
+            block.first = i;
+            block.end = i;
+            block.function = (uint32_t)graph.functions.size() - 1;
+            block.loop = stack.empty() ? CFG_NONE : stack.back().loop_index;
+            block.flags = 0;
+            block.first_successor = 0;
+            block.successor_count = 0;
+            block.first_predecessor = 0;
+            block.predecessor_count = 0;
+            graph.blocks.push_back(block);
+        }
+        uint32_t current = (uint32_t)graph.blocks.size() - 1;
+        graph.block_of[i] = current;
+
+        open_construct* top = stack.empty() ? NULL : &stack.back();
+        switch (inst.opcode)
+        {
+        case D3D10_SB_OPCODE_IF:
+        case D3D10_SB_OPCODE_LOOP:
+        case D3D10_SB_OPCODE_SWITCH:
+        {
+            open_construct construct;
+            construct.opener = i;
+            construct.last = CFG_NONE;
+            construct.breakable = top ? top->breakable : CFG_NONE;
+            construct.loop = top ? top->loop : CFG_NONE;
+            construct.loop_index = top ? top->loop_index : CFG_NONE;
+            if (inst.opcode == D3D10_SB_OPCODE_SWITCH)
+            {
+                construct.breakable = i;
+            }
+            else if (inst.opcode == D3D10_SB_OPCODE_LOOP)
+            {
+                cfg_loop loop;
+                loop.header = CFG_NONE;
+                loop.end = CFG_NONE;
+                loop.exit = CFG_NONE;
+                loop.parent = construct.loop_index;
+                loop.depth = construct.loop_index == CFG_NONE ? 1 : graph.loops[construct.loop_index].depth + 1;
+                loop.instruction = i;
+                construct.breakable = i;
+                construct.loop = i;
+                construct.loop_index = (uint32_t)graph.loops.size();
+                graph.loops.push_back(loop);
+            }
+            stack.push_back(construct);
+            break;
+        }
+        case D3D10_SB_OPCODE_ELSE:
+            if (!top || instructions[top->opener].opcode != D3D10_SB_OPCODE_IF || top->last != CFG_NONE)
+                return false;
+            link[top->opener] = i;
+            top->last = i;
+            break;
+        case D3D10_SB_OPCODE_ENDIF:
+            if (!top || instructions[top->opener].opcode != D3D10_SB_OPCODE_IF)
+                return false;
+            match[top->opener] = i;
+            if (top->last != CFG_NONE)
+                match[top->last] = i;
+            stack.pop_back();
+            break;
+        case D3D10_SB_OPCODE_ENDLOOP:
+            if (!top || instructions[top->opener].opcode != D3D10_SB_OPCODE_LOOP)
+                return false;
+            match[top->opener] = i;
+            link[i] = top->opener;
+            graph.loops[top->loop_index].end = current + 1;
+            stack.pop_back();
+            break;
+        case D3D10_SB_OPCODE_CASE:
+        case D3D10_SB_OPCODE_DEFAULT:
+            if (!top || instructions[top->opener].opcode != D3D10_SB_OPCODE_SWITCH)
+                return false;
+            link[top->last == CFG_NONE ? top->opener : top->last] = i;
+            top->last = i;
+            break;
+        case D3D10_SB_OPCODE_ENDSWITCH:
+            if (!top || instructions[top->opener].opcode != D3D10_SB_OPCODE_SWITCH)
+                return false;
+            match[top->opener] = i;
+            stack.pop_back();
+            break;
+        case D3D10_SB_OPCODE_BREAK:
+        case D3D10_SB_OPCODE_BREAKC:
+            if (!top || top->breakable == CFG_NONE)
+                return false;
+            link[i] = top->breakable;
+            break;
+        case D3D10_SB_OPCODE_CONTINUE:
+        case D3D10_SB_OPCODE_CONTINUEC:
+            if (!top || top->loop == CFG_NONE)
+                return false;
+            link[i] = top->loop;
+            break;
+        case D3D10_SB_OPCODE_CALL:
+        case D3D10_SB_OPCODE_CALLC:
+        case D3D11_SB_OPCODE_INTERFACE_CALL:
+        {
+            cfg_call call;
+            call.instruction = i;
+            call.block = current;
+            call.caller = (uint32_t)graph.functions.size() - 1;
+            call.callee = CFG_NONE;
+            graph.calls.push_back(call);
+            graph.functions.back().call_count++;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    if (!stack.empty())
+        return false;
+    if (count)
+    {
+        graph.blocks.back().end = count;
+        graph.functions.back().end_block = (uint32_t)graph.blocks.size();
+    }
+
+    // Second pass, over blocks: edges out of each, from the instruction that ends it.
+    for (uint32_t b = 0; b < (uint32_t)graph.blocks.size(); b++)
+    {
+        cfg_block& block = graph.blocks[b];
+        const cfg_function& function = graph.functions[block.function];
+        // The block that starts at a position, CFG_NONE if the position is past the function.
+        auto block_at = [&](uint32_t position) -> uint32_t {
+            if (position >= count || graph.block_of[position] >= function.end_block)
+                return CFG_NONE;
+            return graph.block_of[position];
+        };
+        // Flow that leaves the function makes the block an exit; the same target twice is one edge.
+        auto add = [&](uint32_t to, uint32_t kind) {
+            if (to == CFG_NONE)
+            {
+                block.flags |= CFG_BLOCK_EXIT;
+                return;
+            }
+            for (uint32_t e = block.first_successor; e < (uint32_t)graph.successors.size(); e++)
+            {
+                if (graph.successors[e].to == to)
+                    return;
+            }
+            cfg_edge edge = { b, to, kind };
+            graph.successors.push_back(edge);
+        };
+
+        block.first_successor = (uint32_t)graph.successors.size();
+        uint32_t last = block.end - 1;
+        uint32_t next = b + 1 < function.end_block ? b + 1 : CFG_NONE;
+        switch (instructions[last].opcode)
+        {
+        case D3D10_SB_OPCODE_IF:
+            add(next, CFG_EDGE_FALLTHROUGH);
+            add(block_at(link[last] != CFG_NONE ? link[last] + 1 : match[last]), CFG_EDGE_BRANCH);
+            break;
+        case D3D10_SB_OPCODE_ELSE:
+            add(block_at(match[last]), CFG_EDGE_BRANCH);
+            break;
+        case D3D10_SB_OPCODE_SWITCH:
+        {
+            // Cases are distinct blocks, so the edges need no check for repeats.
+            bool has_default = false;
+            for (uint32_t c = link[last]; c != CFG_NONE; c = link[c])
+            {
+                cfg_edge edge = { b, graph.block_of[c], CFG_EDGE_BRANCH };
+                graph.successors.push_back(edge);
+                has_default |= instructions[c].opcode == D3D10_SB_OPCODE_DEFAULT;
+            }
+            if (!has_default)
+                add(block_at(match[last]), CFG_EDGE_BRANCH);
+            break;
+        }
+        case D3D10_SB_OPCODE_BREAK:
+        case D3D10_SB_OPCODE_BREAKC:
+        {
+            if (instructions[last].opcode == D3D10_SB_OPCODE_BREAKC)
+                add(next, CFG_EDGE_FALLTHROUGH);
+            uint32_t construct = link[last];
+            bool loop = instructions[construct].opcode == D3D10_SB_OPCODE_LOOP;
+            add(block_at(loop ? match[construct] + 1 : match[construct]), CFG_EDGE_BREAK);
+            break;
+        }
+        case D3D10_SB_OPCODE_CONTINUE:
+        case D3D10_SB_OPCODE_CONTINUEC:
+            if (instructions[last].opcode == D3D10_SB_OPCODE_CONTINUEC)
+                add(next, CFG_EDGE_FALLTHROUGH);
+            add(block_at(link[last] + 1), CFG_EDGE_CONTINUE);
+            break;
+        case D3D10_SB_OPCODE_ENDLOOP:
+            add(block_at(link[last] + 1), CFG_EDGE_BACK);
+            break;
+        case D3D10_SB_OPCODE_RET:
+            block.flags |= CFG_BLOCK_EXIT;
+            break;
+        case D3D10_SB_OPCODE_RETC:
+            block.flags |= CFG_BLOCK_EXIT;
+            add(next, CFG_EDGE_FALLTHROUGH);
+            break;
+        default:
+            add(next, CFG_EDGE_FALLTHROUGH);
+            break;
+        }
+        block.successor_count = (uint32_t)graph.successors.size() - block.first_successor;
+    }
+
+    // The same edges grouped by target, by counting sort.
+    for (const cfg_edge& edge : graph.successors)
+        graph.blocks[edge.to].predecessor_count++;
+    uint32_t position = 0;
+    for (cfg_block& block : graph.blocks)
+    {
+        block.first_predecessor = position;
+        position += block.predecessor_count;
+        block.predecessor_count = 0;
+    }
+    graph.predecessors.resize(graph.successors.size());
+    for (const cfg_edge& edge : graph.successors)
+    {
+        cfg_block& to = graph.blocks[edge.to];
+        graph.predecessors[to.first_predecessor + to.predecessor_count++] = edge;
+    }
+
+    // Loop bodies start after the loop instruction; breaks leave to the instruction after endloop.
+    for (cfg_loop& loop : graph.loops)
+    {
+        uint32_t endloop = match[loop.instruction];
+        loop.header = graph.block_of[loop.instruction + 1];
+        uint32_t exit = endloop + 1;
+        if (exit < count && graph.blocks[graph.block_of[exit]].function == graph.blocks[loop.header].function)
+            loop.exit = graph.block_of[exit];
+    }
+
+    // Calls name their label as an operand: the only one of call, the second of callc.
+    std::sort(labels.begin(), labels.end());
+    for (cfg_call& call : graph.calls)
+    {
+        const DecodedInstruction& inst = instructions[call.instruction];
+        if (inst.opcode == D3D11_SB_OPCODE_INTERFACE_CALL)
+            continue;
+        uint32_t label = label_number(inst, operands, inst.opcode == D3D10_SB_OPCODE_CALLC ? 1 : 0);
+        std::vector<std::pair<uint32_t, uint32_t> >::const_iterator found =
+            std::lower_bound(labels.begin(), labels.end(), std::make_pair(label, 0u));
+        if (label != CFG_NONE && found != labels.end() && found->first == label)
+            call.callee = found->second;
+    }
+    return true;
+}
+
+void cfg_write_dot(const cfg& graph, const DecodedInstruction* instructions, const char* name, std::ostream& out)
+{
+    static const char* edge_style[] = {
+        "",
+        "",
+        " [label=\"break\"]",
+        " [label=\"continue\"]",
+        " [style=dashed]",
+    };
+
+    out << "digraph \"";
+    for (const char* c = name; *c; c++)
+        out << (*c == '"' || *c == '\\' ? "\\" : "") << *c;
+    out << "\" {\n";
+    out << "  node [shape=box, fontname=monospace];\n";
+    for (uint32_t f = 0; f < (uint32_t)graph.functions.size(); f++)
+    {
+        const cfg_function& function = graph.functions[f];
+        out << "  subgraph cluster_" << f << " {\n";
+        out << "    label=\"" << cfg_function_kind_text[function.kind];
+        if (function.label != CFG_NONE)
+            out << " l" << function.label;
+        out << "\";\n";
+        for (uint32_t b = function.first_block; b < function.end_block; b++)
+        {
+            const cfg_block& block = graph.blocks[b];
+            out << "    b" << b << " [label=\"B" << b;
+            if (block.loop != CFG_NONE)
+                out << " (loop " << block.loop << ", depth " << graph.loops[block.loop].depth << ")";
+            out << "\\l";
+            for (uint32_t i = block.first; i < block.end; i++)
+                out << i << ": " << TokenText(OpcodeText, OpcodeTextCount, instructions[i].opcode) << "\\l";
+            out << "\"" << (block.flags & CFG_BLOCK_EXIT ? ", peripheries=2" : "") << "];\n";
+        }
+        out << "  }\n";
+    }
+    for (const cfg_edge& edge : graph.successors)
+        out << "  b" << edge.from << " -> b" << edge.to << edge_style[edge.kind] << ";\n";
+    for (const cfg_call& call : graph.calls)
+    {
+        if (call.callee != CFG_NONE)
+            out << "  b" << call.block << " -> b" << graph.functions[call.callee].first_block << " [style=dotted];\n";
+    }
+    out << "}\n";
+}
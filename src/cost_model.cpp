@@ -0,0 +1,462 @@
+#include "cost_model.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile_text.h"
+
+const char* cost_class_text[] = {
+    "none",
+    "alu",
+    "transcendental",
+    "double",
+    "texture",
+    "memory",
+    "flow",
+};
+static_assert(COST_CLASS_COUNT == sizeof(cost_class_text) / sizeof(cost_class_text[0]), "cost_class_text mismatch with cost classes");
+
+namespace {
+
+// Cost class of each D3D10_SB_OPCODE_TYPE, named as in OpcodeText.
+const uint8_t OpcodeCostClass[] = {
+    COST_CLASS_ALU,                      // add
+    COST_CLASS_ALU,                      // and
+    COST_CLASS_FLOW,                     // break
+    COST_CLASS_FLOW,                     // breakc
+    COST_CLASS_FLOW,                     // call
+    COST_CLASS_FLOW,                     // callc
+    COST_CLASS_FLOW,                     // case
+    COST_CLASS_FLOW,                     // continue
+    COST_CLASS_FLOW,                     // continuec
+    COST_CLASS_FLOW,                     // cut
+    COST_CLASS_FLOW,                     // default
+    COST_CLASS_ALU,                      // deriv_rtx
+    COST_CLASS_ALU,                      // deriv_rty
+    COST_CLASS_FLOW,                     // discard
+    COST_CLASS_TRANSCENDENTAL,           // div
+    COST_CLASS_ALU,                      // dp2
+    COST_CLASS_ALU,                      // dp3
+    COST_CLASS_ALU,                      // dp4
+    COST_CLASS_FLOW,                     // else
+    COST_CLASS_FLOW,                     // emit
+    COST_CLASS_FLOW,                     // emitThenCut
+    COST_CLASS_FLOW,                     // endif
+    COST_CLASS_FLOW,                     // endloop
+    COST_CLASS_FLOW,                     // endswitch
+    COST_CLASS_ALU,                      // eq
+    COST_CLASS_TRANSCENDENTAL,           // exp
+    COST_CLASS_ALU,                      // frc
+    COST_CLASS_ALU,                      // ftoi
+    COST_CLASS_ALU,                      // ftou
+    COST_CLASS_ALU,                      // ge
+    COST_CLASS_ALU,                      // iadd
+    COST_CLASS_FLOW,                     // if
+    COST_CLASS_ALU,                      // ieq
+    COST_CLASS_ALU,                      // ige
+    COST_CLASS_ALU,                      // ilt
+    COST_CLASS_ALU,                      // imad
+    COST_CLASS_ALU,                      // imax
+    COST_CLASS_ALU,                      // imin
+    COST_CLASS_ALU,                      // imul
+    COST_CLASS_ALU,                      // ine
+    COST_CLASS_ALU,                      // ineg
+    COST_CLASS_ALU,                      // ishl
+    COST_CLASS_ALU,                      // ishr
+    COST_CLASS_ALU,                      // itof
+    COST_CLASS_NONE,                     // label
+    COST_CLASS_TEXTURE,                  // ld
+    COST_CLASS_TEXTURE,                  // ld2dms
+    COST_CLASS_TRANSCENDENTAL,           // log
+    COST_CLASS_FLOW,                     // loop
+    COST_CLASS_ALU,                      // lt
+    COST_CLASS_ALU,                      // mad
+    COST_CLASS_ALU,                      // min
+    COST_CLASS_ALU,                      // max
+    COST_CLASS_NONE,                     // CustomData
+    COST_CLASS_ALU,                      // mov
+    COST_CLASS_ALU,                      // movc
+    COST_CLASS_ALU,                      // mul
+    COST_CLASS_ALU,                      // ne
+    COST_CLASS_NONE,                     // nop
+    COST_CLASS_ALU,                      // not
+    COST_CLASS_ALU,                      // or
+    COST_CLASS_TEXTURE,                  // resinfo
+    COST_CLASS_FLOW,                     // ret
+    COST_CLASS_FLOW,                     // retc
+    COST_CLASS_ALU,                      // round_ne
+    COST_CLASS_ALU,                      // round_ni
+    COST_CLASS_ALU,                      // round_pi
+    COST_CLASS_ALU,                      // round_z
+    COST_CLASS_TRANSCENDENTAL,           // rsq
+    COST_CLASS_TEXTURE,                  // sample
+    COST_CLASS_TEXTURE,                  // sample_c
+    COST_CLASS_TEXTURE,                  // sample_c_lz
+    COST_CLASS_TEXTURE,                  // sample_l
+    COST_CLASS_TEXTURE,                  // sample_d
+    COST_CLASS_TEXTURE,                  // sample_b
+    COST_CLASS_TRANSCENDENTAL,           // sqrt
+    COST_CLASS_FLOW,                     // switch
+    COST_CLASS_TRANSCENDENTAL,           // sincos
+    COST_CLASS_TRANSCENDENTAL,           // udiv
+    COST_CLASS_ALU,                      // ult
+    COST_CLASS_ALU,                      // uge
+    COST_CLASS_ALU,                      // umul
+    COST_CLASS_ALU,                      // umad
+    COST_CLASS_ALU,                      // umax
+    COST_CLASS_ALU,                      // umin
+    COST_CLASS_ALU,                      // ushr
+    COST_CLASS_ALU,                      // utof
+    COST_CLASS_ALU,                      // xor
+    COST_CLASS_NONE,                     // dcl_resource
+    COST_CLASS_NONE,                     // dcl_constantBuffer
+    COST_CLASS_NONE,                     // dcl_sampler
+    COST_CLASS_NONE,                     // dcl_indexRange
+    COST_CLASS_NONE,                     // dcl_gsOutputTopology
+    COST_CLASS_NONE,                     // dcl_gsInputPrimitive
+    COST_CLASS_NONE,                     // dcl_maxOutputVertexCount
+    COST_CLASS_NONE,                     // dcl_input
+    COST_CLASS_NONE,                     // dcl_input_sgv
+    COST_CLASS_NONE,                     // dcl_input_siv
+    COST_CLASS_NONE,                     // dcl_input_ps
+    COST_CLASS_NONE,                     // dcl_input_ps_sgv
+    COST_CLASS_NONE,                     // dcl_input_ps_siv
+    COST_CLASS_NONE,                     // dcl_output
+    COST_CLASS_NONE,                     // dcl_output_sgv
+    COST_CLASS_NONE,                     // dcl_output_siv
+    COST_CLASS_NONE,                     // dcl_temps
+    COST_CLASS_NONE,                     // dcl_indexableTemp
+    COST_CLASS_NONE,                     // dcl_globalFlags
+    COST_CLASS_NONE,                     // EndOfD3D10Text
+    COST_CLASS_TEXTURE,                  // lod
+    COST_CLASS_TEXTURE,                  // gather4
+    COST_CLASS_TEXTURE,                  // samplepos
+    COST_CLASS_TEXTURE,                  // sampleinfo
+    COST_CLASS_NONE,                     // EndOfD3D10_1Text
+    COST_CLASS_NONE,                     // hs_decls
+    COST_CLASS_NONE,                     // hs_control_point_phase
+    COST_CLASS_NONE,                     // hs_fork_phase
+    COST_CLASS_NONE,                     // hs_join_phase
+    COST_CLASS_FLOW,                     // emit_stream
+    COST_CLASS_FLOW,                     // cut_stream
+    COST_CLASS_FLOW,                     // emitThenCut_stream
+    COST_CLASS_FLOW,                     // interface_call
+    COST_CLASS_TEXTURE,                  // bufinfo
+    COST_CLASS_ALU,                      // deriv_rtx_coarse
+    COST_CLASS_ALU,                      // deriv_rtx_fine
+    COST_CLASS_ALU,                      // deriv_rty_coarse
+    COST_CLASS_ALU,                      // deriv_rty_fine
+    COST_CLASS_TEXTURE,                  // gather4_c
+    COST_CLASS_TEXTURE,                  // gather4_po
+    COST_CLASS_TEXTURE,                  // gather4_po_c
+    COST_CLASS_TRANSCENDENTAL,           // rcp
+    COST_CLASS_ALU,                      // f32to16
+    COST_CLASS_ALU,                      // f16to32
+    COST_CLASS_ALU,                      // uaddc
+    COST_CLASS_ALU,                      // usubb
+    COST_CLASS_ALU,                      // countbits
+    COST_CLASS_ALU,                      // firstbit_hi
+    COST_CLASS_ALU,                      // firstbit_lo
+    COST_CLASS_ALU,                      // firstbit_shi
+    COST_CLASS_ALU,                      // ubfe
+    COST_CLASS_ALU,                      // ibfe
+    COST_CLASS_ALU,                      // bfi
+    COST_CLASS_ALU,                      // bfrev
+    COST_CLASS_ALU,                      // swapc
+    COST_CLASS_NONE,                     // dcl_stream
+    COST_CLASS_NONE,                     // dcl_function_body
+    COST_CLASS_NONE,                     // dcl_function_table
+    COST_CLASS_NONE,                     // dcl_interface
+    COST_CLASS_NONE,                     // dcl_input_control_point_count
+    COST_CLASS_NONE,                     // dcl_output_control_point_count
+    COST_CLASS_NONE,                     // dcl_tessellator_domain
+    COST_CLASS_NONE,                     // dcl_tessellator_partitioning
+    COST_CLASS_NONE,                     // dcl_tessellator_output_primitive
+    COST_CLASS_NONE,                     // dcl_hs_max_factor
+    COST_CLASS_NONE,                     // dcl_hs_fork_phase_instance_count
+    COST_CLASS_NONE,                     // dcl_hs_join_phase_instance_count
+    COST_CLASS_NONE,                     // dcl_thread_group
+    COST_CLASS_NONE,                     // dcl_uav_typed
+    COST_CLASS_NONE,                     // dcl_uav_raw
+    COST_CLASS_NONE,                     // dcl_uav_structured
+    COST_CLASS_NONE,                     // dcl_tgsm_raw
+    COST_CLASS_NONE,                     // dcl_tgsm_structured
+    COST_CLASS_NONE,                     // dcl_resource_raw
+    COST_CLASS_NONE,                     // dcl_resource_structured
+    COST_CLASS_MEMORY,                   // ld_uav_raw
+    COST_CLASS_MEMORY,                   // store_uav_raw
+    COST_CLASS_MEMORY,                   // ld_raw
+    COST_CLASS_MEMORY,                   // store_raw
+    COST_CLASS_MEMORY,                   // ld_structured
+    COST_CLASS_MEMORY,                   // store_structured
+    COST_CLASS_MEMORY,                   // atomic_and
+    COST_CLASS_MEMORY,                   // atomic_or
+    COST_CLASS_MEMORY,                   // atomic_xor
+    COST_CLASS_MEMORY,                   // atomic_cmp_store
+    COST_CLASS_MEMORY,                   // atomic_iadd
+    COST_CLASS_MEMORY,                   // atomic_imax
+    COST_CLASS_MEMORY,                   // atomic_imin
+    COST_CLASS_MEMORY,                   // atomic_umax
+    COST_CLASS_MEMORY,                   // atomic_umin
+    COST_CLASS_MEMORY,                   // imm_atomic_alloc
+    COST_CLASS_MEMORY,                   // imm_atomic_consume
+    COST_CLASS_MEMORY,                   // imm_atomic_iadd
+    COST_CLASS_MEMORY,                   // imm_atomic_and
+    COST_CLASS_MEMORY,                   // imm_atomic_or
+    COST_CLASS_MEMORY,                   // imm_atomic_xor
+    COST_CLASS_MEMORY,                   // imm_atomic_exch
+    COST_CLASS_MEMORY,                   // imm_atomic_cmp_exch
+    COST_CLASS_MEMORY,                   // imm_atomic_imax
+    COST_CLASS_MEMORY,                   // imm_atomic_imin
+    COST_CLASS_MEMORY,                   // imm_atomic_umax
+    COST_CLASS_MEMORY,                   // imm_atomic_umin
+    COST_CLASS_MEMORY,                   // symc
+    COST_CLASS_DOUBLE,                   // dadd
+    COST_CLASS_DOUBLE,                   // dmax
+    COST_CLASS_DOUBLE,                   // dmin
+    COST_CLASS_DOUBLE,                   // dmul
+    COST_CLASS_DOUBLE,                   // deq
+    COST_CLASS_DOUBLE,                   // dge
+    COST_CLASS_DOUBLE,                   // dlt
+    COST_CLASS_DOUBLE,                   // dne
+    COST_CLASS_DOUBLE,                   // dmov
+    COST_CLASS_DOUBLE,                   // dmovc
+    COST_CLASS_DOUBLE,                   // dtof
+    COST_CLASS_DOUBLE,                   // ftod
+    COST_CLASS_ALU,                      // eval_snapped
+    COST_CLASS_ALU,                      // eval_sample_index
+    COST_CLASS_ALU,                      // eval_centroid
+    COST_CLASS_NONE,                     // dcl_gs_instance_count
+    COST_CLASS_FLOW,                     // abort
+    COST_CLASS_FLOW,                     // debug_break
+    COST_CLASS_NONE,                     // EndOfD3D11Text
+    COST_CLASS_DOUBLE,                   // ddiv
+    COST_CLASS_DOUBLE,                   // dfma
+    COST_CLASS_DOUBLE,                   // drcp
+    COST_CLASS_ALU,                      // msad
+    COST_CLASS_DOUBLE,                   // dtoi
+    COST_CLASS_DOUBLE,                   // dtou
+    COST_CLASS_DOUBLE,                   // itod
+    COST_CLASS_DOUBLE,                   // utod
+    COST_CLASS_NONE,                     // EndOfD3D11_1Text
+    COST_CLASS_TEXTURE,                  // gather4_feedback
+    COST_CLASS_TEXTURE,                  // gather4_c_feedback
+    COST_CLASS_TEXTURE,                  // gather4_po_feedback
+    COST_CLASS_TEXTURE,                  // gather4_po_c_feedback
+    COST_CLASS_TEXTURE,                  // ld_feedback
+    COST_CLASS_TEXTURE,                  // ld_ms_feedback
+    COST_CLASS_MEMORY,                   // ld_uav_typed_feedback
+    COST_CLASS_MEMORY,                   // ld_raw_feedback
+    COST_CLASS_MEMORY,                   // ld_structured_feedback
+    COST_CLASS_TEXTURE,                  // sample_l_feedback
+    COST_CLASS_TEXTURE,                  // sample_c_lz_feedback
+    COST_CLASS_TEXTURE,                  // sample_clamp_feedback
+    COST_CLASS_TEXTURE,                  // sample_b_clamp_feedback
+    COST_CLASS_TEXTURE,                  // sample_d_clamp_feedback
+    COST_CLASS_TEXTURE,                  // sample_c_clamp_feedback
+    COST_CLASS_ALU,                      // check_access_fully_mapped
+    COST_CLASS_NONE,                     // EndOfWDDM1_3Text
+};
+static_assert(D3D10_SB_NUM_OPCODES == sizeof(OpcodeCostClass) / sizeof(OpcodeCostClass[0]), "OpcodeCostClass mismatch with opcode numbers");
+
+const float DefaultClassCost[COST_CLASS_COUNT] = { 0, 1, 4, 8, 8, 16, 2 };
+const float DefaultClassLatency[COST_CLASS_COUNT] = { 0, 4, 16, 16, 200, 200, 1 };
+
+bool parse_cost(const std::string& word, double& value)
+{
+    char* end;
+    value = strtod(word.c_str(), &end);
+    return end != word.c_str() && *end == 0 && value >= 0 && value < HUGE_VAL;
+}
+
+uint32_t find_text(const char* table[], uint32_t count, const std::string& word)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (word == table[i])
+            return i;
+    }
+    return count;
+}
+
+} // namespace
+
+uint32_t cost_class_of(D3D10_SB_OPCODE_TYPE opcode)
+{
+    return (uint32_t)opcode < D3D10_SB_NUM_OPCODES ? (uint32_t)OpcodeCostClass[opcode] : (uint32_t)COST_CLASS_NONE;
+}
+
+void cost_profile_default(cost_profile& profile)
+{
+    profile.name = "default";
+    profile.loop_iterations = 8;
+    for (uint32_t op = 0; op < D3D10_SB_NUM_OPCODES; op++)
+    {
+        profile.opcode_cost[op] = DefaultClassCost[OpcodeCostClass[op]];
+        profile.opcode_latency[op] = DefaultClassLatency[OpcodeCostClass[op]];
+    }
+}
+
+bool cost_profile_parse(const char* text, size_t size, cost_profile& profile, uint32_t& error_line)
+{
+    const char* end = text + size;
+    error_line = 0;
+    std::string words[4];
+    double value;
+    for (const char* line = text; line < end; )
+    {
+        const char* line_end = (const char*)memchr(line, '\n', end - line);
+        if (!line_end)
+            line_end = end;
+        error_line++;
+        uint32_t count = profile_split_words(line, line_end, words, 4);
+        line = line_end + 1;
+
+        if (count == 0)
+            continue;
+        // class and opcode lines set latencies instead of costs after the word latency.
+        const std::string* w = words;
+        float* table = profile.opcode_cost;
+        if (count > 1 && words[0] == "latency")
+        {
+            w++;
+            count--;
+            table = profile.opcode_latency;
+        }
+        if (count == 2 && table == profile.opcode_cost && w[0] == "name")
+        {
+            profile.name = w[1];
+        }
+        else if (count == 2 && table == profile.opcode_cost && w[0] == "loop_iterations" && parse_cost(w[1], value))
+        {
+            profile.loop_iterations = value;
+        }
+        else if (count == 3 && w[0] == "class" && parse_cost(w[2], value))
+        {
+            uint32_t c = find_text(cost_class_text, COST_CLASS_COUNT, w[1]);
+            if (c == COST_CLASS_COUNT)
+                return false;
+            for (uint32_t op = 0; op < D3D10_SB_NUM_OPCODES; op++)
+            {
+                if (OpcodeCostClass[op] == c)
+                    table[op] = (float)value;
+            }
+        }
+        else if (count == 3 && w[0] == "opcode" && parse_cost(w[2], value))
+        {
+            // The reserved entries of OpcodeText are comments, which no word can match.
+            uint32_t op = find_text(OpcodeText, OpcodeTextCount, w[1]);
+            if (op == OpcodeTextCount)
+                return false;
+            table[op] = (float)value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    error_line = 0;
+    return true;
+}
+
+void cost_estimate_program(const DecodedInstruction* instructions, uint32_t count, const cfg& graph,
+    const cost_profile& profile, cost_estimate& result)
+{
+    uint32_t blocks = (uint32_t)graph.blocks.size();
+    uint32_t functions = (uint32_t)graph.functions.size();
+
+    // How often each function runs. Entry points run once, fork and join phases once per instance,
+    // and each call adds the frequency of its block to the callee. SM5 does not allow recursion, so
+    // functions can be taken callers first. Should a malformed program have a cycle anyway, its
+    // functions are taken in program order once nothing else is ready, and calls back into
+    // functions already taken are ignored.
+    std::vector<double> function_frequency(functions, 0);
+    std::vector<uint32_t> callers(functions, 0);
+    for (const cfg_call& call : graph.calls)
+    {
+        if (call.callee != CFG_NONE)
+            callers[call.callee]++;
+    }
+    for (uint32_t f = 0; f < functions; f++)
+    {
+        if (graph.functions[f].kind != CFG_FUNCTION_SUBROUTINE)
+            function_frequency[f] = 1;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (instructions[i].opcode == D3D11_SB_OPCODE_DCL_HS_FORK_PHASE_INSTANCE_COUNT
+            || instructions[i].opcode == D3D11_SB_OPCODE_DCL_HS_JOIN_PHASE_INSTANCE_COUNT)
+            function_frequency[graph.blocks[graph.block_of[i]].function] = instructions[i].data[0];
+    }
+
+    std::vector<double> depth_weight(1, 1.0);
+    for (const cfg_loop& loop : graph.loops)
+    {
+        while (depth_weight.size() <= loop.depth)
+            depth_weight.push_back(depth_weight.back() * profile.loop_iterations);
+    }
+
+    result.frequency.resize(blocks);
+    std::vector<uint32_t> ready;
+    std::vector<uint8_t> done(functions, 0);
+    for (uint32_t f = 0; f < functions; f++)
+    {
+        if (callers[f] == 0)
+            ready.push_back(f);
+    }
+    for (uint32_t next = 0, visited = 0; visited < functions; visited++)
+    {
+        uint32_t f;
+        if (!ready.empty())
+        {
+            f = ready.back();
+            ready.pop_back();
+        }
+        else
+        {
+            while (done[next])
+                next++;
+            f = next;
+        }
+        done[f] = 1;
+
+        const cfg_function& function = graph.functions[f];
+        for (uint32_t b = function.first_block; b < function.end_block; b++)
+            result.frequency[b] = function_frequency[f] * depth_weight[cfg_loop_depth(graph, b)];
+        for (uint32_t c = function.first_call; c < function.first_call + function.call_count; c++)
+        {
+            const cfg_call& call = graph.calls[c];
+            if (call.callee == CFG_NONE || done[call.callee])
+                continue;
+            function_frequency[call.callee] += result.frequency[call.block];
+            if (--callers[call.callee] == 0)
+                ready.push_back(call.callee);
+        }
+    }
+
+    result.total = 0;
+    for (uint32_t c = 0; c < COST_CLASS_COUNT; c++)
+        result.classes[c] = 0;
+    result.hottest_block = CFG_NONE;
+    result.instructions.resize(count);
+    result.blocks.assign(blocks, 0);
+    result.functions.assign(functions, 0);
+    for (uint32_t b = 0; b < blocks; b++)
+    {
+        const cfg_block& block = graph.blocks[b];
+        double frequency = result.frequency[b];
+        double sum = 0;
+        for (uint32_t i = block.first; i < block.end; i++)
+        {
+            D3D10_SB_OPCODE_TYPE opcode = instructions[i].opcode;
+            double cost = profile.opcode_cost[opcode] * frequency;
+            result.instructions[i] = cost;
+            result.classes[OpcodeCostClass[opcode]] += cost;
+            sum += cost;
+        }
+        result.blocks[b] = sum;
+        result.functions[block.function] += sum;
+        result.total += sum;
+        if (sum > 0 && (result.hottest_block == CFG_NONE || sum > result.blocks[result.hottest_block]))
+            result.hottest_block = b;
+    }
+}
@@ -0,0 +1,190 @@
+#include "critical_path.h"
+
+namespace {
+
+// Registers are tracked up to this number, in each of the kinds below.
+const uint32_t MaxRegisters = 4096;
+
+enum register_kind
+{
+    KIND_TEMP,
+    KIND_INDEXABLE_TEMP,
+    KIND_UAV,
+    KIND_GROUP_SHARED,
+    KIND_COUNT,
+};
+
+// Kind of a register operand whose dependencies are tracked, KIND_COUNT for any other.
+uint32_t register_kind_of(const DecodedOperand& operand)
+{
+    if (operand.indexDim < 1 || operand.index[0].value >= MaxRegisters)
+        return KIND_COUNT;
+    switch (operand.type)
+    {
+    case D3D10_SB_OPERAND_TYPE_TEMP:
+        return KIND_TEMP;
+    case D3D10_SB_OPERAND_TYPE_INDEXABLE_TEMP:
+        return KIND_INDEXABLE_TEMP;
+    case D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW:
+        return KIND_UAV;
+    case D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY:
+        return KIND_GROUP_SHARED;
+    default:
+        return KIND_COUNT;
+    }
+}
+
+// Atomics that return the value they replaced read memory as well as write it.
+bool is_returning_atomic(D3D10_SB_OPCODE_TYPE opcode)
+{
+    return opcode >= D3D11_SB_OPCODE_IMM_ATOMIC_ALLOC && opcode <= D3D11_SB_OPCODE_IMM_ATOMIC_UMIN;
+}
+
+// Walks one block, keeping in writer the last instruction to write each component, as a slot of
+// four per register after the registers of the kinds before it.
+class block_walk
+{
+public:
+    block_walk(const DecodedOperand* operands, const cost_profile& profile, uint32_t stride, latency_estimate& result)
+        : operands(operands), profile(profile), stride(stride), result(result)
+    {
+    }
+
+    void run(const DecodedInstruction* instructions, const cfg_block& block, block_latency& out)
+    {
+        first = block.first;
+        out.latency = 0;
+        out.issue = 0;
+        out.slowest = 0;
+        out.chain_last = CFG_NONE;
+        for (uint32_t i = block.first; i < block.end; i++)
+        {
+            const DecodedInstruction& inst = instructions[i];
+            result.finish[i] = 0;
+            result.previous[i] = CFG_NONE;
+            if (IsDeclaration(inst.opcode))
+                continue;
+            out.issue += profile.opcode_cost[inst.opcode];
+
+            start = 0;
+            waited = CFG_NONE;
+            const DecodedOperand* ops = operands + inst.firstOperand;
+            uint32_t destinations = DestinationCount(inst.opcode);
+            destinations = destinations < inst.operandCount ? destinations : inst.operandCount;
+            uint32_t positions = SourcePositions(inst, operands);
+            for (uint32_t o = destinations; o < inst.operandCount; o++)
+                read(ops[o], ComponentsRead(ops[o], positions));
+            for (uint32_t o = inst.operandCount; o < (uint32_t)inst.operandCount + inst.relativeCount; o++)
+                read(ops[o], ComponentsRead(ops[o], 1));
+            if (is_returning_atomic(inst.opcode))
+            {
+                for (uint32_t o = 0; o < destinations; o++)
+                    read(ops[o], 1);
+            }
+
+            double latency = profile.opcode_latency[inst.opcode];
+            out.slowest = latency > out.slowest ? latency : out.slowest;
+            double finish = start + latency;
+            result.finish[i] = finish;
+            result.previous[i] = waited;
+            if (finish > out.latency)
+            {
+                out.latency = finish;
+                out.chain_last = i;
+            }
+            for (uint32_t o = 0; o < destinations; o++)
+                write(ops[o], i);
+        }
+
+        out.chain_first = out.chain_last;
+        out.chain_length = 0;
+        for (uint32_t i = out.chain_last; i != CFG_NONE; i = result.previous[i])
+        {
+            out.chain_first = i;
+            out.chain_length++;
+        }
+    }
+
+private:
+    // Memory registers are tracked as a whole, in the first slot of theirs.
+    static uint32_t components_of(uint32_t kind, uint32_t components)
+    {
+        if (kind == KIND_UAV || kind == KIND_GROUP_SHARED)
+            return 1;
+        return components & 0xf;
+    }
+
+    void read(const DecodedOperand& operand, uint32_t components)
+    {
+        uint32_t kind = register_kind_of(operand);
+        if (kind == KIND_COUNT)
+            return;
+        uint32_t slot = kind * stride + (uint32_t)operand.index[0].value * 4;
+        components = components_of(kind, components);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            if (!(components & (1 << c)))
+                continue;
+            uint32_t writer = result.writer[slot + c];
+            if (writer != CFG_NONE && writer >= first && result.finish[writer] > start)
+            {
+                start = result.finish[writer];
+                waited = writer;
+            }
+        }
+    }
+
+    void write(const DecodedOperand& operand, uint32_t instruction)
+    {
+        uint32_t kind = register_kind_of(operand);
+        if (kind == KIND_COUNT)
+            return;
+        uint32_t slot = kind * stride + (uint32_t)operand.index[0].value * 4;
+        uint32_t mask = operand.numComponents == 4 && operand.selectionMode == D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE
+            ? operand.mask : 0xf;
+        mask = components_of(kind, mask);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            if (mask & (1 << c))
+                result.writer[slot + c] = instruction;
+        }
+    }
+
+    const DecodedOperand* operands;
+    const cost_profile& profile;
+    uint32_t stride;
+    latency_estimate& result;
+    uint32_t first;             // first instruction of the block; earlier writers are outside it
+    double start;               // of the instruction being walked
+    uint32_t waited;
+};
+
+} // namespace
+
+void latency_estimate_program(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, const cost_profile& profile, latency_estimate& result)
+{
+    // Slots are only needed up to the highest register the program names.
+    uint32_t registers = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const DecodedInstruction& inst = instructions[i];
+        if (IsDeclaration(inst.opcode))
+            continue;
+        for (uint32_t o = 0; o < (uint32_t)inst.operandCount + inst.relativeCount; o++)
+        {
+            const DecodedOperand& operand = operands[inst.firstOperand + o];
+            if (register_kind_of(operand) != KIND_COUNT && operand.index[0].value >= registers)
+                registers = (uint32_t)operand.index[0].value + 1;
+        }
+    }
+    uint32_t stride = registers * 4;
+    result.writer.assign((size_t)stride * KIND_COUNT, CFG_NONE);
+    result.finish.resize(count);
+    result.previous.resize(count);
+    result.blocks.resize(graph.blocks.size());
+
+    block_walk walk(operands, profile, stride, result);
+    for (uint32_t b = 0; b < graph.blocks.size(); b++)
+        walk.run(instructions, graph.blocks[b], result.blocks[b]);
+}
@@ -27,15 +27,18 @@
 #include <stdint.h>
 #include <string.h>
 #include "dxbc.h"
+#include "fxdis_stats.h"
 
-std::pair<void*, size_t> dxbc_assemble(struct dxbc_chunk_header** chunks, unsigned num_chunks)
+std::pair<void*, size_t> dxbc_assemble(struct dxbc_chunk_header** chunks, unsigned num_chunks, fxdis_arena* arena)
 {
    size_t data_size = 0;
    for(unsigned i = 0; i < num_chunks; ++i)
       data_size += sizeof(uint32_t) + sizeof(dxbc_chunk_header) + bswap_le32(chunks[i]->size);
 
    size_t total_size = sizeof(dxbc_container_header) + data_size;
-   dxbc_container_header* header = (dxbc_container_header*)malloc(total_size);
+   if(!arena)
+      FXDIS_STATS_ADD(FXDIS_STATS_ALLOCATIONS, 1);
+   dxbc_container_header* header = (dxbc_container_header*)(arena ? arena->allocate(total_size) : malloc(total_size));
    if(!header)
       return std::make_pair((void*)0, 0);
 
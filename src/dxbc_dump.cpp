@@ -29,15 +29,20 @@
 #include <iomanip>
 #include "dxbc.h"
 
+void dxbc_format_chunk(std::ostream& out, unsigned i, unsigned fourcc, size_t offset, uint32_t size)
+{
+   char fourcc_str[5];
+   memcpy(fourcc_str, &fourcc, 4);
+   fourcc_str[4] = 0;
+   out << "# DXBC chunk " << std::setw(2) << i << ": " << fourcc_str << " offset " << offset << " size " << size << "\n";
+}
+
 std::ostream& operator <<(std::ostream& out, const dxbc_container& container)
 {
    for(unsigned i = 0; i < container.chunks.size(); ++i)
    {
       struct dxbc_chunk_header* chunk = container.chunks[i];
-      char fourcc_str[5];
-      memcpy(fourcc_str, &chunk->fourcc, 4);
-      fourcc_str[4] = 0;
-      out << "# DXBC chunk " << std::setw(2) << i << ": " << fourcc_str << " offset " << ((char*)chunk - (char*)container.data) << " size " << bswap_le32(chunk->size) << "\n";
+      dxbc_format_chunk(out, i, chunk->fourcc, (char*)chunk - (char*)container.data, bswap_le32(chunk->size));
    }
    return out;
 }
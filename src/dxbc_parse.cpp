@@ -24,52 +24,103 @@
  *
  **************************************************************************/
 
-#include <memory>
+#include <new>
 #include "dxbc.h"
+#include "fxdis_stats.h"
 #include <d3d11shader.h>
 #include <d3dcommon.h>
 
-dxbc_container* dxbc_parse(const void* data, int size)
+/* returns the i-th chunk, or NULL if it is misaligned or its table entry or header lies outside the size bytes of data */
+static dxbc_chunk_header* dxbc_chunk_at(const void* data, int size, unsigned i)
 {
-   std::auto_ptr<dxbc_container> container(new dxbc_container());
-   container->data = data;
    dxbc_container_header* header = (dxbc_container_header*)data;
    uint32_t* chunk_offsets = (uint32_t*)(header + 1);
-   if(bswap_le32(header->fourcc) != FOURCC_DXBC)
+   if((size_t)size < sizeof(*header) + (i + 1) * sizeof(uint32_t))
       return 0;
-   unsigned num_chunks = bswap_le32(header->chunk_count);
-   for(unsigned i = 0; i < num_chunks; ++i)
+   unsigned offset = bswap_le32(chunk_offsets[i]);
+   if((offset & 3) || offset > (unsigned)size || (unsigned)size - offset < sizeof(dxbc_chunk_header))
+      return 0;
+   dxbc_chunk_header* chunk = (dxbc_chunk_header*)((char*)data + offset);
+   if(bswap_le32(chunk->size) > (unsigned)size - offset - sizeof(dxbc_chunk_header))
+      return 0;
+   return chunk;
+}
+
+dxbc_container* dxbc_parse(const void* data, int size, fxdis_arena* arena)
+{
+   /* validate up front, so nothing is built that would have to be torn down again */
+   int num_chunks = dxbc_count_chunks(data, size);
+   if(num_chunks < 0)
+      return 0;
+   dxbc_container* container;
+   if(arena)
+   {
+      void* memory = arena->allocate(sizeof(dxbc_container), alignof(dxbc_container));
+      if(!memory)
+         return 0;
+      container = new(memory) dxbc_container(arena);
+   }
+   else
+      container = new dxbc_container();
+   container->data = data;
+   container->chunks.reserve(num_chunks);
+   for(int i = 0; i < num_chunks; ++i)
    {
-      unsigned offset = bswap_le32(chunk_offsets[i]);
-      dxbc_chunk_header* chunk = (dxbc_chunk_header*)((char*)data + offset);
+      dxbc_chunk_header* chunk = dxbc_chunk_at(data, size, i);
       unsigned fourcc = bswap_le32(chunk->fourcc);
       container->chunk_map[fourcc] = i;
       container->chunks.push_back(chunk);
    }
-   return container.release();
+   return container;
 }
 
 dxbc_chunk_header* dxbc_find_chunk(const void* data, int size, unsigned fourcc)
 {
+   if(size < (int)sizeof(dxbc_container_header))
+      return 0;
    dxbc_container_header* header = (dxbc_container_header*)data;
-   uint32_t* chunk_offsets = (uint32_t*)(header + 1);
    if(bswap_le32(header->fourcc) != FOURCC_DXBC)
       return 0;
    unsigned num_chunks = bswap_le32(header->chunk_count);
    for(unsigned i = 0; i < num_chunks; ++i)
    {
-      unsigned offset = bswap_le32(chunk_offsets[i]);
-      dxbc_chunk_header* chunk = (dxbc_chunk_header*)((char*)data + offset);
+      dxbc_chunk_header* chunk = dxbc_chunk_at(data, size, i);
+      if(!chunk)
+         return 0;
       if(bswap_le32(chunk->fourcc) == fourcc)
          return chunk;
    }
    return 0;
 }
 
-int dxbc_parse_signature(dxbc_chunk_signature* sig, D3D11_SIGNATURE_PARAMETER_DESC** params)
+int dxbc_count_chunks(const void* data, int size)
+{
+   if(size < (int)sizeof(dxbc_container_header))
+      return -1;
+   dxbc_container_header* header = (dxbc_container_header*)data;
+   if(bswap_le32(header->fourcc) != FOURCC_DXBC)
+      return -1;
+   unsigned num_chunks = bswap_le32(header->chunk_count);
+   if(num_chunks > (unsigned)size / sizeof(uint32_t))
+      return -1;
+   for(unsigned i = 0; i < num_chunks; ++i)
+   {
+      if(!dxbc_chunk_at(data, size, i))
+         return -1;
+   }
+   return (int)num_chunks;
+}
+
+int dxbc_parse_signature(dxbc_chunk_signature* sig, D3D11_SIGNATURE_PARAMETER_DESC** params, fxdis_arena* arena)
 {
    unsigned count = bswap_le32(sig->count);
-   *params = (D3D11_SIGNATURE_PARAMETER_DESC*)malloc(sizeof(D3D11_SIGNATURE_PARAMETER_DESC) * count);
+   if(arena)
+      *params = arena->allocate_array<D3D11_SIGNATURE_PARAMETER_DESC>(count);
+   else
+   {
+      FXDIS_STATS_ADD(FXDIS_STATS_ALLOCATIONS, 1);
+      *params = (D3D11_SIGNATURE_PARAMETER_DESC*)malloc(sizeof(D3D11_SIGNATURE_PARAMETER_DESC) * count);
+   }
 
    for (unsigned i = 0; i < count; ++i)
    {
@@ -0,0 +1,25 @@
+#include "fxdis_stats.h"
+
+const char* FxdisStatsPhaseText[] = {
+    "read",
+    "parse",
+    "find_chunk",
+    "decode",
+    "format",
+    "write",
+};
+
+const char* FxdisStatsCounterText[] = {
+    "files",
+    "instructions",
+    "operands",
+    "extended_tokens",
+    "relative_operands",
+    "bytes_emitted",
+    "allocations",
+};
+
+#ifdef FXDIS_STATS
+thread_local fxdis_stats* fxdis_stats_current;
+thread_local fxdis_stats_timer* fxdis_stats_timing;
+#endif
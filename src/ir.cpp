@@ -0,0 +1,175 @@
+#include "ir.h"
+#include <string.h>
+
+static_assert(sizeof(ir_header) % 8 == 0, "ir_header must keep the records after it aligned");
+static_assert(sizeof(ir_chunk) == 12, "ir_chunk is stored as it is");
+static_assert(sizeof(DecodedInstruction) % 8 == 0 && sizeof(DecodedOperand) % 8 == 0,
+    "IR records must keep each other aligned");
+
+namespace {
+
+const uint32_t record_sizes = (uint32_t)(sizeof(DecodedInstruction) | sizeof(DecodedOperand) << 16);
+
+bool valid_operand(const DecodedOperand* operands, uint32_t operand, uint32_t begin, uint32_t end, uint32_t depth)
+{
+    if (operand < begin || operand >= end || depth > DECODED_MAX_RELATIVE_DEPTH)
+        return false;
+    const DecodedOperand& o = operands[operand];
+    if (o.numComponents > 4 || o.selectionMode > D3D10_SB_OPERAND_4_COMPONENT_SELECT_1_MODE
+        || o.indexDim > 3 || o.immCount > 8)
+        return false;
+    for (int i = 0; i < 4; i++)
+    {
+        if (o.swizzle[i] > 3)
+            return false;
+    }
+    if (o.type == D3D10_SB_OPERAND_TYPE_IMMEDIATE64 && o.numComponents * 2 > 8)
+        return false;
+    // Relative registers may nest but never loop, which the depth limit catches.
+    for (uint32_t idx = 0; idx < o.indexDim; idx++)
+    {
+        uint32_t relative = o.index[idx].relative;
+        if (relative != DECODED_NO_OPERAND && !valid_operand(operands, relative, begin, end, depth + 1))
+            return false;
+    }
+    return true;
+}
+
+bool valid_instruction(const ir_header* ir, const DecodedInstruction& inst)
+{
+    // The opcode is only an enum once it is known to be in range.
+    uint32_t opcode;
+    memcpy(&opcode, &inst.opcode, sizeof(opcode));
+    if (opcode >= D3D10_SB_NUM_OPCODES || inst.extOpcodeCount > DECODED_MAX_EXT_OPCODES
+        || inst.dataCount > DECODED_MAX_DATA)
+        return false;
+    if (inst.offset > ir->token_count || inst.length > ir->token_count - inst.offset)
+        return false;
+    uint32_t begin = inst.firstOperand;
+    uint32_t end = begin + inst.operandCount + inst.relativeCount;
+    if (begin > ir->operand_count || end > ir->operand_count)
+        return false;
+    if (inst.opcode == D3D10_SB_OPCODE_CUSTOMDATA)
+    {
+        // Custom data is printed from the tokens, data[1] of them.
+        if (inst.dataCount < 2 || inst.data[1] < 2 || inst.data[1] > ir->token_count - inst.offset)
+            return false;
+    }
+    else if (inst.operandCount * DeclarationDataPerOperand(inst.opcode) > inst.dataCount)
+    {
+        return false;
+    }
+    if ((inst.opcode == D3D10_SB_OPCODE_DCL_RESOURCE || inst.opcode == D3D10_SB_OPCODE_DCL_SAMPLER) && inst.operandCount != 1)
+        return false;
+    const DecodedOperand* operands = ir_operands(ir);
+    for (uint32_t i = 0; i < inst.operandCount; i++)
+    {
+        if (!valid_operand(operands, begin + i, begin, end, 0))
+            return false;
+    }
+    return true;
+}
+
+inline uint32_t align8(size_t size)
+{
+    return (uint32_t)((size + 7) & ~(size_t)7);
+}
+
+} // namespace
+
+DECODE_STATUS ir_encode(const uint32_t* tokens, uint32_t sizeInBytes, std::vector<char>& out,
+    const dxbc_container* container)
+{
+    TokenDecoder decoder(tokens, sizeInBytes);
+    DECODE_STATUS status = decoder.DecodeHeader();
+    if (status != DECODE_STATUS::OK)
+        return status;
+
+    // The pool is never cleared, so operand indices come out relative to the whole program.
+    std::vector<DecodedInstruction> instructions;
+    DecodedOperandPool operands;
+    DecodedInstruction inst;
+    while ((status = decoder.Next(inst, operands)) == DECODE_STATUS::OK)
+        instructions.push_back(inst);
+    if (status != DECODE_STATUS::END)
+        return status;
+
+    ir_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = IR_MAGIC;
+    header.version = IR_VERSION;
+    header.header_size = sizeof(ir_header);
+    header.record_sizes = record_sizes;
+    header.flags = decoder.SizeMismatch() ? IR_FLAG_SIZE_MISMATCH : 0;
+    header.program_version = decoder.Version();
+    header.instruction_count = (uint32_t)instructions.size();
+    header.operand_count = (uint32_t)operands.size();
+    header.token_count = sizeInBytes / 4;
+    header.instructions_offset = sizeof(ir_header);
+    header.operands_offset = header.instructions_offset + align8(instructions.size() * sizeof(DecodedInstruction));
+    header.tokens_offset = header.operands_offset + align8(operands.size() * sizeof(DecodedOperand));
+    header.chunk_count = container ? (uint32_t)container->chunks.size() : 0;
+    header.chunks_offset = header.tokens_offset + align8(header.token_count * 4);
+    header.total_size = header.chunks_offset + align8(header.chunk_count * sizeof(ir_chunk));
+
+    size_t base = out.size();
+    out.resize(base + header.total_size);
+    char* file = &out[base];
+    memcpy(file, &header, sizeof(header));
+    if (!instructions.empty())
+        memcpy(file + header.instructions_offset, &instructions[0], instructions.size() * sizeof(DecodedInstruction));
+    if (!operands.empty())
+        memcpy(file + header.operands_offset, &operands[0], operands.size() * sizeof(DecodedOperand));
+    memcpy(file + header.tokens_offset, tokens, header.token_count * 4);
+    ir_chunk* chunks = (ir_chunk*)(file + header.chunks_offset);
+    for (uint32_t i = 0; i < header.chunk_count; i++)
+    {
+        const dxbc_chunk_header* chunk = container->chunks[i];
+        chunks[i].fourcc = chunk->fourcc;
+        chunks[i].offset = (uint32_t)((const char*)chunk - (const char*)container->data);
+        chunks[i].size = bswap_le32(chunk->size);
+    }
+    return status;
+}
+
+const ir_header* ir_validate(const void* data, size_t size)
+{
+    const ir_header* ir = (const ir_header*)data;
+    if (((uintptr_t)data & 7) || size < sizeof(ir_header))
+        return NULL;
+    if (ir->magic != IR_MAGIC || ir->version != IR_VERSION || ir->header_size != sizeof(ir_header)
+        || ir->record_sizes != record_sizes || ir->total_size != size)
+        return NULL;
+
+    // Each section must start aligned, in order, and fit before the next one.
+    uint64_t instructions_end = (uint64_t)ir->instructions_offset + (uint64_t)ir->instruction_count * sizeof(DecodedInstruction);
+    uint64_t operands_end = (uint64_t)ir->operands_offset + (uint64_t)ir->operand_count * sizeof(DecodedOperand);
+    uint64_t tokens_end = (uint64_t)ir->tokens_offset + (uint64_t)ir->token_count * 4;
+    uint64_t chunks_end = (uint64_t)ir->chunks_offset + (uint64_t)ir->chunk_count * sizeof(ir_chunk);
+    if ((ir->instructions_offset | ir->operands_offset | ir->tokens_offset | ir->chunks_offset) & 7)
+        return NULL;
+    if (ir->instructions_offset < sizeof(ir_header) || instructions_end > ir->operands_offset
+        || operands_end > ir->tokens_offset || tokens_end > ir->chunks_offset || chunks_end > size)
+        return NULL;
+
+    const DecodedInstruction* instructions = ir_instructions(ir);
+    for (uint32_t i = 0; i < ir->instruction_count; i++)
+    {
+        if (!valid_instruction(ir, instructions[i]))
+            return NULL;
+    }
+    return ir;
+}
+
+void ir_format(const ir_header* ir, std::ostream& out)
+{
+    const ir_chunk* chunks = ir_chunks(ir);
+    for (uint32_t i = 0; i < ir->chunk_count; i++)
+        dxbc_format_chunk(out, i, chunks[i].fourcc, chunks[i].offset, chunks[i].size);
+    TokenParser::FormatHeader(out, ir->program_version, (ir->flags & IR_FLAG_SIZE_MISMATCH) != 0);
+    const DecodedInstruction* instructions = ir_instructions(ir);
+    const DecodedOperand* operands = ir_operands(ir);
+    const uint32_t* tokens = ir_tokens(ir);
+    for (uint32_t i = 0; i < ir->instruction_count; i++)
+        TokenParser::FormatInstruction(out, instructions[i], operands, tokens);
+}
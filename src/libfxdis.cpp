@@ -0,0 +1,254 @@
+#include "libfxdis.h"
+#include "dxbc.h"
+#include "D3D11TokenParser.h"
+#include "fxdis_stats.h"
+#include <limits.h>
+#include <string.h>
+#include <ostream>
+
+namespace {
+
+// Copies text into the caller's buffer and counts whatever did not fit.
+class buffer_streambuf : public std::streambuf
+{
+public:
+    buffer_streambuf(char* buffer, size_t size) : length(0), text(buffer), capacity(size ? size - 1 : 0) {}
+    void terminate()
+    {
+        if (text)
+            text[length < capacity ? length : capacity] = '\0';
+    }
+    size_t length;
+protected:
+    std::streamsize xsputn(const char* s, std::streamsize n)
+    {
+        if (length < capacity)
+        {
+            size_t room = capacity - length;
+            memcpy(text + length, s, (size_t)n < room ? (size_t)n : room);
+        }
+        length += (size_t)n;
+        return n;
+    }
+    int_type overflow(int_type c)
+    {
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            char ch = traits_type::to_char_type(c);
+            xsputn(&ch, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+private:
+    char* text;
+    size_t capacity;
+};
+
+// Batches text in a fixed buffer and hands it to the caller's write function.
+class callback_streambuf : public std::streambuf
+{
+public:
+    callback_streambuf(fxdis_write_fn fn, void* user) : aborted(false), write(fn), context(user)
+    {
+        setp(chunk, chunk + sizeof(chunk));
+    }
+    bool aborted;
+protected:
+    int_type overflow(int_type c)
+    {
+        if (!flush_chunk())
+            return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+    int sync()
+    {
+        return flush_chunk() ? 0 : -1;
+    }
+private:
+    bool flush_chunk()
+    {
+        size_t size = pptr() - pbase();
+        setp(chunk, chunk + sizeof(chunk));
+        if (aborted)
+            return false;
+        if (size && write(context, chunk, size))
+            aborted = true;
+        return !aborted;
+    }
+    fxdis_write_fn write;
+    void* context;
+    char chunk[4096];
+};
+
+// Per-call scratch space. Typical shaders fit in it, so a call normally makes no heap allocation.
+const size_t scratch_size = 8 << 10;
+
+bool valid_container(const fxdis_container* container)
+{
+    return container && container->program && container->program_size <= UINT32_MAX;
+}
+
+fxdis_result disassemble(const fxdis_container* container, std::ostream& out)
+{
+    alignas(16) char scratch[scratch_size];
+    fxdis_arena arena(scratch, sizeof(scratch));
+    if (container->chunk_count)
+    {
+        dxbc_container* dxbc;
+        {
+            FXDIS_STATS_TIME(FXDIS_STATS_PARSE);
+            dxbc = dxbc_parse(container->data, (int)container->size, &arena);
+        }
+        if (dxbc)
+        {
+            FXDIS_STATS_TIME(FXDIS_STATS_FORMAT);
+            out << *dxbc;
+        }
+    }
+    TokenParser parser(container->program, (uint32_t)container->program_size, out, &arena);
+    return parser.Parse() ? FXDIS_OK : FXDIS_ERROR_INVALID_PROGRAM;
+}
+
+} // namespace
+
+fxdis_result fxdis_open(fxdis_container* container, const void* data, size_t size)
+{
+    if (!container || !data || size > INT_MAX || ((uintptr_t)data & 3))
+        return FXDIS_ERROR_INVALID_ARGUMENT;
+    memset(container, 0, sizeof(*container));
+    container->data = data;
+    container->size = size;
+
+    if (size < 4 || bswap_le32(*(const uint32_t*)data) != FOURCC_DXBC)
+    {
+        // A bare token stream, as stored inside a SHDR/SHEX chunk.
+        container->program = (const uint32_t*)data;
+        container->program_size = size;
+        return FXDIS_OK;
+    }
+
+    int chunk_count = dxbc_count_chunks(data, (int)size);
+    if (chunk_count < 0)
+        return FXDIS_ERROR_INVALID_CONTAINER;
+    container->chunk_count = chunk_count;
+    dxbc_chunk_header* chunk;
+    {
+        FXDIS_STATS_TIME(FXDIS_STATS_FIND_CHUNK);
+        chunk = dxbc_find_shader_bytecode(data, (int)size);
+    }
+    if (!chunk)
+        return FXDIS_ERROR_NO_SHADER;
+    container->program = (const uint32_t*)(chunk + 1);
+    container->program_size = bswap_le32(chunk->size);
+    return FXDIS_OK;
+}
+
+fxdis_result fxdis_disassemble_to_buffer(const fxdis_container* container, char* buffer, size_t buffer_size, size_t* needed)
+{
+    if (!valid_container(container) || (!buffer && buffer_size))
+        return FXDIS_ERROR_INVALID_ARGUMENT;
+    buffer_streambuf text(buffer, buffer_size);
+    std::ostream out(&text);
+    fxdis_result result = disassemble(container, out);
+    text.terminate();
+    if (needed)
+        *needed = text.length;
+    if (result == FXDIS_OK && (!buffer_size || text.length > buffer_size - 1))
+        result = FXDIS_ERROR_BUFFER_TOO_SMALL;
+    return result;
+}
+
+fxdis_result fxdis_disassemble_to_callback(const fxdis_container* container, fxdis_write_fn write, void* user)
+{
+    if (!valid_container(container) || !write)
+        return FXDIS_ERROR_INVALID_ARGUMENT;
+    callback_streambuf text(write, user);
+    std::ostream out(&text);
+    fxdis_result result = disassemble(container, out);
+    out.flush();
+    return text.aborted ? FXDIS_ERROR_ABORTED : result;
+}
+
+fxdis_result fxdis_analyze(const fxdis_container* container, fxdis_program_info* info, fxdis_instruction_fn callback, void* user)
+{
+    if (!valid_container(container))
+        return FXDIS_ERROR_INVALID_ARGUMENT;
+
+    fxdis_program_info summary;
+    memset(&summary, 0, sizeof(summary));
+    alignas(16) char scratch[scratch_size];
+    fxdis_arena arena(scratch, sizeof(scratch));
+    TokenDecoder decoder(container->program, (uint32_t)container->program_size, &arena);
+    DECODE_STATUS status = decoder.DecodeHeader();
+    if (status == DECODE_STATUS::OK)
+    {
+        summary.program_type = DECODE_D3D10_SB_TOKENIZED_PROGRAM_TYPE(decoder.Version());
+        summary.major_version = DECODE_D3D10_SB_TOKENIZED_PROGRAM_MAJOR_VERSION(decoder.Version());
+        summary.minor_version = DECODE_D3D10_SB_TOKENIZED_PROGRAM_MINOR_VERSION(decoder.Version());
+
+        DecodedInstruction inst;
+        DecodedOperandPool operands(&arena);
+        while ((status = decoder.Next(inst, operands)) == DECODE_STATUS::OK)
+        {
+            operands.clear();
+            bool declaration = IsDeclaration(inst.opcode);
+            if (declaration)
+                summary.declaration_count++;
+            else
+                summary.instruction_count++;
+            switch (inst.opcode)
+            {
+            case D3D10_SB_OPCODE_DCL_TEMPS:
+                summary.temp_registers = inst.data[0];
+                break;
+            case D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP:
+                summary.indexable_temp_registers += inst.data[1];
+                break;
+            case D3D11_SB_OPCODE_DCL_THREAD_GROUP:
+                memcpy(summary.thread_group, inst.data, sizeof(summary.thread_group));
+                break;
+            default:
+                break;
+            }
+
+            if (callback)
+            {
+                fxdis_instruction instruction;
+                instruction.opcode = inst.opcode;
+                instruction.name = OpcodeText[inst.opcode];
+                instruction.offset = inst.offset;
+                instruction.length = inst.length;
+                instruction.operand_count = inst.operandCount;
+                instruction.is_declaration = declaration;
+                if (callback(user, &instruction))
+                {
+                    if (info)
+                        *info = summary;
+                    return FXDIS_ERROR_ABORTED;
+                }
+            }
+        }
+    }
+    if (info)
+        *info = summary;
+    return status == DECODE_STATUS::END ? FXDIS_OK : FXDIS_ERROR_INVALID_PROGRAM;
+}
+
+const char* fxdis_result_text(fxdis_result result)
+{
+    static const char* const text[] = {
+        "ok",
+        "invalid argument",
+        "invalid container",
+        "no shader program in container",
+        "invalid shader program",
+        "buffer too small",
+        "aborted by callback",
+    };
+    return (unsigned)result < sizeof(text) / sizeof(text[0]) ? text[result] : "unknown result";
+}
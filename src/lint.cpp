@@ -0,0 +1,137 @@
+#include "lint.h"
+#include "cost_model.h"
+#include <algorithm>
+
+const char* lint_level_text[] = {
+    "note",
+    "warning",
+};
+
+const lint_rule_info lint_rules[LINT_RULE_COUNT] = {
+    { "FXL0001", "skip-optimization", LINT_WARNING,
+        "The program was compiled with optimizations skipped, as for debugging." },
+    { "FXL0002", "double-precision", LINT_WARNING,
+        "Double precision arithmetic runs at a fraction of the float rate, or is emulated, on most GPUs." },
+    { "FXL0003", "dynamic-constant-buffer", LINT_NOTE,
+        "A dynamic indexed constant buffer is read through memory instead of the constant path when the index varies." },
+    { "FXL0004", "indexable-temp", LINT_WARNING,
+        "Indexable temp arrays do not fit in registers on most GPUs and are kept in scratch memory." },
+    { "FXL0005", "sample-rate-input", LINT_WARNING,
+        "Per-sample interpolation or SV_SampleIndex makes a pixel shader run once per sample instead of once per pixel." },
+    { "FXL0006", "unneeded-globally-coherent", LINT_NOTE,
+        "A globally coherent UAV bypasses caches, which only helps a program that fences UAV memory across thread groups." },
+};
+
+namespace {
+
+void add(lint_checker& checker, std::vector<lint_finding>& to, lint_rule rule, const DecodedInstruction& inst,
+    uint32_t index, uint32_t size)
+{
+    lint_finding finding;
+    finding.rule = rule;
+    finding.instruction = checker.instructions;
+    finding.offset = inst.offset;
+    finding.length = inst.length;
+    finding.opcode = inst.opcode;
+    finding.index = index;
+    finding.size = size;
+    to.push_back(finding);
+}
+
+// Number of a declared register.
+uint32_t register_of(const DecodedOperand& operand)
+{
+    return operand.indexDim ? (uint32_t)operand.index[0].value : 0;
+}
+
+bool is_sample_interpolation(uint32_t opcodeToken)
+{
+    D3D10_SB_INTERPOLATION_MODE mode = DECODE_D3D10_SB_INPUT_INTERPOLATION_MODE(opcodeToken);
+    return mode == D3D10_SB_INTERPOLATION_LINEAR_SAMPLE || mode == D3D10_SB_INTERPOLATION_LINEAR_NOPERSPECTIVE_SAMPLE;
+}
+
+bool by_instruction(const lint_finding& a, const lint_finding& b)
+{
+    return a.instruction < b.instruction;
+}
+
+} // namespace
+
+void lint_begin(lint_checker& checker)
+{
+    checker.findings.clear();
+    checker.coherent.clear();
+    checker.instructions = 0;
+    checker.global_fence = false;
+}
+
+void lint_instruction(lint_checker& checker, const DecodedInstruction& inst, const DecodedOperand* operands)
+{
+    const DecodedOperand* first = operands + inst.firstOperand;
+    switch (inst.opcode)
+    {
+    case D3D10_SB_OPCODE_DCL_GLOBAL_FLAGS:
+        if (inst.opcodeToken & D3D11_1_SB_GLOBAL_FLAG_SKIP_OPTIMIZATION)
+            add(checker, checker.findings, LINT_SKIP_OPTIMIZATION, inst, 0, 0);
+        break;
+    case D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER:
+        if (DECODE_D3D10_SB_CONSTANT_BUFFER_ACCESS_PATTERN(inst.opcodeToken) == D3D10_SB_CONSTANT_BUFFER_DYNAMIC_INDEXED)
+        {
+            for (uint32_t i = 0; i < inst.operandCount; i++)
+            {
+                // Declared as cb#[size].
+                uint32_t size = first[i].indexDim == 2 ? (uint32_t)first[i].index[1].value : 0;
+                add(checker, checker.findings, LINT_DYNAMIC_CONSTANT_BUFFER, inst, register_of(first[i]), size);
+            }
+        }
+        break;
+    case D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP:
+        if (inst.dataCount >= 2)
+            add(checker, checker.findings, LINT_INDEXABLE_TEMP, inst, inst.data[0], inst.data[1]);
+        break;
+    case D3D10_SB_OPCODE_DCL_INPUT_PS:
+    case D3D10_SB_OPCODE_DCL_INPUT_PS_SIV:
+        if (is_sample_interpolation(inst.opcodeToken))
+        {
+            for (uint32_t i = 0; i < inst.operandCount; i++)
+                add(checker, checker.findings, LINT_SAMPLE_RATE_INPUT, inst, register_of(first[i]), 0);
+        }
+        break;
+    case D3D10_SB_OPCODE_DCL_INPUT_PS_SGV:
+    case D3D10_SB_OPCODE_DCL_INPUT_SGV:
+        for (uint32_t i = 0; i < inst.operandCount && i < inst.dataCount; i++)
+        {
+            if (DECODE_D3D10_SB_NAME(inst.data[i]) == D3D10_SB_NAME_SAMPLE_INDEX)
+                add(checker, checker.findings, LINT_SAMPLE_RATE_INPUT, inst, register_of(first[i]), 0);
+        }
+        break;
+    case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_TYPED:
+    case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW:
+    case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED:
+        if (inst.opcodeToken & D3D11_SB_GLOBALLY_COHERENT_ACCESS)
+        {
+            for (uint32_t i = 0; i < inst.operandCount; i++)
+                add(checker, checker.coherent, LINT_UNNEEDED_COHERENCE, inst, register_of(first[i]), 0);
+        }
+        break;
+    case D3D11_SB_OPCODE_SYNC:
+        if (inst.opcodeToken & D3D11_SB_SYNC_UNORDERED_ACCESS_VIEW_MEMORY_GLOBAL)
+            checker.global_fence = true;
+        break;
+    default:
+        if (cost_class_of(inst.opcode) == COST_CLASS_DOUBLE)
+            add(checker, checker.findings, LINT_DOUBLE_PRECISION, inst, 0, 0);
+        break;
+    }
+    checker.instructions++;
+}
+
+void lint_end(lint_checker& checker)
+{
+    if (checker.global_fence || checker.coherent.empty())
+        return;
+    // Both lists are in program order.
+    size_t middle = checker.findings.size();
+    checker.findings.insert(checker.findings.end(), checker.coherent.begin(), checker.coherent.end());
+    std::inplace_merge(checker.findings.begin(), checker.findings.begin() + middle, checker.findings.end(), by_instruction);
+}
@@ -0,0 +1,413 @@
+#include "liveness.h"
+
+namespace {
+
+uint32_t popcount64(uint64_t v)
+{
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (uint32_t)((v * 0x0101010101010101ull) >> 56);
+}
+
+// Registers with at least one live component, counting one per nibble.
+uint32_t count_registers(const uint64_t* set, uint32_t words)
+{
+    uint32_t count = 0;
+    for (uint32_t w = 0; w < words; w++)
+    {
+        uint64_t any = set[w] | set[w] >> 1 | set[w] >> 2 | set[w] >> 3;
+        count += popcount64(any & 0x1111111111111111ull);
+    }
+    return count;
+}
+
+bool is_call(const DecodedInstruction& inst)
+{
+    return inst.opcode == D3D10_SB_OPCODE_CALL || inst.opcode == D3D10_SB_OPCODE_CALLC;
+}
+
+// Sets hold four bits per r# register, then, from a word boundary, four bits per x# array.
+class analysis
+{
+public:
+    analysis(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands, const cfg& graph)
+        : instructions(instructions), count(count), operands(operands), graph(graph), temps(0), arrays(0)
+    {
+    }
+
+    bool run(temp_pressure& result)
+    {
+        if (!size_sets(result))
+            return false;
+        uint32_t blocks = (uint32_t)graph.blocks.size();
+        live_in.assign((size_t)blocks * words, 0);
+        live_out.assign((size_t)blocks * words, 0);
+        use.assign((size_t)blocks * words, 0);
+        def.assign((size_t)blocks * words, 0);
+        exit_live.assign(graph.functions.size() * words, 0);
+        has_call.assign(blocks, 0);
+        for (const cfg_call& call : graph.calls)
+        {
+            if (call.callee != CFG_NONE)
+                has_call[call.block] = 1;
+        }
+        for (uint32_t b = 0; b < blocks; b++)
+        {
+            const cfg_block& block = graph.blocks[b];
+            for (uint32_t i = block.end; i-- > block.first;)
+                step(&use[(size_t)b * words], instructions[i], &def[(size_t)b * words]);
+        }
+        solve_live();
+        if (arrays)
+            solve_written();
+        measure(result);
+        return true;
+    }
+
+private:
+    // Finds how many registers the sets need, and what the program declares.
+    bool size_sets(temp_pressure& result)
+    {
+        std::vector<uint32_t> function_temps(graph.functions.size(), 0);
+        std::vector<uint32_t> function_indexable(graph.functions.size(), 0);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const DecodedInstruction& inst = instructions[i];
+            uint32_t function = graph.blocks[graph.block_of[i]].function;
+            if (inst.opcode == D3D10_SB_OPCODE_DCL_TEMPS)
+            {
+                function_temps[function] = inst.data[0];
+            }
+            else if (inst.opcode == D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP)
+            {
+                function_indexable[function] += inst.data[1];
+                if (inst.data[0] < LIVENESS_MAX_REGISTERS)
+                {
+                    if (inst.data[0] >= array_size.size())
+                        array_size.resize(inst.data[0] + 1, 1);
+                    array_size[inst.data[0]] = inst.data[1] > array_size[inst.data[0]] ? inst.data[1] : array_size[inst.data[0]];
+                }
+            }
+            if (IsDeclaration(inst.opcode))
+                continue;
+            for (uint32_t o = 0; o < (uint32_t)inst.operandCount + inst.relativeCount; o++)
+            {
+                const DecodedOperand& operand = operands[inst.firstOperand + o];
+                if ((operand.type != D3D10_SB_OPERAND_TYPE_TEMP && operand.type != D3D10_SB_OPERAND_TYPE_INDEXABLE_TEMP)
+                    || operand.indexDim < 1)
+                    continue;
+                uint64_t index = operand.index[0].value;
+                if (index >= LIVENESS_MAX_REGISTERS)
+                    return false;
+                uint32_t& used = operand.type == D3D10_SB_OPERAND_TYPE_TEMP ? temps : arrays;
+                used = (uint32_t)index + 1 > used ? (uint32_t)index + 1 : used;
+            }
+        }
+        result.declared_temps = 0;
+        result.declared_indexable = 0;
+        for (size_t f = 0; f < graph.functions.size(); f++)
+        {
+            result.declared_temps = function_temps[f] > result.declared_temps ? function_temps[f] : result.declared_temps;
+            result.declared_indexable = function_indexable[f] > result.declared_indexable ? function_indexable[f] : result.declared_indexable;
+        }
+        if (array_size.size() < arrays)
+            array_size.resize(arrays, 1);
+        temp_words = (temps * 4 + 63) / 64;
+        array_base = temp_words * 64;
+        // At least one word, so that programs without temps need no special case.
+        words = temp_words + (arrays * 4 + 63) / 64;
+        words = words ? words : 1;
+        array_words = (arrays + 63) / 64;
+        return true;
+    }
+
+    // Moves live back over one instruction: destinations kill what they write of r#, then every
+    // source and index register is read. Kills are also added to killed if given.
+    void step(uint64_t* live, const DecodedInstruction& inst, uint64_t* killed = NULL) const
+    {
+        if (IsDeclaration(inst.opcode))
+            return;
+        const DecodedOperand* ops = operands + inst.firstOperand;
+        uint32_t destinations = DestinationCount(inst.opcode);
+        destinations = destinations < inst.operandCount ? destinations : inst.operandCount;
+        for (uint32_t o = 0; o < destinations; o++)
+        {
+            if (ops[o].type != D3D10_SB_OPERAND_TYPE_TEMP || ops[o].indexDim < 1 || ops[o].numComponents != 4
+                || ops[o].selectionMode != D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE)
+                continue;
+            uint32_t bit = (uint32_t)ops[o].index[0].value * 4;
+            live[bit / 64] &= ~((uint64_t)(ops[o].mask & 0xf) << (bit % 64));
+            if (killed)
+                killed[bit / 64] |= (uint64_t)(ops[o].mask & 0xf) << (bit % 64);
+        }
+        uint32_t positions = SourcePositions(inst, operands);
+        for (uint32_t o = destinations; o < inst.operandCount; o++)
+            read(live, ops[o], ComponentsRead(ops[o], positions));
+        for (uint32_t o = inst.operandCount; o < (uint32_t)inst.operandCount + inst.relativeCount; o++)
+            read(live, ops[o], ComponentsRead(ops[o], 1));
+    }
+
+    void read(uint64_t* live, const DecodedOperand& operand, uint32_t components) const
+    {
+        if (operand.indexDim < 1)
+            return;
+        uint32_t bit;
+        if (operand.type == D3D10_SB_OPERAND_TYPE_TEMP)
+            bit = (uint32_t)operand.index[0].value * 4;
+        else if (operand.type == D3D10_SB_OPERAND_TYPE_INDEXABLE_TEMP)
+            bit = array_base + (uint32_t)operand.index[0].value * 4;
+        else
+            return;
+        live[bit / 64] |= (uint64_t)(components & 0xf) << (bit % 64);
+    }
+
+    // Moves live back over a whole block, through the subroutines it calls. Whatever is live after
+    // a call is added to what the callee returns with; returns true if that grew.
+    bool walk_block(uint32_t b, uint64_t* live)
+    {
+        const cfg_block& block = graph.blocks[b];
+        bool grew = false;
+        for (uint32_t i = block.end; i-- > block.first;)
+        {
+            const DecodedInstruction& inst = instructions[i];
+            if (is_call(inst))
+                grew |= enter_call(i, live);
+            step(live, inst);
+        }
+        return grew;
+    }
+
+    bool enter_call(uint32_t instruction, uint64_t* live)
+    {
+        // Calls are recorded in program order.
+        uint32_t low = 0;
+        uint32_t high = (uint32_t)graph.calls.size();
+        while (low < high)
+        {
+            uint32_t middle = (low + high) / 2;
+            if (graph.calls[middle].instruction < instruction)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        uint32_t callee = low < graph.calls.size() && graph.calls[low].instruction == instruction ? graph.calls[low].callee : CFG_NONE;
+        if (callee == CFG_NONE || graph.functions[callee].first_block == graph.functions[callee].end_block)
+            return false;
+        bool grew = false;
+        uint64_t* returned = &exit_live[(size_t)callee * words];
+        const uint64_t* entry = &live_in[(size_t)graph.functions[callee].first_block * words];
+        for (uint32_t w = 0; w < words; w++)
+        {
+            grew |= (live[w] & ~returned[w]) != 0;
+            returned[w] |= live[w];
+            live[w] |= entry[w];
+        }
+        return grew;
+    }
+
+    // Backward fixed point. Blocks are visited last to first, which follows most edges of
+    // structured code in one pass; each loop level and each call needs one more.
+    void solve_live()
+    {
+        uint32_t blocks = (uint32_t)graph.blocks.size();
+        std::vector<uint64_t> live(words);
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (uint32_t b = blocks; b-- > 0;)
+            {
+                const cfg_block& block = graph.blocks[b];
+                uint64_t* out = &live_out[(size_t)b * words];
+                uint64_t* in = &live_in[(size_t)b * words];
+                for (uint32_t e = block.first_successor; e < block.first_successor + block.successor_count; e++)
+                {
+                    const uint64_t* successor = &live_in[(size_t)graph.successors[e].to * words];
+                    for (uint32_t w = 0; w < words; w++)
+                        out[w] |= successor[w];
+                }
+                if (block.flags & CFG_BLOCK_EXIT)
+                {
+                    const uint64_t* returned = &exit_live[(size_t)block.function * words];
+                    for (uint32_t w = 0; w < words; w++)
+                        out[w] |= returned[w];
+                }
+                if (has_call[b])
+                {
+                    live.assign(out, out + words);
+                    changed |= walk_block(b, &live[0]);
+                }
+                else
+                {
+                    const uint64_t* u = &use[(size_t)b * words];
+                    const uint64_t* d = &def[(size_t)b * words];
+                    for (uint32_t w = 0; w < words; w++)
+                        live[w] = u[w] | (out[w] & ~d[w]);
+                }
+                for (uint32_t w = 0; w < words; w++)
+                {
+                    changed |= (live[w] & ~in[w]) != 0;
+                    in[w] |= live[w];
+                }
+            }
+        }
+    }
+
+    // Adds the x# arrays an instruction may write to written. Calls may write any of them.
+    void write_arrays(const DecodedInstruction& inst, uint64_t* written) const
+    {
+        if (is_call(inst) || inst.opcode == D3D11_SB_OPCODE_INTERFACE_CALL)
+        {
+            for (uint32_t w = 0; w < array_words; w++)
+                written[w] = ~0ull;
+            return;
+        }
+        if (IsDeclaration(inst.opcode))
+            return;
+        uint32_t destinations = DestinationCount(inst.opcode);
+        for (uint32_t o = 0; o < destinations && o < inst.operandCount; o++)
+        {
+            const DecodedOperand& operand = operands[inst.firstOperand + o];
+            if (operand.type == D3D10_SB_OPERAND_TYPE_INDEXABLE_TEMP && operand.indexDim >= 1)
+                written[operand.index[0].value / 64] |= 1ull << (operand.index[0].value % 64);
+        }
+    }
+
+    // Forward fixed point of the arrays that may have been written, kept per instruction as the
+    // state after it. Subroutines may be entered with any array written.
+    void solve_written()
+    {
+        uint32_t blocks = (uint32_t)graph.blocks.size();
+        std::vector<uint64_t> out((size_t)blocks * array_words, 0);
+        std::vector<uint64_t> state(array_words);
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (uint32_t b = 0; b < blocks; b++)
+            {
+                enter_block(b, out, &state[0]);
+                for (uint32_t i = graph.blocks[b].first; i < graph.blocks[b].end; i++)
+                    write_arrays(instructions[i], &state[0]);
+                for (uint32_t w = 0; w < array_words; w++)
+                {
+                    changed |= (state[w] & ~out[(size_t)b * array_words + w]) != 0;
+                    out[(size_t)b * array_words + w] |= state[w];
+                }
+            }
+        }
+        written.assign((size_t)count * array_words, 0);
+        for (uint32_t b = 0; b < blocks; b++)
+        {
+            enter_block(b, out, &state[0]);
+            for (uint32_t i = graph.blocks[b].first; i < graph.blocks[b].end; i++)
+            {
+                write_arrays(instructions[i], &state[0]);
+                for (uint32_t w = 0; w < array_words; w++)
+                    written[(size_t)i * array_words + w] = state[w];
+            }
+        }
+    }
+
+    void enter_block(uint32_t b, const std::vector<uint64_t>& out, uint64_t* state) const
+    {
+        const cfg_block& block = graph.blocks[b];
+        const cfg_function& function = graph.functions[block.function];
+        bool subroutine_entry = function.kind == CFG_FUNCTION_SUBROUTINE && function.first_block == b;
+        for (uint32_t w = 0; w < array_words; w++)
+            state[w] = subroutine_entry ? ~0ull : 0;
+        for (uint32_t e = block.first_predecessor; e < block.first_predecessor + block.predecessor_count; e++)
+        {
+            for (uint32_t w = 0; w < array_words; w++)
+                state[w] |= out[(size_t)graph.predecessors[e].from * array_words + w];
+        }
+    }
+
+    // Counts at every instruction from the solved sets.
+    void measure(temp_pressure& result)
+    {
+        result.peak_temps = 0;
+        result.peak_components = 0;
+        result.peak_indexable = 0;
+        result.peak_instruction = CFG_NONE;
+        result.live_temps.assign(count, 0);
+        std::vector<uint64_t> live(words);
+        std::vector<uint64_t> after(words);
+        for (uint32_t b = 0; b < (uint32_t)graph.blocks.size(); b++)
+        {
+            const cfg_block& block = graph.blocks[b];
+            live.assign(&live_out[(size_t)b * words], &live_out[(size_t)b * words] + words);
+            for (uint32_t i = block.end; i-- > block.first;)
+            {
+                after = live;
+                if (is_call(instructions[i]))
+                    enter_call(i, &live[0]);
+                step(&live[0], instructions[i]);
+                if (IsDeclaration(instructions[i].opcode))
+                    continue;
+
+                uint32_t before_registers = count_registers(&live[0], temp_words);
+                uint32_t after_registers = count_registers(&after[0], temp_words);
+                uint32_t registers = before_registers > after_registers ? before_registers : after_registers;
+                uint32_t before_components = 0;
+                uint32_t after_components = 0;
+                for (uint32_t w = 0; w < temp_words; w++)
+                {
+                    before_components += popcount64(live[w]);
+                    after_components += popcount64(after[w]);
+                }
+                uint32_t components = before_components > after_components ? before_components : after_components;
+                result.live_temps[i] = (uint16_t)registers;
+                result.peak_temps = registers > result.peak_temps ? registers : result.peak_temps;
+                result.peak_components = components > result.peak_components ? components : result.peak_components;
+
+                uint32_t indexable = 0;
+                for (uint32_t a = 0; a < arrays; a++)
+                {
+                    uint32_t bit = array_base + a * 4;
+                    bool is_live = ((live[bit / 64] | after[bit / 64]) >> (bit % 64)) & 0xf;
+                    if (is_live && (written[(size_t)i * array_words + a / 64] >> (a % 64)) & 1)
+                        indexable += array_size[a];
+                }
+                result.peak_indexable = indexable > result.peak_indexable ? indexable : result.peak_indexable;
+            }
+        }
+        for (uint32_t i = 0; i < count && result.peak_temps; i++)
+        {
+            if (result.live_temps[i] == result.peak_temps)
+            {
+                result.peak_instruction = i;
+                break;
+            }
+        }
+    }
+
+    const DecodedInstruction* instructions;
+    uint32_t count;
+    const DecodedOperand* operands;
+    const cfg& graph;
+    uint32_t temps;
+    uint32_t arrays;
+    uint32_t temp_words;
+    uint32_t array_base;
+    uint32_t words;
+    uint32_t array_words;
+    std::vector<uint32_t> array_size;
+    std::vector<uint64_t> live_in;
+    std::vector<uint64_t> live_out;
+    std::vector<uint64_t> use;
+    std::vector<uint64_t> def;
+    std::vector<uint64_t> exit_live;
+    std::vector<uint8_t> has_call;
+    std::vector<uint64_t> written;
+};
+
+} // namespace
+
+bool liveness_analyze(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, temp_pressure& result)
+{
+    analysis run(instructions, count, operands, graph);
+    return run.run(result);
+}
@@ -0,0 +1,167 @@
+#include "occupancy.h"
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "profile_text.h"
+
+const char* occupancy_limit_text[] = {
+    "waves",
+    "registers",
+    "lds",
+    "groups",
+};
+
+namespace {
+
+struct profile_setting
+{
+    const char* name;
+    uint32_t hardware_profile::* value;
+};
+
+const profile_setting ProfileSettings[] = {
+    { "wave_width", &hardware_profile::wave_width },
+    { "simds_per_cu", &hardware_profile::simds_per_cu },
+    { "max_waves_per_simd", &hardware_profile::max_waves_per_simd },
+    { "registers_per_simd", &hardware_profile::registers_per_simd },
+    { "register_granularity", &hardware_profile::register_granularity },
+    { "max_registers_per_thread", &hardware_profile::max_registers_per_thread },
+    { "lds_per_cu", &hardware_profile::lds_per_cu },
+    { "lds_granularity", &hardware_profile::lds_granularity },
+    { "max_groups_per_cu", &hardware_profile::max_groups_per_cu },
+    { "lds_banks", &hardware_profile::lds_banks },
+    { "cache_line_bytes", &hardware_profile::cache_line_bytes },
+};
+
+bool parse_positive(const std::string& word, uint32_t& value)
+{
+    char* end;
+    unsigned long parsed = strtoul(word.c_str(), &end, 10);
+    if (end == word.c_str() || *end != 0 || word[0] == '-' || parsed == 0 || parsed > 0xffffffffu)
+        return false;
+    value = (uint32_t)parsed;
+    return true;
+}
+
+uint64_t round_up(uint64_t value, uint64_t granularity)
+{
+    return (value + granularity - 1) / granularity * granularity;
+}
+
+} // namespace
+
+void hardware_profile_default(hardware_profile& profile)
+{
+    profile.name = "default";
+    profile.wave_width = 64;
+    profile.simds_per_cu = 4;
+    profile.max_waves_per_simd = 10;
+    profile.registers_per_simd = 256;
+    profile.register_granularity = 4;
+    profile.max_registers_per_thread = 256;
+    profile.lds_per_cu = 65536;
+    profile.lds_granularity = 512;
+    profile.max_groups_per_cu = 16;
+    profile.lds_banks = 32;
+    profile.cache_line_bytes = 64;
+}
+
+bool hardware_profile_parse(const char* text, size_t size, hardware_profile& profile, uint32_t& error_line)
+{
+    const char* end = text + size;
+    error_line = 0;
+    std::string words[2];
+    for (const char* line = text; line < end; )
+    {
+        const char* line_end = (const char*)memchr(line, '\n', end - line);
+        if (!line_end)
+            line_end = end;
+        error_line++;
+        uint32_t count = profile_split_words(line, line_end, words, 2);
+        line = line_end + 1;
+
+        if (count == 0)
+            continue;
+        if (count != 2)
+            return false;
+        if (words[0] == "name")
+        {
+            profile.name = words[1];
+            continue;
+        }
+        const profile_setting* setting = NULL;
+        for (const profile_setting& s : ProfileSettings)
+        {
+            if (words[0] == s.name)
+                setting = &s;
+        }
+        if (!setting || !parse_positive(words[1], profile.*setting->value))
+            return false;
+    }
+    error_line = 0;
+    return true;
+}
+
+bool occupancy_estimate_program(const DecodedInstruction* instructions, uint32_t count, const hardware_profile& profile,
+    occupancy_estimate& result)
+{
+    bool compute = false;
+    result.temps = 0;
+    result.indexable_registers = 0;
+    result.tgsm_bytes = 0;
+    uint64_t indexable = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const DecodedInstruction& inst = instructions[i];
+        switch (inst.opcode)
+        {
+        case D3D11_SB_OPCODE_DCL_THREAD_GROUP:
+            compute = inst.dataCount == 3;
+            memcpy(result.group, inst.data, sizeof(result.group));
+            break;
+        case D3D10_SB_OPCODE_DCL_TEMPS:
+            result.temps = std::max(result.temps, inst.data[0]);
+            break;
+        case D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP:
+            indexable += (uint64_t)inst.data[1] * std::min(inst.data[2], 4u);
+            break;
+        case D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_RAW:
+            for (uint32_t d = 0; d < inst.dataCount; d++)
+                result.tgsm_bytes += inst.data[d];
+            break;
+        case D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_STRUCTURED:
+            for (uint32_t d = 0; d + 1 < inst.dataCount; d += 2)
+                result.tgsm_bytes += (uint64_t)inst.data[d] * inst.data[d + 1];
+            break;
+        default:
+            break;
+        }
+    }
+    if (!compute)
+        return false;
+
+    const uint64_t wave_width = profile.wave_width;
+    result.threads = (uint64_t)result.group[0] * result.group[1] * result.group[2];
+    result.waves_per_group = (result.threads + wave_width - 1) / wave_width;
+    result.partial_wave = result.threads % wave_width != 0;
+    result.lane_utilization = result.waves_per_group ? (double)result.threads / (result.waves_per_group * wave_width) : 0;
+
+    result.indexable_registers = (uint32_t)std::min<uint64_t>(indexable, 0xffffffffu);
+    uint64_t registers = round_up(std::max<uint64_t>(4ull * result.temps + indexable, 1), profile.register_granularity);
+    result.registers = (uint32_t)std::min<uint64_t>(registers, profile.max_registers_per_thread);
+    result.register_waves = std::min(profile.registers_per_simd / result.registers, profile.max_waves_per_simd);
+
+    // Groups are resident whole, so each bound counts groups per compute unit.
+    uint64_t waves = result.waves_per_group ? result.waves_per_group : 1;
+    uint64_t by_slots = (uint64_t)profile.simds_per_cu * profile.max_waves_per_simd / waves;
+    uint64_t by_registers = (uint64_t)profile.simds_per_cu * result.register_waves / waves;
+    uint64_t by_lds = result.tgsm_bytes ? profile.lds_per_cu / round_up(result.tgsm_bytes, profile.lds_granularity) : UINT64_MAX;
+    result.groups_per_cu = std::min(std::min(by_slots, by_registers), std::min(by_lds, (uint64_t)profile.max_groups_per_cu));
+    result.limit = result.groups_per_cu == by_registers && by_registers < by_slots ? OCCUPANCY_LIMIT_REGISTERS
+        : result.groups_per_cu == by_lds ? OCCUPANCY_LIMIT_LDS
+        : result.groups_per_cu == profile.max_groups_per_cu && profile.max_groups_per_cu < by_slots ? OCCUPANCY_LIMIT_GROUPS
+        : OCCUPANCY_LIMIT_WAVES;
+    result.waves_per_simd = (double)(result.groups_per_cu * result.waves_per_group) / profile.simds_per_cu;
+    result.occupancy = result.waves_per_simd / profile.max_waves_per_simd;
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef PROFILE_TEXT_H_
+#define PROFILE_TEXT_H_
+
+// Line splitting shared by the cost and hardware profile parsers.
+
+#include <stdint.h>
+#include <string>
+
+inline bool profile_is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Splits a line into at most max words, ignoring a comment. Returns the word count, or max + 1 if
+// there are more.
+inline uint32_t profile_split_words(const char* line, const char* end, std::string* words, uint32_t max)
+{
+    uint32_t count = 0;
+    const char* p = line;
+    for (;;)
+    {
+        while (p < end && profile_is_space(*p))
+            p++;
+        if (p == end || *p == '#')
+            return count;
+        const char* start = p;
+        while (p < end && !profile_is_space(*p) && *p != '#')
+            p++;
+        if (count == max)
+            return max + 1;
+        words[count++].assign(start, p);
+    }
+}
+
+#endif /* PROFILE_TEXT_H_ */
@@ -0,0 +1,269 @@
+#include "shader_pack.h"
+#include "dxbc.h"
+#include "D3D11TokenParser.h"
+#include <string.h>
+#include <algorithm>
+
+static_assert(sizeof(shader_pack_header) % 8 == 0 && sizeof(shader_pack_record) % 8 == 0,
+    "pack tables must keep each other aligned");
+
+namespace {
+
+const uint32_t record_sizes = (uint32_t)(sizeof(shader_pack_record) | sizeof(shader_pack_binding) << 16);
+
+inline uint64_t align(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+shader_pack_binding make_binding(uint32_t kind, uint32_t dimension, const DecodedOperand& operand, uint32_t size)
+{
+    shader_pack_binding binding;
+    memset(&binding, 0, sizeof(binding));
+    binding.kind = (uint8_t)kind;
+    binding.dimension = (uint8_t)dimension;
+    binding.slot = operand.indexDim ? (uint32_t)operand.index[0].value : 0;
+    binding.size = size;
+    return binding;
+}
+
+// Fills in the program version, thread group size and bindings from the program's declarations.
+bool describe_program(const uint32_t* tokens, uint32_t size, shader_pack_record& record,
+    std::vector<shader_pack_binding>& bindings)
+{
+    TokenDecoder decoder(tokens, size);
+    if (decoder.DecodeHeader() != DECODE_STATUS::OK)
+        return false;
+    record.program_version = decoder.Version();
+
+    DecodedOperandPool operands;
+    DecodedInstruction inst;
+    DECODE_STATUS status;
+    while ((status = decoder.Next(inst, operands)) == DECODE_STATUS::OK)
+    {
+        const DecodedOperand* first = operands.data() + inst.firstOperand;
+        uint32_t dimension = DECODE_D3D10_SB_RESOURCE_DIMENSION(inst.opcodeToken);
+        for (uint32_t i = 0; i < inst.operandCount; i++)
+        {
+            switch (inst.opcode)
+            {
+            case D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER:
+                bindings.push_back(make_binding(SHADER_PACK_BINDING_CONSTANT_BUFFER, 0, first[i],
+                    first[i].indexDim > 1 ? (uint32_t)first[i].index[1].value : 0));
+                break;
+            case D3D10_SB_OPCODE_DCL_SAMPLER:
+                bindings.push_back(make_binding(SHADER_PACK_BINDING_SAMPLER, 0, first[i], 0));
+                break;
+            case D3D10_SB_OPCODE_DCL_RESOURCE:
+                bindings.push_back(make_binding(SHADER_PACK_BINDING_RESOURCE, dimension, first[i], 0));
+                break;
+            case D3D11_SB_OPCODE_DCL_RESOURCE_RAW:
+                bindings.push_back(make_binding(SHADER_PACK_BINDING_RESOURCE, D3D11_SB_RESOURCE_DIMENSION_RAW_BUFFER, first[i], 0));
+                break;
+            case D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED:
+                bindings.push_back(make_binding(SHADER_PACK_BINDING_RESOURCE, D3D11_SB_RESOURCE_DIMENSION_STRUCTURED_BUFFER, first[i], inst.data[i]));
+                break;
+            case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_TYPED:
+                bindings.push_back(make_binding(SHADER_PACK_BINDING_UAV, dimension, first[i], 0));
+                break;
+            case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW:
+                bindings.push_back(make_binding(SHADER_PACK_BINDING_UAV, D3D11_SB_RESOURCE_DIMENSION_RAW_BUFFER, first[i], 0));
+                break;
+            case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED:
+                bindings.push_back(make_binding(SHADER_PACK_BINDING_UAV, D3D11_SB_RESOURCE_DIMENSION_STRUCTURED_BUFFER, first[i], inst.data[i]));
+                break;
+            default:
+                break;
+            }
+        }
+        if (inst.opcode == D3D11_SB_OPCODE_DCL_THREAD_GROUP)
+            memcpy(record.thread_group, inst.data, sizeof(record.thread_group));
+        operands.clear();
+    }
+    return status == DECODE_STATUS::END;
+}
+
+uint64_t chunk_hash(const dxbc_chunk_header* chunk)
+{
+    return chunk ? shader_pack_hash(chunk + 1, bswap_le32(chunk->size)) : 0;
+}
+
+} // namespace
+
+uint64_t shader_pack_hash(const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+shader_pack_status shader_pack_writer::add(const void* data, size_t size, const char* name, uint64_t& hash)
+{
+    hash = shader_pack_hash(data, size);
+    std::map<uint64_t, size_t>::const_iterator found = by_hash.find(hash);
+    if (found != by_hash.end())
+    {
+        const std::vector<char>& payload = shaders[found->second].payload;
+        return payload.size() == size && !memcmp(&payload[0], data, size) ? SHADER_PACK_DUPLICATE : SHADER_PACK_COLLISION;
+    }
+
+    // The container is validated whole before any chunk in it is looked at.
+    if (size > 0x7fffffff)
+        return SHADER_PACK_INVALID;
+    dxbc_container* container = dxbc_parse(data, (int)size);
+    if (!container)
+        return SHADER_PACK_INVALID;
+    delete container;
+    dxbc_chunk_header* program = dxbc_find_shader_bytecode(data, (int)size);
+    if (!program)
+        return SHADER_PACK_INVALID;
+
+    shader s;
+    memset(&s.record, 0, sizeof(s.record));
+    if (!describe_program((const uint32_t*)(program + 1), bswap_le32(program->size), s.record, s.bindings))
+        return SHADER_PACK_INVALID;
+    s.record.hash = hash;
+    s.record.payload_size = (uint32_t)size;
+    for (unsigned kind = DXBC_FIND_INPUT_SIGNATURE; kind <= DXBC_FIND_PATCH_SIGNATURE; kind++)
+        s.record.signature_hashes[kind] = chunk_hash(dxbc_find_signature(data, (int)size, kind));
+    s.payload.assign((const char*)data, (const char*)data + size);
+    s.name = name;
+
+    by_hash[hash] = shaders.size();
+    shaders.push_back(std::move(s));
+    return SHADER_PACK_ADDED;
+}
+
+bool shader_pack_writer::write(std::ostream& out) const
+{
+    // by_hash is ordered, so walking it gives the index order; payloads keep the order of adding.
+    shader_pack_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SHADER_PACK_MAGIC;
+    header.version = SHADER_PACK_VERSION;
+    header.header_size = sizeof(shader_pack_header);
+    header.record_sizes = record_sizes;
+    header.page_size = SHADER_PACK_PAGE_SIZE;
+    header.shader_count = (uint32_t)shaders.size();
+
+    uint64_t binding_count = 0;
+    uint64_t names_size = 0;
+    for (const shader& s : shaders)
+    {
+        binding_count += s.bindings.size();
+        names_size += s.name.size();
+    }
+    if (binding_count > UINT32_MAX || names_size > UINT32_MAX)
+        return false;
+    header.binding_count = (uint32_t)binding_count;
+    header.names_size = (uint32_t)names_size;
+    header.hashes_offset = sizeof(shader_pack_header);
+    header.records_offset = header.hashes_offset + shaders.size() * sizeof(uint64_t);
+    header.bindings_offset = header.records_offset + shaders.size() * sizeof(shader_pack_record);
+    header.names_offset = header.bindings_offset + binding_count * sizeof(shader_pack_binding);
+
+    std::vector<uint64_t> payload_offsets(shaders.size());
+    std::vector<uint32_t> first_bindings(shaders.size());
+    std::vector<uint32_t> name_offsets(shaders.size());
+    uint64_t offset = header.names_offset + names_size;
+    uint32_t binding = 0;
+    uint32_t name = 0;
+    for (size_t i = 0; i < shaders.size(); i++)
+    {
+        offset = align(offset, SHADER_PACK_PAGE_SIZE);
+        payload_offsets[i] = offset;
+        offset += shaders[i].payload.size();
+        first_bindings[i] = binding;
+        binding += (uint32_t)shaders[i].bindings.size();
+        name_offsets[i] = name;
+        name += (uint32_t)shaders[i].name.size();
+    }
+    header.total_size = offset;
+
+    out.write((const char*)&header, sizeof(header));
+    for (const auto& entry : by_hash)
+        out.write((const char*)&entry.first, sizeof(entry.first));
+    for (const auto& entry : by_hash)
+    {
+        shader_pack_record record = shaders[entry.second].record;
+        record.payload_offset = payload_offsets[entry.second];
+        record.first_binding = first_bindings[entry.second];
+        record.binding_count = (uint32_t)shaders[entry.second].bindings.size();
+        record.name_offset = name_offsets[entry.second];
+        record.name_size = (uint32_t)shaders[entry.second].name.size();
+        out.write((const char*)&record, sizeof(record));
+    }
+    for (const shader& s : shaders)
+    {
+        if (!s.bindings.empty())
+            out.write((const char*)&s.bindings[0], s.bindings.size() * sizeof(shader_pack_binding));
+    }
+    for (const shader& s : shaders)
+        out.write(s.name.data(), s.name.size());
+
+    static const char padding[SHADER_PACK_PAGE_SIZE] = {};
+    uint64_t position = header.names_offset + names_size;
+    for (size_t i = 0; i < shaders.size(); i++)
+    {
+        out.write(padding, (std::streamsize)(payload_offsets[i] - position));
+        out.write(&shaders[i].payload[0], shaders[i].payload.size());
+        position = payload_offsets[i] + shaders[i].payload.size();
+    }
+    return !out.fail();
+}
+
+const shader_pack_header* shader_pack_open(const void* data, size_t size)
+{
+    const shader_pack_header* pack = (const shader_pack_header*)data;
+    if (((uintptr_t)data & 7) || size < sizeof(shader_pack_header))
+        return NULL;
+    if (pack->magic != SHADER_PACK_MAGIC || pack->version != SHADER_PACK_VERSION
+        || pack->header_size != sizeof(shader_pack_header) || pack->record_sizes != record_sizes
+        || pack->total_size != size)
+        return NULL;
+    if (pack->page_size < 8 || (pack->page_size & (pack->page_size - 1)))
+        return NULL;
+
+    // The tables must start aligned, in order, and fit before the next one; payloads come after.
+    uint64_t hashes_end = pack->hashes_offset + (uint64_t)pack->shader_count * sizeof(uint64_t);
+    uint64_t records_end = pack->records_offset + (uint64_t)pack->shader_count * sizeof(shader_pack_record);
+    uint64_t bindings_end = pack->bindings_offset + (uint64_t)pack->binding_count * sizeof(shader_pack_binding);
+    uint64_t names_end = pack->names_offset + (uint64_t)pack->names_size;
+    if (((pack->hashes_offset | pack->records_offset) & 7) || (pack->bindings_offset & 3))
+        return NULL;
+    if (pack->hashes_offset < sizeof(shader_pack_header) || pack->hashes_offset > size
+        || hashes_end > pack->records_offset || records_end > pack->bindings_offset
+        || bindings_end > pack->names_offset || names_end > size)
+        return NULL;
+
+    const uint64_t* hashes = shader_pack_hashes(pack);
+    const shader_pack_record* records = shader_pack_records(pack);
+    for (uint32_t i = 0; i < pack->shader_count; i++)
+    {
+        const shader_pack_record& r = records[i];
+        if (r.hash != hashes[i] || (i && hashes[i - 1] >= hashes[i]))
+            return NULL;
+        if ((r.payload_offset & (pack->page_size - 1)) || r.payload_offset < names_end
+            || r.payload_offset > size || r.payload_size > size - r.payload_offset)
+            return NULL;
+        if ((uint64_t)r.first_binding + r.binding_count > pack->binding_count
+            || (uint64_t)r.name_offset + r.name_size > pack->names_size)
+            return NULL;
+    }
+    return pack;
+}
+
+const shader_pack_record* shader_pack_find(const shader_pack_header* pack, uint64_t hash)
+{
+    const uint64_t* hashes = shader_pack_hashes(pack);
+    const uint64_t* end = hashes + pack->shader_count;
+    const uint64_t* found = std::lower_bound(hashes, end, hash);
+    if (found == end || *found != hash)
+        return NULL;
+    return shader_pack_records(pack) + (found - hashes);
+}
@@ -0,0 +1,219 @@
+#include "tgsm_banks.h"
+#include "thread_affine.h"
+#include <string.h>
+#include <algorithm>
+
+namespace {
+
+#define NO_OPERAND 0xffffffffu
+// The largest thread group Direct3D allows; larger declarations are only counted this far.
+#define MAX_GROUP_THREADS 1024u
+
+bool is_access(D3D10_SB_OPCODE_TYPE opcode)
+{
+    return opcode == D3D11_SB_OPCODE_LD_STRUCTURED || opcode == D3D11_SB_OPCODE_STORE_STRUCTURED
+        || opcode == D3D11_SB_OPCODE_LD_RAW || opcode == D3D11_SB_OPCODE_STORE_RAW;
+}
+
+// Where an access's g# and address operands are.
+struct access_operands
+{
+    uint32_t memory;
+    uint32_t index;             // byte address for raw accesses
+    uint32_t offset;            // NO_OPERAND for raw accesses
+};
+
+access_operands operands_of(D3D10_SB_OPCODE_TYPE opcode)
+{
+    switch (opcode)
+    {
+    case D3D11_SB_OPCODE_LD_STRUCTURED:
+        return { 3, 1, 2 };
+    case D3D11_SB_OPCODE_STORE_STRUCTURED:
+        return { 0, 1, 2 };
+    case D3D11_SB_OPCODE_LD_RAW:
+        return { 2, 1, NO_OPERAND };
+    default:
+        return { 0, 1, NO_OPERAND };
+    }
+}
+
+// Declared g# memory.
+struct tgsm_declaration
+{
+    uint32_t reg;
+    uint32_t stride;            // 0 for raw
+};
+
+uint32_t register_of(const DecodedOperand& operand)
+{
+    return operand.indexDim ? (uint32_t)operand.index[0].value : 0;
+}
+
+bool worse(const tgsm_access& a, const tgsm_access& b)
+{
+    return a.resolved != b.resolved ? a.resolved : a.ways > b.ways;
+}
+
+class analysis
+{
+public:
+    analysis(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands, const cfg& graph,
+        const hardware_profile& profile, tgsm_bank_report& result)
+        : instructions(instructions), count(count), operands(operands), graph(graph), profile(profile), result(result)
+    {
+    }
+
+    bool run()
+    {
+        result.accesses.clear();
+        bool compute = false;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const DecodedInstruction& inst = instructions[i];
+            const DecodedOperand* ops = operands + inst.firstOperand;
+            if (inst.opcode == D3D11_SB_OPCODE_DCL_THREAD_GROUP)
+            {
+                compute = inst.dataCount == 3 && inst.data[0] && inst.data[1] && inst.data[2];
+                memcpy(result.group, inst.data, sizeof(result.group));
+            }
+            else if (inst.opcode == D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_RAW && inst.operandCount >= 1)
+            {
+                tgsm_declaration d = { register_of(ops[0]), 0 };
+                declarations.push_back(d);
+            }
+            else if (inst.opcode == D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_STRUCTURED && inst.operandCount >= 1
+                && inst.dataCount >= 2)
+            {
+                tgsm_declaration d = { register_of(ops[0]), inst.data[0] };
+                declarations.push_back(d);
+            }
+            else if (is_access(inst.opcode))
+            {
+                access_operands a = operands_of(inst.opcode);
+                uint32_t needed = std::max(a.memory, a.offset != NO_OPERAND ? a.offset : a.index) + 1;
+                if (inst.operandCount < needed || ops[a.memory].type != D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY)
+                    continue;
+                thread_affine_query q = { i, a.index };
+                queries.push_back(q);
+                q.operand = a.offset != NO_OPERAND ? a.offset : a.index;
+                queries.push_back(q);
+            }
+        }
+        if (!compute)
+            return true;
+        uint64_t threads = (uint64_t)result.group[0] * result.group[1] * result.group[2];
+        group_threads = (uint32_t)std::min<uint64_t>(threads, MAX_GROUP_THREADS);
+        result.lanes = std::min(std::min(profile.wave_width, profile.lds_banks), MAX_GROUP_THREADS);
+
+        if (!thread_affine_solve(instructions, count, operands, graph, result.group, queries, values))
+            return false;
+        for (size_t q = 0; q < queries.size(); q += 2)
+            record_access(queries[q].instruction, values[q], values[q + 1]);
+        std::stable_sort(result.accesses.begin(), result.accesses.end(), worse);
+        return true;
+    }
+
+private:
+    const tgsm_declaration* declaration_of(uint32_t reg) const
+    {
+        for (const tgsm_declaration& d : declarations)
+        {
+            if (d.reg == reg)
+                return &d;
+        }
+        return NULL;
+    }
+
+    void record_access(uint32_t i, const thread_affine& index, const thread_affine& offset)
+    {
+        const DecodedInstruction& inst = instructions[i];
+        access_operands a = operands_of(inst.opcode);
+        tgsm_access access;
+        memset(&access, 0, sizeof(access));
+        access.instruction = i;
+        access.reg = register_of(operands[inst.firstOperand + a.memory]);
+        const tgsm_declaration* declaration = declaration_of(access.reg);
+        thread_affine address = index;
+        if (a.offset != NO_OPERAND)
+        {
+            // Structured memory is addressed by structure and byte offset.
+            access.element_stride = declaration ? declaration->stride : 0;
+            address = declaration && declaration->stride
+                ? thread_affine_add(thread_affine_scale(index, declaration->stride), offset)
+                : thread_affine_make(THREAD_AFFINE_UNKNOWN, 0, 0, 0, 0);
+        }
+        else if (declaration && declaration->stride)
+        {
+            address = thread_affine_make(THREAD_AFFINE_UNKNOWN, 0, 0, 0, 0);
+        }
+        access.resolved = declaration && thread_affine_known(address);
+        if (access.resolved)
+        {
+            access.uniform_offset = address.kind == THREAD_AFFINE_UNIFORM;
+            access.offset = address.constant;
+            // A dimension the group has one thread in adds nothing.
+            for (uint32_t c = 0; c < 3; c++)
+                access.lane_stride[c] = result.group[c] > 1 ? address.k[c] : 0;
+            count_ways(access);
+        }
+        result.accesses.push_back(access);
+    }
+
+    // Finds the lanes served together that reach the most distinct dwords of one bank.
+    void count_ways(tgsm_access& access)
+    {
+        const uint32_t* group = result.group;
+        access.ways = 0;
+        for (uint32_t first = 0; first < group_threads; first += result.lanes)
+        {
+            dwords.clear();
+            for (uint32_t t = first; t < first + result.lanes && t < group_threads; t++)
+            {
+                uint32_t x = t % group[0];
+                uint32_t y = t / group[0] % group[1];
+                uint32_t z = t / group[0] / group[1];
+                uint32_t address = access.offset + access.lane_stride[0] * x + access.lane_stride[1] * y
+                    + access.lane_stride[2] * z;
+                dwords.push_back(address >> 2);
+            }
+            std::sort(dwords.begin(), dwords.end());
+            dwords.erase(std::unique(dwords.begin(), dwords.end()), dwords.end());
+            for (uint32_t& d : dwords)
+                d %= profile.lds_banks;
+            std::sort(dwords.begin(), dwords.end());
+            uint32_t ways = 0;
+            for (size_t d = 0, run = 0; d < dwords.size(); d++)
+            {
+                run = d && dwords[d] == dwords[d - 1] ? run + 1 : 1;
+                ways = std::max(ways, (uint32_t)run);
+            }
+            if (ways > access.ways)
+            {
+                access.ways = ways;
+                access.worst_thread = first;
+            }
+        }
+    }
+
+    const DecodedInstruction* instructions;
+    uint32_t count;
+    const DecodedOperand* operands;
+    const cfg& graph;
+    const hardware_profile& profile;
+    tgsm_bank_report& result;
+    uint32_t group_threads;             // threads of a group that are looked at
+    std::vector<tgsm_declaration> declarations;
+    std::vector<thread_affine_query> queries;   // index and offset of each access, or its address twice
+    std::vector<thread_affine> values;
+    std::vector<uint32_t> dwords;
+};
+
+} // namespace
+
+bool tgsm_banks_analyze(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, const hardware_profile& profile, tgsm_bank_report& result)
+{
+    analysis run(instructions, count, operands, graph, profile, result);
+    return run.run();
+}
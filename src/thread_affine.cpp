@@ -0,0 +1,489 @@
+#include "thread_affine.h"
+#include "cost_model.h"
+#include <string.h>
+#include <algorithm>
+
+#define NO_SLOT 0xffffffffu
+
+thread_affine thread_affine_make(uint32_t kind, uint32_t constant, uint32_t x, uint32_t y, uint32_t z)
+{
+    thread_affine value = { kind, kind == THREAD_AFFINE_EXACT ? constant : 0, { x, y, z } };
+    if (!thread_affine_known(value))
+        memset(value.k, 0, sizeof(value.k));
+    return value;
+}
+
+namespace {
+
+thread_affine unknown()
+{
+    return thread_affine_make(THREAD_AFFINE_UNKNOWN, 0, 0, 0, 0);
+}
+
+thread_affine unreached()
+{
+    return thread_affine_make(THREAD_AFFINE_UNREACHED, 0, 0, 0, 0);
+}
+
+bool is_uniform(const thread_affine& value)
+{
+    return thread_affine_known(value) && !value.k[0] && !value.k[1] && !value.k[2];
+}
+
+bool is_constant(const thread_affine& value)
+{
+    return value.kind == THREAD_AFFINE_EXACT && is_uniform(value);
+}
+
+// Kind of a result made from two values: unreached or unknown if either is.
+uint32_t combined_kind(const thread_affine& a, const thread_affine& b)
+{
+    if (a.kind == THREAD_AFFINE_UNREACHED || b.kind == THREAD_AFFINE_UNREACHED)
+        return THREAD_AFFINE_UNREACHED;
+    return std::max(a.kind, b.kind);
+}
+
+} // namespace
+
+thread_affine thread_affine_add(const thread_affine& a, const thread_affine& b)
+{
+    return thread_affine_make(combined_kind(a, b), a.constant + b.constant, a.k[0] + b.k[0], a.k[1] + b.k[1],
+        a.k[2] + b.k[2]);
+}
+
+thread_affine thread_affine_scale(const thread_affine& a, uint32_t factor)
+{
+    if (factor == 0 && a.kind != THREAD_AFFINE_UNREACHED)
+        return thread_affine_make(THREAD_AFFINE_EXACT, 0, 0, 0, 0);
+    return thread_affine_make(a.kind, a.constant * factor, a.k[0] * factor, a.k[1] * factor, a.k[2] * factor);
+}
+
+namespace {
+
+thread_affine multiply(const thread_affine& a, const thread_affine& b)
+{
+    if (is_constant(a))
+        return thread_affine_scale(b, a.constant);
+    if (is_constant(b))
+        return thread_affine_scale(a, b.constant);
+    uint32_t kind = combined_kind(a, b);
+    if (kind == THREAD_AFFINE_UNREACHED)
+        return unreached();
+    return is_uniform(a) && is_uniform(b) ? thread_affine_make(THREAD_AFFINE_UNIFORM, 0, 0, 0, 0) : unknown();
+}
+
+// Joins from into to where control flow meets; returns true if to changed.
+bool join(thread_affine& to, const thread_affine& from)
+{
+    if (from.kind == THREAD_AFFINE_UNREACHED || to.kind == THREAD_AFFINE_UNKNOWN)
+        return false;
+    if (to.kind == THREAD_AFFINE_UNREACHED)
+    {
+        to = from;
+        return true;
+    }
+    thread_affine joined;
+    if (from.kind == THREAD_AFFINE_UNKNOWN || memcmp(to.k, from.k, sizeof(to.k)) != 0)
+        joined = unknown();
+    else if (to.kind == THREAD_AFFINE_EXACT && from.kind == THREAD_AFFINE_EXACT && to.constant == from.constant)
+        return false;
+    else
+        joined = thread_affine_make(THREAD_AFFINE_UNIFORM, 0, to.k[0], to.k[1], to.k[2]);
+    bool changed = memcmp(&joined, &to, sizeof(joined)) != 0;
+    to = joined;
+    return changed;
+}
+
+bool is_call(D3D10_SB_OPCODE_TYPE opcode)
+{
+    return opcode == D3D10_SB_OPCODE_CALL || opcode == D3D10_SB_OPCODE_CALLC || opcode == D3D11_SB_OPCODE_INTERFACE_CALL;
+}
+
+// Component an operand reads at a swizzle position.
+uint32_t component_at(const DecodedOperand& operand, uint32_t position)
+{
+    uint32_t read = ComponentsRead(operand, 1 << position);
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        if (read & (1 << c))
+            return c;
+    }
+    return 0;
+}
+
+bool has_relative_index(const DecodedOperand& operand)
+{
+    for (uint32_t d = 0; d < operand.indexDim && d < 3; d++)
+    {
+        if (operand.index[d].relative != DECODED_NO_OPERAND)
+            return true;
+    }
+    return false;
+}
+
+uint32_t written(const DecodedOperand& dest)
+{
+    if (dest.type != D3D10_SB_OPERAND_TYPE_TEMP || dest.indexDim < 1)
+        return 0;
+    return dest.numComponents == 4 && dest.selectionMode == D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE ? dest.mask & 0xf : 0xf;
+}
+
+// Values are kept per tracked temp component: those a query reads, and those they are computed
+// from.
+class analysis
+{
+public:
+    analysis(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands, const cfg& graph,
+        const uint32_t group[3], const std::vector<thread_affine_query>& queries, std::vector<thread_affine>& values)
+        : instructions(instructions), count(count), operands(operands), graph(graph), group(group), queries(queries),
+        values(values), slots(0)
+    {
+    }
+
+    bool run()
+    {
+        values.clear();
+        if (!find_slots())
+            return false;
+        solve();
+        answer();
+        return true;
+    }
+
+private:
+    uint32_t slot_of(const DecodedOperand& operand, uint32_t component) const
+    {
+        if (operand.type != D3D10_SB_OPERAND_TYPE_TEMP || operand.indexDim < 1 || has_relative_index(operand))
+            return NO_SLOT;
+        return slot[(size_t)operand.index[0].value * 4 + component];
+    }
+
+    // Marks the temp components an operand reads at positions; returns true if any was new.
+    bool mark(const DecodedOperand& operand, uint32_t positions)
+    {
+        if (operand.type != D3D10_SB_OPERAND_TYPE_TEMP || operand.indexDim < 1 || has_relative_index(operand))
+            return false;
+        uint32_t read = ComponentsRead(operand, positions);
+        bool grew = false;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            uint32_t& s = slot[(size_t)operand.index[0].value * 4 + c];
+            if ((read & (1 << c)) && s == NO_SLOT)
+            {
+                s = 0;
+                grew = true;
+            }
+        }
+        return grew;
+    }
+
+    // Numbers the temp components the queries depend on, going backwards from them until no more
+    // are found; loops take a pass more per level.
+    bool find_slots()
+    {
+        uint32_t temps = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const DecodedInstruction& inst = instructions[i];
+            if (IsDeclaration(inst.opcode))
+                continue;
+            for (uint32_t o = 0; o < (uint32_t)inst.operandCount + inst.relativeCount; o++)
+            {
+                const DecodedOperand& operand = operands[inst.firstOperand + o];
+                if (operand.type != D3D10_SB_OPERAND_TYPE_TEMP || operand.indexDim < 1)
+                    continue;
+                uint64_t index = operand.index[0].value;
+                if (index >= THREAD_AFFINE_MAX_REGISTERS)
+                    return false;
+                temps = std::max(temps, (uint32_t)index + 1);
+            }
+        }
+        slot.assign((size_t)temps * 4, NO_SLOT);
+        for (const thread_affine_query& q : queries)
+        {
+            if (q.instruction < count && q.operand < instructions[q.instruction].operandCount)
+                mark(operands[instructions[q.instruction].firstOperand + q.operand], 1);
+        }
+        bool grew = true;
+        while (grew)
+        {
+            grew = false;
+            for (uint32_t i = count; i-- > 0;)
+            {
+                const DecodedInstruction& inst = instructions[i];
+                if (IsDeclaration(inst.opcode) || is_call(inst.opcode))
+                    continue;
+                uint32_t destinations = std::min<uint32_t>(DestinationCount(inst.opcode), inst.operandCount);
+                uint32_t positions = 0;
+                for (uint32_t o = 0; o < destinations; o++)
+                {
+                    for (uint32_t p = 0; p < 4; p++)
+                    {
+                        if ((written(operands[inst.firstOperand + o]) & (1 << p))
+                            && slot_of(operands[inst.firstOperand + o], p) != NO_SLOT)
+                            positions |= 1 << p;
+                    }
+                }
+                if (!positions)
+                    continue;
+                if (!IsComponentwise(inst.opcode))
+                    positions = SourcePositions(inst, operands);
+                for (uint32_t o = destinations; o < inst.operandCount; o++)
+                    grew |= mark(operands[inst.firstOperand + o], positions);
+            }
+        }
+        for (uint32_t& s : slot)
+        {
+            if (s != NO_SLOT)
+                s = slots++;
+        }
+        return (uint64_t)slots * graph.blocks.size() <= THREAD_AFFINE_MAX_STATE;
+    }
+
+    // Value of a source operand at a swizzle position.
+    thread_affine read(const thread_affine* state, const DecodedOperand& operand, uint32_t position) const
+    {
+        if (has_relative_index(operand))
+            return unknown();
+        uint32_t c = component_at(operand, position);
+        thread_affine value;
+        switch (operand.type)
+        {
+        case D3D10_SB_OPERAND_TYPE_TEMP:
+        {
+            uint32_t s = slot_of(operand, c);
+            value = s == NO_SLOT ? unknown() : state[s];
+            break;
+        }
+        case D3D10_SB_OPERAND_TYPE_IMMEDIATE32:
+            value = thread_affine_make(THREAD_AFFINE_EXACT, operand.numComponents == 4 && position < operand.immCount
+                ? operand.imm[position] : operand.imm[0], 0, 0, 0);
+            break;
+        case D3D11_SB_OPERAND_TYPE_INPUT_THREAD_ID_IN_GROUP:
+        case D3D11_SB_OPERAND_TYPE_INPUT_THREAD_ID:
+            if (c == 3)
+                return unknown();
+            value = thread_affine_make(operand.type == D3D11_SB_OPERAND_TYPE_INPUT_THREAD_ID ? THREAD_AFFINE_UNIFORM
+                : THREAD_AFFINE_EXACT, 0, c == 0, c == 1, c == 2);
+            break;
+        case D3D11_SB_OPERAND_TYPE_INPUT_THREAD_ID_IN_GROUP_FLATTENED:
+            value = thread_affine_make(THREAD_AFFINE_EXACT, 0, 1, group[0], group[0] * group[1]);
+            break;
+        case D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER:
+        case D3D10_SB_OPERAND_TYPE_IMMEDIATE_CONSTANT_BUFFER:
+        case D3D11_SB_OPERAND_TYPE_INPUT_THREAD_GROUP_ID:
+            value = thread_affine_make(THREAD_AFFINE_UNIFORM, 0, 0, 0, 0);
+            break;
+        default:
+            return unknown();
+        }
+        switch (operand.modifier)
+        {
+        case D3D10_SB_OPERAND_MODIFIER_NONE:
+            return value;
+        case D3D10_SB_OPERAND_MODIFIER_NEG:
+            return thread_affine_scale(value, 0xffffffffu);
+        default:
+            if (value.kind == THREAD_AFFINE_UNREACHED)
+                return value;
+            return is_uniform(value) ? thread_affine_make(THREAD_AFFINE_UNIFORM, 0, 0, 0, 0) : unknown();
+        }
+    }
+
+    // Value an instruction writes to destination operand o at a position.
+    thread_affine evaluate(const thread_affine* state, const DecodedInstruction& inst, uint32_t o, uint32_t position) const
+    {
+        const DecodedOperand* ops = operands + inst.firstOperand;
+        uint32_t sources = inst.operandCount - std::min<uint32_t>(DestinationCount(inst.opcode), inst.operandCount);
+        const DecodedOperand* src = ops + (inst.operandCount - sources);
+        if (!DECODE_IS_D3D10_SB_INSTRUCTION_SATURATE_ENABLED(inst.opcodeToken))
+        {
+            switch (inst.opcode)
+            {
+            case D3D10_SB_OPCODE_MOV:
+                if (sources == 1)
+                    return read(state, src[0], position);
+                break;
+            case D3D10_SB_OPCODE_INEG:
+                if (sources == 1)
+                    return thread_affine_scale(read(state, src[0], position), 0xffffffffu);
+                break;
+            case D3D10_SB_OPCODE_IADD:
+                if (sources == 2)
+                    return thread_affine_add(read(state, src[0], position), read(state, src[1], position));
+                break;
+            case D3D10_SB_OPCODE_ISHL:
+            {
+                if (sources != 2)
+                    break;
+                thread_affine shift = read(state, src[1], position);
+                if (is_constant(shift))
+                    return thread_affine_scale(read(state, src[0], position), 1u << (shift.constant & 31));
+                break;
+            }
+            case D3D10_SB_OPCODE_IMUL:
+            case D3D10_SB_OPCODE_UMUL:
+                // The low half, in the second destination.
+                if (sources == 2 && o == 1)
+                    return multiply(read(state, src[0], position), read(state, src[1], position));
+                break;
+            case D3D10_SB_OPCODE_IMAD:
+            case D3D10_SB_OPCODE_UMAD:
+                if (sources == 3)
+                    return thread_affine_add(multiply(read(state, src[0], position), read(state, src[1], position)),
+                        read(state, src[2], position));
+                break;
+            default:
+                break;
+            }
+        }
+
+        // Anything else is uniform if it computes from uniform sources alone.
+        uint32_t c = cost_class_of(inst.opcode);
+        if (c != COST_CLASS_ALU && c != COST_CLASS_TRANSCENDENTAL && c != COST_CLASS_DOUBLE)
+            return unknown();
+        uint32_t positions = IsComponentwise(inst.opcode) ? 1u << position : SourcePositions(inst, operands);
+        for (uint32_t s = 0; s < sources; s++)
+        {
+            for (uint32_t p = 0; p < 4; p++)
+            {
+                if (!(positions & (1 << p)))
+                    continue;
+                thread_affine value = read(state, src[s], p);
+                if (value.kind == THREAD_AFFINE_UNREACHED || !is_uniform(value))
+                    return value.kind == THREAD_AFFINE_UNREACHED ? value : unknown();
+            }
+        }
+        return thread_affine_make(THREAD_AFFINE_UNIFORM, 0, 0, 0, 0);
+    }
+
+    // Moves state forward over one instruction.
+    void step(thread_affine* state, const DecodedInstruction& inst)
+    {
+        if (IsDeclaration(inst.opcode))
+            return;
+        if (is_call(inst.opcode))
+        {
+            // Whatever the callee writes is not followed.
+            std::fill(state, state + slots, unknown());
+            return;
+        }
+        const DecodedOperand* ops = operands + inst.firstOperand;
+        uint32_t destinations = std::min<uint32_t>(DestinationCount(inst.opcode), inst.operandCount);
+        // Every result is worked out before any is written, as sources may be destinations too.
+        results.clear();
+        for (uint32_t o = 0; o < destinations; o++)
+        {
+            uint32_t mask = written(ops[o]);
+            for (uint32_t p = 0; p < 4; p++)
+            {
+                uint32_t s = (mask & (1 << p)) ? slot_of(ops[o], p) : NO_SLOT;
+                if (s != NO_SLOT)
+                    results.push_back(std::make_pair(s, evaluate(state, inst, o, p)));
+            }
+        }
+        for (const std::pair<uint32_t, thread_affine>& r : results)
+            state[r.first] = r.second;
+    }
+
+    // Value of every tracked component at the start of a block.
+    void block_in(uint32_t b)
+    {
+        const cfg_block& block = graph.blocks[b];
+        // Temps are undefined where a function starts.
+        std::fill(state.begin(), state.end(), b == graph.functions[block.function].first_block ? unknown() : unreached());
+        for (uint32_t e = block.first_predecessor; e < block.first_predecessor + block.predecessor_count; e++)
+        {
+            const thread_affine* from = &block_out[(size_t)graph.predecessors[e].from * slots];
+            for (uint32_t s = 0; s < slots; s++)
+                join(state[s], from[s]);
+        }
+    }
+
+    // Forward fixpoint over every block. Values only go up from unreached to exact, uniform and
+    // unknown, so each block is walked a few times at most.
+    void solve()
+    {
+        uint32_t blocks = (uint32_t)graph.blocks.size();
+        block_out.assign((size_t)blocks * slots, unreached());
+        state.resize(slots);
+        dirty.assign(blocks, 1);
+        bool pending = true;
+        while (pending)
+        {
+            pending = false;
+            for (uint32_t b = 0; b < blocks; b++)
+            {
+                if (!dirty[b])
+                    continue;
+                dirty[b] = 0;
+                const cfg_block& block = graph.blocks[b];
+                block_in(b);
+                for (uint32_t i = block.first; i < block.end; i++)
+                    step(state.data(), instructions[i]);
+                bool changed = false;
+                thread_affine* out = &block_out[(size_t)b * slots];
+                for (uint32_t s = 0; s < slots; s++)
+                    changed |= join(out[s], state[s]);
+                if (!changed)
+                    continue;
+                for (uint32_t e = block.first_successor; e < block.first_successor + block.successor_count; e++)
+                {
+                    uint32_t to = graph.successors[e].to;
+                    dirty[to] = 1;
+                    pending |= to <= b;
+                }
+            }
+        }
+    }
+
+    // Walks the blocks with queries once more with the values solved, and reads each query.
+    void answer()
+    {
+        uint32_t walked = CFG_NONE;
+        uint32_t next = 0;
+        for (const thread_affine_query& q : queries)
+        {
+            if (q.instruction >= count || q.operand >= instructions[q.instruction].operandCount)
+            {
+                values.push_back(unknown());
+                continue;
+            }
+            uint32_t b = graph.block_of[q.instruction];
+            if (b != walked || next > q.instruction)
+            {
+                block_in(b);
+                walked = b;
+                next = graph.blocks[b].first;
+            }
+            for (; next < q.instruction; next++)
+                step(state.data(), instructions[next]);
+            const DecodedInstruction& inst = instructions[q.instruction];
+            values.push_back(read(state.data(), operands[inst.firstOperand + q.operand], 0));
+        }
+    }
+
+    const DecodedInstruction* instructions;
+    uint32_t count;
+    const DecodedOperand* operands;
+    const cfg& graph;
+    const uint32_t* group;
+    const std::vector<thread_affine_query>& queries;
+    std::vector<thread_affine>& values;
+    uint32_t slots;
+    std::vector<uint32_t> slot;         // per temp component: its slot, or NO_SLOT if not tracked
+    std::vector<thread_affine> block_out;   // per block and slot
+    std::vector<thread_affine> state;
+    std::vector<uint8_t> dirty;         // blocks whose inputs changed since they were walked
+    std::vector<std::pair<uint32_t, thread_affine> > results;
+};
+
+} // namespace
+
+bool thread_affine_solve(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, const uint32_t group[3], const std::vector<thread_affine_query>& queries,
+    std::vector<thread_affine>& values)
+{
+    analysis run(instructions, count, operands, graph, group, queries, values);
+    return run.run();
+}
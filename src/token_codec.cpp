@@ -0,0 +1,1163 @@
+#include "token_codec.h"
+#include "D3D11TokenParser.h"
+#include "dxbc.h"
+#include <string.h>
+#include <algorithm>
+#include <initializer_list>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+enum STREAM
+{
+    STREAM_PREFIX,          // container bytes around the program
+    STREAM_DICTIONARY,      // dictionaries and one-off values of the four streams below that use one
+    STREAM_MISC,            // program header, declaration values and anything not understood
+    STREAM_OPCODE,
+    STREAM_EXTENDED,        // extended opcode and extended operand tokens
+    STREAM_OPERAND,         // operand tokens without their component selection
+    STREAM_COMPONENTS,      // the write mask of each operand token in mask mode, one byte each; in
+                            // version 1 the component byte of every operand token
+    STREAM_IMMEDIATE,
+    STREAM_INDEX,           // register indices, delta coded per operand type and dimension
+    STREAM_ICB,             // immediate constant buffer values, delta coded
+    STREAM_SWIZZLE,         // the swizzle of each operand token in swizzle mode
+    STREAM_SELECT,          // the component byte of every other operand token
+    STREAM_COUNT
+};
+
+// Version 1 files end after the ICB stream.
+const int VERSION_1_STREAMS = STREAM_SWIZZLE;
+
+const int dictionary_streams[] = { STREAM_OPCODE, STREAM_EXTENDED, STREAM_OPERAND, STREAM_IMMEDIATE };
+
+enum STREAM_MODE
+{
+    MODE_RAW,
+    MODE_RUN,               // one byte repeated
+    MODE_LISTED_HUFFMAN,    // code lengths listed one by one, as version 1 wrote them
+    MODE_HUFFMAN,
+    MODE_STATIC_HUFFMAN     // one of the static codes
+};
+
+// Bits 4-11 of an operand token, its write mask, swizzle or selected component.
+const uint32_t OPERAND_COMPONENT_SHIFT = 4;
+const uint32_t OPERAND_COMPONENT_BITS = 0xffu << OPERAND_COMPONENT_SHIFT;
+
+const int HUFFMAN_MAX_BITS = 11;
+// Code lengths are themselves Huffman coded, as in Deflate: a symbol is either a length or a run
+// of zero lengths or of the previous length, followed by the run's size in a few bits.
+enum LENGTH_SYMBOL
+{
+    LENGTH_ZEROS = HUFFMAN_MAX_BITS + 1,    // 3-10 zeros, 3 bits
+    LENGTH_MANY_ZEROS,                      // 11-138 zeros, 7 bits
+    LENGTH_REPEAT,                          // the previous length 3-6 more times, 2 bits
+    LENGTH_SYMBOLS
+};
+const int LENGTH_MAX_BITS = 7;
+const int STATIC_CODES = 10;
+// Streams this long are coded as four lanes of consecutive symbols, so that decoding can follow
+// four independent bit streams at once.
+const int HUFFMAN_LANES = 4;
+const uint32_t HUFFMAN_LANE_MIN = 256;
+const uint32_t INDEX_CONTEXTS = 256 * 3;
+
+// Masks, swizzles and selected components use different values, so they are coded apart. The
+// stream is looked up from the component count and selection mode in bits 0-3 of the operand
+// token, which the decoder knows before reading the component bits; the two alternate too often
+// for a branch. The decoder keeps the three readers in an array of their own, indexed by the
+// COMPONENT_KIND, so that reading one does not make it reload every stream.
+enum COMPONENT_KIND
+{
+    COMPONENT_MASK,
+    COMPONENT_SWIZZLE,
+    COMPONENT_SELECT,
+    COMPONENT_KINDS
+};
+const STREAM component_kind_streams[COMPONENT_KINDS] = { STREAM_COMPONENTS, STREAM_SWIZZLE, STREAM_SELECT };
+const uint8_t component_kinds[16] = {
+    COMPONENT_SELECT, COMPONENT_SELECT, COMPONENT_MASK, COMPONENT_SELECT,
+    COMPONENT_SELECT, COMPONENT_SELECT, COMPONENT_SWIZZLE, COMPONENT_SELECT,
+    COMPONENT_SELECT, COMPONENT_SELECT, COMPONENT_SELECT, COMPONENT_SELECT,
+    COMPONENT_SELECT, COMPONENT_SELECT, COMPONENT_SELECT, COMPONENT_SELECT,
+};
+// Version 1 has the one component stream.
+const uint8_t version_1_component_kinds[16] = { COMPONENT_MASK };
+
+inline uint32_t zigzag(uint32_t delta)
+{
+    return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+inline uint32_t unzigzag(uint32_t value)
+{
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+void put_varint(std::vector<char>& out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+struct byte_reader
+{
+    const uint8_t* p;
+    const uint8_t* end;
+
+    uint32_t varint(bool& failed)
+    {
+        if (p != end && *p < 0x80)
+            return *p++;
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            if (p == end)
+            {
+                failed = true;
+                return 0;
+            }
+            uint8_t byte = *p++;
+            value |= (uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        failed = true;
+        return 0;
+    }
+};
+
+// Walks a token stream the way TokenDecoder does and hands every token to the source with the
+// stream it belongs in. Compression reads the tokens it is given; decompression produces them
+// from the streams. Every decision depends only on tokens already walked, so both sides split
+// identically whatever the tokens are.
+template<typename Source>
+class program_walker
+{
+public:
+    program_walker(Source& source) : source(source), pos(0), end(0) {}
+
+    void program(uint32_t count)
+    {
+        uint32_t program_end = count;
+        if (count >= 2)
+        {
+            take<STREAM_MISC>();
+            uint32_t declared = take<STREAM_MISC>();
+            if (declared < count)
+                program_end = std::max(declared, 2u);
+        }
+        while (pos < program_end)
+            instruction(program_end);
+        rest(count);
+    }
+
+private:
+    template<STREAM stream>
+    uint32_t take(uint32_t context = 0)
+    {
+        return source.template take<stream>(context, pos++);
+    }
+
+    void rest(uint32_t until)
+    {
+        while (pos < until)
+            take<STREAM_MISC>();
+    }
+
+    static bool takes_operands(uint32_t opcode)
+    {
+        switch (opcode)
+        {
+        case D3D10_SB_OPCODE_DCL_MAX_OUTPUT_VERTEX_COUNT:
+        case D3D10_SB_OPCODE_DCL_TEMPS:
+        case D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP:
+        case D3D11_SB_OPCODE_DCL_HS_MAX_TESSFACTOR:
+        case D3D11_SB_OPCODE_DCL_HS_FORK_PHASE_INSTANCE_COUNT:
+        case D3D11_SB_OPCODE_DCL_HS_JOIN_PHASE_INSTANCE_COUNT:
+        case D3D11_SB_OPCODE_DCL_GS_INSTANCE_COUNT:
+        case D3D11_SB_OPCODE_DCL_THREAD_GROUP:
+        case D3D11_SB_OPCODE_DCL_FUNCTION_BODY:
+        case D3D11_SB_OPCODE_DCL_FUNCTION_TABLE:
+        case D3D11_SB_OPCODE_DCL_INTERFACE:
+            return false;
+        default:
+            return opcode < D3D10_SB_NUM_OPCODES;
+        }
+    }
+
+    void instruction(uint32_t program_end)
+    {
+        uint32_t start = pos;
+        uint32_t token = take<STREAM_OPCODE>();
+        uint32_t opcode = (uint32_t)DECODE_D3D10_SB_OPCODE_TYPE(token);
+        if (opcode == D3D10_SB_OPCODE_CUSTOMDATA)
+        {
+            if (pos == program_end)
+                return;
+            uint32_t length = take<STREAM_MISC>();
+            end = start + std::min(length, program_end - start);
+            while (pos < end)
+                take<STREAM_ICB>();
+            return;
+        }
+        uint32_t length = DECODE_D3D10_SB_TOKENIZED_INSTRUCTION_LENGTH(token);
+        if (!length)
+        {
+            rest(program_end);
+            return;
+        }
+        end = start + std::min(length, program_end - start);
+        for (uint32_t ext = token; DECODE_IS_D3D10_SB_OPCODE_EXTENDED(ext) && pos < end; )
+            ext = take<STREAM_EXTENDED>();
+        if (!takes_operands(opcode))
+        {
+            rest(end);
+            return;
+        }
+        uint32_t data = DeclarationDataPerOperand((D3D10_SB_OPCODE_TYPE)opcode);
+        while (pos < end)
+        {
+            operand(0);
+            for (uint32_t i = 0; i < data && pos < end; i++)
+                take<STREAM_MISC>();
+        }
+    }
+
+    void operand(uint32_t depth)
+    {
+        uint32_t token = take<STREAM_OPERAND>();
+        for (uint32_t ext = token; DECODE_IS_D3D10_SB_OPERAND_EXTENDED(ext) && pos < end; )
+            ext = take<STREAM_EXTENDED>();
+
+        uint32_t type = DECODE_D3D10_SB_OPERAND_TYPE(token);
+        if (type == D3D10_SB_OPERAND_TYPE_IMMEDIATE32 || type == D3D10_SB_OPERAND_TYPE_IMMEDIATE64)
+        {
+            uint32_t count = DECODE_D3D10_SB_OPERAND_NUM_COMPONENTS(token) == D3D10_SB_OPERAND_4_COMPONENT ? 4 : 1;
+            if (type == D3D10_SB_OPERAND_TYPE_IMMEDIATE64)
+                count *= 2;
+            for (uint32_t i = 0; i < count && pos < end; i++)
+                take<STREAM_IMMEDIATE>();
+        }
+
+        uint32_t dimension = DECODE_D3D10_SB_OPERAND_INDEX_DIMENSION(token);
+        for (uint32_t idx = 0; idx < dimension && idx < 3; idx++)
+        {
+            switch (DECODE_D3D10_SB_OPERAND_INDEX_REPRESENTATION(idx, token))
+            {
+            case D3D10_SB_OPERAND_INDEX_IMMEDIATE32_PLUS_RELATIVE:
+                if (pos < end)
+                    take<STREAM_INDEX>((type & 0xff) * 3 + idx);
+                // fall through
+            case D3D10_SB_OPERAND_INDEX_RELATIVE:
+                if (pos < end && depth < DECODED_MAX_RELATIVE_DEPTH)
+                    operand(depth + 1);
+                break;
+            case D3D10_SB_OPERAND_INDEX_IMMEDIATE32:
+                if (pos < end)
+                    take<STREAM_INDEX>((type & 0xff) * 3 + idx);
+                break;
+            case D3D10_SB_OPERAND_INDEX_IMMEDIATE64_PLUS_RELATIVE:
+            case D3D10_SB_OPERAND_INDEX_IMMEDIATE64:
+                for (int i = 0; i < 2 && pos < end; i++)
+                    take<STREAM_MISC>();
+                if (DECODE_D3D10_SB_OPERAND_INDEX_REPRESENTATION(idx, token) == D3D10_SB_OPERAND_INDEX_IMMEDIATE64_PLUS_RELATIVE
+                    && pos < end && depth < DECODED_MAX_RELATIVE_DEPTH)
+                    operand(depth + 1);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    Source& source;
+    uint32_t pos;
+    uint32_t end;       // of the current instruction
+};
+
+// Compression side: reads the tokens and collects each stream's values.
+struct split_source
+{
+    const char* tokens;
+    std::vector<uint32_t> values[STREAM_COUNT];
+    uint32_t previous_index[INDEX_CONTEXTS];
+    uint32_t previous_icb;
+
+    template<STREAM stream>
+    uint32_t take(uint32_t context, uint32_t pos)
+    {
+        uint32_t value;
+        memcpy(&value, tokens + pos * 4, 4);
+        uint32_t stored = value;
+        if (stream == STREAM_OPERAND)
+        {
+            values[component_kind_streams[component_kinds[value & 15]]].push_back((value & OPERAND_COMPONENT_BITS) >> OPERAND_COMPONENT_SHIFT);
+            stored = value & ~OPERAND_COMPONENT_BITS;
+        }
+        else if (stream == STREAM_INDEX)
+        {
+            stored = zigzag(value - previous_index[context]);
+            previous_index[context] = value;
+        }
+        else if (stream == STREAM_ICB)
+        {
+            stored = zigzag(value - previous_icb);
+            previous_icb = value;
+        }
+        values[stream].push_back(stored);
+        return value;
+    }
+};
+
+// Decompression side: reads each stream's values and writes the tokens.
+struct join_source
+{
+    char* tokens;
+    byte_reader streams[STREAM_COUNT];
+    const char* dictionary[STREAM_COUNT];
+    uint32_t dictionary_size[STREAM_COUNT];
+    byte_reader literals[STREAM_COUNT];
+    uint32_t previous_index[INDEX_CONTEXTS];
+    uint32_t previous_icb;
+    byte_reader components[COMPONENT_KINDS];
+    const uint8_t* component_kinds;
+    bool failed;
+
+    template<STREAM stream>
+    uint32_t take(uint32_t context, uint32_t pos)
+    {
+        uint32_t value = streams[stream].varint(failed);
+        switch (stream)
+        {
+        case STREAM_INDEX:
+            value = previous_index[context] += unzigzag(value);
+            break;
+        case STREAM_ICB:
+            value = previous_icb += unzigzag(value);
+            break;
+        case STREAM_MISC:
+            break;
+        default:
+            if (value == 0 && literals[stream].end - literals[stream].p >= 4)
+            {
+                memcpy(&value, literals[stream].p, 4);
+                literals[stream].p += 4;
+            }
+            else if (value && value <= dictionary_size[stream])
+            {
+                memcpy(&value, dictionary[stream] + (value - 1) * 4, 4);
+            }
+            else
+            {
+                failed = true;
+                value = 0;
+            }
+            break;
+        }
+        uint32_t token = value;
+        if (stream == STREAM_OPERAND)
+        {
+            byte_reader& components = this->components[component_kinds[value & 15]];
+            if (components.p == components.end)
+                failed = true;
+            else
+                token |= (uint32_t)*components.p++ << OPERAND_COMPONENT_SHIFT;
+        }
+        memcpy(tokens + pos * 4, &token, 4);
+        // The walker does not look at the component bits, so it need not wait for them.
+        return value;
+    }
+};
+
+void huffman_lengths(const uint32_t counts[256], uint8_t lengths[256], int max_bits = HUFFMAN_MAX_BITS)
+{
+    // Plain Huffman first, then clamped to max_bits by shifting codes down until the Kraft sum
+    // fits again.
+    typedef std::pair<uint64_t, int> entry;
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry> > heap;
+    int parent[511];
+    int symbols[256];
+    int leaves = 0;
+    for (int s = 0; s < 256; s++)
+    {
+        lengths[s] = 0;
+        if (counts[s])
+        {
+            symbols[leaves] = s;
+            heap.push(entry(counts[s], leaves++));
+        }
+    }
+    int nodes = leaves;
+    while (heap.size() > 1)
+    {
+        entry a = heap.top();
+        heap.pop();
+        entry b = heap.top();
+        heap.pop();
+        parent[a.second] = parent[b.second] = nodes;
+        heap.push(entry(a.first + b.first, nodes++));
+    }
+    parent[nodes - 1] = -1;
+
+    uint32_t length_count[HUFFMAN_MAX_BITS + 1] = { 0 };
+    for (int leaf = 0; leaf < leaves; leaf++)
+    {
+        int depth = 0;
+        for (int node = leaf; parent[node] >= 0; node = parent[node])
+            depth++;
+        length_count[std::min(depth, max_bits)]++;
+    }
+    uint32_t total = 0;
+    for (int len = 1; len <= max_bits; len++)
+        total += length_count[len] << (max_bits - len);
+    while (total > (1u << max_bits))
+    {
+        length_count[max_bits]--;
+        for (int len = max_bits - 1; len > 0; len--)
+        {
+            if (length_count[len])
+            {
+                length_count[len]--;
+                length_count[len + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // The most frequent symbols get the shortest codes.
+    std::sort(symbols, symbols + leaves, [&](int a, int b) {
+        return counts[a] != counts[b] ? counts[a] > counts[b] : a < b;
+    });
+    int next = 0;
+    for (int len = 1; len <= max_bits; len++)
+    {
+        for (uint32_t i = 0; i < length_count[len]; i++)
+            lengths[symbols[next++]] = (uint8_t)len;
+    }
+}
+
+// Canonical codes, bit reversed for reading from the low end. False unless the lengths form a
+// complete code.
+bool huffman_codes(const uint8_t lengths[256], uint32_t codes[256], int max_bits = HUFFMAN_MAX_BITS)
+{
+    uint32_t length_count[HUFFMAN_MAX_BITS + 1] = { 0 };
+    uint32_t total = 0;
+    for (int s = 0; s < 256; s++)
+    {
+        if (lengths[s] > max_bits)
+            return false;
+        if (lengths[s])
+        {
+            length_count[lengths[s]]++;
+            total += 1u << (max_bits - lengths[s]);
+        }
+    }
+    if (total != (1u << max_bits))
+        return false;
+    uint32_t next[HUFFMAN_MAX_BITS + 1];
+    uint32_t code = 0;
+    next[0] = 0;
+    for (int len = 1; len <= max_bits; len++)
+    {
+        code = (code + length_count[len - 1]) << 1;
+        next[len] = code;
+    }
+    for (int s = 0; s < 256; s++)
+    {
+        int len = lengths[s];
+        if (!len)
+            continue;
+        uint32_t forward = next[len]++;
+        uint32_t reversed = 0;
+        for (int bit = 0; bit < len; bit++)
+            reversed |= ((forward >> bit) & 1) << (len - 1 - bit);
+        codes[s] = reversed;
+    }
+    return true;
+}
+
+uint64_t coded_bits(const uint32_t counts[256], const uint8_t lengths[256])
+{
+    uint64_t bits = 0;
+    for (int s = 0; s < 256; s++)
+        bits += (uint64_t)counts[s] * lengths[s];
+    return bits;
+}
+
+struct bit_writer
+{
+    std::vector<char>& out;
+    uint64_t buffer;
+    int count;
+
+    void put(uint32_t value, int bits)
+    {
+        buffer |= (uint64_t)value << count;
+        count += bits;
+        while (count >= 8)
+        {
+            out.push_back((char)buffer);
+            buffer >>= 8;
+            count -= 8;
+        }
+    }
+
+    void flush()
+    {
+        if (count)
+            out.push_back((char)buffer);
+        buffer = 0;
+        count = 0;
+    }
+};
+
+void put_bits(const uint8_t* raw, size_t size, const uint8_t lengths[256], const uint32_t codes[256], std::vector<char>& bits)
+{
+    bit_writer writer = { bits, 0, 0 };
+    for (size_t i = 0; i < size; i++)
+        writer.put(codes[raw[i]], lengths[raw[i]]);
+    writer.flush();
+}
+
+int length_extra_bits(int symbol)
+{
+    return symbol == LENGTH_ZEROS ? 3 : symbol == LENGTH_MANY_ZEROS ? 7 : symbol == LENGTH_REPEAT ? 2 : 0;
+}
+
+// Writes the code lengths of all 256 symbols: the lengths of the length code, three bits each,
+// then the symbols of the lengths and their run sizes, padded to a byte.
+void put_lengths(const uint8_t lengths[256], std::vector<char>& out)
+{
+    uint8_t symbols[256];
+    uint8_t extra[256];
+    int count = 0;
+    for (int s = 0; s < 256; )
+    {
+        int run = 1;
+        while (s + run < 256 && lengths[s + run] == lengths[s])
+            run++;
+        if (!lengths[s] && run >= 3)
+        {
+            run = std::min(run, 138);
+            symbols[count] = run <= 10 ? LENGTH_ZEROS : LENGTH_MANY_ZEROS;
+            extra[count++] = (uint8_t)(run - (run <= 10 ? 3 : 11));
+        }
+        else if (lengths[s] && s && lengths[s - 1] == lengths[s] && run >= 3)
+        {
+            run = std::min(run, 6);
+            symbols[count] = LENGTH_REPEAT;
+            extra[count++] = (uint8_t)(run - 3);
+        }
+        else
+        {
+            run = 1;
+            symbols[count] = lengths[s];
+            extra[count++] = 0;
+        }
+        s += run;
+    }
+
+    uint32_t counts[256] = { 0 };
+    for (int i = 0; i < count; i++)
+        counts[symbols[i]]++;
+    // A code needs two symbols; give the second one a count it will not use.
+    int used = 0;
+    for (int s = 0; s < LENGTH_SYMBOLS; s++)
+        used += counts[s] != 0;
+    if (used < 2)
+        counts[counts[0] ? 1 : 0] = 1;
+    uint8_t length_lengths[256];
+    uint32_t length_codes[256];
+    huffman_lengths(counts, length_lengths, LENGTH_MAX_BITS);
+    huffman_codes(length_lengths, length_codes, LENGTH_MAX_BITS);
+
+    bit_writer writer = { out, 0, 0 };
+    for (int s = 0; s < LENGTH_SYMBOLS; s++)
+        writer.put(length_lengths[s], 3);
+    for (int i = 0; i < count; i++)
+    {
+        writer.put(length_codes[symbols[i]], length_lengths[symbols[i]]);
+        writer.put(extra[i], length_extra_bits(symbols[i]));
+    }
+    writer.flush();
+}
+
+struct bit_reader
+{
+    const uint8_t* p;
+    const uint8_t* end;
+    uint64_t buffer;
+    int bits;       // goes negative only when reading past the end, which shifts in zeros
+
+    // Leaves at least 56 bits, enough for five codes. Needs eight bytes left.
+    void refill_fast()
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        buffer |= word << bits;
+        p += (63 - bits) >> 3;
+        bits |= 56;
+    }
+
+    void refill()
+    {
+        while (bits <= 56 && p < end)
+        {
+            buffer |= (uint64_t)*p++ << bits;
+            bits += 8;
+        }
+    }
+
+    uint8_t decode(const uint16_t* table, uint32_t table_mask)
+    {
+        uint16_t e = table[buffer & table_mask];
+        buffer >>= e >> 8;
+        bits -= e >> 8;
+        return (uint8_t)e;
+    }
+
+    uint32_t take(int count)
+    {
+        refill();
+        uint32_t value = (uint32_t)buffer & ((1u << count) - 1);
+        buffer >>= count;
+        bits -= count;
+        return value;
+    }
+};
+
+// Decoding table indexed by the next bits of the stream, only as many as the longest code has so
+// that the short streams of a small shader do not pay for a full table. Returns the index mask.
+uint32_t fill_table(const uint8_t lengths[256], const uint32_t codes[256], uint16_t table[1 << HUFFMAN_MAX_BITS])
+{
+    uint32_t size = 1;
+    for (int s = 0; s < 256; s++)
+        size = std::max(size, 1u << lengths[s]);
+    for (int s = 0; s < 256; s++)
+    {
+        for (uint32_t j = codes[s]; lengths[s] && j < size; j += 1u << lengths[s])
+            table[j] = (uint16_t)(s | lengths[s] << 8);
+    }
+    return size - 1;
+}
+
+// Static codes the encoder can name instead of sending code lengths. Dictionary indices and
+// zigzag deltas are mostly small, so their weights fall off as 1/(s + a) or 1/(s + a)^2 for a few
+// offsets a. Weights are integers so that every build derives the same lengths.
+struct static_code_set
+{
+    uint8_t lengths[STATIC_CODES][256];
+    uint32_t codes[STATIC_CODES][256];
+    uint16_t tables[STATIC_CODES][1 << HUFFMAN_MAX_BITS];
+    uint32_t masks[STATIC_CODES];
+
+    static_code_set()
+    {
+        for (int k = 0; k < STATIC_CODES; k++)
+        {
+            uint32_t offset = 1u << (k >> 1);
+            uint32_t weights[256];
+            for (uint32_t s = 0; s < 256; s++)
+                weights[s] = k & 1 ? (1u << 30) / ((s + offset) * (s + offset)) : (1u << 30) / (s + offset);
+            huffman_lengths(weights, lengths[k]);
+            huffman_codes(lengths[k], codes[k]);
+            masks[k] = fill_table(lengths[k], codes[k], tables[k]);
+        }
+    }
+};
+
+const static_code_set& static_codes()
+{
+    static const static_code_set codes;
+    return codes;
+}
+
+// Reads the lengths put_lengths wrote.
+bool get_lengths(byte_reader& in, uint8_t lengths[256])
+{
+    bit_reader reader = { in.p, in.end, 0, 0 };
+    uint8_t length_lengths[256] = { 0 };
+    for (int s = 0; s < LENGTH_SYMBOLS; s++)
+        length_lengths[s] = (uint8_t)reader.take(3);
+    uint32_t length_codes[256];
+    if (!huffman_codes(length_lengths, length_codes, LENGTH_MAX_BITS))
+        return false;
+    uint16_t table[1 << HUFFMAN_MAX_BITS];
+    uint32_t mask = fill_table(length_lengths, length_codes, table);
+
+    for (int s = 0; s < 256; )
+    {
+        reader.refill();
+        int symbol = reader.decode(table, mask);
+        if (symbol <= HUFFMAN_MAX_BITS)
+        {
+            lengths[s++] = (uint8_t)symbol;
+            continue;
+        }
+        if (symbol == LENGTH_REPEAT && (!s || !lengths[s - 1]))
+            return false;
+        uint8_t length = symbol == LENGTH_REPEAT ? lengths[s - 1] : 0;
+        int run = (symbol == LENGTH_MANY_ZEROS ? 11 : 3) + (int)reader.take(length_extra_bits(symbol));
+        if (run > 256 - s)
+            return false;
+        memset(lengths + s, length, run);
+        s += run;
+    }
+    if (reader.bits < 0)
+        return false;
+    in.p += ((reader.p - in.p) * 8 - reader.bits + 7) / 8;
+    return true;
+}
+
+// A stream is stored as: mode, raw size, and for Huffman the coded size, the code, the coded size
+// of every lane but the last, and the bits. The code is the stream's own lengths, or which static
+// code it uses where that comes out smaller once the lengths are paid for, as it does for the
+// short streams of a small shader.
+void put_stream(const uint8_t* raw, size_t size, std::vector<char>& out)
+{
+    uint32_t counts[256] = { 0 };
+    for (size_t i = 0; i < size; i++)
+        counts[raw[i]]++;
+    int distinct = 0;
+    for (int s = 0; s < 256; s++)
+        distinct += counts[s] != 0;
+
+    if (distinct == 1)
+    {
+        out.push_back(MODE_RUN);
+        put_varint(out, (uint32_t)size);
+        out.push_back((char)raw[0]);
+        return;
+    }
+    if (distinct > 1)
+    {
+        uint8_t own_lengths[256];
+        huffman_lengths(counts, own_lengths);
+        std::vector<char> table;
+        put_lengths(own_lengths, table);
+        uint64_t best = table.size() * 8 + coded_bits(counts, own_lengths);
+        int static_code = -1;
+        const static_code_set& statics = static_codes();
+        for (int k = 0; k < STATIC_CODES; k++)
+        {
+            uint64_t bits = 8 + coded_bits(counts, statics.lengths[k]);
+            if (bits < best)
+            {
+                best = bits;
+                static_code = k;
+            }
+        }
+        const uint8_t* lengths = own_lengths;
+        uint32_t own_codes[256];
+        const uint32_t* codes = own_codes;
+        if (static_code >= 0)
+        {
+            lengths = statics.lengths[static_code];
+            codes = statics.codes[static_code];
+            table.assign(1, (char)static_code);
+        }
+        else
+        {
+            huffman_codes(lengths, own_codes);
+        }
+
+        int lanes = size >= HUFFMAN_LANE_MIN ? HUFFMAN_LANES : 1;
+        size_t lane_size = (size + lanes - 1) / lanes;
+        std::vector<char> bits;
+        bits.reserve(size / 2 + 8);
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            size_t lane_start = bits.size();
+            put_bits(raw + lane * lane_size, std::min(size - lane * lane_size, lane_size), lengths, codes, bits);
+            if (lane < lanes - 1)
+                put_varint(table, (uint32_t)(bits.size() - lane_start));
+        }
+        if (table.size() + bits.size() + 5 < size)
+        {
+            out.push_back(static_code >= 0 ? MODE_STATIC_HUFFMAN : MODE_HUFFMAN);
+            put_varint(out, (uint32_t)size);
+            put_varint(out, (uint32_t)bits.size());
+            out.insert(out.end(), table.begin(), table.end());
+            out.insert(out.end(), bits.begin(), bits.end());
+            return;
+        }
+    }
+    out.push_back(MODE_RAW);
+    put_varint(out, (uint32_t)size);
+    out.insert(out.end(), (const char*)raw, (const char*)raw + size);
+}
+
+typedef std::vector<uint8_t, arena_allocator<uint8_t> > byte_buffer;
+
+// Reads version 1 code lengths: the number of symbols present, then those symbols listed by value
+// when there are few and as a bitmap otherwise, then their lengths four bits each.
+bool get_listed_lengths(byte_reader& in, uint8_t lengths[256])
+{
+    int distinct = *in.p++ + 1;
+    const uint8_t* present = in.p;
+    size_t table_size = (distinct <= 32 ? distinct : 32) + (distinct + 1) / 2;
+    if (table_size > (size_t)(in.end - in.p))
+        return false;
+    in.p += distinct <= 32 ? distinct : 32;
+    int listed = 0;
+    for (int s = 0; s < 256; s++)
+    {
+        bool used = distinct <= 32 ? listed < distinct && present[listed] == s : (present[s >> 3] >> (s & 7)) & 1;
+        if (!used)
+            continue;
+        if (listed == distinct)
+            return false;
+        lengths[s] = (in.p[listed >> 1] >> ((listed & 1) * 4)) & 15;
+        listed++;
+    }
+    if (listed != distinct)
+        return false;
+    in.p += (distinct + 1) / 2;
+    return true;
+}
+
+// Reads a stream into reader, decoding it into storage unless it was stored raw. No stream may
+// be larger than limit bytes.
+bool get_stream(byte_reader& in, size_t limit, byte_buffer& storage, byte_reader& reader)
+{
+    if (in.p == in.end)
+        return false;
+    uint8_t mode = *in.p++;
+    bool failed = false;
+    uint32_t size = in.varint(failed);
+    if (failed || size > limit)
+        return false;
+
+    if (mode == MODE_RAW)
+    {
+        if (size > (size_t)(in.end - in.p))
+            return false;
+        reader.p = in.p;
+        reader.end = in.p + size;
+        in.p += size;
+        return true;
+    }
+    if (mode == MODE_RUN)
+    {
+        if (in.p == in.end)
+            return false;
+        storage.assign(size, *in.p++);
+    }
+    else if (mode == MODE_LISTED_HUFFMAN || mode == MODE_HUFFMAN || mode == MODE_STATIC_HUFFMAN)
+    {
+        uint32_t coded = in.varint(failed);
+        if (failed || in.p == in.end || size > (uint64_t)coded * 8)
+            return false;
+        uint16_t own_table[1 << HUFFMAN_MAX_BITS];
+        const uint16_t* table = own_table;
+        uint32_t mask;
+        if (mode == MODE_STATIC_HUFFMAN)
+        {
+            if (*in.p >= STATIC_CODES)
+                return false;
+            const static_code_set& statics = static_codes();
+            table = statics.tables[*in.p];
+            mask = statics.masks[*in.p++];
+        }
+        else
+        {
+            uint8_t lengths[256] = { 0 };
+            uint32_t codes[256];
+            if (!(mode == MODE_LISTED_HUFFMAN ? get_listed_lengths(in, lengths) : get_lengths(in, lengths))
+                || !huffman_codes(lengths, codes))
+                return false;
+            mask = fill_table(lengths, codes, own_table);
+        }
+
+        int lanes = size >= HUFFMAN_LANE_MIN ? HUFFMAN_LANES : 1;
+        uint32_t lane_size = (size + lanes - 1) / lanes;
+        uint32_t lane_coded[HUFFMAN_LANES];
+        for (int lane = 0; lane < lanes - 1; lane++)
+            lane_coded[lane] = in.varint(failed);
+        if (failed || coded > (size_t)(in.end - in.p))
+            return false;
+        bit_reader readers[HUFFMAN_LANES];
+        const uint8_t* lane_start = in.p;
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            bit_reader& reader = readers[lane];
+            reader.p = lane_start;
+            reader.end = in.p + coded;
+            if (lane < lanes - 1)
+            {
+                if (lane_coded[lane] > (size_t)(reader.end - lane_start))
+                    return false;
+                reader.end = lane_start += lane_coded[lane];
+            }
+            reader.buffer = 0;
+            reader.bits = 0;
+        }
+
+        storage.resize(size);
+        uint8_t* out = storage.empty() ? NULL : &storage[0];
+        uint32_t last_size = size - (lanes - 1) * lane_size;
+        uint32_t i = 0;
+        if (lanes == HUFFMAN_LANES)
+        {
+            bit_reader& a = readers[0];
+            bit_reader& b = readers[1];
+            bit_reader& c = readers[2];
+            bit_reader& d = readers[3];
+            for (; i + 5 <= last_size && a.end - a.p >= 8 && b.end - b.p >= 8 && c.end - c.p >= 8 && d.end - d.p >= 8; i += 5)
+            {
+                a.refill_fast();
+                b.refill_fast();
+                c.refill_fast();
+                d.refill_fast();
+                for (uint32_t k = i; k < i + 5; k++)
+                {
+                    out[k] = a.decode(table, mask);
+                    out[lane_size + k] = b.decode(table, mask);
+                    out[2 * lane_size + k] = c.decode(table, mask);
+                    out[3 * lane_size + k] = d.decode(table, mask);
+                }
+            }
+        }
+        for (int lane = 0; lane < lanes; lane++)
+        {
+            bit_reader& reader = readers[lane];
+            uint32_t count = lane == lanes - 1 ? last_size : lane_size;
+            uint8_t* lane_out = out + lane * lane_size;
+            for (uint32_t k = i; k < count; k++)
+            {
+                if (reader.bits < HUFFMAN_MAX_BITS)
+                    reader.refill();
+                lane_out[k] = reader.decode(table, mask);
+            }
+            if (reader.bits < 0)
+                return false;
+        }
+        in.p += coded;
+    }
+    else
+    {
+        return false;
+    }
+    reader.p = storage.empty() ? NULL : &storage[0];
+    reader.end = reader.p + storage.size();
+    return true;
+}
+
+// Where the program lies in the input: the shader chunk of a container, or the whole input.
+void locate_program(const void* data, size_t size, size_t& offset, uint32_t& count)
+{
+    dxbc_chunk_header* chunk = size < 0x7fffffff ? dxbc_find_shader_bytecode(data, (int)size) : NULL;
+    if (chunk)
+    {
+        offset = (const char*)(chunk + 1) - (const char*)data;
+        count = (uint32_t)(std::min((size_t)bswap_le32(chunk->size), size - offset) / 4);
+    }
+    else
+    {
+        offset = 0;
+        count = (uint32_t)(size / 4);
+    }
+}
+
+} // namespace
+
+bool token_compress(const void* data, size_t size, std::vector<char>& out)
+{
+    if (size >= 0xffffffffu)
+        return false;
+    size_t offset;
+    uint32_t count;
+    locate_program(data, size, offset, count);
+
+    split_source split;
+    split.tokens = (const char*)data + offset;
+    memset(split.previous_index, 0, sizeof(split.previous_index));
+    split.previous_icb = 0;
+    program_walker<split_source> walker(split);
+    walker.program(count);
+
+    // Values that repeat go in a dictionary ordered by frequency, so the common ones get one-byte
+    // indices starting from 1. Index 0 stands for the next one-off value, which is stored in full
+    // after the dictionary.
+    std::vector<char> streams[STREAM_COUNT];
+    std::vector<char>& dictionaries = streams[STREAM_DICTIONARY];
+    for (int stream : dictionary_streams)
+    {
+        std::unordered_map<uint32_t, uint32_t> frequency;
+        for (uint32_t value : split.values[stream])
+            frequency[value]++;
+        std::vector<std::pair<uint32_t, uint32_t> > entries;
+        for (const std::pair<const uint32_t, uint32_t>& entry : frequency)
+        {
+            if (entry.second > 1)
+                entries.push_back(entry);
+        }
+        std::sort(entries.begin(), entries.end(), [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        put_varint(dictionaries, (uint32_t)entries.size());
+        std::unordered_map<uint32_t, uint32_t> index;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            uint32_t value = entries[i].first;
+            for (int b = 0; b < 4; b++)
+                dictionaries.push_back((char)(value >> (b * 8)));
+            index[value] = (uint32_t)i + 1;
+        }
+        put_varint(dictionaries, (uint32_t)(frequency.size() - entries.size()));
+        for (uint32_t value : split.values[stream])
+        {
+            std::unordered_map<uint32_t, uint32_t>::const_iterator found = index.find(value);
+            if (found == index.end())
+            {
+                put_varint(streams[stream], 0);
+                for (int b = 0; b < 4; b++)
+                    dictionaries.push_back((char)(value >> (b * 8)));
+            }
+            else
+            {
+                put_varint(streams[stream], found->second);
+            }
+        }
+    }
+    for (int stream : { STREAM_COMPONENTS, STREAM_SWIZZLE, STREAM_SELECT })
+    {
+        for (uint32_t value : split.values[stream])
+            streams[stream].push_back((char)value);
+    }
+    for (int stream : { STREAM_MISC, STREAM_INDEX, STREAM_ICB })
+    {
+        for (uint32_t value : split.values[stream])
+            put_varint(streams[stream], value);
+    }
+    const char* bytes = (const char*)data;
+    streams[STREAM_PREFIX].assign(bytes, bytes + offset);
+    streams[STREAM_PREFIX].insert(streams[STREAM_PREFIX].end(), bytes + offset + count * 4, bytes + size);
+
+    for (int b = 0; b < 4; b++)
+        out.push_back((char)(TOKEN_CODEC_MAGIC >> (b * 8)));
+    put_varint(out, TOKEN_CODEC_VERSION);
+    put_varint(out, (uint32_t)size);
+    put_varint(out, (uint32_t)offset);
+    put_varint(out, count);
+    for (int stream = 0; stream < STREAM_COUNT; stream++)
+        put_stream((const uint8_t*)streams[stream].data(), streams[stream].size(), out);
+    return true;
+}
+
+namespace {
+
+bool read_header(byte_reader& in, uint32_t& version, uint32_t& size, uint32_t& offset, uint32_t& count)
+{
+    uint32_t magic;
+    if (in.end - in.p < 4)
+        return false;
+    memcpy(&magic, in.p, 4);
+    in.p += 4;
+    bool failed = false;
+    if (bswap_le32(magic) != TOKEN_CODEC_MAGIC)
+        return false;
+    // Version 2 adds stream modes and the swizzle and select streams; version 1 files still read.
+    version = in.varint(failed);
+    if (version < 1 || version > TOKEN_CODEC_VERSION)
+        return false;
+    size = in.varint(failed);
+    offset = in.varint(failed);
+    count = in.varint(failed);
+    return !failed && offset <= size && count <= (size - offset) / 4;
+}
+
+} // namespace
+
+size_t token_decompressed_size(const void* data, size_t size)
+{
+    byte_reader in = { (const uint8_t*)data, (const uint8_t*)data + size };
+    uint32_t version, original_size, offset, count;
+    return read_header(in, version, original_size, offset, count) ? original_size : 0;
+}
+
+bool token_decompress(const void* data, size_t size, void* out, size_t out_size, fxdis_arena* arena)
+{
+    byte_reader in = { (const uint8_t*)data, (const uint8_t*)data + size };
+    uint32_t version, original_size, offset, count;
+    if (!read_header(in, version, original_size, offset, count) || original_size != out_size)
+        return false;
+
+    // No stream can usefully be larger than five bytes per token plus the dictionary counts.
+    size_t limit = (size_t)out_size * 5 + 64;
+    std::vector<byte_buffer, arena_allocator<byte_buffer> > storage(STREAM_COUNT, byte_buffer(arena), arena_allocator<byte_buffer>(arena));
+    join_source join;
+    memset(join.streams, 0, sizeof(join.streams));
+    memset(join.literals, 0, sizeof(join.literals));
+    for (int stream = 0; stream < (version == 1 ? VERSION_1_STREAMS : STREAM_COUNT); stream++)
+    {
+        if (!get_stream(in, limit, storage[stream], join.streams[stream]))
+            return false;
+    }
+    if (in.p != in.end)
+        return false;
+
+    byte_reader& prefix = join.streams[STREAM_PREFIX];
+    size_t tail = out_size - offset - (size_t)count * 4;
+    if ((size_t)(prefix.end - prefix.p) != offset + tail)
+        return false;
+    char* bytes = (char*)out;
+    if (offset)
+        memcpy(bytes, prefix.p, offset);
+    if (tail)
+        memcpy(bytes + offset + (size_t)count * 4, prefix.p + offset, tail);
+
+    join.component_kinds = version == 1 ? version_1_component_kinds : component_kinds;
+    for (int kind = 0; kind < COMPONENT_KINDS; kind++)
+    {
+        byte_reader& stream = join.streams[component_kind_streams[kind]];
+        join.components[kind] = stream;
+        stream.p = stream.end;
+    }
+    join.failed = false;
+    byte_reader& dictionaries = join.streams[STREAM_DICTIONARY];
+    for (int stream : dictionary_streams)
+    {
+        uint32_t entries = dictionaries.varint(join.failed);
+        if (join.failed || entries > (size_t)(dictionaries.end - dictionaries.p) / 4)
+            return false;
+        join.dictionary[stream] = (const char*)dictionaries.p;
+        join.dictionary_size[stream] = entries;
+        dictionaries.p += entries * 4;
+        uint32_t literals = dictionaries.varint(join.failed);
+        if (join.failed || literals > (size_t)(dictionaries.end - dictionaries.p) / 4)
+            return false;
+        join.literals[stream].p = dictionaries.p;
+        join.literals[stream].end = dictionaries.p + literals * 4;
+        dictionaries.p += literals * 4;
+    }
+    if (dictionaries.p != dictionaries.end)
+        return false;
+
+    join.tokens = bytes + offset;
+    memset(join.previous_index, 0, sizeof(join.previous_index));
+    join.previous_icb = 0;
+    program_walker<join_source> walker(join);
+    walker.program(count);
+    if (join.failed)
+        return false;
+    for (int stream = STREAM_MISC; stream < STREAM_COUNT; stream++)
+    {
+        if (join.streams[stream].p != join.streams[stream].end || join.literals[stream].p != join.literals[stream].end)
+            return false;
+    }
+    for (const byte_reader& components : join.components)
+    {
+        if (components.p != components.end)
+            return false;
+    }
+    return true;
+}
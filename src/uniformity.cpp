@@ -0,0 +1,523 @@
+#include "uniformity.h"
+#include "cost_model.h"
+#include <algorithm>
+
+const char* uniformity_branch_text[] = {
+    "",
+    "uniform",
+    "divergent",
+};
+
+bool uniformity_takes_derivatives(D3D10_SB_OPCODE_TYPE opcode)
+{
+    switch (opcode)
+    {
+    case D3D10_SB_OPCODE_DERIV_RTX:
+    case D3D10_SB_OPCODE_DERIV_RTY:
+    case D3D11_SB_OPCODE_DERIV_RTX_COARSE:
+    case D3D11_SB_OPCODE_DERIV_RTX_FINE:
+    case D3D11_SB_OPCODE_DERIV_RTY_COARSE:
+    case D3D11_SB_OPCODE_DERIV_RTY_FINE:
+    case D3D10_SB_OPCODE_SAMPLE:
+    case D3D10_SB_OPCODE_SAMPLE_B:
+    case D3D10_SB_OPCODE_SAMPLE_C:
+    case D3D10_1_SB_OPCODE_LOD:
+    case D3DWDDM1_3_SB_OPCODE_SAMPLE_CLAMP_FEEDBACK:
+    case D3DWDDM1_3_SB_OPCODE_SAMPLE_B_CLAMP_FEEDBACK:
+    case D3DWDDM1_3_SB_OPCODE_SAMPLE_C_CLAMP_FEEDBACK:
+        return true;
+    default:
+        return false;
+    }
+}
+
+namespace {
+
+// Operands that are the same for every lane, besides the temps, which are tracked.
+bool is_uniform_type(uint32_t type)
+{
+    switch (type)
+    {
+    case D3D10_SB_OPERAND_TYPE_IMMEDIATE32:
+    case D3D10_SB_OPERAND_TYPE_IMMEDIATE64:
+    case D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER:
+    case D3D10_SB_OPERAND_TYPE_IMMEDIATE_CONSTANT_BUFFER:
+    case D3D11_SB_OPERAND_TYPE_INPUT_THREAD_GROUP_ID:
+    case D3D10_SB_OPERAND_TYPE_SAMPLER:
+    case D3D10_SB_OPERAND_TYPE_RESOURCE:
+    case D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW:
+    case D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY:
+    case D3D10_SB_OPERAND_TYPE_LABEL:
+    case D3D10_SB_OPERAND_TYPE_NULL:
+    case D3D10_SB_OPERAND_TYPE_RASTERIZER:
+    case D3D11_SB_OPERAND_TYPE_STREAM:
+    case D3D11_SB_OPERAND_TYPE_FUNCTION_BODY:
+    case D3D11_SB_OPERAND_TYPE_FUNCTION_TABLE:
+    case D3D11_SB_OPERAND_TYPE_INTERFACE:
+    case D3D11_SB_OPERAND_TYPE_THIS_POINTER:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Instructions whose results differ from lane to lane whatever their sources.
+bool gives_divergent(D3D10_SB_OPCODE_TYPE opcode)
+{
+    switch (opcode)
+    {
+    case D3D10_SB_OPCODE_RESINFO:
+    case D3D11_SB_OPCODE_BUFINFO:
+    case D3D10_1_SB_OPCODE_SAMPLE_INFO:
+    case D3D10_1_SB_OPCODE_SAMPLE_POS:
+        return false;
+    default:
+        break;
+    }
+    uint32_t c = cost_class_of(opcode);
+    return c == COST_CLASS_TEXTURE || c == COST_CLASS_MEMORY || uniformity_takes_derivatives(opcode);
+}
+
+bool has_condition(D3D10_SB_OPCODE_TYPE opcode)
+{
+    switch (opcode)
+    {
+    case D3D10_SB_OPCODE_IF:
+    case D3D10_SB_OPCODE_SWITCH:
+    case D3D10_SB_OPCODE_BREAKC:
+    case D3D10_SB_OPCODE_CONTINUEC:
+    case D3D10_SB_OPCODE_RETC:
+    case D3D10_SB_OPCODE_CALLC:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// if, loop and switch still open during the walk over a function.
+struct open_construct
+{
+    D3D10_SB_OPCODE_TYPE opcode;
+    uint32_t instruction;
+    bool divergent;
+};
+
+// Sets hold four bits per r# register, then, from a word boundary, four bits per x# array; a set
+// bit is a divergent component.
+class analysis
+{
+public:
+    analysis(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands, const cfg& graph,
+        uniformity& result)
+        : instructions(instructions), count(count), operands(operands), graph(graph), result(result), temps(0), arrays(0)
+    {
+    }
+
+    bool run()
+    {
+        if (!size_sets())
+            return false;
+        uint32_t blocks = (uint32_t)graph.blocks.size();
+        uint32_t functions = (uint32_t)graph.functions.size();
+        block_in.assign((size_t)blocks * words, 0);
+        block_out.assign((size_t)blocks * words, 0);
+        entry.assign((size_t)functions * words, 0);
+        exit.assign((size_t)functions * words, 0);
+        state.resize(words);
+        divergent_function.assign(functions, 0);
+        divergent_construct.assign(count, 0);
+        result.branches.assign(count, UNIFORMITY_NOT_A_BRANCH);
+        result.divergent_blocks.assign(blocks, 0);
+
+        // Divergent places only grow, and values with them, so each round starts from the last.
+        do
+            solve_values();
+        while (classify());
+
+        result.divergent_derivatives.clear();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (uniformity_takes_derivatives(instructions[i].opcode) && result.divergent_blocks[graph.block_of[i]])
+                result.divergent_derivatives.push_back(i);
+        }
+        return true;
+    }
+
+private:
+    bool size_sets()
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const DecodedInstruction& inst = instructions[i];
+            if (IsDeclaration(inst.opcode))
+                continue;
+            for (uint32_t o = 0; o < (uint32_t)inst.operandCount + inst.relativeCount; o++)
+            {
+                const DecodedOperand& operand = operands[inst.firstOperand + o];
+                if ((operand.type != D3D10_SB_OPERAND_TYPE_TEMP && operand.type != D3D10_SB_OPERAND_TYPE_INDEXABLE_TEMP)
+                    || operand.indexDim < 1)
+                    continue;
+                uint64_t index = operand.index[0].value;
+                if (index >= UNIFORMITY_MAX_REGISTERS)
+                    return false;
+                uint32_t& used = operand.type == D3D10_SB_OPERAND_TYPE_TEMP ? temps : arrays;
+                used = (uint32_t)index + 1 > used ? (uint32_t)index + 1 : used;
+            }
+        }
+        array_base = (temps * 4 + 63) / 64 * 64;
+        // At least one word, so that programs without temps need no special case.
+        words = (array_base + arrays * 4 + 63) / 64;
+        words = words ? words : 1;
+        return true;
+    }
+
+    bool index_divergent(const uint64_t* set, const DecodedOperand& operand) const
+    {
+        for (uint32_t d = 0; d < operand.indexDim && d < 3; d++)
+        {
+            uint32_t relative = operand.index[d].relative;
+            if (relative != DECODED_NO_OPERAND
+                && divergent_components(set, operands[relative], ComponentsRead(operands[relative], 1)))
+                return true;
+        }
+        return false;
+    }
+
+    // Components of the mask that are divergent in the operand, as read: from the registers it
+    // names, or all of them if any of its indices is divergent.
+    uint32_t divergent_components(const uint64_t* set, const DecodedOperand& operand, uint32_t components) const
+    {
+        components &= 0xf;
+        if (index_divergent(set, operand))
+            return components;
+        uint32_t bit;
+        if (operand.type == D3D10_SB_OPERAND_TYPE_TEMP && operand.indexDim >= 1)
+            bit = (uint32_t)operand.index[0].value * 4;
+        else if (operand.type == D3D10_SB_OPERAND_TYPE_INDEXABLE_TEMP && operand.indexDim >= 1)
+            bit = array_base + (uint32_t)operand.index[0].value * 4;
+        else
+            return is_uniform_type(operand.type) ? 0 : components;
+        return (uint32_t)(set[bit / 64] >> (bit % 64)) & components;
+    }
+
+    bool condition_divergent(const uint64_t* set, const DecodedInstruction& inst) const
+    {
+        if (inst.operandCount < 1)
+            return false;
+        const DecodedOperand& condition = operands[inst.firstOperand];
+        return divergent_components(set, condition, ComponentsRead(condition, 1)) != 0;
+    }
+
+    // Moves set forward over one instruction, which runs in divergent flow if divergent is set.
+    void step(uint64_t* set, const DecodedInstruction& inst, bool divergent) const
+    {
+        if (IsDeclaration(inst.opcode))
+            return;
+        const DecodedOperand* ops = operands + inst.firstOperand;
+        uint32_t destinations = DestinationCount(inst.opcode);
+        destinations = destinations < inst.operandCount ? destinations : inst.operandCount;
+        if (destinations == 0)
+            return;
+
+        // Positions of the result that are divergent.
+        uint32_t positions = 0;
+        if (divergent || gives_divergent(inst.opcode))
+        {
+            positions = 0xf;
+        }
+        else
+        {
+            uint32_t read = SourcePositions(inst, operands);
+            for (uint32_t o = destinations; o < inst.operandCount; o++)
+            {
+                if (!divergent_components(set, ops[o], ComponentsRead(ops[o], read)))
+                    continue;
+                for (uint32_t p = 0; p < 4; p++)
+                {
+                    if ((read & (1 << p)) && divergent_components(set, ops[o], ComponentsRead(ops[o], 1 << p)))
+                        positions |= 1 << p;
+                }
+            }
+            if (positions && !IsComponentwise(inst.opcode))
+                positions = 0xf;
+        }
+
+        for (uint32_t o = 0; o < destinations; o++)
+        {
+            const DecodedOperand& dest = ops[o];
+            if ((dest.type != D3D10_SB_OPERAND_TYPE_TEMP && dest.type != D3D10_SB_OPERAND_TYPE_INDEXABLE_TEMP)
+                || dest.indexDim < 1)
+                continue;
+            uint32_t mask = dest.numComponents == 4 && dest.selectionMode == D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE
+                ? dest.mask & 0xf : 0xf;
+            uint32_t bit;
+            if (dest.type == D3D10_SB_OPERAND_TYPE_TEMP)
+            {
+                bit = (uint32_t)dest.index[0].value * 4;
+                set[bit / 64] &= ~((uint64_t)mask << (bit % 64));
+            }
+            else
+            {
+                // One element of the array is written and the rest keep what they had, so nothing
+                // turns uniform. A divergent index makes every component written divergent.
+                bit = array_base + (uint32_t)dest.index[0].value * 4;
+                if (index_divergent(set, dest))
+                    set[bit / 64] |= (uint64_t)mask << (bit % 64);
+            }
+            set[bit / 64] |= (uint64_t)(positions & mask) << (bit % 64);
+        }
+    }
+
+    uint32_t callee_of(uint32_t instruction) const
+    {
+        // Calls are recorded in program order.
+        uint32_t low = 0;
+        uint32_t high = (uint32_t)graph.calls.size();
+        while (low < high)
+        {
+            uint32_t middle = (low + high) / 2;
+            if (graph.calls[middle].instruction < instruction)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if (low == graph.calls.size() || graph.calls[low].instruction != instruction)
+            return CFG_NONE;
+        uint32_t callee = graph.calls[low].callee;
+        return callee != CFG_NONE && graph.functions[callee].first_block != graph.functions[callee].end_block ? callee : CFG_NONE;
+    }
+
+    // Adds what is divergent at a call to the callee's entry, and continues with what is divergent
+    // where it returns. Returns true if the entry grew.
+    bool enter_call(uint32_t callee, uint64_t* set)
+    {
+        bool grew = false;
+        uint64_t* in = &entry[(size_t)callee * words];
+        for (uint32_t w = 0; w < words; w++)
+        {
+            grew |= (set[w] & ~in[w]) != 0;
+            in[w] |= set[w];
+            set[w] = exit[(size_t)callee * words + w];
+        }
+        return grew;
+    }
+
+    static bool merge(uint64_t* to, const uint64_t* from, uint32_t words)
+    {
+        bool grew = false;
+        for (uint32_t w = 0; w < words; w++)
+        {
+            grew |= (from[w] & ~to[w]) != 0;
+            to[w] |= from[w];
+        }
+        return grew;
+    }
+
+    // Forward fixpoint of the divergent sets over every block, with the divergent blocks as they
+    // are now.
+    void solve_values()
+    {
+        uint32_t blocks = (uint32_t)graph.blocks.size();
+        dirty.assign(blocks, 1);
+        bool pending = true;
+        while (pending)
+        {
+            pending = false;
+            for (uint32_t b = 0; b < blocks; b++)
+            {
+                if (!dirty[b])
+                    continue;
+                dirty[b] = 0;
+                const cfg_block& block = graph.blocks[b];
+                uint64_t* in = &block_in[(size_t)b * words];
+                if (b == graph.functions[block.function].first_block)
+                    merge(in, &entry[(size_t)block.function * words], words);
+                for (uint32_t e = block.first_predecessor; e < block.first_predecessor + block.predecessor_count; e++)
+                    merge(in, &block_out[(size_t)graph.predecessors[e].from * words], words);
+
+                std::copy(in, in + words, state.begin());
+                for (uint32_t i = block.first; i < block.end; i++)
+                {
+                    const DecodedInstruction& inst = instructions[i];
+                    step(state.data(), inst, result.divergent_blocks[b] != 0);
+                    uint32_t callee = inst.opcode == D3D10_SB_OPCODE_CALL || inst.opcode == D3D10_SB_OPCODE_CALLC
+                        ? callee_of(i) : CFG_NONE;
+                    if (callee != CFG_NONE && enter_call(callee, state.data()))
+                        pending |= touch(graph.functions[callee].first_block, b);
+                }
+                if (merge(&block_out[(size_t)b * words], state.data(), words))
+                {
+                    for (uint32_t e = block.first_successor; e < block.first_successor + block.successor_count; e++)
+                        pending |= touch(graph.successors[e].to, b);
+                }
+                if ((block.flags & CFG_BLOCK_EXIT) && merge(&exit[(size_t)block.function * words], state.data(), words))
+                {
+                    for (const cfg_call& call : graph.calls)
+                    {
+                        if (call.callee == block.function)
+                            pending |= touch(call.block, b);
+                    }
+                }
+            }
+        }
+    }
+
+    // Marks a block to be walked again; returns true if that takes another sweep.
+    bool touch(uint32_t block, uint32_t current)
+    {
+        dirty[block] = 1;
+        return block <= current;
+    }
+
+    // Classifies every branch with the sets as solved, and marks the constructs, blocks and
+    // functions that are divergent because of them. Returns true if any new block became divergent.
+    bool classify()
+    {
+        bool grew = false;
+        for (uint32_t f = 0; f < graph.functions.size(); f++)
+        {
+            const cfg_function& function = graph.functions[f];
+            bool tail = false;          // a divergent return has been passed
+            uint32_t divergent_open = 0;
+            open.clear();
+            for (uint32_t b = function.first_block; b < function.end_block; b++)
+            {
+                const cfg_block& block = graph.blocks[b];
+                std::copy(&block_in[(size_t)b * words], &block_in[(size_t)b * words] + words, state.begin());
+                for (uint32_t i = block.first; i < block.end; i++)
+                {
+                    const DecodedInstruction& inst = instructions[i];
+                    if ((inst.opcode == D3D10_SB_OPCODE_ENDIF || inst.opcode == D3D10_SB_OPCODE_ENDSWITCH) && !open.empty())
+                    {
+                        divergent_open -= open.back().divergent;
+                        open.pop_back();
+                    }
+                    bool divergent = divergent_function[f] || tail || divergent_open > 0;
+                    if (i == block.first && divergent && !result.divergent_blocks[b])
+                    {
+                        result.divergent_blocks[b] = 1;
+                        grew = true;
+                    }
+
+                    bool condition = has_condition(inst.opcode) && condition_divergent(state.data(), inst);
+                    if (has_condition(inst.opcode))
+                        result.branches[i] = condition ? UNIFORMITY_DIVERGENT : UNIFORMITY_UNIFORM;
+                    switch (inst.opcode)
+                    {
+                    case D3D10_SB_OPCODE_IF:
+                    case D3D10_SB_OPCODE_SWITCH:
+                    case D3D10_SB_OPCODE_LOOP:
+                    {
+                        open_construct construct = { inst.opcode, i, condition || divergent_construct[i] };
+                        open.push_back(construct);
+                        divergent_open += construct.divergent;
+                        if (inst.opcode == D3D10_SB_OPCODE_LOOP)
+                            result.branches[i] = divergent_construct[i] ? UNIFORMITY_DIVERGENT : UNIFORMITY_UNIFORM;
+                        break;
+                    }
+                    case D3D10_SB_OPCODE_BREAK:
+                    case D3D10_SB_OPCODE_BREAKC:
+                    case D3D10_SB_OPCODE_CONTINUE:
+                    case D3D10_SB_OPCODE_CONTINUEC:
+                        if (divergent || condition)
+                        {
+                            // break leaves the innermost loop or switch, continue the innermost loop.
+                            bool is_break = inst.opcode == D3D10_SB_OPCODE_BREAK || inst.opcode == D3D10_SB_OPCODE_BREAKC;
+                            for (size_t k = open.size(); k-- > 0;)
+                            {
+                                if (open[k].opcode == D3D10_SB_OPCODE_LOOP || (is_break && open[k].opcode == D3D10_SB_OPCODE_SWITCH))
+                                {
+                                    grew |= mark(open[k], divergent_open);
+                                    break;
+                                }
+                            }
+                        }
+                        break;
+                    case D3D10_SB_OPCODE_RET:
+                    case D3D10_SB_OPCODE_RETC:
+                        if (divergent || condition)
+                        {
+                            // Some lanes go on past the return: the rest of the function, and every
+                            // loop it leaves, is divergent.
+                            tail = true;
+                            for (open_construct& construct : open)
+                            {
+                                if (construct.opcode == D3D10_SB_OPCODE_LOOP)
+                                    grew |= mark(construct, divergent_open);
+                            }
+                        }
+                        break;
+                    case D3D10_SB_OPCODE_CALL:
+                    case D3D10_SB_OPCODE_CALLC:
+                    {
+                        uint32_t callee = callee_of(i);
+                        if ((divergent || condition) && callee != CFG_NONE && !divergent_function[callee])
+                        {
+                            divergent_function[callee] = 1;
+                            grew = true;
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                    }
+
+                    step(state.data(), inst, result.divergent_blocks[b] != 0);
+                    uint32_t callee = inst.opcode == D3D10_SB_OPCODE_CALL || inst.opcode == D3D10_SB_OPCODE_CALLC
+                        ? callee_of(i) : CFG_NONE;
+                    if (callee != CFG_NONE)
+                        std::copy(&exit[(size_t)callee * words], &exit[(size_t)callee * words] + words, state.begin());
+                    if (inst.opcode == D3D10_SB_OPCODE_ENDLOOP && !open.empty())
+                    {
+                        divergent_open -= open.back().divergent;
+                        open.pop_back();
+                    }
+                }
+            }
+        }
+        return grew;
+    }
+
+    // Marks a loop or switch divergent from here on, and in the rounds that follow.
+    bool mark(open_construct& construct, uint32_t& divergent_open)
+    {
+        bool grew = !divergent_construct[construct.instruction];
+        divergent_construct[construct.instruction] = 1;
+        if (!construct.divergent)
+        {
+            construct.divergent = true;
+            divergent_open++;
+        }
+        if (construct.opcode == D3D10_SB_OPCODE_LOOP)
+            result.branches[construct.instruction] = UNIFORMITY_DIVERGENT;
+        return grew;
+    }
+
+    const DecodedInstruction* instructions;
+    uint32_t count;
+    const DecodedOperand* operands;
+    const cfg& graph;
+    uniformity& result;
+    uint32_t temps;
+    uint32_t arrays;
+    uint32_t array_base;        // first bit of the x# arrays
+    uint32_t words;
+    std::vector<uint64_t> block_in;
+    std::vector<uint64_t> block_out;
+    std::vector<uint64_t> entry;        // per function: divergent at any of its calls
+    std::vector<uint64_t> exit;         // per function: divergent where it returns
+    std::vector<uint64_t> state;
+    std::vector<uint8_t> dirty;                 // blocks whose inputs grew since they were walked
+    std::vector<uint8_t> divergent_function;
+    std::vector<uint8_t> divergent_construct;   // per loop and switch instruction
+    std::vector<open_construct> open;
+};
+
+} // namespace
+
+bool uniformity_analyze(const DecodedInstruction* instructions, uint32_t count, const DecodedOperand* operands,
+    const cfg& graph, uniformity& result)
+{
+    analysis run(instructions, count, operands, graph, result);
+    return run.run();
+}
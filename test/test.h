@@ -0,0 +1,83 @@
+#ifndef TEST_H_
+#define TEST_H_
+
+// Shared by the analysis tests: programs are assembled with bench/shader_builder.h, decoded the way
+// fxdis decodes them, and checked against values worked out by hand. A test prints every check that
+// fails and exits with EXIT_FAILURE if any did.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <iostream>
+#include "shader_builder.h"
+#include "D3D11TokenParser.h"
+#include "cfg.h"
+
+static int test_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #condition " does not hold\n"; \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        auto actual_value = (actual); \
+        auto expected_value = (expected); \
+        if (!(actual_value == expected_value)) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " is " << +actual_value << ", expected " \
+                << +expected_value << "\n"; \
+            test_failures++; \
+        } \
+    } while (0)
+
+inline int test_result(const char* name)
+{
+    if (test_failures)
+        std::cerr << name << ": " << test_failures << " checks failed" << std::endl;
+    return test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// A program decoded into instructions and one operand pool, with its control-flow graph.
+struct test_program
+{
+    tokens program;
+    std::vector<DecodedInstruction> instructions;
+    DecodedOperandPool operands;
+    cfg graph;
+
+    // Decodes program and builds the graph; false if either fails.
+    bool load(tokens&& t)
+    {
+        program = std::move(t);
+        instructions.clear();
+        operands.clear();
+        TokenDecoder decoder(program.data(), (uint32_t)(program.size() * 4));
+        if (decoder.DecodeHeader() != DECODE_STATUS::OK)
+            return false;
+        DecodedInstruction inst;
+        DECODE_STATUS status;
+        while ((status = decoder.Next(inst, operands)) == DECODE_STATUS::OK)
+            instructions.push_back(inst);
+        return status == DECODE_STATUS::END && cfg_build(instructions.data(), count(), operands.data(), graph);
+    }
+
+    uint32_t count() const { return (uint32_t)instructions.size(); }
+};
+
+inline tokens temp(uint32_t index, uint32_t mask = D3D10_SB_OPERAND_4_COMPONENT_MASK_ALL)
+{
+    return dst(D3D10_SB_OPERAND_TYPE_TEMP, index, mask);
+}
+
+inline uint32_t test_nonzero()
+{
+    return ENCODE_D3D10_SB_INSTRUCTION_TEST_BOOLEAN(D3D10_SB_INSTRUCTION_TEST_NONZERO);
+}
+
+#endif /* TEST_H_ */
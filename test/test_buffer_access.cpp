@@ -0,0 +1,141 @@
+// buffer_access_analyze on a hand-assembled compute shader under the default profile, whose waves
+// are 64 lanes and cache lines 64 bytes.
+
+#include "test.h"
+#include "buffer_access.h"
+
+namespace {
+
+tokens thread_id_in_group_x()
+{
+    return { operand_token(D3D11_SB_OPERAND_TYPE_INPUT_THREAD_ID_IN_GROUP, D3D10_SB_OPERAND_4_COMPONENT, 0) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SELECT_1_MODE) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECT_1(0) };
+}
+
+tokens r_x(uint32_t index)
+{
+    return select1(D3D10_SB_OPERAND_TYPE_TEMP, index, 0);
+}
+
+const uint32_t mask_x = D3D10_SB_OPERAND_4_COMPONENT_MASK_X;
+
+//   0 dcl_input vThreadIDInGroup.x
+//   1 dcl_resource_structured t0, 20           unaligned_stride: 20 straddles 16-byte boundaries
+//   2 dcl_resource_structured t1, 32
+//   3 dcl_resource_raw t2
+//   4 dcl_uav_raw u0
+//   5 dcl_uav_structured u1, 16
+//   6 dcl_thread_group 64, 1, 1
+//   7 ld_structured r0.x, vThreadIDInGroup.x, l(4), t1.x
+//                                              partial_load: 4 of 32 bytes, efficiency 0.125;
+//                                              strided: 32 bytes apart, two lanes use 8 bytes of
+//                                              each 64-byte line, efficiency 0.125
+//   8 ishl r1.x, vThreadIDInGroup.x, l(2)
+//   9 store_raw u0.x, r1.x, r0.x              contiguous: nothing to report
+//  10 ld_raw r2.x, l(0), t2.x                 every lane reads the same dword: a broadcast
+//  11 ld_structured r3.xyzw, r0.x, l(0), u1.xyzw
+//                                              scattered: the index was loaded; the whole structure
+//                                              is read, so no partial_load
+//  12 ld_structured r4.x, vThreadIDInGroup.x, l(0), t0.x
+//                                              partial_load: 4 of 20 bytes; 20 bytes apart, so
+//                                              lines are used at 4 / 20 = 0.2
+//  13 ret
+void test_findings()
+{
+    program_builder b(D3D11_SB_COMPUTE_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_DCL_INPUT, special_dst(D3D11_SB_OPERAND_TYPE_INPUT_THREAD_ID_IN_GROUP, D3D10_SB_OPERAND_4_COMPONENT, mask_x));
+    b.op(D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED, cat({ resource(D3D10_SB_OPERAND_TYPE_RESOURCE, 0), { 20 } }));
+    b.op(D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED, cat({ resource(D3D10_SB_OPERAND_TYPE_RESOURCE, 1), { 32 } }));
+    b.op(D3D11_SB_OPCODE_DCL_RESOURCE_RAW, resource(D3D10_SB_OPERAND_TYPE_RESOURCE, 2));
+    b.op(D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW, resource(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 0));
+    b.op(D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED,
+        cat({ resource(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 1), { 16 } }));
+    b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP, { 64, 1, 1 });
+    b.op(D3D11_SB_OPCODE_LD_STRUCTURED, cat({ temp(0, mask_x), thread_id_in_group_x(), imm32_scalar(4),
+        src(D3D10_SB_OPERAND_TYPE_RESOURCE, 1) }));
+    b.op(D3D10_SB_OPCODE_ISHL, cat({ temp(1, mask_x), thread_id_in_group_x(), imm32_scalar(2) }));
+    b.op(D3D11_SB_OPCODE_STORE_RAW, cat({ dst(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 0, mask_x), r_x(1), r_x(0) }));
+    b.op(D3D11_SB_OPCODE_LD_RAW, cat({ temp(2, mask_x), imm32_scalar(0), src(D3D10_SB_OPERAND_TYPE_RESOURCE, 2) }));
+    b.op(D3D11_SB_OPCODE_LD_STRUCTURED, cat({ temp(3), r_x(0), imm32_scalar(0),
+        src(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 1) }));
+    b.op(D3D11_SB_OPCODE_LD_STRUCTURED, cat({ temp(4, mask_x), thread_id_in_group_x(), imm32_scalar(0),
+        src(D3D10_SB_OPERAND_TYPE_RESOURCE, 0) }));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    hardware_profile profile;
+    hardware_profile_default(profile);
+    buffer_report report;
+    CHECK(buffer_access_analyze(p.instructions.data(), p.count(), p.operands.data(), p.graph, profile, report));
+    CHECK_EQ(report.findings.size(), 6u);
+    if (report.findings.size() != 6)
+        return;
+    const buffer_finding* f = report.findings.data();
+
+    CHECK_EQ(f[0].kind, (uint32_t)BUFFER_UNALIGNED_STRIDE);
+    CHECK_EQ(f[0].instruction, 1u);
+    CHECK_EQ(f[0].reg, 0u);
+    CHECK_EQ(f[0].stride, 20u);
+
+    CHECK_EQ(f[1].kind, (uint32_t)BUFFER_PARTIAL_LOAD);
+    CHECK_EQ(f[1].instruction, 7u);
+    CHECK_EQ(f[1].type, (uint32_t)D3D10_SB_OPERAND_TYPE_RESOURCE);
+    CHECK_EQ(f[1].reg, 1u);
+    CHECK_EQ(f[1].bytes, 4u);
+    CHECK_EQ(f[1].efficiency, 0.125);
+
+    CHECK_EQ(f[2].kind, (uint32_t)BUFFER_STRIDED);
+    CHECK_EQ(f[2].instruction, 7u);
+    CHECK_EQ(f[2].efficiency, 0.125);
+    CHECK_EQ(f[2].address.kind, (uint32_t)THREAD_AFFINE_EXACT);
+    CHECK_EQ(f[2].address.constant, 4u);
+    CHECK_EQ(f[2].address.k[0], 32u);
+
+    CHECK_EQ(f[3].kind, (uint32_t)BUFFER_SCATTERED);
+    CHECK_EQ(f[3].instruction, 11u);
+    CHECK_EQ(f[3].type, (uint32_t)D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW);
+    CHECK_EQ(f[3].bytes, 16u);
+
+    CHECK_EQ(f[4].kind, (uint32_t)BUFFER_PARTIAL_LOAD);
+    CHECK_EQ(f[4].instruction, 12u);
+    CHECK_EQ(f[4].efficiency, 0.2);
+
+    CHECK_EQ(f[5].kind, (uint32_t)BUFFER_STRIDED);
+    CHECK_EQ(f[5].instruction, 12u);
+    CHECK_EQ(f[5].efficiency, 0.2);
+    CHECK_EQ(f[5].address.k[0], 20u);
+}
+
+// Outside compute shaders only strides and partial loads are checked.
+void test_pixel_shader()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED, cat({ resource(D3D10_SB_OPERAND_TYPE_RESOURCE, 0), { 8 } }));
+    b.op(D3D11_SB_OPCODE_LD_STRUCTURED, cat({ temp(0, D3D10_SB_OPERAND_4_COMPONENT_MASK_Y), r_x(0), imm32_scalar(0),
+        src(D3D10_SB_OPERAND_TYPE_RESOURCE, 0) }));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    hardware_profile profile;
+    hardware_profile_default(profile);
+    buffer_report report;
+    CHECK(buffer_access_analyze(p.instructions.data(), p.count(), p.operands.data(), p.graph, profile, report));
+    // an 8-byte stride divides 16; the y destination reads the buffer's y of 2 dwords
+    CHECK_EQ(report.findings.size(), 1u);
+    if (report.findings.size() != 1)
+        return;
+    CHECK_EQ(report.findings[0].kind, (uint32_t)BUFFER_PARTIAL_LOAD);
+    CHECK_EQ(report.findings[0].efficiency, 0.5);
+}
+
+} // namespace
+
+int main()
+{
+    test_findings();
+    test_pixel_shader();
+    return test_result("test_buffer_access");
+}
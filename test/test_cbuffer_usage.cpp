@@ -0,0 +1,131 @@
+// cbuffer_usage_analyze on a hand-assembled pixel shader reading two constant buffers, one of them
+// by a register index, with and without a layout from RDEF.
+
+#include "test.h"
+#include "cbuffer_usage.h"
+
+namespace {
+
+// cb#[element] with every component replicated from one.
+tokens cb_replicated(uint32_t slot, uint32_t element, uint32_t component)
+{
+    tokens operand = src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, slot, element);
+    operand[0] = (operand[0] & ~D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MASK) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE(component, component, component, component);
+    return operand;
+}
+
+// cb#[r#.x + offset]
+tokens cb_relative(uint32_t slot, uint32_t offset, uint32_t index_register)
+{
+    return cat({ { operand_token(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, D3D10_SB_OPERAND_4_COMPONENT, 2) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SWIZZLE_MODE) |
+        D3D10_SB_OPERAND_4_COMPONENT_NOSWIZZLE |
+        ENCODE_D3D10_SB_OPERAND_INDEX_REPRESENTATION(1, D3D10_SB_OPERAND_INDEX_IMMEDIATE32_PLUS_RELATIVE), slot, offset },
+        select1(D3D10_SB_OPERAND_TYPE_TEMP, index_register, 0) });
+}
+
+//   0 dcl_constantbuffer cb0[4], immediateIndexed
+//   1 dcl_constantbuffer cb1[8], dynamicIndexed
+//   2 mov r0, cb0[0]                  cb0[0].xyzw, bytes 0-15
+//   3 dp2 r1.x, cb0[2], r0            cb0[2].xy, bytes 32-39
+//   4 mov r2.x, cb0[3].yyyy           cb0[3].y, bytes 52-55
+//   5 mov r3, cb1[r0.x + 5]           cb1[5] to the end, bytes 80-127
+//   6 ret
+//
+// cb0: 64 bytes declared, 28 read, the last at byte 55, so 28 unused before it and 8 after.
+// cb1: 128 bytes declared, 48 read, 80 unused before them and none after.
+void build(test_program& p)
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER, src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 4));
+    b.op(D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER, src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 1, 8),
+        ENCODE_D3D10_SB_D3D10_SB_CONSTANT_BUFFER_ACCESS_PATTERN(D3D10_SB_CONSTANT_BUFFER_DYNAMIC_INDEXED));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(0), src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 0) }));
+    b.op(D3D10_SB_OPCODE_DP2, cat({ temp(1, D3D10_SB_OPERAND_4_COMPONENT_MASK_X),
+        src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 2), src(D3D10_SB_OPERAND_TYPE_TEMP, 0) }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(2, D3D10_SB_OPERAND_4_COMPONENT_MASK_X), cb_replicated(0, 3, 1) }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(3), cb_relative(1, 5, 0) }));
+    b.op(D3D10_SB_OPCODE_RET);
+    CHECK(p.load(b.finish()));
+}
+
+void test_declared()
+{
+    test_program p;
+    build(p);
+    cbuffer_report report;
+    cbuffer_usage_analyze(p.instructions.data(), p.count(), p.operands.data(), std::vector<cbuffer_layout>(), report);
+    CHECK_EQ(report.buffers.size(), 2u);
+    if (report.buffers.size() != 2)
+        return;
+
+    const cbuffer_usage& cb0 = report.buffers[0];
+    CHECK_EQ(cb0.reg, 0u);
+    CHECK_EQ(cb0.declaration, 0u);
+    CHECK(!cb0.dynamic);
+    CHECK(!cb0.relative);
+    CHECK_EQ(cb0.declared_bytes, 64u);
+    CHECK_EQ(cb0.size_bytes, 64u);
+    CHECK_EQ(cb0.layout, CBUFFER_NO_LAYOUT);
+    CHECK_EQ(cb0.read_bytes, 28u);
+    CHECK_EQ(cb0.interior_unused_bytes, 28u);
+    CHECK_EQ(cb0.trailing_unused_bytes, 8u);
+    uint8_t expected[4] = { 0xf, 0, 0x3, 0x2 };
+    for (uint32_t r = 0; r < 4; r++)
+        CHECK_EQ(cb0.components[r], expected[r]);
+
+    const cbuffer_usage& cb1 = report.buffers[1];
+    CHECK_EQ(cb1.reg, 1u);
+    CHECK(cb1.dynamic);
+    CHECK(cb1.relative);
+    CHECK_EQ(cb1.declared_bytes, 128u);
+    CHECK_EQ(cb1.read_bytes, 48u);
+    CHECK_EQ(cb1.interior_unused_bytes, 80u);
+    CHECK_EQ(cb1.trailing_unused_bytes, 0u);
+}
+
+// A layout larger than the declaration widens cb0 to 96 bytes, all 40 past byte 55 unused, and its
+// variables are checked byte by byte.
+void test_layout()
+{
+    test_program p;
+    build(p);
+    cbuffer_layout layout;
+    layout.name = "constants";
+    layout.reg = 0;
+    layout.size = 96;
+    layout.variables.push_back({ "world", 0, 16 });
+    layout.variables.push_back({ "tint", 16, 16 });
+    layout.variables.push_back({ "scale", 32, 12 });
+    layout.variables.push_back({ "bias", 52, 8 });
+    std::vector<cbuffer_layout> layouts(1, layout);
+    cbuffer_report report;
+    cbuffer_usage_analyze(p.instructions.data(), p.count(), p.operands.data(), layouts, report);
+    CHECK_EQ(report.buffers.size(), 2u);
+    if (report.buffers.size() != 2)
+        return;
+    const cbuffer_usage& cb0 = report.buffers[0];
+    CHECK_EQ(cb0.layout, 0u);
+    CHECK_EQ(cb0.declared_bytes, 64u);
+    CHECK_EQ(cb0.size_bytes, 96u);
+    CHECK_EQ(cb0.trailing_unused_bytes, 40u);
+    CHECK_EQ(report.buffers[1].layout, CBUFFER_NO_LAYOUT);
+
+    CHECK_EQ(cbuffer_bytes_read(cb0, 0, 16), 16u);
+    CHECK_EQ(cbuffer_bytes_read(cb0, 16, 16), 0u);
+    CHECK_EQ(cbuffer_bytes_read(cb0, 32, 12), 8u);
+    CHECK_EQ(cbuffer_bytes_read(cb0, 52, 8), 4u);
+    // a range starting inside a dword counts only its own bytes of it
+    CHECK_EQ(cbuffer_bytes_read(cb0, 34, 4), 4u);
+    CHECK_EQ(cbuffer_bytes_read(cb0, 38, 4), 2u);
+}
+
+} // namespace
+
+int main()
+{
+    test_declared();
+    test_layout();
+    return test_result("test_cbuffer_usage");
+}
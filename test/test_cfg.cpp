@@ -0,0 +1,160 @@
+// cfg_build on hand-assembled flow control: blocks, edge kinds, loops, subroutines and calls.
+
+#include "test.h"
+
+namespace {
+
+bool has_edge(const cfg& graph, uint32_t from, uint32_t to, cfg_edge_kind kind)
+{
+    const cfg_block& block = graph.blocks[from];
+    for (uint32_t s = 0; s < block.successor_count; s++)
+    {
+        const cfg_edge& edge = graph.successors[block.first_successor + s];
+        if (edge.to == to && edge.kind == (uint32_t)kind)
+            return true;
+    }
+    return false;
+}
+
+// opcode r0, r0, r1
+void op_r0_r1(program_builder& b, D3D10_SB_OPCODE_TYPE opcode)
+{
+    b.op(opcode, cat({ temp(0), src(D3D10_SB_OPERAND_TYPE_TEMP, 0), src(D3D10_SB_OPERAND_TYPE_TEMP, 1) }));
+}
+
+// A loop left by breakc around an if/else, then a call of a subroutine:
+//
+//   0 dcl_temps 2          block 0
+//   1 mov r0, v0
+//   2 loop
+//   3   breakc_nz r0.x     block 1, the loop header
+//   4   if_nz r0.y         block 2
+//   5     add r0, r0, r1   block 3
+//   6   else
+//   7     mul r0, r0, r1   block 4
+//   8   endif              block 5
+//   9 endloop
+//  10 call l0              block 6, the loop exit
+//  11 ret
+//  12 label l0             block 7, the subroutine
+//  13 mov r1, r0
+//  14 ret
+void test_loop_and_call()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_DCL_TEMPS, { 2 });
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(0), src(D3D10_SB_OPERAND_TYPE_INPUT, 0) }));
+    b.op(D3D10_SB_OPCODE_LOOP);
+    b.op(D3D10_SB_OPCODE_BREAKC, select1(D3D10_SB_OPERAND_TYPE_TEMP, 0, 0), test_nonzero());
+    b.op(D3D10_SB_OPCODE_IF, select1(D3D10_SB_OPERAND_TYPE_TEMP, 0, 1), test_nonzero());
+    op_r0_r1(b, D3D10_SB_OPCODE_ADD);
+    b.op(D3D10_SB_OPCODE_ELSE);
+    op_r0_r1(b, D3D10_SB_OPCODE_MUL);
+    b.op(D3D10_SB_OPCODE_ENDIF);
+    b.op(D3D10_SB_OPCODE_ENDLOOP);
+    b.op(D3D10_SB_OPCODE_CALL, resource(D3D10_SB_OPERAND_TYPE_LABEL, 0));
+    b.op(D3D10_SB_OPCODE_RET);
+    b.op(D3D10_SB_OPCODE_LABEL, resource(D3D10_SB_OPERAND_TYPE_LABEL, 0));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(1), src(D3D10_SB_OPERAND_TYPE_TEMP, 0) }));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    const cfg& g = p.graph;
+    CHECK_EQ(g.blocks.size(), 8u);
+    if (g.blocks.size() != 8)
+        return;
+    uint32_t firsts[] = { 0, 3, 4, 5, 7, 8, 10, 12 };
+    for (uint32_t i = 0; i < 8; i++)
+        CHECK_EQ(g.blocks[i].first, firsts[i]);
+
+    CHECK(has_edge(g, 0, 1, CFG_EDGE_FALLTHROUGH));
+    CHECK(has_edge(g, 1, 2, CFG_EDGE_FALLTHROUGH));
+    CHECK(has_edge(g, 1, 6, CFG_EDGE_BREAK));
+    CHECK(has_edge(g, 2, 3, CFG_EDGE_FALLTHROUGH));
+    CHECK(has_edge(g, 2, 4, CFG_EDGE_BRANCH));
+    CHECK(has_edge(g, 3, 5, CFG_EDGE_BRANCH));
+    CHECK(has_edge(g, 4, 5, CFG_EDGE_FALLTHROUGH));
+    CHECK(has_edge(g, 5, 1, CFG_EDGE_BACK));
+    CHECK_EQ(g.blocks[5].successor_count, 1u);
+    CHECK_EQ(g.blocks[1].predecessor_count, 2u);
+    CHECK_EQ(g.blocks[5].predecessor_count, 2u);
+    CHECK_EQ(g.blocks[6].successor_count, 0u);
+    CHECK_EQ(g.blocks[6].flags, CFG_BLOCK_EXIT);
+    CHECK_EQ(g.blocks[7].flags, CFG_BLOCK_EXIT);
+
+    CHECK_EQ(g.loops.size(), 1u);
+    CHECK_EQ(g.loops[0].header, 1u);
+    CHECK_EQ(g.loops[0].end, 6u);
+    CHECK_EQ(g.loops[0].exit, 6u);
+    CHECK_EQ(g.loops[0].instruction, 2u);
+    CHECK_EQ(cfg_loop_depth(g, 0), 0u);
+    for (uint32_t i = 1; i < 6; i++)
+        CHECK_EQ(cfg_loop_depth(g, i), 1u);
+    CHECK_EQ(cfg_loop_depth(g, 6), 0u);
+
+    CHECK_EQ(g.functions.size(), 2u);
+    CHECK_EQ(g.functions[0].kind, (uint32_t)CFG_FUNCTION_MAIN);
+    CHECK_EQ(g.functions[0].end_block, 7u);
+    CHECK_EQ(g.functions[1].kind, (uint32_t)CFG_FUNCTION_SUBROUTINE);
+    CHECK_EQ(g.functions[1].label, 0u);
+    CHECK_EQ(g.blocks[7].function, 1u);
+    CHECK_EQ(g.calls.size(), 1u);
+    CHECK_EQ(g.calls[0].instruction, 10u);
+    CHECK_EQ(g.calls[0].block, 6u);
+    CHECK_EQ(g.calls[0].callee, 1u);
+    CHECK_EQ(g.block_of[9], 5u);
+}
+
+// Nested loops count depth from the outermost, and parents come first.
+void test_nested_loops()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_LOOP);
+    b.op(D3D10_SB_OPCODE_LOOP);
+    b.op(D3D10_SB_OPCODE_BREAK);
+    b.op(D3D10_SB_OPCODE_ENDLOOP);
+    b.op(D3D10_SB_OPCODE_BREAK);
+    b.op(D3D10_SB_OPCODE_ENDLOOP);
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    CHECK_EQ(p.graph.loops.size(), 2u);
+    if (p.graph.loops.size() != 2)
+        return;
+    CHECK_EQ(p.graph.loops[0].depth, 1u);
+    CHECK_EQ(p.graph.loops[1].depth, 2u);
+    CHECK_EQ(p.graph.loops[1].parent, 0u);
+    CHECK_EQ(cfg_loop_depth(p.graph, p.graph.block_of[2]), 2u);
+    CHECK_EQ(cfg_loop_depth(p.graph, p.graph.block_of[4]), 1u);
+}
+
+// Flow control that closes nothing, or is left open, is rejected.
+void test_bad_nesting()
+{
+    program_builder endif(D3D10_SB_PIXEL_SHADER, 5, 0);
+    endif.op(D3D10_SB_OPCODE_ENDIF);
+    endif.op(D3D10_SB_OPCODE_RET);
+    test_program p;
+    CHECK(!p.load(endif.finish()));
+
+    program_builder open(D3D10_SB_PIXEL_SHADER, 5, 0);
+    open.op(D3D10_SB_OPCODE_LOOP);
+    open.op(D3D10_SB_OPCODE_RET);
+    CHECK(!p.load(open.finish()));
+
+    program_builder stray_break(D3D10_SB_PIXEL_SHADER, 5, 0);
+    stray_break.op(D3D10_SB_OPCODE_BREAK);
+    CHECK(!p.load(stray_break.finish()));
+}
+
+} // namespace
+
+int main()
+{
+    test_loop_and_call();
+    test_nested_loops();
+    test_bad_nesting();
+    return test_result("test_cfg");
+}
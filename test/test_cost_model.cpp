@@ -0,0 +1,119 @@
+// cost_estimate_program on a hand-assembled program with nested loops and a subroutine, under the
+// default profile and a parsed one.
+
+#include <string.h>
+#include "test.h"
+#include "cost_model.h"
+
+namespace {
+
+tokens r(uint32_t index)
+{
+    return src(D3D10_SB_OPERAND_TYPE_TEMP, index);
+}
+
+//   0 dcl_temps 2                          block 0, runs once
+//   1 mov r0, v0                           alu 1
+//   2 sqrt r1, r0                          transcendental 4
+//   3 loop                                 flow 2
+//   4   breakc_nz r0.x                     block 1, 8 times
+//   5   add r0, r0, r1                     block 2, 8 times
+//   6   loop
+//   7     breakc_nz r1.x                   block 3, 64 times
+//   8     call l0                          block 4, 64 times
+//   9   endloop
+//  10 endloop                              block 5, 8 times
+//  11 ret                                  block 6, once
+//  12 label l0                             block 7, as often as its call: 64 times
+//  13 mul r1, r1, r0
+//  14 ret
+void build(test_program& p)
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_DCL_TEMPS, { 2 });
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(0), src(D3D10_SB_OPERAND_TYPE_INPUT, 0) }));
+    b.op(D3D10_SB_OPCODE_SQRT, cat({ temp(1), r(0) }));
+    b.op(D3D10_SB_OPCODE_LOOP);
+    b.op(D3D10_SB_OPCODE_BREAKC, select1(D3D10_SB_OPERAND_TYPE_TEMP, 0, 0), test_nonzero());
+    b.op(D3D10_SB_OPCODE_ADD, cat({ temp(0), r(0), r(1) }));
+    b.op(D3D10_SB_OPCODE_LOOP);
+    b.op(D3D10_SB_OPCODE_BREAKC, select1(D3D10_SB_OPERAND_TYPE_TEMP, 1, 0), test_nonzero());
+    b.op(D3D10_SB_OPCODE_CALL, resource(D3D10_SB_OPERAND_TYPE_LABEL, 0));
+    b.op(D3D10_SB_OPCODE_ENDLOOP);
+    b.op(D3D10_SB_OPCODE_ENDLOOP);
+    b.op(D3D10_SB_OPCODE_RET);
+    b.op(D3D10_SB_OPCODE_LABEL, resource(D3D10_SB_OPERAND_TYPE_LABEL, 0));
+    b.op(D3D10_SB_OPCODE_MUL, cat({ temp(1), r(1), r(0) }));
+    b.op(D3D10_SB_OPCODE_RET);
+    CHECK(p.load(b.finish()));
+}
+
+void test_default_profile()
+{
+    test_program p;
+    build(p);
+    cost_profile profile;
+    cost_profile_default(profile);
+    cost_estimate cost;
+    cost_estimate_program(p.instructions.data(), p.count(), p.graph, profile, cost);
+
+    CHECK_EQ(cost.frequency.size(), 8u);
+    if (cost.frequency.size() != 8)
+        return;
+    double frequency[] = { 1, 8, 8, 64, 64, 8, 1, 64 };
+    for (uint32_t b = 0; b < 8; b++)
+        CHECK_EQ(cost.frequency[b], frequency[b]);
+
+    // alu: mov once, add 8 times, mul 64 times
+    CHECK_EQ(cost.classes[COST_CLASS_ALU], 73.0);
+    CHECK_EQ(cost.classes[COST_CLASS_TRANSCENDENTAL], 4.0);
+    // flow at 2 each: the outer loop once, breakc, inner loop and outer endloop 8 times, breakc,
+    // call, inner endloop and the subroutine's ret 64 times, the main ret once
+    CHECK_EQ(cost.classes[COST_CLASS_FLOW], 2.0 * (1 + 8 * 3 + 64 * 4 + 1));
+    CHECK_EQ(cost.classes[COST_CLASS_NONE], 0.0);
+    CHECK_EQ(cost.total, 73.0 + 4 + 2 * 282);
+
+    CHECK_EQ(cost.instructions[8], 128.0);
+    CHECK_EQ(cost.instructions[12], 0.0);
+    // call and inner endloop, not counting the callee
+    CHECK_EQ(cost.blocks[4], 256.0);
+    CHECK_EQ(cost.blocks[7], 64.0 + 128);
+    CHECK_EQ(cost.hottest_block, 4u);
+    CHECK_EQ(cost.functions[1], 192.0);
+}
+
+void test_parsed_profile()
+{
+    const char* text =
+        "# halves loops and doubles alu\n"
+        "name test\n"
+        "loop_iterations 4\n"
+        "class alu 2\n"
+        "opcode mul 5\n";
+    cost_profile profile;
+    cost_profile_default(profile);
+    uint32_t line = 0;
+    CHECK(cost_profile_parse(text, strlen(text), profile, line));
+    CHECK(profile.name == "test");
+
+    test_program p;
+    build(p);
+    cost_estimate cost;
+    cost_estimate_program(p.instructions.data(), p.count(), p.graph, profile, cost);
+    // mov 2 once, add 2 four times, mul 5 sixteen times
+    CHECK_EQ(cost.classes[COST_CLASS_ALU], 2.0 + 8 + 80);
+    CHECK_EQ(cost.frequency[3], 16.0);
+
+    const char* bad = "loop_iterations 4\nclass nonsense 1\n";
+    CHECK(!cost_profile_parse(bad, strlen(bad), profile, line));
+    CHECK_EQ(line, 2u);
+}
+
+} // namespace
+
+int main()
+{
+    test_default_profile();
+    test_parsed_profile();
+    return test_result("test_cost_model");
+}
@@ -0,0 +1,114 @@
+// latency_estimate_program on hand-assembled blocks: a chain through registers, a load waiting on
+// a store to the same UAV, and independent instructions that are not latency bound.
+
+#include "test.h"
+#include "critical_path.h"
+
+namespace {
+
+tokens r(uint32_t index)
+{
+    return src(D3D10_SB_OPERAND_TYPE_TEMP, index);
+}
+
+// Default profile latencies: alu 4, transcendental 16, flow 1. Issue costs: alu 1,
+// transcendental 4, flow 2.
+//
+//   0 mov r0, v0             finishes at 4
+//   1 mul r1, r0, r0         8
+//   2 sqrt r2, r1            24
+//   3 add r3, r2, r0         28
+//   4 mov r4, v0             4, off the chain
+//   5 mov o0, r3             32
+//   6 ret                    1
+void test_register_chain()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(0), src(D3D10_SB_OPERAND_TYPE_INPUT, 0) }));
+    b.op(D3D10_SB_OPCODE_MUL, cat({ temp(1), r(0), r(0) }));
+    b.op(D3D10_SB_OPCODE_SQRT, cat({ temp(2), r(1) }));
+    b.op(D3D10_SB_OPCODE_ADD, cat({ temp(3), r(2), r(0) }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(4), src(D3D10_SB_OPERAND_TYPE_INPUT, 0) }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), r(3) }));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    cost_profile profile;
+    cost_profile_default(profile);
+    latency_estimate latency;
+    latency_estimate_program(p.instructions.data(), p.count(), p.operands.data(), p.graph, profile, latency);
+    CHECK_EQ(latency.blocks.size(), 1u);
+    const block_latency& block = latency.blocks[0];
+    CHECK_EQ(block.latency, 32.0);
+    CHECK_EQ(block.issue, 11.0);
+    CHECK_EQ(block.slowest, 16.0);
+    CHECK_EQ(block.chain_first, 0u);
+    CHECK_EQ(block.chain_last, 5u);
+    CHECK_EQ(block.chain_length, 5u);
+    CHECK(block_latency_bound(block));
+    double finish[] = { 4, 8, 24, 28, 4, 32, 1 };
+    for (uint32_t i = 0; i < 7; i++)
+        CHECK_EQ(latency.finish[i], finish[i]);
+    CHECK_EQ(latency.previous[3], 2u);
+    CHECK_EQ(latency.previous[4], CFG_NONE);
+}
+
+// Memory latency is 200 and issue cost 16. The load reads u1 after the store to it, so waits for it.
+//
+//   0 store_raw u1.x, l(0), r0.x     finishes at 200
+//   1 ld_raw r1.x, l(0), u1          400
+//   2 ret
+void test_memory_order()
+{
+    program_builder b(D3D11_SB_COMPUTE_SHADER, 5, 0);
+    b.op(D3D11_SB_OPCODE_STORE_RAW, cat({ dst(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 1, D3D10_SB_OPERAND_4_COMPONENT_MASK_X),
+        imm32_scalar(0), select1(D3D10_SB_OPERAND_TYPE_TEMP, 0, 0) }));
+    b.op(D3D11_SB_OPCODE_LD_RAW, cat({ temp(1, D3D10_SB_OPERAND_4_COMPONENT_MASK_X), imm32_scalar(0),
+        src(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 1) }));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    cost_profile profile;
+    cost_profile_default(profile);
+    latency_estimate latency;
+    latency_estimate_program(p.instructions.data(), p.count(), p.operands.data(), p.graph, profile, latency);
+    const block_latency& block = latency.blocks[0];
+    CHECK_EQ(block.latency, 400.0);
+    CHECK_EQ(block.issue, 34.0);
+    CHECK_EQ(block.chain_first, 0u);
+    CHECK_EQ(block.chain_last, 1u);
+    CHECK_EQ(block.chain_length, 2u);
+    CHECK(block_latency_bound(block));
+}
+
+// Three independent moves overlap: latency 4 against issue 3 plus the slowest 4.
+void test_independent()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    for (uint32_t i = 0; i < 3; i++)
+        b.op(D3D10_SB_OPCODE_MOV, cat({ temp(i), src(D3D10_SB_OPERAND_TYPE_INPUT, 0) }));
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    cost_profile profile;
+    cost_profile_default(profile);
+    latency_estimate latency;
+    latency_estimate_program(p.instructions.data(), p.count(), p.operands.data(), p.graph, profile, latency);
+    const block_latency& block = latency.blocks[0];
+    CHECK_EQ(block.latency, 4.0);
+    CHECK_EQ(block.issue, 3.0);
+    CHECK_EQ(block.chain_length, 1u);
+    CHECK(!block_latency_bound(block));
+}
+
+} // namespace
+
+int main()
+{
+    test_register_chain();
+    test_memory_order();
+    test_independent();
+    return test_result("test_critical_path");
+}
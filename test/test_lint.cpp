@@ -0,0 +1,102 @@
+// The lint rules on a hand-assembled pixel shader that breaks each of them once, and on one whose
+// globally coherent UAV is needed.
+
+#include <string>
+#include "test.h"
+#include "lint.h"
+
+namespace {
+
+void check(const test_program& p, lint_checker& checker)
+{
+    lint_begin(checker);
+    for (const DecodedInstruction& inst : p.instructions)
+        lint_instruction(checker, inst, p.operands.data());
+    lint_end(checker);
+}
+
+//   0 dcl_globalFlags skipOptimization            FXL0001
+//   1 dcl_constantbuffer cb1[4], dynamicIndexed    FXL0003
+//   2 dcl_constantbuffer cb0[2], immediateIndexed
+//   3 dcl_indexableTemp x2[6], 4                   FXL0004
+//   4 dcl_input_ps linear sample v1                FXL0005
+//   5 dcl_uav_raw_glc u3                           FXL0006, found at the end: nothing fences globally
+//   6 dadd r0.xy, r0, r0                          FXL0002
+//   7 ret
+void test_every_rule()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_DCL_GLOBAL_FLAGS, tokens(), D3D11_1_SB_GLOBAL_FLAG_SKIP_OPTIMIZATION);
+    b.op(D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER, src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 1, 4),
+        ENCODE_D3D10_SB_D3D10_SB_CONSTANT_BUFFER_ACCESS_PATTERN(D3D10_SB_CONSTANT_BUFFER_DYNAMIC_INDEXED));
+    b.op(D3D10_SB_OPCODE_DCL_CONSTANT_BUFFER, src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 2));
+    b.op(D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP, { 2, 6, 4 });
+    b.op(D3D10_SB_OPCODE_DCL_INPUT_PS, dst(D3D10_SB_OPERAND_TYPE_INPUT, 1),
+        ENCODE_D3D10_SB_INPUT_INTERPOLATION_MODE(D3D10_SB_INTERPOLATION_LINEAR_SAMPLE));
+    b.op(D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW, resource(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 3),
+        D3D11_SB_GLOBALLY_COHERENT_ACCESS);
+    b.op(D3D11_SB_OPCODE_DADD, cat({ temp(0, D3D10_SB_OPERAND_4_COMPONENT_MASK_X | D3D10_SB_OPERAND_4_COMPONENT_MASK_Y),
+        src(D3D10_SB_OPERAND_TYPE_TEMP, 0), src(D3D10_SB_OPERAND_TYPE_TEMP, 0) }));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    lint_checker checker;
+    check(p, checker);
+    CHECK_EQ(checker.findings.size(), 6u);
+    if (checker.findings.size() != 6)
+        return;
+    // rule, instruction, register, size
+    uint32_t expected[6][4] = {
+        { LINT_SKIP_OPTIMIZATION, 0, 0, 0 },
+        { LINT_DYNAMIC_CONSTANT_BUFFER, 1, 1, 4 },
+        { LINT_INDEXABLE_TEMP, 3, 2, 6 },
+        { LINT_SAMPLE_RATE_INPUT, 4, 1, 0 },
+        { LINT_UNNEEDED_COHERENCE, 5, 3, 0 },
+        { LINT_DOUBLE_PRECISION, 6, 0, 0 },
+    };
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        const lint_finding& f = checker.findings[i];
+        CHECK_EQ(f.rule, expected[i][0]);
+        CHECK_EQ(f.instruction, expected[i][1]);
+        CHECK_EQ(f.index, expected[i][2]);
+        CHECK_EQ(f.size, expected[i][3]);
+        CHECK_EQ(f.offset, p.instructions[f.instruction].offset);
+    }
+}
+
+// Rule IDs are stable and follow the enum.
+void test_rule_ids()
+{
+    for (uint32_t i = 0; i < LINT_RULE_COUNT; i++)
+        CHECK(std::string(lint_rules[i].id) == "FXL000" + std::to_string(i + 1));
+    CHECK(std::string(lint_rules[LINT_UNNEEDED_COHERENCE].name) == "unneeded-globally-coherent");
+}
+
+// A sync that fences UAV memory globally is what globally coherent is for, so the UAV passes.
+void test_needed_coherence()
+{
+    program_builder b(D3D11_SB_COMPUTE_SHADER, 5, 0);
+    b.op(D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW, resource(D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW, 0),
+        D3D11_SB_GLOBALLY_COHERENT_ACCESS);
+    b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP, { 64, 1, 1 });
+    b.op(D3D11_SB_OPCODE_SYNC, tokens(), ENCODE_D3D11_SB_SYNC_FLAGS(D3D11_SB_SYNC_UNORDERED_ACCESS_VIEW_MEMORY_GLOBAL));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    lint_checker checker;
+    check(p, checker);
+    CHECK(checker.findings.empty());
+}
+
+} // namespace
+
+int main()
+{
+    test_every_rule();
+    test_needed_coherence();
+    test_rule_ids();
+    return test_result("test_lint");
+}
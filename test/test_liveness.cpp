@@ -0,0 +1,127 @@
+// liveness_analyze on hand-assembled programs: peak temps and components, where the peak is, and
+// values carried around a loop.
+
+#include "test.h"
+#include "liveness.h"
+
+namespace {
+
+tokens r(uint32_t index, uint32_t swizzle = D3D10_SB_OPERAND_4_COMPONENT_NOSWIZZLE)
+{
+    return src(D3D10_SB_OPERAND_TYPE_TEMP, index, swizzle);
+}
+
+tokens v0()
+{
+    return src(D3D10_SB_OPERAND_TYPE_INPUT, 0);
+}
+
+// Three values are live together, then fold into one:
+//
+//   0 dcl_temps 4
+//   1 mov r0.xyzw, v0
+//   2 mov r1.xy, v0          r0 r1              6 components
+//   3 mov r2.x, v0           r0 r1 r2           7 components, the peak
+//   4 mov r3.xyzw, v0        r3 is never read, so it is never live
+//   5 add r0.xy, r0, r1      r0 r2 after it
+//   6 add r0.x, r0, r2
+//   7 mov o0, r0
+//   8 ret
+void test_straight_line()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_DCL_TEMPS, { 4 });
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(0), v0() }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(1, D3D10_SB_OPERAND_4_COMPONENT_MASK_X | D3D10_SB_OPERAND_4_COMPONENT_MASK_Y), v0() }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(2, D3D10_SB_OPERAND_4_COMPONENT_MASK_X), v0() }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(3), v0() }));
+    b.op(D3D10_SB_OPCODE_ADD, cat({ temp(0, D3D10_SB_OPERAND_4_COMPONENT_MASK_X | D3D10_SB_OPERAND_4_COMPONENT_MASK_Y),
+        r(0), r(1) }));
+    b.op(D3D10_SB_OPCODE_ADD, cat({ temp(0, D3D10_SB_OPERAND_4_COMPONENT_MASK_X), r(0), r(2) }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), r(0) }));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    temp_pressure pressure;
+    CHECK(liveness_analyze(p.instructions.data(), p.count(), p.operands.data(), p.graph, pressure));
+    CHECK_EQ(pressure.declared_temps, 4u);
+    CHECK_EQ(pressure.peak_temps, 3u);
+    CHECK_EQ(pressure.peak_components, 7u);
+    CHECK_EQ(pressure.peak_instruction, 3u);
+    CHECK_EQ(pressure.declared_indexable, 0u);
+    CHECK_EQ(pressure.peak_indexable, 0u);
+    uint16_t live[] = { 0, 1, 2, 3, 3, 3, 2, 1, 0 };
+    CHECK_EQ(pressure.live_temps.size(), sizeof(live) / sizeof(live[0]));
+    for (uint32_t i = 0; i < pressure.live_temps.size() && i < sizeof(live) / sizeof(live[0]); i++)
+        CHECK_EQ(pressure.live_temps[i], live[i]);
+}
+
+// A value written before a loop and read inside it stays live through the whole body, even
+// where the body no longer reads it:
+//
+//   0 mov r0, v0
+//   1 mov r1, v0
+//   2 loop
+//   3   breakc_nz r1.x
+//   4   mov r2, r0               r0 live here, read again next time around
+//   5   add r1, r1, r2
+//   6 endloop
+//   7 ret
+void test_loop_carried()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(0), v0() }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(1), v0() }));
+    b.op(D3D10_SB_OPCODE_LOOP);
+    b.op(D3D10_SB_OPCODE_BREAKC, select1(D3D10_SB_OPERAND_TYPE_TEMP, 1, 0), test_nonzero());
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(2), r(0) }));
+    b.op(D3D10_SB_OPCODE_ADD, cat({ temp(1), r(1), r(2) }));
+    b.op(D3D10_SB_OPCODE_ENDLOOP);
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    temp_pressure pressure;
+    CHECK(liveness_analyze(p.instructions.data(), p.count(), p.operands.data(), p.graph, pressure));
+    CHECK_EQ(pressure.peak_temps, 3u);
+    CHECK_EQ(pressure.peak_instruction, 4u);
+    CHECK_EQ(pressure.live_temps[5], 3u);
+    CHECK_EQ(pressure.live_temps[6], 2u);
+    CHECK_EQ(pressure.live_temps[7], 0u);
+}
+
+// An indexable temp array counts whole once written, and the declaration sizes add up.
+void test_indexable()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_DCL_TEMPS, { 1 });
+    b.op(D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP, { 0, 8, 4 });
+    b.op(D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP, { 1, 2, 4 });
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(0), v0() }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ { operand_token(D3D10_SB_OPERAND_TYPE_INDEXABLE_TEMP, D3D10_SB_OPERAND_4_COMPONENT, 2) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE) |
+        D3D10_SB_OPERAND_4_COMPONENT_MASK_ALL, 0, 3 }, r(0) }));
+    b.op(D3D10_SB_OPCODE_FTOU, cat({ temp(0, D3D10_SB_OPERAND_4_COMPONENT_MASK_X), select1(D3D10_SB_OPERAND_TYPE_TEMP, 0, 0) }));
+    b.op(D3D10_SB_OPCODE_MOV, cat({ dst(D3D10_SB_OPERAND_TYPE_OUTPUT, 0), relative_src(0, 0, 0) }));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    temp_pressure pressure;
+    CHECK(liveness_analyze(p.instructions.data(), p.count(), p.operands.data(), p.graph, pressure));
+    CHECK_EQ(pressure.declared_temps, 1u);
+    CHECK_EQ(pressure.declared_indexable, 10u);
+    CHECK_EQ(pressure.peak_indexable, 8u);
+    CHECK_EQ(pressure.peak_temps, 1u);
+}
+
+} // namespace
+
+int main()
+{
+    test_straight_line();
+    test_loop_carried();
+    test_indexable();
+    return test_result("test_liveness");
+}
@@ -0,0 +1,109 @@
+// occupancy_estimate_program on hand-assembled compute shader declarations under the default
+// profile: waves of 64 on 4 SIMDs of 10 wave slots and 256 registers allocated 4 at a time, 64KB of
+// shared memory allocated 512 bytes at a time, and at most 16 groups per compute unit.
+
+#include <string.h>
+#include "test.h"
+#include "occupancy.h"
+
+namespace {
+
+void declare_tgsm(program_builder& b)
+{
+    b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_RAW,
+        cat({ resource(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 0), { 1024 } }));
+    b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_STRUCTURED,
+        cat({ resource(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 1), { 132, 64 } }));
+}
+
+// 64 threads with 5 temps and an 8 x 4 indexable array: 52 registers, so the register file holds 4
+// waves per SIMD, 16 groups per compute unit. Shared memory is 1024 + 132 * 64 = 9472 bytes, 9728
+// once allocated, so only 6 groups fit in 64KB: shared memory sets the limit, at 6 waves over 4
+// SIMDs.
+void test_lds_bound()
+{
+    program_builder b(D3D11_SB_COMPUTE_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_DCL_TEMPS, { 5 });
+    b.op(D3D10_SB_OPCODE_DCL_INDEXABLE_TEMP, { 0, 8, 4 });
+    declare_tgsm(b);
+    b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP, { 64, 1, 1 });
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    hardware_profile profile;
+    hardware_profile_default(profile);
+    occupancy_estimate o;
+    CHECK(occupancy_estimate_program(p.instructions.data(), p.count(), profile, o));
+    CHECK_EQ(o.group[0], 64u);
+    CHECK_EQ(o.threads, 64u);
+    CHECK_EQ(o.waves_per_group, 1u);
+    CHECK(!o.partial_wave);
+    CHECK_EQ(o.lane_utilization, 1.0);
+    CHECK_EQ(o.temps, 5u);
+    CHECK_EQ(o.indexable_registers, 32u);
+    CHECK_EQ(o.registers, 52u);
+    CHECK_EQ(o.tgsm_bytes, 9472u);
+    CHECK_EQ(o.register_waves, 4u);
+    CHECK_EQ(o.groups_per_cu, 6u);
+    CHECK_EQ(o.waves_per_simd, 1.5);
+    CHECK_EQ(o.occupancy, 0.15);
+    CHECK_EQ(o.limit, (uint32_t)OCCUPANCY_LIMIT_LDS);
+}
+
+// 10 x 10 threads fill two waves of 64 only partly. 3 temps are 12 registers, which would allow 21
+// waves per SIMD; the 10 wave slots of each SIMD allow 20 groups, and the compute unit's limit of 16
+// groups comes first.
+void test_partial_wave()
+{
+    program_builder b(D3D11_SB_COMPUTE_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_DCL_TEMPS, { 3 });
+    b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP, { 10, 10, 1 });
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    hardware_profile profile;
+    hardware_profile_default(profile);
+    occupancy_estimate o;
+    CHECK(occupancy_estimate_program(p.instructions.data(), p.count(), profile, o));
+    CHECK_EQ(o.threads, 100u);
+    CHECK_EQ(o.waves_per_group, 2u);
+    CHECK(o.partial_wave);
+    CHECK_EQ(o.lane_utilization, 100.0 / 128);
+    CHECK_EQ(o.registers, 12u);
+    CHECK_EQ(o.tgsm_bytes, 0u);
+    CHECK_EQ(o.groups_per_cu, 16u);
+    CHECK_EQ(o.waves_per_simd, 8.0);
+    CHECK_EQ(o.limit, (uint32_t)OCCUPANCY_LIMIT_GROUPS);
+}
+
+// A profile file changes only what it names; other shaders are not compute shaders.
+void test_profile_and_other_stages()
+{
+    const char* text = "# wave32 part\nname test\nwave_width 32\n";
+    hardware_profile profile;
+    hardware_profile_default(profile);
+    uint32_t line = 0;
+    CHECK(hardware_profile_parse(text, strlen(text), profile, line));
+    CHECK_EQ(profile.wave_width, 32u);
+    CHECK_EQ(profile.simds_per_cu, 4u);
+    const char* bad = "wave_width 0\n";
+    CHECK(!hardware_profile_parse(bad, strlen(bad), profile, line));
+    CHECK_EQ(line, 1u);
+
+    test_program p;
+    CHECK(p.load(build_program(D3D10_SB_PIXEL_SHADER, 1)));
+    occupancy_estimate o;
+    CHECK(!occupancy_estimate_program(p.instructions.data(), p.count(), profile, o));
+}
+
+} // namespace
+
+int main()
+{
+    test_lds_bound();
+    test_partial_wave();
+    test_profile_and_other_stages();
+    return test_result("test_occupancy");
+}
@@ -0,0 +1,120 @@
+// tgsm_banks_analyze on hand-assembled compute shader accesses under the default profile, whose
+// 32 banks serve 32 lanes of a wave at a time.
+
+#include "test.h"
+#include "tgsm_banks.h"
+
+namespace {
+
+tokens thread_id_in_group_x()
+{
+    return { operand_token(D3D11_SB_OPERAND_TYPE_INPUT_THREAD_ID_IN_GROUP, D3D10_SB_OPERAND_4_COMPONENT, 0) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SELECT_1_MODE) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECT_1(0) };
+}
+
+tokens g(uint32_t index)
+{
+    return src(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, index);
+}
+
+tokens r_x(uint32_t index)
+{
+    return select1(D3D10_SB_OPERAND_TYPE_TEMP, index, 0);
+}
+
+const uint32_t mask_x = D3D10_SB_OPERAND_4_COMPONENT_MASK_X;
+
+//   0 dcl_input vThreadIDInGroup.x
+//   1 dcl_tgsm_raw g0, 1024
+//   2 dcl_tgsm_structured g1, 128, 64
+//   3 dcl_tgsm_structured g2, 4, 64
+//   4 dcl_thread_group 64, 1, 1
+//   5 ld_structured r0.x, vThreadIDInGroup.x, l(0), g1     128 bytes apart: every lane in bank 0,
+//                                                           32 ways
+//   6 ishl r1.x, vThreadIDInGroup.x, l(3)
+//   7 ld_raw r2.x, r1.x, g0                                 8 bytes apart: every other bank, 2 ways
+//   8 store_structured g2.x, vThreadIDInGroup.x, l(0), r0   4 bytes apart: one lane per bank
+//   9 ld_raw r3.x, l(0), g0                                 every lane reads one dword: 1 way
+//  10 ld_raw r3.x, r2.x, g0                                 the address was loaded: unresolved
+//  11 ret
+void test_ways()
+{
+    program_builder b(D3D11_SB_COMPUTE_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_DCL_INPUT, special_dst(D3D11_SB_OPERAND_TYPE_INPUT_THREAD_ID_IN_GROUP, D3D10_SB_OPERAND_4_COMPONENT, mask_x));
+    b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_RAW,
+        cat({ resource(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 0), { 1024 } }));
+    b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_STRUCTURED,
+        cat({ resource(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 1), { 128, 64 } }));
+    b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP_SHARED_MEMORY_STRUCTURED,
+        cat({ resource(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 2), { 4, 64 } }));
+    b.op(D3D11_SB_OPCODE_DCL_THREAD_GROUP, { 64, 1, 1 });
+    b.op(D3D11_SB_OPCODE_LD_STRUCTURED, cat({ temp(0, mask_x), thread_id_in_group_x(), imm32_scalar(0), g(1) }));
+    b.op(D3D10_SB_OPCODE_ISHL, cat({ temp(1, mask_x), thread_id_in_group_x(), imm32_scalar(3) }));
+    b.op(D3D11_SB_OPCODE_LD_RAW, cat({ temp(2, mask_x), r_x(1), g(0) }));
+    b.op(D3D11_SB_OPCODE_STORE_STRUCTURED, cat({ dst(D3D11_SB_OPERAND_TYPE_THREAD_GROUP_SHARED_MEMORY, 2, mask_x),
+        thread_id_in_group_x(), imm32_scalar(0), r_x(0) }));
+    b.op(D3D11_SB_OPCODE_LD_RAW, cat({ temp(3, mask_x), imm32_scalar(0), g(0) }));
+    b.op(D3D11_SB_OPCODE_LD_RAW, cat({ temp(3, mask_x), r_x(2), g(0) }));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    hardware_profile profile;
+    hardware_profile_default(profile);
+    tgsm_bank_report report;
+    CHECK(tgsm_banks_analyze(p.instructions.data(), p.count(), p.operands.data(), p.graph, profile, report));
+    CHECK_EQ(report.lanes, 32u);
+    CHECK_EQ(report.accesses.size(), 5u);
+    if (report.accesses.size() != 5)
+        return;
+
+    // worst first, then program order, unresolved last
+    const tgsm_access* a = report.accesses.data();
+    CHECK_EQ(a[0].instruction, 5u);
+    CHECK(a[0].resolved);
+    CHECK_EQ(a[0].reg, 1u);
+    CHECK_EQ(a[0].element_stride, 128u);
+    CHECK_EQ(a[0].lane_stride[0], 128u);
+    CHECK_EQ(a[0].ways, 32u);
+    CHECK_EQ(a[0].worst_thread, 0u);
+
+    CHECK_EQ(a[1].instruction, 7u);
+    CHECK(a[1].resolved);
+    CHECK_EQ(a[1].element_stride, 0u);
+    CHECK_EQ(a[1].lane_stride[0], 8u);
+    CHECK_EQ(a[1].ways, 2u);
+
+    CHECK_EQ(a[2].instruction, 8u);
+    CHECK_EQ(a[2].lane_stride[0], 4u);
+    CHECK_EQ(a[2].ways, 1u);
+
+    CHECK_EQ(a[3].instruction, 9u);
+    CHECK_EQ(a[3].lane_stride[0], 0u);
+    CHECK_EQ(a[3].ways, 1u);
+
+    CHECK_EQ(a[4].instruction, 10u);
+    CHECK(!a[4].resolved);
+    CHECK_EQ(a[4].ways, 0u);
+}
+
+// A pixel shader has no thread group, so nothing is reported.
+void test_not_compute()
+{
+    test_program p;
+    CHECK(p.load(build_program(D3D10_SB_PIXEL_SHADER, 1)));
+    hardware_profile profile;
+    hardware_profile_default(profile);
+    tgsm_bank_report report;
+    CHECK(tgsm_banks_analyze(p.instructions.data(), p.count(), p.operands.data(), p.graph, profile, report));
+    CHECK(report.accesses.empty());
+}
+
+} // namespace
+
+int main()
+{
+    test_ways();
+    test_not_compute();
+    return test_result("test_tgsm_banks");
+}
@@ -0,0 +1,121 @@
+// uniformity_analyze on a hand-assembled pixel shader: branches on constants, inputs and values
+// derived from them, a loop lanes leave at different times, and a derivative in divergent flow.
+
+#include "test.h"
+#include "uniformity.h"
+
+namespace {
+
+// cb0[0].x, as a branch condition
+tokens cb0_x()
+{
+    return { operand_token(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, D3D10_SB_OPERAND_4_COMPONENT, 2) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECTION_MODE(D3D10_SB_OPERAND_4_COMPONENT_SELECT_1_MODE) |
+        ENCODE_D3D10_SB_OPERAND_4_COMPONENT_SELECT_1(0), 0, 0 };
+}
+
+tokens x(D3D10_SB_OPERAND_TYPE type, uint32_t index)
+{
+    return select1(type, index, 0);
+}
+
+//   0 if_nz cb0[0].x                 uniform
+//   1   mov r0, v0
+//   2 endif
+//   3 if_nz v0.x                     divergent
+//   4   sample r1, r0, t0, s0        derivative in divergent flow
+//   5 endif
+//   6 mov r2, cb0[0]
+//   7 if_nz r2.x                     uniform: a constant copied
+//   8 endif
+//   9 if_nz r0.x                     divergent: an input copied
+//  10 endif
+//  11 loop                           divergent: lanes break at different times
+//  12   breakc_nz v0.x               divergent
+//  13   mov r3, cb0[0]               a constant, but written in divergent flow
+//  14 endloop
+//  15 if_nz r3.x                     divergent
+//  16 endif
+//  17 sample r1, r0, t0, s0          back in uniform flow
+//  18 ret
+void test_branches()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_IF, cb0_x(), test_nonzero());
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(0), src(D3D10_SB_OPERAND_TYPE_INPUT, 0) }));
+    b.op(D3D10_SB_OPCODE_ENDIF);
+    b.op(D3D10_SB_OPCODE_IF, x(D3D10_SB_OPERAND_TYPE_INPUT, 0), test_nonzero());
+    b.op(D3D10_SB_OPCODE_SAMPLE, cat({ temp(1), src(D3D10_SB_OPERAND_TYPE_TEMP, 0), src(D3D10_SB_OPERAND_TYPE_RESOURCE, 0),
+        src(D3D10_SB_OPERAND_TYPE_SAMPLER, 0) }));
+    b.op(D3D10_SB_OPCODE_ENDIF);
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(2), src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 0) }));
+    b.op(D3D10_SB_OPCODE_IF, x(D3D10_SB_OPERAND_TYPE_TEMP, 2), test_nonzero());
+    b.op(D3D10_SB_OPCODE_ENDIF);
+    b.op(D3D10_SB_OPCODE_IF, x(D3D10_SB_OPERAND_TYPE_TEMP, 0), test_nonzero());
+    b.op(D3D10_SB_OPCODE_ENDIF);
+    b.op(D3D10_SB_OPCODE_LOOP);
+    b.op(D3D10_SB_OPCODE_BREAKC, x(D3D10_SB_OPERAND_TYPE_INPUT, 0), test_nonzero());
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(3), src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 0) }));
+    b.op(D3D10_SB_OPCODE_ENDLOOP);
+    b.op(D3D10_SB_OPCODE_IF, x(D3D10_SB_OPERAND_TYPE_TEMP, 3), test_nonzero());
+    b.op(D3D10_SB_OPCODE_ENDIF);
+    b.op(D3D10_SB_OPCODE_SAMPLE, cat({ temp(1), src(D3D10_SB_OPERAND_TYPE_TEMP, 0), src(D3D10_SB_OPERAND_TYPE_RESOURCE, 0),
+        src(D3D10_SB_OPERAND_TYPE_SAMPLER, 0) }));
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    uniformity u;
+    CHECK(uniformity_analyze(p.instructions.data(), p.count(), p.operands.data(), p.graph, u));
+    CHECK_EQ(u.branches.size(), 19u);
+    if (u.branches.size() != 19)
+        return;
+    CHECK_EQ(u.branches[0], UNIFORMITY_UNIFORM);
+    CHECK_EQ(u.branches[3], UNIFORMITY_DIVERGENT);
+    CHECK_EQ(u.branches[7], UNIFORMITY_UNIFORM);
+    CHECK_EQ(u.branches[9], UNIFORMITY_DIVERGENT);
+    CHECK_EQ(u.branches[11], UNIFORMITY_DIVERGENT);
+    CHECK_EQ(u.branches[12], UNIFORMITY_DIVERGENT);
+    CHECK_EQ(u.branches[15], UNIFORMITY_DIVERGENT);
+    CHECK_EQ(u.branches[1], UNIFORMITY_NOT_A_BRANCH);
+    CHECK_EQ(u.branches[17], UNIFORMITY_NOT_A_BRANCH);
+
+    CHECK_EQ(u.divergent_blocks[p.graph.block_of[1]], 0);
+    CHECK_EQ(u.divergent_blocks[p.graph.block_of[4]], 1);
+    CHECK_EQ(u.divergent_blocks[p.graph.block_of[13]], 1);
+    CHECK_EQ(u.divergent_blocks[p.graph.block_of[17]], 0);
+    CHECK_EQ(u.divergent_derivatives.size(), 1u);
+    if (!u.divergent_derivatives.empty())
+        CHECK_EQ(u.divergent_derivatives[0], 4u);
+}
+
+// A loop every lane leaves together stays uniform, and so do the values written in it.
+void test_uniform_loop()
+{
+    program_builder b(D3D10_SB_PIXEL_SHADER, 5, 0);
+    b.op(D3D10_SB_OPCODE_LOOP);
+    b.op(D3D10_SB_OPCODE_BREAKC, cb0_x(), test_nonzero());
+    b.op(D3D10_SB_OPCODE_MOV, cat({ temp(0), src2d(D3D10_SB_OPERAND_TYPE_CONSTANT_BUFFER, 0, 0) }));
+    b.op(D3D10_SB_OPCODE_ENDLOOP);
+    b.op(D3D10_SB_OPCODE_IF, x(D3D10_SB_OPERAND_TYPE_TEMP, 0), test_nonzero());
+    b.op(D3D10_SB_OPCODE_ENDIF);
+    b.op(D3D10_SB_OPCODE_RET);
+
+    test_program p;
+    CHECK(p.load(b.finish()));
+    uniformity u;
+    CHECK(uniformity_analyze(p.instructions.data(), p.count(), p.operands.data(), p.graph, u));
+    CHECK_EQ(u.branches[0], UNIFORMITY_UNIFORM);
+    CHECK_EQ(u.branches[1], UNIFORMITY_UNIFORM);
+    CHECK_EQ(u.branches[4], UNIFORMITY_UNIFORM);
+    CHECK(u.divergent_derivatives.empty());
+}
+
+} // namespace
+
+int main()
+{
+    test_branches();
+    test_uniform_loop();
+    return test_result("test_uniformity");
+}
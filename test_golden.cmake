@@ -0,0 +1,68 @@
+# Golden-output check of fxdis: the disassembly and each report mode in MODES over test.bin and a
+# dozen shaders from fixed fxdis_gen seeds, compared byte for byte with test_golden/MODE.txt. Each golden
+# ends with the exit status of its run. ctest runs it (see CMakeLists.txt); by hand:
+#
+#   cmake -DFXDIS=build/fxdis -DFXDIS_GEN=build/fxdis_gen -DWORK_DIR=build/test_golden -P test_golden.cmake
+#
+# After a change that is meant to alter some output, add -DUPDATE=ON to rewrite the goldens from
+# this build, and review their diff before committing it.
+
+foreach(variable FXDIS FXDIS_GEN WORK_DIR)
+    if(NOT ${variable})
+        message(FATAL_ERROR "${variable} is not set")
+    endif()
+endforeach()
+
+set(GOLDEN_DIR ${CMAKE_CURRENT_LIST_DIR}/test_golden)
+set(MODES disassembly cfg liveness cost cost-blocks cost-instructions latency uniformity lint lint-sarif
+    occupancy tgsm-banks buffers cbuffers)
+
+# Inputs are given by relative paths, so the output does not depend on where the build is.
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR}/sm5 ${WORK_DIR}/sm4)
+file(COPY ${CMAKE_CURRENT_LIST_DIR}/test.bin DESTINATION ${WORK_DIR})
+foreach(set "sm5;7;5" "sm4;1000;4")
+    list(GET set 0 dir)
+    list(GET set 1 seed)
+    list(GET set 2 sm)
+    execute_process(COMMAND ${FXDIS_GEN} --count 6 --instructions 100 --seed ${seed} --sm ${sm} ${dir}
+        WORKING_DIRECTORY ${WORK_DIR} RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "fxdis_gen failed: ${status}")
+    endif()
+endforeach()
+file(GLOB generated RELATIVE ${WORK_DIR} ${WORK_DIR}/sm5/*.dxbc ${WORK_DIR}/sm4/*.dxbc)
+list(SORT generated)
+set(INPUTS test.bin ${generated})
+
+set(failed)
+foreach(mode ${MODES})
+    if(mode STREQUAL "disassembly")
+        set(arguments)
+    else()
+        set(arguments --${mode})
+    endif()
+    execute_process(COMMAND ${FXDIS} ${arguments} ${INPUTS}
+        WORKING_DIRECTORY ${WORK_DIR} OUTPUT_VARIABLE output RESULT_VARIABLE status)
+    string(REPLACE "\r\n" "\n" output "${output}")
+    string(APPEND output "# exit status ${status}\n")
+    set(golden ${GOLDEN_DIR}/${mode}.txt)
+    if(UPDATE)
+        file(WRITE ${golden} "${output}")
+    else()
+        if(EXISTS ${golden})
+            file(READ ${golden} expected)
+        else()
+            set(expected)
+        endif()
+        if(NOT output STREQUAL expected)
+            file(WRITE ${WORK_DIR}/${mode}.txt "${output}")
+            list(APPEND failed ${mode})
+        endif()
+    endif()
+endforeach()
+
+if(failed)
+    string(REPLACE ";" ", " failed "${failed}")
+    message(FATAL_ERROR "Output differs from test_golden for: ${failed}. This build's output is in ${WORK_DIR}.")
+endif()
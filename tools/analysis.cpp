@@ -0,0 +1,520 @@
+#include "analysis.h"
+#include "archive.h"
+#include "fxdis.h"
+#include "dxbc.h"
+#include "D3D11TokenParser.h"
+#include "cfg.h"
+#include "liveness.h"
+#include "cost_model.h"
+#include "critical_path.h"
+#include "uniformity.h"
+#include "occupancy.h"
+#include "tgsm_banks.h"
+#include "buffer_access.h"
+#include "cbuffer_usage.h"
+#include <stdlib.h>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+// Quotes a field that would otherwise break the row.
+void write_csv_field(std::ostream& out, const std::string& field)
+{
+    if (field.find_first_of(",\"\n") == std::string::npos)
+    {
+        out << field;
+        return;
+    }
+    out << '"';
+    for (char c : field)
+        out << (c == '"' ? "\"\"" : std::string(1, c));
+    out << '"';
+}
+
+// A byte address as the thread id gives it, such as "16*vThreadIDInGroup.x + 4".
+std::string address_pattern(const thread_affine& address)
+{
+    static const char* terms[] = { "vThreadIDInGroup.x", "vThreadIDInGroup.y", "vThreadIDInGroup.z" };
+    std::string text;
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        int32_t stride = (int32_t)address.k[c];
+        if (!stride)
+            continue;
+        text += text.empty() ? (stride < 0 ? "-" : "") : (stride < 0 ? " - " : " + ");
+        uint32_t magnitude = stride < 0 ? 0u - (uint32_t)stride : (uint32_t)stride;
+        if (magnitude != 1)
+            text += std::to_string(magnitude) + "*";
+        text += terms[c];
+    }
+    int32_t offset = (int32_t)address.constant;
+    if (address.kind == THREAD_AFFINE_UNIFORM)
+        text += text.empty() ? "uniform" : " + uniform";
+    else if (offset || text.empty())
+        text += text.empty() ? std::to_string(offset)
+            : (offset < 0 ? " - " : " + ") + std::to_string(offset < 0 ? 0u - (uint32_t)offset : (uint32_t)offset);
+    return text;
+}
+
+// Everything decoded from one input. The storage is kept from input to input, so a run stops
+// allocating once it has seen its largest program.
+struct program
+{
+    std::vector<DecodedInstruction> instructions;
+    DecodedOperandPool operands;
+    cfg graph;
+    temp_pressure pressure;
+    cost_estimate cost;
+    latency_estimate latency;
+    uniformity uniform;
+    occupancy_estimate occupancy;
+    tgsm_bank_report banks;
+    buffer_report buffers;
+    std::vector<cbuffer_layout> layouts;
+    cbuffer_report cbuffers;
+};
+
+class analyzer
+{
+public:
+    analyzer(analysis_report r, const cost_profile& p, const hardware_profile& h, std::ostream& o)
+        : report(r), profile(p), hardware(h), out(o), failed(false) {}
+
+    void add_path(const std::string& path)
+    {
+        fxdis_arena& arena = fxdis_thread_arena();
+        if (archive_is_archive(path.c_str()))
+        {
+            archive_reader* reader = archive_open(path.c_str(), std::cerr);
+            if (!reader)
+            {
+                failed = true;
+                return;
+            }
+            std::string name;
+            std::vector<char> data;
+            while (reader->next(name, data))
+                add_input(path + ":" + name, data.empty() ? NULL : &data[0], data.size());
+            if (!reader->error.empty())
+            {
+                std::cerr << path << ": " << reader->error << std::endl;
+                failed = true;
+            }
+            delete reader;
+            return;
+        }
+
+        fxdis_arena_scope scope(arena);
+        size_t size;
+        const void* data = fxdis_read_file(path.c_str(), size, arena, std::cerr);
+        if (!data)
+        {
+            failed = true;
+            return;
+        }
+        add_input(path, data, size);
+    }
+
+    bool ok() const { return !failed; }
+
+private:
+    // A DXBC container, or a bare token stream as fxdis_disassemble takes it.
+    void add_input(const std::string& path, const void* data, size_t size)
+    {
+        dxbc_chunk_header* chunk = data ? dxbc_find_shader_bytecode(data, (int)size) : NULL;
+        const uint32_t* tokens = chunk ? (const uint32_t*)(chunk + 1) : (const uint32_t*)data;
+        uint32_t token_bytes = chunk ? bswap_le32(chunk->size) : (uint32_t)size;
+
+        // The pool is never cleared, so operand indices refer to the whole program as cfg_build expects.
+        TokenDecoder decoder(tokens, token_bytes);
+        shader.instructions.clear();
+        shader.operands.clear();
+        DECODE_STATUS status = data ? decoder.DecodeHeader() : DECODE_STATUS::TRUNCATED;
+        if (status == DECODE_STATUS::OK)
+        {
+            DecodedInstruction inst;
+            while ((status = decoder.Next(inst, shader.operands)) == DECODE_STATUS::OK)
+                shader.instructions.push_back(inst);
+        }
+        if (status != DECODE_STATUS::END)
+        {
+            std::cerr << path << ": " << DecodeStatusText[(int)status] << std::endl;
+            failed = true;
+            return;
+        }
+        if (report == ANALYSIS_OCCUPANCY)
+        {
+            write_occupancy(path);
+            return;
+        }
+        if (report == ANALYSIS_CBUFFERS)
+        {
+            write_cbuffers(path, data, size);
+            return;
+        }
+        if (!cfg_build(shader.instructions.data(), (uint32_t)shader.instructions.size(), shader.operands.data(), shader.graph))
+        {
+            std::cerr << path << ": flow control is not properly nested" << std::endl;
+            failed = true;
+            return;
+        }
+
+        switch (report)
+        {
+        case ANALYSIS_CFG:
+            cfg_write_dot(shader.graph, shader.instructions.data(), path.c_str(), out);
+            break;
+        case ANALYSIS_LIVENESS:
+            write_liveness(path);
+            break;
+        case ANALYSIS_COST:
+        case ANALYSIS_COST_BLOCKS:
+        case ANALYSIS_COST_INSTRUCTIONS:
+            write_cost(path);
+            break;
+        case ANALYSIS_LATENCY:
+            write_latency(path);
+            break;
+        case ANALYSIS_UNIFORMITY:
+            write_uniformity(path);
+            break;
+        case ANALYSIS_OCCUPANCY:
+            break;
+        case ANALYSIS_TGSM_BANKS:
+            write_tgsm_banks(path);
+            break;
+        case ANALYSIS_BUFFERS:
+            write_buffers(path);
+            break;
+        case ANALYSIS_CBUFFERS:
+            break;
+        }
+    }
+
+    void write_liveness(const std::string& path)
+    {
+        temp_pressure& p = shader.pressure;
+        if (!liveness_analyze(shader.instructions.data(), (uint32_t)shader.instructions.size(), shader.operands.data(), shader.graph, p))
+        {
+            std::cerr << path << ": uses more than " << LIVENESS_MAX_REGISTERS << " registers" << std::endl;
+            failed = true;
+            return;
+        }
+        write_csv_field(out, path);
+        out << "," << p.declared_temps << "," << p.peak_temps << "," << p.peak_components << ","
+            << p.declared_indexable << "," << p.peak_indexable << ",";
+        if (p.peak_instruction != CFG_NONE)
+        {
+            const DecodedInstruction& inst = shader.instructions[p.peak_instruction];
+            out << p.peak_instruction << "," << inst.offset << "," << TokenText(OpcodeText, OpcodeTextCount, inst.opcode);
+        }
+        else
+        {
+            out << ",,";
+        }
+        out << "\n";
+    }
+
+    void write_cost(const std::string& path)
+    {
+        cost_estimate& c = shader.cost;
+        const cfg& graph = shader.graph;
+        cost_estimate_program(shader.instructions.data(), (uint32_t)shader.instructions.size(), graph, profile, c);
+        if (report == ANALYSIS_COST)
+        {
+            write_csv_field(out, path);
+            out << "," << c.total;
+            for (uint32_t k = COST_CLASS_ALU; k < COST_CLASS_COUNT; k++)
+                out << "," << c.classes[k];
+            if (c.hottest_block != CFG_NONE)
+            {
+                const DecodedInstruction& first = shader.instructions[graph.blocks[c.hottest_block].first];
+                out << "," << c.hottest_block << "," << first.offset << "," << c.blocks[c.hottest_block];
+            }
+            else
+            {
+                out << ",,,";
+            }
+            out << "\n";
+        }
+        else if (report == ANALYSIS_COST_BLOCKS)
+        {
+            for (uint32_t b = 0; b < graph.blocks.size(); b++)
+            {
+                const cfg_block& block = graph.blocks[b];
+                write_csv_field(out, path);
+                out << "," << b << "," << block.function << "," << cfg_function_kind_text[graph.functions[block.function].kind]
+                    << "," << shader.instructions[block.first].offset << "," << block.end - block.first
+                    << "," << cfg_loop_depth(graph, b) << "," << c.frequency[b] << "," << c.blocks[b] << "\n";
+            }
+        }
+        else
+        {
+            for (uint32_t i = 0; i < shader.instructions.size(); i++)
+            {
+                const DecodedInstruction& inst = shader.instructions[i];
+                write_csv_field(out, path);
+                out << "," << i << "," << inst.offset << "," << graph.block_of[i] << ","
+                    << TokenText(OpcodeText, OpcodeTextCount, inst.opcode) << ","
+                    << cost_class_text[cost_class_of(inst.opcode)] << "," << c.instructions[i] << "\n";
+            }
+        }
+    }
+
+    void write_latency(const std::string& path)
+    {
+        latency_estimate& l = shader.latency;
+        const cfg& graph = shader.graph;
+        latency_estimate_program(shader.instructions.data(), (uint32_t)shader.instructions.size(), shader.operands.data(),
+            graph, profile, l);
+        for (uint32_t b = 0; b < graph.blocks.size(); b++)
+        {
+            const block_latency& block = l.blocks[b];
+            if (!block_latency_bound(block))
+                continue;
+            const DecodedInstruction& first = shader.instructions[block.chain_first];
+            const DecodedInstruction& last = shader.instructions[block.chain_last];
+            write_csv_field(out, path);
+            out << "," << b << "," << cfg_function_kind_text[graph.functions[graph.blocks[b].function].kind]
+                << "," << shader.instructions[graph.blocks[b].first].offset << "," << graph.blocks[b].end - graph.blocks[b].first
+                << "," << block.latency << "," << block.issue << "," << block.slowest << "," << block.chain_length
+                << "," << first.offset << "," << TokenText(OpcodeText, OpcodeTextCount, first.opcode)
+                << "," << last.offset << "," << TokenText(OpcodeText, OpcodeTextCount, last.opcode) << "\n";
+        }
+    }
+
+    void write_uniformity(const std::string& path)
+    {
+        uniformity& u = shader.uniform;
+        if (!uniformity_analyze(shader.instructions.data(), (uint32_t)shader.instructions.size(), shader.operands.data(),
+            shader.graph, u))
+        {
+            std::cerr << path << ": uses more than " << UNIFORMITY_MAX_REGISTERS << " registers" << std::endl;
+            failed = true;
+            return;
+        }
+        // Both lists are in program order; merge them.
+        size_t next_derivative = 0;
+        for (uint32_t i = 0; i < shader.instructions.size(); i++)
+        {
+            const char* finding;
+            if (next_derivative < u.divergent_derivatives.size() && u.divergent_derivatives[next_derivative] == i)
+            {
+                finding = "derivative_in_divergent_flow";
+                next_derivative++;
+            }
+            else if (u.branches[i] != UNIFORMITY_NOT_A_BRANCH)
+            {
+                finding = uniformity_branch_text[u.branches[i]];
+            }
+            else
+            {
+                continue;
+            }
+            const DecodedInstruction& inst = shader.instructions[i];
+            write_csv_field(out, path);
+            out << "," << i << "," << inst.offset << "," << shader.graph.block_of[i] << ","
+                << TokenText(OpcodeText, OpcodeTextCount, inst.opcode) << "," << finding << "\n";
+        }
+    }
+
+    void write_occupancy(const std::string& path)
+    {
+        occupancy_estimate& o = shader.occupancy;
+        if (!occupancy_estimate_program(shader.instructions.data(), (uint32_t)shader.instructions.size(), hardware, o))
+            return;
+        write_csv_field(out, path);
+        out << "," << o.group[0] << "," << o.group[1] << "," << o.group[2] << "," << o.threads << "," << o.waves_per_group
+            << "," << o.partial_wave << "," << o.lane_utilization << "," << o.temps << "," << o.indexable_registers
+            << "," << o.registers << "," << o.tgsm_bytes << "," << o.groups_per_cu << "," << o.waves_per_simd
+            << "," << o.occupancy << "," << occupancy_limit_text[o.limit] << "\n";
+    }
+
+    void write_tgsm_banks(const std::string& path)
+    {
+        tgsm_bank_report& r = shader.banks;
+        if (!tgsm_banks_analyze(shader.instructions.data(), (uint32_t)shader.instructions.size(), shader.operands.data(),
+            shader.graph, hardware, r))
+        {
+            std::cerr << path << ": too large for the bank conflict analysis" << std::endl;
+            failed = true;
+            return;
+        }
+        for (const tgsm_access& a : r.accesses)
+        {
+            const DecodedInstruction& inst = shader.instructions[a.instruction];
+            write_csv_field(out, path);
+            out << "," << a.instruction << "," << inst.offset << "," << TokenText(OpcodeText, OpcodeTextCount, inst.opcode)
+                << ",g" << a.reg << "," << a.element_stride << ",";
+            if (a.resolved)
+                out << address_pattern(thread_affine_make(a.uniform_offset ? THREAD_AFFINE_UNIFORM : THREAD_AFFINE_EXACT,
+                    a.offset, a.lane_stride[0], a.lane_stride[1], a.lane_stride[2])) << "," << a.ways << "," << a.worst_thread << "\n";
+            else
+                out << "unresolved,,\n";
+        }
+    }
+
+    void write_buffers(const std::string& path)
+    {
+        buffer_report& r = shader.buffers;
+        if (!buffer_access_analyze(shader.instructions.data(), (uint32_t)shader.instructions.size(), shader.operands.data(),
+            shader.graph, hardware, r))
+        {
+            std::cerr << path << ": too large for the buffer access analysis" << std::endl;
+            failed = true;
+            return;
+        }
+        for (const buffer_finding& f : r.findings)
+        {
+            const DecodedInstruction& inst = shader.instructions[f.instruction];
+            write_csv_field(out, path);
+            out << "," << f.instruction << "," << inst.offset << "," << TokenText(OpcodeText, OpcodeTextCount, inst.opcode)
+                << "," << (f.type == D3D10_SB_OPERAND_TYPE_RESOURCE ? "t" : "u") << f.reg << "," << f.stride << ","
+                << buffer_finding_text[f.kind] << "," << f.bytes << ",";
+            if (f.kind == BUFFER_PARTIAL_LOAD || f.kind == BUFFER_STRIDED)
+                out << f.efficiency;
+            out << ",";
+            if (f.kind == BUFFER_STRIDED)
+                out << address_pattern(f.address);
+            out << "\n";
+        }
+    }
+
+    void write_cbuffers(const std::string& path, const void* data, size_t size)
+    {
+        dxbc_chunk_header* rdef = data ? dxbc_find_chunk(data, (int)size, FOURCC_RDEF) : NULL;
+        if (!rdef)
+            shader.layouts.clear();
+        else if (!cbuffer_layouts_parse(rdef + 1, bswap_le32(rdef->size), shader.layouts))
+            std::cerr << path << ": malformed RDEF chunk, constant buffers are not named" << std::endl;
+        cbuffer_report& r = shader.cbuffers;
+        cbuffer_usage_analyze(shader.instructions.data(), (uint32_t)shader.instructions.size(), shader.operands.data(),
+            shader.layouts, r);
+        for (const cbuffer_usage& u : r.buffers)
+        {
+            const cbuffer_layout* layout = u.layout != CBUFFER_NO_LAYOUT ? &shader.layouts[u.layout] : NULL;
+            write_csv_field(out, path);
+            out << ",cb" << u.reg << ",";
+            write_csv_field(out, layout ? layout->name : std::string());
+            out << "," << (u.dynamic ? "dynamic_indexed" : "immediate_indexed") << "," << u.declared_bytes << ","
+                << u.size_bytes << "," << u.read_bytes << "," << u.interior_unused_bytes << "," << u.trailing_unused_bytes
+                << "," << u.relative << ",";
+            std::string unread;
+            for (size_t v = 0; layout && v < layout->variables.size(); v++)
+            {
+                const cbuffer_variable& variable = layout->variables[v];
+                if (!cbuffer_bytes_read(u, variable.offset, variable.size))
+                    unread += (unread.empty() ? "" : " ") + variable.name;
+            }
+            write_csv_field(out, unread);
+            out << "\n";
+        }
+    }
+
+    analysis_report report;
+    const cost_profile& profile;
+    const hardware_profile& hardware;
+    std::ostream& out;
+    program shader;
+    bool failed;
+};
+
+// Reads a whole profile file; fxdis_read_file is meant for shaders and rejects small files.
+bool read_profile(const char* path, std::string& text)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    text.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return true;
+}
+
+} // namespace
+
+int analysis_run(const std::vector<std::string>& inputs, const analysis_options& options, std::ostream& out)
+{
+    std::string text;
+    uint32_t line;
+    cost_profile profile;
+    cost_profile_default(profile);
+    if (options.cost_profile)
+    {
+        if (!read_profile(options.cost_profile, text))
+        {
+            std::cerr << "Could not open cost profile: " << options.cost_profile << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!cost_profile_parse(text.data(), text.size(), profile, line))
+        {
+            std::cerr << options.cost_profile << ":" << line << ": not a valid cost profile line" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    hardware_profile hardware;
+    hardware_profile_default(hardware);
+    if (options.hardware_profile)
+    {
+        if (!read_profile(options.hardware_profile, text))
+        {
+            std::cerr << "Could not open hardware profile: " << options.hardware_profile << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!hardware_profile_parse(text.data(), text.size(), hardware, line))
+        {
+            std::cerr << options.hardware_profile << ":" << line << ": not a valid hardware profile line" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    analyzer run(options.report, profile, hardware, out);
+    switch (options.report)
+    {
+    case ANALYSIS_CFG:
+        break;
+    case ANALYSIS_LIVENESS:
+        out << "path,declared_temps,peak_temps,peak_components,declared_indexable,peak_indexable,peak_instruction,peak_offset,peak_opcode\n";
+        break;
+    case ANALYSIS_COST:
+        out.precision(10);
+        out << "path,total";
+        for (uint32_t k = COST_CLASS_ALU; k < COST_CLASS_COUNT; k++)
+            out << "," << cost_class_text[k];
+        out << ",hottest_block,hottest_offset,hottest_cost\n";
+        break;
+    case ANALYSIS_COST_BLOCKS:
+        out.precision(10);
+        out << "path,block,function,function_kind,offset,instructions,loop_depth,frequency,cost\n";
+        break;
+    case ANALYSIS_COST_INSTRUCTIONS:
+        out.precision(10);
+        out << "path,instruction,offset,block,opcode,class,cost\n";
+        break;
+    case ANALYSIS_LATENCY:
+        out.precision(10);
+        out << "path,block,function_kind,offset,instructions,latency,issue,slowest,chain_length,chain_first_offset,chain_first_opcode,"
+            "chain_last_offset,chain_last_opcode\n";
+        break;
+    case ANALYSIS_UNIFORMITY:
+        out << "path,instruction,offset,block,opcode,finding\n";
+        break;
+    case ANALYSIS_OCCUPANCY:
+        out << "path,group_x,group_y,group_z,threads,waves_per_group,partial_wave,lane_utilization,temps,indexable_registers,"
+            "registers,tgsm_bytes,groups_per_cu,waves_per_simd,occupancy,limit\n";
+        break;
+    case ANALYSIS_TGSM_BANKS:
+        out << "path,instruction,offset,opcode,register,element_stride,address,ways,worst_thread\n";
+        break;
+    case ANALYSIS_BUFFERS:
+        out << "path,instruction,offset,opcode,register,stride,finding,bytes,efficiency,address\n";
+        break;
+    case ANALYSIS_CBUFFERS:
+        out << "path,register,name,access,declared_bytes,size_bytes,read_bytes,interior_unused_bytes,trailing_unused_bytes,"
+            "relative,unread_variables\n";
+        break;
+    }
+    for (const std::string& input : inputs)
+        run.add_path(input);
+    out.flush();
+    return run.ok() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
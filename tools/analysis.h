@@ -0,0 +1,41 @@
+#ifndef ANALYSIS_H_
+#define ANALYSIS_H_
+
+#include <vector>
+#include <string>
+#include <iostream>
+
+// Reports that fxdis produces from a program's control-flow graph instead of disassembling it.
+enum analysis_report
+{
+    ANALYSIS_CFG,               // the graph itself, in Graphviz dot syntax
+    ANALYSIS_LIVENESS,          // temp register pressure from liveness, one CSV row per input
+    ANALYSIS_COST,              // estimated cost by cost class, one CSV row per input
+    ANALYSIS_COST_BLOCKS,       // estimated cost of each basic block, one CSV row per block
+    ANALYSIS_COST_INSTRUCTIONS, // estimated cost of each instruction, one CSV row per instruction
+    ANALYSIS_LATENCY,           // latency-bound basic blocks, one CSV row each
+    ANALYSIS_UNIFORMITY,        // uniform and divergent branches, and derivatives in divergent flow, one
+                                // CSV row each
+    ANALYSIS_OCCUPANCY,         // estimated occupancy of compute shaders, one CSV row per input
+    ANALYSIS_TGSM_BANKS,        // bank conflicts of group shared memory accesses, one CSV row each
+    ANALYSIS_BUFFERS,           // structured and raw buffer layout and access findings, one CSV row each
+    ANALYSIS_CBUFFERS,          // bytes of each constant buffer read, one CSV row per buffer
+};
+
+struct analysis_options
+{
+    analysis_report report;
+    const char* cost_profile;       // profile file applied over the default cost profile, NULL for none;
+                                    // used by the cost and latency reports only
+    const char* hardware_profile;   // profile file applied over the default hardware profile, NULL for
+                                    // none; used by the occupancy and bank conflict reports only
+};
+
+// Decodes every input, builds its control-flow graph and writes the report to out, one input after
+// another. The occupancy report needs no graph, and skips inputs that are not compute shaders.
+// Archives are read entry by entry. Inputs that cannot be read or decoded, or whose flow control
+// does not nest, are reported on stderr and make the result EXIT_FAILURE. A cost or hardware profile
+// that cannot be read or parsed fails the run before any input is read.
+int analysis_run(const std::vector<std::string>& inputs, const analysis_options& options, std::ostream& out);
+
+#endif /* ANALYSIS_H_ */
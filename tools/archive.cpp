@@ -0,0 +1,525 @@
+#include "archive.h"
+#include "fxdis.h"
+#include "dxbc.h"
+#include "shader_pack.h"
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef FXDIS_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef FXDIS_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+bool byte_source::read(void* dst, size_t size)
+{
+    char* p = (char*)dst;
+    while (size)
+    {
+        const char* data;
+        size_t avail = fill(&data);
+        if (!avail)
+            return false;
+        size_t n = avail < size ? avail : size;
+        memcpy(p, data, n);
+        consume(n);
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool byte_source::read(std::vector<char>& data, uint64_t size)
+{
+    data.clear();
+    while (size)
+    {
+        const char* p;
+        size_t avail = fill(&p);
+        if (!avail)
+            return false;
+        size_t n = avail < size ? avail : (size_t)size;
+        data.insert(data.end(), p, p + n);
+        consume(n);
+        size -= n;
+    }
+    return true;
+}
+
+bool byte_source::skip(uint64_t size)
+{
+    while (size)
+    {
+        const char* data;
+        size_t avail = fill(&data);
+        if (!avail)
+            return false;
+        size_t n = avail < size ? avail : (size_t)size;
+        consume(n);
+        size -= n;
+    }
+    return true;
+}
+
+size_t byte_source::fill(const char** data)
+{
+    if (begin == end && !eof)
+    {
+        begin = 0;
+        end = produce(&buffer[0], buffer.size());
+        eof = end == 0;
+    }
+    *data = &buffer[begin];
+    return end - begin;
+}
+
+namespace {
+
+uint16_t rd16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+uint32_t rd32(const unsigned char* p) { return rd16(p) | ((uint32_t)rd16(p + 2) << 16); }
+uint64_t rd64(const unsigned char* p) { return rd32(p) | ((uint64_t)rd32(p + 4) << 32); }
+
+// Compares in place; archive_is_archive runs once per input and must not allocate.
+bool ends_with(const char* s, const char* suffix)
+{
+    size_t size = strlen(s), n = strlen(suffix);
+    return size >= n && !memcmp(s + size - n, suffix, n);
+}
+
+#ifdef FXDIS_WITH_ZSTD
+class zstd_source : public byte_source
+{
+public:
+    zstd_source(byte_source* in) : inner(in), stream(ZSTD_createDStream()) { ZSTD_initDStream(stream); }
+    ~zstd_source() { ZSTD_freeDStream(stream); delete inner; }
+protected:
+    size_t produce(char* dst, size_t capacity)
+    {
+        ZSTD_outBuffer output = { dst, capacity, 0 };
+        while (output.pos == 0)
+        {
+            const char* data;
+            size_t avail = inner->fill(&data);
+            if (!avail)
+                break;
+            ZSTD_inBuffer input = { data, avail, 0 };
+            size_t ret = ZSTD_decompressStream(stream, &output, &input);
+            inner->consume(input.pos);
+            if (ZSTD_isError(ret))
+                return 0;
+        }
+        return output.pos;
+    }
+private:
+    byte_source* inner;
+    ZSTD_DStream* stream;
+};
+#endif
+
+// POSIX ustar, including GNU long names and pax path records.
+class tar_reader : public archive_reader
+{
+public:
+    tar_reader(byte_source* s) : archive_reader(s) {}
+    bool next(std::string& name, std::vector<char>& data)
+    {
+        std::string long_name;
+        for (;;)
+        {
+            unsigned char header[512];
+            if (!source->read(header, sizeof(header)))
+                return false;
+            if (!header[0])
+                return false; // end-of-archive block
+
+            uint64_t size = 0;
+            if (header[124] & 0x80)
+            {
+                for (int i = 1; i < 12; i++)
+                    size = (size << 8) | header[124 + i];
+            }
+            else
+            {
+                for (int i = 0; i < 12 && header[124 + i] >= '0' && header[124 + i] <= '7'; i++)
+                    size = (size << 3) | (header[124 + i] - '0');
+            }
+            uint64_t padded = (size + 511) & ~(uint64_t)511;
+            char type = header[156];
+
+            if (size > ARCHIVE_MAX_ENTRY)
+                return fail("entry too large");
+
+            if (type == 'L' || type == 'x')
+            {
+                if (!source->read(data, size) || !source->skip(padded - size))
+                    return fail("truncated archive");
+                std::string meta(data.begin(), data.end());
+                if (type == 'L')
+                {
+                    long_name = meta.c_str();
+                }
+                else
+                {
+                    // pax records are "<length> <key>=<value>\n"
+                    for (size_t pos = 0; pos < meta.size();)
+                    {
+                        size_t len = strtoul(meta.c_str() + pos, NULL, 10);
+                        size_t key = meta.find(' ', pos);
+                        if (!len || key == std::string::npos || pos + len > meta.size())
+                            break;
+                        if (!meta.compare(key + 1, 5, "path="))
+                            long_name = meta.substr(key + 6, pos + len - key - 7);
+                        pos += len;
+                    }
+                }
+                continue;
+            }
+            if (type != '0' && type != '\0')
+            {
+                if (!source->skip(padded))
+                    return fail("truncated archive");
+                continue;
+            }
+
+            if (!long_name.empty())
+            {
+                name = long_name;
+            }
+            else
+            {
+                name.clear();
+                if (!memcmp(header + 257, "ustar", 5) && header[345])
+                    name.append((const char*)header + 345, strnlen((const char*)header + 345, 155)).append("/");
+                name.append((const char*)header, strnlen((const char*)header, 100));
+            }
+            if (!source->read(data, size) || !source->skip(padded - size))
+                return fail("truncated archive");
+            return true;
+        }
+    }
+private:
+    bool fail(const char* reason)
+    {
+        error = reason;
+        return false;
+    }
+};
+
+// Zip, walked through its local file headers so the central directory at the end is never needed.
+class zip_reader : public archive_reader
+{
+public:
+    zip_reader(byte_source* s) : archive_reader(s) {}
+    bool next(std::string& name, std::vector<char>& data)
+    {
+        for (;;)
+        {
+            unsigned char header[30];
+            if (!source->read(header, 4))
+                return false;
+            uint32_t signature = rd32(header);
+            if (signature != 0x04034b50)
+                return signature == 0x02014b50 || signature == 0x06054b50 ? false : fail("bad local header");
+            if (!source->read(header + 4, sizeof(header) - 4))
+                return fail("truncated archive");
+
+            uint16_t flags = rd16(header + 6);
+            uint16_t method = rd16(header + 8);
+            uint64_t packed = rd32(header + 18);
+            uint64_t unpacked = rd32(header + 22);
+            std::vector<unsigned char> extra(rd16(header + 28));
+            name.resize(rd16(header + 26));
+            if ((!name.empty() && !source->read(&name[0], name.size())) || (!extra.empty() && !source->read(&extra[0], extra.size())))
+                return fail("truncated archive");
+
+            // zip64 sizes live in extra field 0x0001, which also widens the data descriptor's sizes
+            bool zip64 = false;
+            for (size_t pos = 0; pos + 4 <= extra.size(); pos += 4 + rd16(&extra[pos + 2]))
+            {
+                if (rd16(&extra[pos]) != 0x0001)
+                    continue;
+                zip64 = true;
+                if (pos + 20 <= extra.size())
+                {
+                    unpacked = rd64(&extra[pos + 4]);
+                    packed = rd64(&extra[pos + 12]);
+                }
+            }
+
+            bool streamed = (flags & 8) != 0;
+            if (flags & 1)
+                return fail("encrypted entries are not supported");
+            if (streamed && method != 8)
+                return fail("streamed entries must be deflated");
+
+            bool directory = !name.empty() && name[name.size() - 1] == '/';
+            if (unpacked > ARCHIVE_MAX_ENTRY)
+                return fail("entry too large");
+            if (method == 0)
+            {
+                if (!source->read(data, unpacked))
+                    return fail("truncated archive");
+            }
+            else if (method == 8)
+            {
+                if (!inflate_entry(streamed ? UINT64_MAX : packed, (size_t)unpacked, data))
+                    return false;
+                if (streamed)
+                {
+                    // crc and both sizes, 4 or in zip64 8 bytes each, after an optional signature
+                    size_t size = zip64 ? 20 : 12;
+                    unsigned char descriptor[24];
+                    if (!source->read(descriptor, size))
+                        return fail("truncated archive");
+                    if (rd32(descriptor) == 0x08074b50 && !source->read(descriptor + size, 4))
+                        return fail("truncated archive");
+                }
+            }
+            else
+            {
+                return fail("unsupported compression method");
+            }
+            if (!directory)
+                return true;
+        }
+    }
+private:
+    bool fail(const char* reason)
+    {
+        error = reason;
+        return false;
+    }
+
+#ifdef FXDIS_WITH_ZLIB
+    bool inflate_entry(uint64_t packed, size_t unpacked, std::vector<char>& data)
+    {
+        z_stream z;
+        memset(&z, 0, sizeof(z));
+        if (inflateInit2(&z, -MAX_WBITS) != Z_OK)
+            return fail("inflate failed");
+        // The header's size is only a hint; the buffer doubles as output arrives.
+        data.resize(unpacked && unpacked < (1 << 20) ? unpacked : 1 << 16);
+        int ret = Z_OK;
+        while (ret != Z_STREAM_END)
+        {
+            const char* in;
+            size_t avail = source->fill(&in);
+            if (avail > packed)
+                avail = (size_t)packed;
+            if (!avail)
+                break;
+            if (z.total_out == data.size())
+                data.resize(data.size() * 2);
+            z.next_in = (Bytef*)in;
+            z.avail_in = (uInt)avail;
+            z.next_out = (Bytef*)&data[z.total_out];
+            z.avail_out = (uInt)(data.size() - z.total_out);
+            ret = inflate(&z, Z_NO_FLUSH);
+            size_t used = avail - z.avail_in;
+            source->consume(used);
+            packed -= used;
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+                break;
+        }
+        data.resize(z.total_out);
+        inflateEnd(&z);
+        return ret == Z_STREAM_END ? true : fail("corrupt deflate stream");
+    }
+#else
+    bool inflate_entry(uint64_t, size_t, std::vector<char>&)
+    {
+        return fail("deflated entries need a build with FXDIS_WITH_ZLIB");
+    }
+#endif
+};
+
+// Shader packs are made to be mapped and searched, not streamed, so the whole file is read in
+// first and checked once; entries then come out in the order they were added to the pack.
+class pack_reader : public archive_reader
+{
+public:
+    pack_reader(byte_source* s) : archive_reader(s), pack(NULL), position(0) {}
+    bool next(std::string& name, std::vector<char>& data)
+    {
+        if (!pack)
+        {
+            if (!load())
+                return false;
+        }
+        if (position == order.size())
+            return false;
+        const shader_pack_record* record = order[position++];
+        const char* payload = (const char*)shader_pack_payload(pack, record);
+        name = shader_pack_name(pack, record);
+        data.assign(payload, payload + record->payload_size);
+        return true;
+    }
+private:
+    bool load()
+    {
+        std::vector<char> file;
+        const char* chunk;
+        while (size_t avail = source->fill(&chunk))
+        {
+            file.insert(file.end(), chunk, chunk + avail);
+            source->consume(avail);
+        }
+        // uint64_t storage keeps the tables aligned as shader_pack_open requires.
+        contents.resize((file.size() + 7) / 8);
+        if (!file.empty())
+            memcpy(&contents[0], &file[0], file.size());
+        pack = shader_pack_open(contents.empty() ? NULL : &contents[0], file.size());
+        if (!pack)
+        {
+            uint32_t magic = 0;
+            if (file.size() >= sizeof(magic))
+                memcpy(&magic, &file[0], sizeof(magic));
+            error = magic == SHADER_PACK_MAGIC_SWAPPED ? "shader pack written on a host of the other byte order"
+                : "not a valid shader pack";
+            return false;
+        }
+        const shader_pack_record* records = shader_pack_records(pack);
+        for (uint32_t i = 0; i < pack->shader_count; i++)
+            order.push_back(&records[i]);
+        std::sort(order.begin(), order.end(), [](const shader_pack_record* a, const shader_pack_record* b) {
+            return a->payload_offset < b->payload_offset;
+        });
+        return true;
+    }
+    std::vector<uint64_t> contents;
+    const shader_pack_header* pack;
+    std::vector<const shader_pack_record*> order;
+    size_t position;
+};
+
+template<typename T>
+class blocking_queue
+{
+public:
+    void push(T item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(item);
+        }
+        ready.notify_one();
+    }
+    T pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return !items.empty(); });
+        T item = items.front();
+        items.pop_front();
+        return item;
+    }
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<T> items;
+};
+
+struct archive_entry
+{
+    std::string name;
+    std::vector<char> data;
+};
+
+} // namespace
+
+bool archive_is_archive(const char* path)
+{
+    return ends_with(path, ".tar") || ends_with(path, ".tar.zst") || ends_with(path, ".tzst")
+        || ends_with(path, ".zip") || ends_with(path, ".fxpack");
+}
+
+archive_reader* archive_open(const char* path, std::ostream& out)
+{
+    FILE* file = NULL;
+#ifdef _MSC_VER
+    fopen_s(&file, path, "rb");
+#else
+    file = fopen(path, "rb");
+#endif
+    if (!file)
+    {
+        out << "Could not open file: " << path << "\n";
+        return NULL;
+    }
+    byte_source* source = new file_source(file);
+
+    if (ends_with(path, ".zip"))
+        return new zip_reader(source);
+    if (ends_with(path, ".fxpack"))
+        return new pack_reader(source);
+    if (ends_with(path, ".tar.zst") || ends_with(path, ".tzst"))
+    {
+#ifdef FXDIS_WITH_ZSTD
+        return new tar_reader(new zstd_source(source));
+#else
+        delete source;
+        out << "zstd archives need a build with FXDIS_WITH_ZSTD: " << path << "\n";
+        return NULL;
+#endif
+    }
+    return new tar_reader(source);
+}
+
+int archive_disassemble(const char* path, std::ostream& out)
+{
+    archive_reader* reader = archive_open(path, out);
+    if (!reader)
+        return EXIT_FAILURE;
+
+    // A few buffers circulate between the reader thread and the decoder, so neither waits on the
+    // other for long and no entry ever needs a fresh allocation once the buffers have grown.
+    const int buffer_count = 4;
+    archive_entry entries[buffer_count];
+    blocking_queue<archive_entry*> free_entries;
+    blocking_queue<archive_entry*> full_entries;
+    for (int i = 0; i < buffer_count; i++)
+        free_entries.push(&entries[i]);
+
+    std::thread producer([&] {
+        for (;;)
+        {
+            archive_entry* entry = free_entries.pop();
+            if (!reader->next(entry->name, entry->data))
+            {
+                full_entries.push(NULL);
+                break;
+            }
+            full_entries.push(entry);
+        }
+    });
+
+    int result = EXIT_SUCCESS;
+    while (archive_entry* entry = full_entries.pop())
+    {
+        out << "# FILE: " << path << ":" << entry->name << "\n";
+        if (entry->data.size() < sizeof(dxbc_container_header))
+        {
+            out << "File is too small!\n";
+            result = EXIT_FAILURE;
+        }
+        else if (fxdis_disassemble(&entry->data[0], entry->data.size(), out) != EXIT_SUCCESS)
+        {
+            result = EXIT_FAILURE;
+        }
+        free_entries.push(entry);
+    }
+    producer.join();
+
+    if (!reader->error.empty())
+    {
+        out << "// " << path << ": " << reader->error << "\n";
+        result = EXIT_FAILURE;
+    }
+    delete reader;
+    return result;
+}
@@ -0,0 +1,73 @@
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <iostream>
+
+// Largest archive entry read. A DXBC container's size field is 32 bits, so nothing bigger can be one.
+#define ARCHIVE_MAX_ENTRY 0xffffffffull
+
+// Sequential, buffered byte stream. Archive formats are read front to back and never seek, so the
+// same readers work on plain files and on decompressed streams.
+class byte_source
+{
+public:
+    byte_source() : begin(0), end(0), eof(false) { buffer.resize(1 << 16); }
+    virtual ~byte_source() {}
+    bool read(void* dst, size_t size);
+    // Reads size bytes into data, which grows only as they arrive, so a size field that lies costs
+    // no more memory than the bytes actually there. Returns false if the stream ends first.
+    bool read(std::vector<char>& data, uint64_t size);
+    bool skip(uint64_t size);
+    // Makes buffered bytes available without consuming them. Returns 0 at end of stream.
+    size_t fill(const char** data);
+    void consume(size_t size) { begin += size; }
+protected:
+    // Reads up to capacity raw bytes. Returns 0 at end of stream.
+    virtual size_t produce(char* dst, size_t capacity) = 0;
+private:
+    std::vector<char> buffer;
+    size_t begin;
+    size_t end;
+    bool eof;
+};
+
+class file_source : public byte_source
+{
+public:
+    file_source(FILE* f) : file(f) {}
+    ~file_source() { fclose(file); }
+protected:
+    size_t produce(char* dst, size_t capacity) { return fread(dst, 1, capacity, file); }
+private:
+    FILE* file;
+};
+
+// Yields the files stored in an archive, one at a time.
+class archive_reader
+{
+public:
+    archive_reader(byte_source* s) : source(s) {}
+    virtual ~archive_reader() { delete source; }
+    // Reads the next file into name and data. data keeps its capacity between calls.
+    // Returns false at the end of the archive or on error; error is set in the latter case.
+    virtual bool next(std::string& name, std::vector<char>& data) = 0;
+    std::string error;
+protected:
+    byte_source* source;
+};
+
+// True for the archive types fxdis can read: .tar, .tar.zst/.tzst, .zip and .fxpack shader packs.
+bool archive_is_archive(const char* path);
+
+// Opens an archive by extension. Returns NULL and writes the reason to out on failure.
+archive_reader* archive_open(const char* path, std::ostream& out);
+
+// Disassembles every file of an archive in memory. Entries are read and decompressed on a separate
+// thread while the previous ones are decoded, and each is tagged "# FILE: archive:entry".
+int archive_disassemble(const char* path, std::ostream& out);
+
+#endif /* ARCHIVE_H_ */
@@ -0,0 +1,368 @@
+#include "arrow.h"
+#include <string.h>
+
+namespace {
+
+// Arrow's metadata is FlatBuffers; these are the few table fields and enum values it needs,
+// numbered as in Arrow's Schema.fbs, Message.fbs and File.fbs.
+enum
+{
+    METADATA_V5 = 4,
+    HEADER_SCHEMA = 1,
+    HEADER_RECORD_BATCH = 3,
+    TYPE_INT = 2,
+    TYPE_UTF8 = 5,
+};
+
+const char magic[8] = { 'A', 'R', 'R', 'O', 'W', '1', 0, 0 };
+
+// Just enough of a FlatBuffers builder for Arrow's metadata. Like the reference builder it works
+// back to front: children are created before the tables that refer to them, and every offset is
+// a distance from the end of the buffer. The bytes are kept reversed until finish.
+class flatbuffer_builder
+{
+public:
+    uint32_t size() const { return (uint32_t)reversed.size(); }
+
+    // Pads so that `additional` more bytes end on a multiple of alignment.
+    void align(size_t alignment, size_t additional = 0)
+    {
+        while ((reversed.size() + additional) % alignment)
+            reversed.push_back(0);
+    }
+
+    template<typename T> void push(T value)
+    {
+        align(sizeof(T));
+        uint64_t bits = (uint64_t)value;
+        for (size_t i = sizeof(T); i-- > 0;)
+            reversed.push_back((uint8_t)(bits >> (8 * i)));
+    }
+
+    uint32_t create_string(const std::string& text)
+    {
+        align(4, text.size() + 1);
+        reversed.push_back(0);
+        for (size_t i = text.size(); i-- > 0;)
+            reversed.push_back((uint8_t)text[i]);
+        push((uint32_t)text.size());
+        return size();
+    }
+
+    // A vector of structs made only of 8-byte fields, given as words_per_item words each.
+    uint32_t create_struct_vector(const std::vector<uint64_t>& words, size_t words_per_item)
+    {
+        align(8, words.size() * 8);
+        for (size_t i = words.size(); i-- > 0;)
+            push(words[i]);
+        push((uint32_t)(words.size() / words_per_item));
+        return size();
+    }
+
+    uint32_t create_offset_vector(const std::vector<uint32_t>& offsets)
+    {
+        align(4, offsets.size() * 4);
+        for (size_t i = offsets.size(); i-- > 0;)
+            push(size() + 4 - offsets[i]);
+        push((uint32_t)offsets.size());
+        return size();
+    }
+
+    void start_table()
+    {
+        fields.clear();
+        table_start = size();
+    }
+
+    template<typename T> void add_scalar(uint16_t field, T value)
+    {
+        push(value);
+        fields.push_back(std::make_pair(field, size()));
+    }
+
+    void add_offset(uint16_t field, uint32_t offset)
+    {
+        align(4);
+        push(size() + 4 - offset);
+        fields.push_back(std::make_pair(field, size()));
+    }
+
+    uint32_t end_table()
+    {
+        push((int32_t)0);
+        uint32_t table = size();
+        uint16_t count = 0;
+        for (const auto& field : fields)
+            count = field.first + 1 > count ? field.first + 1 : count;
+        std::vector<uint16_t> vtable(count, 0);
+        for (const auto& field : fields)
+            vtable[field.first] = (uint16_t)(table - field.second);
+        for (size_t i = count; i-- > 0;)
+            push(vtable[i]);
+        push((uint16_t)(table - table_start));
+        push((uint16_t)((count + 2) * 2));
+
+        // The table's first word is the signed distance back to its vtable.
+        int32_t to_vtable = (int32_t)(size() - table);
+        for (int i = 0; i < 4; i++)
+            reversed[table - 1 - i] = (uint8_t)(to_vtable >> (8 * i));
+        return table;
+    }
+
+    std::vector<uint8_t> finish(uint32_t root)
+    {
+        align(8, 4);
+        push(size() + 4 - root);
+        return std::vector<uint8_t>(reversed.rbegin(), reversed.rend());
+    }
+
+private:
+    std::vector<uint8_t> reversed;
+    std::vector<std::pair<uint16_t, uint32_t> > fields;
+    uint32_t table_start;
+};
+
+uint32_t type_width(arrow_writer::column_type type)
+{
+    switch (type)
+    {
+    case arrow_writer::UINT8: return 1;
+    case arrow_writer::UINT16: return 2;
+    case arrow_writer::UINT32: return 4;
+    case arrow_writer::UINT64: return 8;
+    default: return 0;
+    }
+}
+
+void pad8(std::vector<uint8_t>& body)
+{
+    body.resize((body.size() + 7) & ~(size_t)7, 0);
+}
+
+// Schema: little-endian, one nullable field per column, with no children.
+template<typename Columns>
+uint32_t build_schema(flatbuffer_builder& fb, const Columns& columns)
+{
+    std::vector<uint32_t> fields;
+    for (const auto& c : columns)
+    {
+        uint32_t name = fb.create_string(c.name);
+        uint32_t children = fb.create_offset_vector(std::vector<uint32_t>());
+        fb.start_table();
+        if (c.type != arrow_writer::UTF8)
+        {
+            fb.add_scalar<int32_t>(0, (int32_t)type_width(c.type) * 8);
+            fb.add_scalar<uint8_t>(1, 0);
+        }
+        uint32_t type = fb.end_table();
+        fb.start_table();
+        fb.add_offset(0, name);
+        fb.add_offset(3, type);
+        fb.add_offset(5, children);
+        fb.add_scalar<uint8_t>(1, 1);
+        fb.add_scalar<uint8_t>(2, c.type == arrow_writer::UTF8 ? TYPE_UTF8 : TYPE_INT);
+        fields.push_back(fb.end_table());
+    }
+    uint32_t field_vector = fb.create_offset_vector(fields);
+    fb.start_table();
+    fb.add_offset(1, field_vector);
+    fb.add_scalar<int16_t>(0, 0);
+    return fb.end_table();
+}
+
+uint32_t build_message(flatbuffer_builder& fb, uint8_t header_type, uint32_t header, uint64_t body_size)
+{
+    fb.start_table();
+    fb.add_scalar<int64_t>(3, (int64_t)body_size);
+    fb.add_offset(2, header);
+    fb.add_scalar<int16_t>(0, METADATA_V5);
+    fb.add_scalar<uint8_t>(1, header_type);
+    return fb.end_table();
+}
+
+} // namespace
+
+arrow_writer::arrow_writer(std::ostream& o, size_t rows_per_batch)
+    : out(o), batch_rows(rows_per_batch), rows_in_batch(0), total_rows(0), position(0), started(false)
+{
+}
+
+void arrow_writer::add_column(const char* name, column_type type)
+{
+    column c;
+    c.name = name;
+    c.type = type;
+    c.offsets.push_back(0);
+    c.null_count = 0;
+    c.set = false;
+    columns.push_back(c);
+}
+
+void arrow_writer::set(size_t index, uint64_t value)
+{
+    column& c = columns[index];
+    for (uint32_t i = 0; i < type_width(c.type); i++)
+        c.values.push_back((uint8_t)(value >> (8 * i)));
+    c.set = true;
+}
+
+void arrow_writer::set(size_t index, const char* value, size_t size)
+{
+    column& c = columns[index];
+    c.values.insert(c.values.end(), value, value + size);
+    c.offsets.push_back((int32_t)c.values.size());
+    c.set = true;
+}
+
+void arrow_writer::end_row()
+{
+    if (!started)
+        write_schema();
+    for (column& c : columns)
+    {
+        if (rows_in_batch % 8 == 0)
+            c.validity.push_back(0);
+        if (c.set)
+        {
+            c.validity.back() |= (uint8_t)(1 << (rows_in_batch % 8));
+        }
+        else if (c.type == UTF8)
+        {
+            c.offsets.push_back((int32_t)c.values.size());
+            c.null_count++;
+        }
+        else
+        {
+            c.values.resize(c.values.size() + type_width(c.type), 0);
+            c.null_count++;
+        }
+        c.set = false;
+    }
+    total_rows++;
+    if (++rows_in_batch == batch_rows)
+        write_batch();
+}
+
+bool arrow_writer::finish()
+{
+    if (!started)
+        write_schema();
+    if (rows_in_batch)
+        write_batch();
+
+    static const uint8_t end_of_stream[8] = { 0xff, 0xff, 0xff, 0xff, 0, 0, 0, 0 };
+    out.write((const char*)end_of_stream, sizeof(end_of_stream));
+
+    // The footer repeats the schema and lists where every record batch starts.
+    flatbuffer_builder fb;
+    std::vector<uint64_t> words;
+    for (const block& b : blocks)
+    {
+        words.push_back(b.offset);
+        words.push_back(b.metadata_size);
+        words.push_back(b.body_size);
+    }
+    uint32_t batches = fb.create_struct_vector(words, 3);
+    uint32_t dictionaries = fb.create_struct_vector(std::vector<uint64_t>(), 3);
+    uint32_t schema = build_schema(fb, columns);
+    fb.start_table();
+    fb.add_offset(1, schema);
+    fb.add_offset(2, dictionaries);
+    fb.add_offset(3, batches);
+    fb.add_scalar<int16_t>(0, METADATA_V5);
+    std::vector<uint8_t> footer = fb.finish(fb.end_table());
+
+    uint32_t footer_size = (uint32_t)footer.size();
+    out.write((const char*)&footer[0], footer.size());
+    uint8_t size_bytes[4] = { (uint8_t)footer_size, (uint8_t)(footer_size >> 8), (uint8_t)(footer_size >> 16), (uint8_t)(footer_size >> 24) };
+    out.write((const char*)size_bytes, 4);
+    out.write(magic, 6);
+    out.flush();
+    return !out.fail();
+}
+
+void arrow_writer::write_schema()
+{
+    started = true;
+    out.write(magic, sizeof(magic));
+    position = sizeof(magic);
+
+    flatbuffer_builder fb;
+    uint32_t schema = build_schema(fb, columns);
+    write_message(fb.finish(build_message(fb, HEADER_SCHEMA, schema, 0)), std::vector<uint8_t>(), NULL);
+}
+
+void arrow_writer::write_batch()
+{
+    // Buffers per column: validity (empty without nulls), then values, or offsets and characters.
+    std::vector<uint8_t> body;
+    std::vector<uint64_t> nodes;
+    std::vector<uint64_t> buffers;
+    for (column& c : columns)
+    {
+        nodes.push_back(rows_in_batch);
+        nodes.push_back(c.null_count);
+        buffers.push_back(body.size());
+        if (c.null_count)
+        {
+            body.insert(body.end(), c.validity.begin(), c.validity.end());
+            buffers.push_back(c.validity.size());
+            pad8(body);
+        }
+        else
+        {
+            buffers.push_back(0);
+        }
+        if (c.type == UTF8)
+        {
+            buffers.push_back(body.size());
+            buffers.push_back(c.offsets.size() * 4);
+            for (int32_t offset : c.offsets)
+            {
+                for (int i = 0; i < 4; i++)
+                    body.push_back((uint8_t)(offset >> (8 * i)));
+            }
+            pad8(body);
+        }
+        buffers.push_back(body.size());
+        buffers.push_back(c.values.size());
+        body.insert(body.end(), c.values.begin(), c.values.end());
+        pad8(body);
+
+        c.validity.clear();
+        c.values.clear();
+        c.offsets.assign(1, 0);
+        c.null_count = 0;
+    }
+
+    flatbuffer_builder fb;
+    uint32_t buffer_vector = fb.create_struct_vector(buffers, 2);
+    uint32_t node_vector = fb.create_struct_vector(nodes, 2);
+    fb.start_table();
+    fb.add_scalar<int64_t>(0, (int64_t)rows_in_batch);
+    fb.add_offset(1, node_vector);
+    fb.add_offset(2, buffer_vector);
+    uint32_t batch = fb.end_table();
+    block written;
+    write_message(fb.finish(build_message(fb, HEADER_RECORD_BATCH, batch, body.size())), body, &written);
+    blocks.push_back(written);
+    rows_in_batch = 0;
+}
+
+void arrow_writer::write_message(const std::vector<uint8_t>& metadata, const std::vector<uint8_t>& body, block* written)
+{
+    // Encapsulated message: continuation marker, metadata size, metadata, body; all 8-byte aligned.
+    uint32_t size = (uint32_t)metadata.size();
+    uint8_t prefix[8] = { 0xff, 0xff, 0xff, 0xff, (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)(size >> 16), (uint8_t)(size >> 24) };
+    if (written)
+    {
+        written->offset = position;
+        written->metadata_size = sizeof(prefix) + size;
+        written->body_size = body.size();
+    }
+    out.write((const char*)prefix, sizeof(prefix));
+    out.write((const char*)&metadata[0], metadata.size());
+    if (!body.empty())
+        out.write((const char*)&body[0], body.size());
+    position += sizeof(prefix) + metadata.size() + body.size();
+}
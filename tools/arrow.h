@@ -0,0 +1,69 @@
+#ifndef ARROW_H_
+#define ARROW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <iostream>
+
+// Writes one table as an Arrow IPC file, the format Feather v2 also uses, without depending on the
+// Arrow libraries. Rows are collected column by column and written out as a record batch every
+// batch_rows rows, so memory stays bounded however many rows the table gets; only the position of
+// each batch is kept for the footer.
+//
+// Every column is nullable. Integers are unsigned, strings UTF-8.
+class arrow_writer
+{
+public:
+    enum column_type { UINT8, UINT16, UINT32, UINT64, UTF8 };
+
+    explicit arrow_writer(std::ostream& out, size_t batch_rows = 64 << 10);
+
+    // Columns are added before the first row.
+    void add_column(const char* name, column_type type);
+
+    // Values of the current row, by column position. Columns left unset are null.
+    void set(size_t column, uint64_t value);
+    void set(size_t column, const char* value, size_t size);
+    void set(size_t column, const std::string& value) { set(column, value.data(), value.size()); }
+    void end_row();
+
+    // Writes the last batch and the footer. Returns false if any write failed.
+    bool finish();
+
+    uint64_t rows() const { return total_rows; }
+
+private:
+    struct column
+    {
+        std::string name;
+        column_type type;
+        std::vector<uint8_t> validity;
+        std::vector<int32_t> offsets;
+        std::vector<uint8_t> values;
+        size_t null_count;
+        bool set;
+    };
+    struct block
+    {
+        uint64_t offset;
+        uint32_t metadata_size;
+        uint64_t body_size;
+    };
+
+    void write_schema();
+    void write_batch();
+    void write_message(const std::vector<uint8_t>& metadata, const std::vector<uint8_t>& body, block* written);
+
+    std::ostream& out;
+    size_t batch_rows;
+    std::vector<column> columns;
+    std::vector<block> blocks;
+    size_t rows_in_batch;
+    uint64_t total_rows;
+    uint64_t position;
+    bool started;
+};
+
+#endif /* ARROW_H_ */
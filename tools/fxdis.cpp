@@ -26,8 +26,25 @@
 
 #include "dxbc.h"
 #include "D3D11TokenParser.h"
+#include "fxdis.h"
+#include "supervisor.h"
+#include "shard.h"
+#include "archive.h"
+#include "stream.h"
+#include "stats.h"
+#include "histogram.h"
+#include "fxdis_stats.h"
+#include "ir.h"
+#include "token_codec.h"
+#include "shader_pack.h"
+#include "table_export.h"
+#include "analysis.h"
+#include "lint_report.h"
 #include <iostream>
 #include <fstream>
+#include <string.h>
+#include <chrono>
+#include <memory>
 
 void usage()
 {
@@ -36,61 +53,703 @@ void usage()
     std::cerr << "Not affiliated with or endorsed by Microsoft in any way\n";
     std::cerr << "Latest version available from http://cgit.freedesktop.org/mesa/mesa/\n";
     std::cerr << "\n";
-    std::cerr << "Usage: fxdis FILE\n";
+    std::cerr << "Usage: fxdis [OPTIONS] FILE...\n";
+    std::cerr << "       FILE may also be a .tar, .tar.zst/.tzst or .zip archive of shaders, or a .fxpack shader pack\n";
+    std::cerr << "       fxdis merge SHARD_OUTPUT...\n";
+    std::cerr << "       fxdis --stream < CONTAINERS\n";
+    std::cerr << "\n";
+    std::cerr << "  --stream           disassemble DXBC containers from stdin as each one arrives\n";
+    std::cerr << "  --list FILE        read input paths from FILE, one per line\n";
+    std::cerr << "  --isolate          decode every input in a crash-isolated worker process\n";
+    std::cerr << "  --jobs N           number of worker processes for --isolate, or threads for --histogram (default 4)\n";
+    std::cerr << "  --timeout MS       per-input time limit for --isolate, 0 for none (default 10000)\n";
+    std::cerr << "  --quarantine FILE  append inputs that crash or time out to FILE\n";
+    std::cerr << "  --shard I/N        only process inputs whose content hash falls in shard I of N\n";
+    std::cerr << "  --stats            report time per phase and decoder counters on stderr\n";
+    std::cerr << "  --stats-json       the same report as JSON\n";
+    std::cerr << "  --timings FILE     write the time spent on each input, reading to formatting, to FILE as CSV\n";
+    std::cerr << "  --histogram        count opcodes, operand types, modifiers, min precision, resource dimensions\n";
+    std::cerr << "                     and sampler modes over all inputs instead of disassembling, as CSV\n";
+    std::cerr << "  --histogram-json   the same counts as JSON\n";
+    std::cerr << "  --write-ir DIR     save each input's decoded program to DIR/NAME.fxir instead of disassembling;\n";
+    std::cerr << "                     fxdis prints .fxir files without decoding them again\n";
+    std::cerr << "  --compress DIR     save each input compressed to DIR/NAME.fxz instead of disassembling;\n";
+    std::cerr << "                     fxdis reads .fxz files like the originals\n";
+    std::cerr << "  --pack FILE        store all inputs in one indexed shader pack instead of disassembling,\n";
+    std::cerr << "                     printing each input's content hash\n";
+    std::cerr << "  --export DIR       write shader, instruction and declaration tables of all inputs to DIR\n";
+    std::cerr << "                     as Arrow IPC files instead of disassembling\n";
+    std::cerr << "  --cfg              print each input's control-flow graph in Graphviz dot syntax instead of\n";
+    std::cerr << "                     disassembling\n";
+    std::cerr << "  --liveness         report each input's peak live temp registers against dcl_temps, as CSV\n";
+    std::cerr << "  --cost             estimate each input's cost by cost class from opcode costs and loop\n";
+    std::cerr << "                     nesting, as CSV\n";
+    std::cerr << "  --cost-blocks      the same estimate for each basic block\n";
+    std::cerr << "  --cost-instructions\n";
+    std::cerr << "                     the same estimate for each instruction\n";
+    std::cerr << "  --latency          report basic blocks whose dependency chains take longer than issuing them,\n";
+    std::cerr << "                     as CSV\n";
+    std::cerr << "  --uniformity       classify each branch and loop as uniform or divergent, and report\n";
+    std::cerr << "                     derivatives taken in divergent flow, as CSV\n";
+    std::cerr << "  --occupancy        estimate waves per SIMD and occupancy of each compute shader from its thread\n";
+    std::cerr << "                     group size, shared memory and temps, as CSV\n";
+    std::cerr << "  --tgsm-banks       report the bank conflicts of each group shared memory load and store in\n";
+    std::cerr << "                     compute shaders, worst first, as CSV\n";
+    std::cerr << "  --buffers          report structured and raw buffer strides, partial loads, and scattered or\n";
+    std::cerr << "                     strided accesses in compute shaders, as CSV\n";
+    std::cerr << "  --cbuffers         report the bytes of each constant buffer read against its size, with the\n";
+    std::cerr << "                     variables never read where the RDEF chunk names them, as CSV\n";
+    std::cerr << "  --lint             check each input against the performance lint rules in one decode pass,\n";
+    std::cerr << "                     as JSON; fails if any finding is a warning\n";
+    std::cerr << "  --lint-sarif       the same findings as a SARIF 2.1.0 log\n";
+    std::cerr << "  --cost-profile FILE\n";
+    std::cerr << "                     read opcode costs, latencies and loop iterations for --cost and --latency\n";
+    std::cerr << "                     from FILE\n";
+    std::cerr << "  --hardware-profile FILE\n";
+    std::cerr << "                     read wave width, register file, shared memory, group limits and cache\n";
+    std::cerr << "                     line size for --occupancy, --tgsm-banks and --buffers from FILE\n";
     std::cerr << std::endl;
 }
 
-int main(int argc, char** argv)
+fxdis_arena& fxdis_thread_arena()
 {
-    if(argc < 2)
-    {
-        usage();
-        return EXIT_FAILURE;
-    }
+    static thread_local fxdis_arena arena;
+    return arena;
+}
 
-    std::vector<char> data;
+// Opens an input and checks its size; read_input reads and closes it.
+static FILE* open_input(const char* path, uint32_t& nFileSize, std::ostream& out)
+{
     FILE *pFile = NULL;
 #ifdef _MSC_VER
-    fopen_s(&pFile, argv[1], "rb" );
+    fopen_s(&pFile, path, "rb" );
 #else
-    pFile = fopen(argv[1], "rb" );
+    pFile = fopen(path, "rb" );
 #endif
     if ( !pFile )
     {
-       printf("Could not open file: %s\n", argv[1] );
-       return EXIT_FAILURE;
+       out << "Could not open file: " << path << "\n";
+       return NULL;
     }
 
     fseek(pFile, 0, SEEK_END);
-    uint32_t nFileSize = ftell(pFile);
+    nFileSize = ftell(pFile);
     fseek(pFile, 0, SEEK_SET);
 
     if (nFileSize < sizeof(dxbc_container_header))
     {
-      printf("File is too small!\n");
-      return EXIT_FAILURE;
+      out << "File is too small!\n";
+      fclose(pFile);
+      return NULL;
     }
+    return pFile;
+}
 
-    data.resize(nFileSize);
-    if (fread(&data[0], 1, nFileSize, pFile) != nFileSize)
+static bool read_input(FILE* pFile, void* data, uint32_t nFileSize, std::ostream& out)
+{
+    if (fread(data, 1, nFileSize, pFile) != nFileSize)
     {
-       printf("Failed reading file!\n");
-       return EXIT_FAILURE;
+       out << "Failed reading file!\n";
+       fclose(pFile);
+       return false;
     }
     fclose(pFile);
+    return true;
+}
+
+bool fxdis_read_file(const char* path, std::vector<char>& data, std::ostream& out)
+{
+    FXDIS_STATS_TIME(FXDIS_STATS_READ);
+    uint32_t nFileSize;
+    FILE* pFile = open_input(path, nFileSize, out);
+    if (!pFile)
+    {
+        return false;
+    }
+    data.resize(nFileSize);
+    return read_input(pFile, &data[0], nFileSize, out);
+}
 
-	dxbc_container* dxbc = dxbc_parse(&data[0], data.size());
+const void* fxdis_read_file(const char* path, size_t& size, fxdis_arena& arena, std::ostream& out)
+{
+    FXDIS_STATS_TIME(FXDIS_STATS_READ);
+    uint32_t nFileSize;
+    FILE* pFile = open_input(path, nFileSize, out);
+    if (!pFile)
+    {
+        return NULL;
+    }
+    void* data = arena.allocate(nFileSize);
+    if (!data || !read_input(pFile, data, nFileSize, out))
+    {
+        return NULL;
+    }
+    size = nFileSize;
+    return data;
+}
+
+int fxdis_disassemble(const void* data, size_t size, std::ostream& out)
+{
+	FXDIS_STATS_ADD(FXDIS_STATS_FILES, 1);
+	fxdis_arena& arena = fxdis_thread_arena();
+	fxdis_arena_scope scope(arena);
+	if (size_t original_size = token_decompressed_size(data, size))
+	{
+		void* original = arena.allocate(original_size);
+		if (!original || !token_decompress(data, size, original, original_size, &arena))
+		{
+			out << "Damaged compressed file\n";
+			return EXIT_FAILURE;
+		}
+		data = original;
+		size = original_size;
+	}
+	if (size >= sizeof(ir_header)
+		&& (((const ir_header*)data)->magic == IR_MAGIC || ((const ir_header*)data)->magic == IR_MAGIC_SWAPPED))
+	{
+		const ir_header* ir = ir_validate(data, size);
+		if (!ir)
+		{
+			out << "Invalid or incompatible IR file\n";
+			return EXIT_FAILURE;
+		}
+		FXDIS_STATS_TIME(FXDIS_STATS_FORMAT);
+		ir_format(ir, out);
+		return EXIT_SUCCESS;
+	}
+	dxbc_container* dxbc;
+	{
+		FXDIS_STATS_TIME(FXDIS_STATS_PARSE);
+		dxbc = dxbc_parse(data, size, &arena);
+	}
 	dxbc_chunk_header* sm4_chunk = nullptr;
 	if (dxbc)
 	{
-		std::cout << *dxbc;
-		sm4_chunk = dxbc_find_shader_bytecode(&data[0], data.size());
+		{
+			FXDIS_STATS_TIME(FXDIS_STATS_FORMAT);
+			out << *dxbc;
+		}
+		FXDIS_STATS_TIME(FXDIS_STATS_FIND_CHUNK);
+		sm4_chunk = dxbc_find_shader_bytecode(data, size);
 	}
 
 	// If no sm4 chuck is found, parse the binary as SM4/5 tokens from the very beginning.
-	TokenParser sm4Parser = TokenParser(sm4_chunk ? ((uint32_t*)sm4_chunk + 2) : ((uint32_t*)&data[0]), sm4_chunk ? sm4_chunk->size : data.size());
-	sm4Parser.Parse();
-	delete dxbc;
+	TokenParser sm4Parser = TokenParser(sm4_chunk ? ((uint32_t*)sm4_chunk + 2) : ((uint32_t*)data), sm4_chunk ? sm4_chunk->size : size, out, &arena);
+	bool parsed = sm4Parser.Parse();
+
+    return parsed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int fxdis_disassemble_file(const char* path, std::ostream& out)
+{
+    if (archive_is_archive(path))
+    {
+        return archive_disassemble(path, out);
+    }
+
+    fxdis_arena_scope scope(fxdis_thread_arena());
+    size_t size;
+    const void* data = fxdis_read_file(path, size, fxdis_thread_arena(), out);
+    if (!data)
+    {
+        return EXIT_FAILURE;
+    }
+    return fxdis_disassemble(data, size, out);
+}
+
+// Saves the IR of every input as DIR/NAME.fxir, NAME being the input's file name.
+static int write_ir(const std::vector<std::string>& inputs, const std::string& dir)
+{
+    int result = EXIT_SUCCESS;
+    std::vector<char> data;
+    std::vector<char> ir;
+    for (const std::string& input : inputs)
+    {
+        if (!fxdis_read_file(input.c_str(), data, std::cerr))
+        {
+            result = EXIT_FAILURE;
+            continue;
+        }
+        fxdis_arena_scope scope(fxdis_thread_arena());
+        dxbc_container* dxbc = dxbc_parse(&data[0], (int)data.size(), &fxdis_thread_arena());
+        dxbc_chunk_header* chunk = dxbc ? dxbc_find_shader_bytecode(&data[0], (int)data.size()) : NULL;
+        const uint32_t* tokens = chunk ? (const uint32_t*)(chunk + 1) : (const uint32_t*)&data[0];
+        uint32_t size = chunk ? bswap_le32(chunk->size) : (uint32_t)data.size();
+        ir.clear();
+        DECODE_STATUS status = ir_encode(tokens, size, ir, dxbc);
+        if (status != DECODE_STATUS::END)
+        {
+            std::cerr << input << ": " << DecodeStatusText[(int)status] << std::endl;
+            result = EXIT_FAILURE;
+            continue;
+        }
+        size_t slash = input.find_last_of("/\\");
+        std::string path = dir + "/" + input.substr(slash == std::string::npos ? 0 : slash + 1) + ".fxir";
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if (!file.write(&ir[0], ir.size()))
+        {
+            std::cerr << "Could not write " << path << std::endl;
+            result = EXIT_FAILURE;
+        }
+    }
+    return result;
+}
+
+// Saves every input compressed as DIR/NAME.fxz, checking that each one decompresses to the
+// original, and reports the total sizes on stderr.
+static int write_compressed(const std::vector<std::string>& inputs, const std::string& dir)
+{
+    int result = EXIT_SUCCESS;
+    uint64_t original_total = 0;
+    uint64_t compressed_total = 0;
+    std::vector<char> data;
+    std::vector<char> compressed;
+    std::vector<char> check;
+    for (const std::string& input : inputs)
+    {
+        if (!fxdis_read_file(input.c_str(), data, std::cerr))
+        {
+            result = EXIT_FAILURE;
+            continue;
+        }
+        compressed.clear();
+        check.resize(data.size());
+        if (!token_compress(&data[0], data.size(), compressed)
+            || !token_decompress(&compressed[0], compressed.size(), &check[0], check.size())
+            || check != data)
+        {
+            std::cerr << input << ": compression failed" << std::endl;
+            result = EXIT_FAILURE;
+            continue;
+        }
+        size_t slash = input.find_last_of("/\\");
+        std::string path = dir + "/" + input.substr(slash == std::string::npos ? 0 : slash + 1) + ".fxz";
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if (!file.write(&compressed[0], compressed.size()))
+        {
+            std::cerr << "Could not write " << path << std::endl;
+            result = EXIT_FAILURE;
+            continue;
+        }
+        original_total += data.size();
+        compressed_total += compressed.size();
+    }
+    std::cerr << original_total << " bytes compressed to " << compressed_total << " ("
+        << (original_total ? compressed_total * 100.0 / original_total : 0.0) << "%)" << std::endl;
+    return result;
+}
 
-    return EXIT_SUCCESS;
+// Stores every input in one shader pack, printing the content hash each can be found under and
+// reporting on stderr how many were stored after removing duplicates.
+static int write_pack(const std::vector<std::string>& inputs, const char* path)
+{
+    int result = EXIT_SUCCESS;
+    shader_pack_writer writer;
+    std::vector<char> data;
+    for (const std::string& input : inputs)
+    {
+        if (!fxdis_read_file(input.c_str(), data, std::cerr))
+        {
+            result = EXIT_FAILURE;
+            continue;
+        }
+        uint64_t hash;
+        shader_pack_status status = writer.add(&data[0], data.size(), input.c_str(), hash);
+        if (status == SHADER_PACK_INVALID || status == SHADER_PACK_COLLISION)
+        {
+            std::cerr << input << (status == SHADER_PACK_INVALID ? ": not a shader container that decodes"
+                : ": content hash collides with another input") << std::endl;
+            result = EXIT_FAILURE;
+            continue;
+        }
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+        std::cout << hex << " " << input << "\n";
+    }
+    std::ofstream file(path, std::ios::binary);
+    if (!file || !writer.write(file))
+    {
+        std::cerr << "Could not write " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cerr << writer.shader_count() << " shaders packed from " << inputs.size() << " inputs" << std::endl;
+    return result;
+}
+
+// Disassembles one input, adding its row to timings if given. The time is taken in the process,
+// so it leaves out starting fxdis and covers only what a batch spends on the input.
+static int disassemble_timed(const std::string& input, std::ostream& out, std::ostream* timings)
+{
+    if (!timings)
+    {
+        return fxdis_disassemble_file(input.c_str(), out);
+    }
+    auto start = std::chrono::steady_clock::now();
+    int result = fxdis_disassemble_file(input.c_str(), out);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    *timings << input << "," << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() << "\n";
+    return result;
+}
+
+bool read_list(const char* path, std::vector<std::string>& inputs)
+{
+    std::ifstream list(path);
+    if (!list)
+    {
+        std::cerr << "Could not open list: " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(list, line))
+    {
+        if (!line.empty() && line[line.size() - 1] == '\r')
+        {
+            line.erase(line.size() - 1);
+        }
+        if (!line.empty())
+        {
+            inputs.push_back(line);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && !strcmp(argv[1], "merge"))
+    {
+        if (argc < 3)
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+        return shard_merge(std::vector<std::string>(argv + 2, argv + argc), std::cout);
+    }
+
+    std::vector<std::string> inputs;
+    bool isolate = false;
+    bool sharded = false;
+    bool stream = false;
+    bool stats = false;
+    bool stats_json = false;
+    bool histogram_mode = false;
+    bool histogram_json = false;
+    const char* ir_dir = NULL;
+    const char* compress_dir = NULL;
+    const char* pack_path = NULL;
+    const char* export_dir = NULL;
+    const char* timings_path = NULL;
+    bool analyze = false;
+    bool lint = false;
+    bool lint_sarif = false;
+    analysis_options analysis;
+    analysis.report = ANALYSIS_CFG;
+    analysis.cost_profile = NULL;
+    analysis.hardware_profile = NULL;
+    shard_spec shard;
+    supervisor_options options;
+    options.jobs = 4;
+    options.timeout_ms = 10000;
+    options.slot_size = 16 << 20;
+    options.quarantine_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--stream"))
+        {
+            stream = true;
+        }
+        else if (!strcmp(arg, "--stats") || !strcmp(arg, "--stats-json"))
+        {
+            stats = true;
+            stats_json = !strcmp(arg, "--stats-json");
+        }
+        else if (!strcmp(arg, "--timings") && hasValue)
+        {
+            timings_path = argv[++i];
+        }
+        else if (!strcmp(arg, "--histogram") || !strcmp(arg, "--histogram-json"))
+        {
+            histogram_mode = true;
+            histogram_json = !strcmp(arg, "--histogram-json");
+        }
+        else if (!strcmp(arg, "--write-ir") && hasValue)
+        {
+            ir_dir = argv[++i];
+        }
+        else if (!strcmp(arg, "--compress") && hasValue)
+        {
+            compress_dir = argv[++i];
+        }
+        else if (!strcmp(arg, "--pack") && hasValue)
+        {
+            pack_path = argv[++i];
+        }
+        else if (!strcmp(arg, "--export") && hasValue)
+        {
+            export_dir = argv[++i];
+        }
+        else if (!strcmp(arg, "--cfg") || !strcmp(arg, "--liveness"))
+        {
+            analyze = true;
+            analysis.report = !strcmp(arg, "--cfg") ? ANALYSIS_CFG : ANALYSIS_LIVENESS;
+        }
+        else if (!strcmp(arg, "--cost") || !strcmp(arg, "--cost-blocks") || !strcmp(arg, "--cost-instructions"))
+        {
+            analyze = true;
+            analysis.report = !strcmp(arg, "--cost") ? ANALYSIS_COST
+                : !strcmp(arg, "--cost-blocks") ? ANALYSIS_COST_BLOCKS : ANALYSIS_COST_INSTRUCTIONS;
+        }
+        else if (!strcmp(arg, "--latency"))
+        {
+            analyze = true;
+            analysis.report = ANALYSIS_LATENCY;
+        }
+        else if (!strcmp(arg, "--uniformity"))
+        {
+            analyze = true;
+            analysis.report = ANALYSIS_UNIFORMITY;
+        }
+        else if (!strcmp(arg, "--occupancy"))
+        {
+            analyze = true;
+            analysis.report = ANALYSIS_OCCUPANCY;
+        }
+        else if (!strcmp(arg, "--tgsm-banks"))
+        {
+            analyze = true;
+            analysis.report = ANALYSIS_TGSM_BANKS;
+        }
+        else if (!strcmp(arg, "--buffers"))
+        {
+            analyze = true;
+            analysis.report = ANALYSIS_BUFFERS;
+        }
+        else if (!strcmp(arg, "--cbuffers"))
+        {
+            analyze = true;
+            analysis.report = ANALYSIS_CBUFFERS;
+        }
+        else if (!strcmp(arg, "--lint") || !strcmp(arg, "--lint-sarif"))
+        {
+            lint = true;
+            lint_sarif = !strcmp(arg, "--lint-sarif");
+        }
+        else if (!strcmp(arg, "--cost-profile") && hasValue)
+        {
+            analysis.cost_profile = argv[++i];
+        }
+        else if (!strcmp(arg, "--hardware-profile") && hasValue)
+        {
+            analysis.hardware_profile = argv[++i];
+        }
+        else if (!strcmp(arg, "--isolate"))
+        {
+            isolate = true;
+        }
+        else if (!strcmp(arg, "--jobs") && hasValue)
+        {
+            options.jobs = atoi(argv[++i]);
+        }
+        else if (!strcmp(arg, "--timeout") && hasValue)
+        {
+            options.timeout_ms = atoi(argv[++i]);
+        }
+        else if (!strcmp(arg, "--quarantine") && hasValue)
+        {
+            options.quarantine_path = argv[++i];
+        }
+        else if (!strcmp(arg, "--shard") && hasValue)
+        {
+            if (!shard_parse(argv[++i], shard))
+            {
+                std::cerr << "Invalid shard: " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+            sharded = true;
+        }
+        else if (!strcmp(arg, "--list") && hasValue)
+        {
+            if (!read_list(argv[++i], inputs))
+            {
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg[0] == '-' && arg[1] == '-')
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+        else
+        {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (histogram_mode && (isolate || stream || stats))
+    {
+        std::cerr << "--histogram cannot be combined with --isolate, --stream or --stats" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if ((ir_dir || compress_dir || pack_path || export_dir || analyze || lint)
+        && (histogram_mode || isolate || stream || stats || sharded
+            || (!!ir_dir + !!compress_dir + !!pack_path + !!export_dir + analyze + lint) > 1))
+    {
+        std::cerr << "--write-ir, --compress, --pack, --export, --cfg, --liveness, --cost, --latency, --uniformity, --occupancy, --tgsm-banks, --buffers, --cbuffers and --lint cannot be combined with each other or with --histogram, --isolate, --stream, --stats or --shard" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (timings_path && (histogram_mode || isolate || stream || ir_dir || compress_dir || pack_path || export_dir
+        || analyze || lint))
+    {
+        std::cerr << "--timings only times disassembly, without --isolate or --stream" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (analysis.cost_profile && !(analyze && analysis.report >= ANALYSIS_COST && analysis.report <= ANALYSIS_LATENCY))
+    {
+        std::cerr << "--cost-profile needs --cost, --cost-blocks, --cost-instructions or --latency" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (analysis.hardware_profile
+        && !(analyze && analysis.report >= ANALYSIS_OCCUPANCY && analysis.report <= ANALYSIS_BUFFERS))
+    {
+        std::cerr << "--hardware-profile needs --occupancy, --tgsm-banks or --buffers" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (stats)
+    {
+#ifndef FXDIS_STATS
+        std::cerr << "This build of fxdis has no --stats support (FXDIS_STATS is not defined)" << std::endl;
+        return EXIT_FAILURE;
+#endif
+        if (isolate)
+        {
+            std::cerr << "--stats cannot be combined with --isolate" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+#ifdef FXDIS_STATS
+    // A shard's statistics follow its output, for fxdis merge to sum and report.
+    std::unique_ptr<stats_session> session(stats
+        ? new stats_session(std::cout, sharded ? std::cout : std::cerr, stats_json, sharded) : nullptr);
+#endif
+
+    if (stream)
+    {
+        return stream_disassemble(stdin, std::cout);
+    }
+
+    if (inputs.empty())
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if (ir_dir)
+    {
+        return write_ir(inputs, ir_dir);
+    }
+    if (compress_dir)
+    {
+        return write_compressed(inputs, compress_dir);
+    }
+    if (pack_path)
+    {
+        return write_pack(inputs, pack_path);
+    }
+    if (export_dir)
+    {
+        return table_export(inputs, export_dir);
+    }
+    if (analyze)
+    {
+        return analysis_run(inputs, analysis, std::cout);
+    }
+    if (lint)
+    {
+        return lint_run(inputs, lint_sarif, std::cout);
+    }
+
+    if (histogram_mode)
+    {
+        std::vector<std::string> selected;
+        std::vector<size_t> positions = sharded ? shard_select(inputs, shard) : std::vector<size_t>();
+        for (size_t i = 0; i < (sharded ? positions.size() : inputs.size()); i++)
+        {
+            selected.push_back(inputs[sharded ? positions[i] : i]);
+        }
+        histogram counts;
+        memset(&counts, 0, sizeof(counts));
+        histogram_run(selected, options.jobs, counts);
+        if (sharded)
+        {
+            std::cout << shard_header(shard, inputs.size(), true, histogram_json);
+        }
+        // Shards write rows for fxdis merge to sum, whatever form the merged counts take.
+        histogram_write(counts, histogram_json && !sharded, std::cout);
+        return counts.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    std::unique_ptr<std::ofstream> timings;
+    if (timings_path)
+    {
+        timings.reset(new std::ofstream(timings_path));
+        if (!*timings)
+        {
+            std::cerr << "Could not write " << timings_path << std::endl;
+            return EXIT_FAILURE;
+        }
+        *timings << "input,nanoseconds\n";
+    }
+
+    // A single input keeps the plain output; anything that can be part of a larger run gets headers.
+    if (inputs.size() == 1 && !isolate && !sharded)
+    {
+        return disassemble_timed(inputs[0], std::cout, timings.get());
+    }
+
+    std::vector<size_t> positions;
+    if (sharded)
+    {
+        positions = shard_select(inputs, shard);
+        std::cout << shard_header(shard, inputs.size());
+    }
+    else
+    {
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            positions.push_back(i);
+        }
+    }
+
+    if (isolate)
+    {
+        std::vector<std::string> selected;
+        std::vector<std::string> headers;
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            const std::string& input = inputs[positions[i]];
+            selected.push_back(input);
+            headers.push_back((sharded ? shard_input_header(positions[i]) : std::string()) + "# FILE: " + input + "\n");
+        }
+        return supervisor_run(selected, headers, options, fxdis_disassemble_file, std::cout) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // Headers are written in place so that a batch allocates nothing per input.
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        const std::string& input = inputs[positions[i]];
+        if (sharded)
+        {
+            shard_write_input_header(std::cout, positions[i]);
+        }
+        std::cout << "# FILE: " << input << "\n";
+        if (disassemble_timed(input, std::cout, timings.get()) != EXIT_SUCCESS)
+        {
+            result = EXIT_FAILURE;
+        }
+    }
+    return result;
 }
@@ -0,0 +1,25 @@
+#ifndef FXDIS_H_
+#define FXDIS_H_
+
+#include <stddef.h>
+#include <vector>
+#include <string>
+#include <iostream>
+#include "arena.h"
+
+// Per-shader data of the calling thread. Every input is decoded inside a fxdis_arena_scope, so
+// the arena is reset after each one and a batch stops allocating once it has seen its largest shader.
+fxdis_arena& fxdis_thread_arena();
+
+// Reads a whole file into data. Errors are reported on out.
+bool fxdis_read_file(const char* path, std::vector<char>& data, std::ostream& out);
+// The same, into arena. Returns NULL on error.
+const void* fxdis_read_file(const char* path, size_t& size, fxdis_arena& arena, std::ostream& out);
+
+// Disassembles a DXBC container, or a bare SM4/5 token stream if no container header is found.
+int fxdis_disassemble(const void* data, size_t size, std::ostream& out);
+
+// Reads and disassembles a single input file, or every file of an archive.
+int fxdis_disassemble_file(const char* path, std::ostream& out);
+
+#endif /* FXDIS_H_ */
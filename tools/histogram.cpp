@@ -0,0 +1,281 @@
+#include "histogram.h"
+#include "fxdis.h"
+#include "archive.h"
+#include "dxbc.h"
+#include "D3D11TokenParser.h"
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+static_assert(D3D10_SB_NUM_OPCODES <= sizeof(((histogram*)0)->opcodes) / sizeof(uint64_t), "histogram::opcodes is too small");
+
+namespace {
+
+const char* const modifier_names[] = { "none", "neg", "abs", "abs_neg" };
+const char* const min_precision_names[] = { "default", "min16float", "min10float", NULL, "min16sint", "min16uint" };
+
+void count_program(const uint32_t* tokens, uint32_t size, fxdis_arena& arena, histogram& h)
+{
+    h.shaders++;
+    TokenDecoder decoder(tokens, size, &arena);
+    DecodedOperandPool operands(&arena);
+    DECODE_STATUS status = decoder.DecodeHeader();
+    if (status != DECODE_STATUS::OK)
+    {
+        h.failed++;
+        return;
+    }
+    DecodedInstruction inst;
+    while ((status = decoder.Next(inst, operands)) == DECODE_STATUS::OK)
+    {
+        h.opcodes[inst.opcode]++;
+        // The pool holds the relative index registers too; they are operands like any other.
+        for (size_t i = inst.firstOperand; i < operands.size(); i++)
+        {
+            const DecodedOperand& operand = operands[i];
+            h.operand_types[operand.type]++;
+            h.modifiers[operand.modifier]++;
+            h.min_precisions[operand.minPrecision & 7]++;
+        }
+        switch (inst.opcode)
+        {
+        case D3D10_SB_OPCODE_DCL_RESOURCE:
+        case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_TYPED:
+            h.resource_dimensions[DECODE_D3D10_SB_RESOURCE_DIMENSION(inst.opcodeToken) & 31]++;
+            break;
+        // Raw and structured views are told apart by opcode; their dimension field is not reliable.
+        case D3D11_SB_OPCODE_DCL_RESOURCE_RAW:
+        case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW:
+            h.resource_dimensions[D3D11_SB_RESOURCE_DIMENSION_RAW_BUFFER]++;
+            break;
+        case D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED:
+        case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED:
+            h.resource_dimensions[D3D11_SB_RESOURCE_DIMENSION_STRUCTURED_BUFFER]++;
+            break;
+        case D3D10_SB_OPCODE_DCL_SAMPLER:
+            h.sampler_modes[DECODE_D3D10_SB_SAMPLER_MODE(inst.opcodeToken) & 15]++;
+            break;
+        default:
+            break;
+        }
+        operands.clear();
+    }
+    if (status != DECODE_STATUS::END)
+        h.failed++;
+}
+
+// A DXBC container, or a bare token stream as fxdis_disassemble takes it.
+void count_input(const void* data, size_t size, fxdis_arena& arena, histogram& h)
+{
+    dxbc_chunk_header* chunk = dxbc_find_shader_bytecode(data, (int)size);
+    if (chunk)
+        count_program((const uint32_t*)(chunk + 1), bswap_le32(chunk->size), arena, h);
+    else
+        count_program((const uint32_t*)data, (uint32_t)size, arena, h);
+}
+
+void count_path(const std::string& path, histogram& h, std::ostream& errors)
+{
+    fxdis_arena& arena = fxdis_thread_arena();
+    if (archive_is_archive(path.c_str()))
+    {
+        archive_reader* reader = archive_open(path.c_str(), errors);
+        if (!reader)
+        {
+            h.failed++;
+            return;
+        }
+        std::string name;
+        std::vector<char> data;
+        while (reader->next(name, data))
+        {
+            fxdis_arena_scope scope(arena);
+            if (data.size() < sizeof(dxbc_container_header))
+            {
+                h.shaders++;
+                h.failed++;
+                continue;
+            }
+            count_input(&data[0], data.size(), arena, h);
+        }
+        if (!reader->error.empty())
+        {
+            errors << path << ": " << reader->error << "\n";
+            h.failed++;
+        }
+        delete reader;
+        return;
+    }
+
+    fxdis_arena_scope scope(arena);
+    size_t size;
+    const void* data = fxdis_read_file(path.c_str(), size, arena, errors);
+    if (!data)
+    {
+        h.shaders++;
+        h.failed++;
+        return;
+    }
+    count_input(data, size, arena, h);
+}
+
+template<size_t N>
+void merge(uint64_t (&total)[N], const uint64_t (&part)[N])
+{
+    for (size_t i = 0; i < N; i++)
+        total[i] += part[i];
+}
+
+std::string value_name(const char* const* names, size_t count, size_t value, size_t skip = 0)
+{
+    if (value < count && names[value])
+        return names[value] + skip;
+    std::ostringstream name;
+    name << "unknown_" << value;
+    return name.str();
+}
+
+template<size_t N>
+void write_category(std::ostream& out, bool json, bool& first, const char* category, const uint64_t (&counts)[N],
+    const char* const* names, size_t name_count, size_t skip = 0)
+{
+    if (json)
+        out << (first ? "" : ",\n") << "  \"" << category << "\": {";
+    first = false;
+    bool first_value = true;
+    for (size_t i = 0; i < N; i++)
+    {
+        if (!counts[i])
+            continue;
+        std::string name = value_name(names, name_count, i, skip);
+        if (json)
+            out << (first_value ? "" : ", ") << "\"" << name << "\": " << counts[i];
+        else
+            out << category << "," << name << "," << counts[i] << "\n";
+        first_value = false;
+    }
+    if (json)
+        out << "}";
+}
+
+template<size_t N>
+bool read_category(const std::string& name, uint64_t count, uint64_t (&counts)[N], const char* const* names,
+    size_t name_count, size_t skip = 0)
+{
+    for (size_t i = 0; i < N; i++)
+    {
+        if (value_name(names, name_count, i, skip) == name)
+        {
+            counts[i] += count;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+void histogram_run(const std::vector<std::string>& inputs, unsigned jobs, histogram& total)
+{
+    if (jobs < 1)
+        jobs = 1;
+    if (jobs > inputs.size())
+        jobs = inputs.size() ? (unsigned)inputs.size() : 1;
+
+    std::vector<histogram> parts(jobs);
+    std::vector<std::string> errors(jobs);
+    memset(&parts[0], 0, sizeof(histogram) * jobs);
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < jobs; t++)
+    {
+        threads.push_back(std::thread([&, t] {
+            std::ostringstream messages;
+            for (size_t i; (i = next++) < inputs.size(); )
+                count_path(inputs[i], parts[t], messages);
+            errors[t] = messages.str();
+        }));
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (unsigned t = 0; t < jobs; t++)
+    {
+        std::cerr << errors[t];
+        total.shaders += parts[t].shaders;
+        total.failed += parts[t].failed;
+        merge(total.opcodes, parts[t].opcodes);
+        merge(total.operand_types, parts[t].operand_types);
+        merge(total.modifiers, parts[t].modifiers);
+        merge(total.min_precisions, parts[t].min_precisions);
+        merge(total.resource_dimensions, parts[t].resource_dimensions);
+        merge(total.sampler_modes, parts[t].sampler_modes);
+    }
+}
+
+void histogram_write(const histogram& h, bool json, std::ostream& out)
+{
+    if (json)
+        out << "{\n  \"shaders\": " << h.shaders << ",\n  \"failed\": " << h.failed << ",\n";
+    else
+        out << "category,name,count\nsummary,shaders," << h.shaders << "\nsummary,failed," << h.failed << "\n";
+
+    bool first = true;
+    write_category(out, json, first, "opcode", h.opcodes, OpcodeText, OpcodeTextCount);
+    write_category(out, json, first, "operand_type", h.operand_types, OperandText, OperandTextCount);
+    write_category(out, json, first, "modifier", h.modifiers, modifier_names, sizeof(modifier_names) / sizeof(modifier_names[0]));
+    write_category(out, json, first, "min_precision", h.min_precisions, min_precision_names,
+        sizeof(min_precision_names) / sizeof(min_precision_names[0]));
+    // The text tables are written to follow a keyword, as in "dcl_resource_texture2d" and "mode_default".
+    write_category(out, json, first, "resource_dimension", h.resource_dimensions, ResourceDimText, ResourceDimTextCount, 1);
+    write_category(out, json, first, "sampler_mode", h.sampler_modes, SampleModeText, SampleModeTextCount, 5);
+    if (json)
+        out << "\n}\n";
+}
+
+bool histogram_read(std::istream& in, histogram& h)
+{
+    std::string line;
+    if (!std::getline(in, line) || line != "category,name,count")
+        return false;
+    while (std::getline(in, line))
+    {
+        size_t first = line.find(','), last = line.rfind(',');
+        if (first == std::string::npos || first == last || last + 1 == line.size())
+            return false;
+        char* end;
+        uint64_t count = strtoull(line.c_str() + last + 1, &end, 10);
+        if (*end)
+            return false;
+        std::string category = line.substr(0, first);
+        std::string name = line.substr(first + 1, last - first - 1);
+        bool known;
+        if (category == "summary")
+        {
+            uint64_t* total = name == "shaders" ? &h.shaders : name == "failed" ? &h.failed : NULL;
+            known = total != NULL;
+            if (total)
+                *total += count;
+        }
+        else if (category == "opcode")
+            known = read_category(name, count, h.opcodes, OpcodeText, OpcodeTextCount);
+        else if (category == "operand_type")
+            known = read_category(name, count, h.operand_types, OperandText, OperandTextCount);
+        else if (category == "modifier")
+            known = read_category(name, count, h.modifiers, modifier_names, sizeof(modifier_names) / sizeof(modifier_names[0]));
+        else if (category == "min_precision")
+            known = read_category(name, count, h.min_precisions, min_precision_names,
+                sizeof(min_precision_names) / sizeof(min_precision_names[0]));
+        else if (category == "resource_dimension")
+            known = read_category(name, count, h.resource_dimensions, ResourceDimText, ResourceDimTextCount, 1);
+        else if (category == "sampler_mode")
+            known = read_category(name, count, h.sampler_modes, SampleModeText, SampleModeTextCount, 5);
+        else
+            known = false;
+        if (!known)
+            return false;
+    }
+    return true;
+}
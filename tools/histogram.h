@@ -0,0 +1,36 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <iostream>
+
+// Corpus-wide counts of what shaders use. Each array is indexed by the token value itself and has
+// room for every value the decoder can produce.
+struct histogram
+{
+    uint64_t shaders;
+    uint64_t failed;            // inputs that could not be read or decoded to the end
+    uint64_t opcodes[256];
+    uint64_t operand_types[256];
+    uint64_t modifiers[256];
+    uint64_t min_precisions[8];
+    uint64_t resource_dimensions[32];
+    uint64_t sampler_modes[16];
+};
+
+// Decodes every input on jobs threads, without formatting any text, and adds the counts to total.
+// Archives are read entry by entry. Each thread counts on its own and the results are merged once
+// all inputs are done.
+void histogram_run(const std::vector<std::string>& inputs, unsigned jobs, histogram& total);
+
+// Writes "category,name,count" rows, or one JSON object with an object per category. Only values
+// that occur are listed.
+void histogram_write(const histogram& h, bool json, std::ostream& out);
+
+// Reads the rows histogram_write writes without json, up to the end of in, and adds their counts to
+// h. Returns false on a row it did not write.
+bool histogram_read(std::istream& in, histogram& h);
+
+#endif /* HISTOGRAM_H_ */
@@ -0,0 +1,245 @@
+#include "lint_report.h"
+#include "archive.h"
+#include "fxdis.h"
+#include "dxbc.h"
+#include "D3D11TokenParser.h"
+#include "lint.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+void write_json_string(std::ostream& out, const std::string& text)
+{
+    out << '"';
+    for (unsigned char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out << '\\' << c;
+        }
+        else if (c < 0x20)
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out << escape;
+        }
+        else
+        {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+// SARIF locations are URI references: anything but unreserved characters and the path separator
+// is percent-encoded, so that "archive.tar:entry" does not read as a URI scheme.
+std::string uri_reference(const std::string& path)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string uri;
+    for (unsigned char c : path)
+    {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || c == '-' || c == '.' || c == '_' || c == '~' || c == '/')
+            uri += (char)c;
+        else if (c == '\\')
+            uri += '/';
+        else
+            uri += std::string("%") + hex[c >> 4] + hex[c & 15];
+    }
+    return uri;
+}
+
+std::string register_name(const char* prefix, uint32_t index, uint32_t size)
+{
+    std::string name = prefix + std::to_string(index);
+    if (size)
+        name += "[" + std::to_string(size) + "]";
+    return name;
+}
+
+std::string finding_message(const lint_finding& finding)
+{
+    const char* opcode = TokenText(OpcodeText, OpcodeTextCount, finding.opcode);
+    switch (finding.rule)
+    {
+    case LINT_SKIP_OPTIMIZATION:
+        return "compiled with optimizations skipped";
+    case LINT_DOUBLE_PRECISION:
+        return std::string(opcode) + " is a double precision instruction";
+    case LINT_DYNAMIC_CONSTANT_BUFFER:
+        return register_name("cb", finding.index, finding.size) + " is declared dynamic indexed";
+    case LINT_INDEXABLE_TEMP:
+        return register_name("x", finding.index, finding.size) + " is an indexable temp array";
+    case LINT_SAMPLE_RATE_INPUT:
+        return register_name("v", finding.index, 0) + (finding.opcode == D3D10_SB_OPCODE_DCL_INPUT_PS
+            || finding.opcode == D3D10_SB_OPCODE_DCL_INPUT_PS_SIV ? " is interpolated per sample" : " is SV_SampleIndex");
+    case LINT_UNNEEDED_COHERENCE:
+        return register_name("u", finding.index, 0) + " is globally coherent, but no sync fences UAV memory globally";
+    default:
+        return opcode;
+    }
+}
+
+class linter
+{
+public:
+    linter(bool s, std::ostream& o) : sarif(s), out(o), first(true), shaders(0), failed_inputs(0), warnings(false) {}
+
+    void begin()
+    {
+        if (!sarif)
+        {
+            out << "{\n  \"findings\": [";
+            return;
+        }
+        out << "{\n  \"$schema\": \"https://json.schemastore.org/sarif-2.1.0.json\",\n  \"version\": \"2.1.0\",\n"
+            "  \"runs\": [\n    {\n      \"tool\": {\n        \"driver\": {\n          \"name\": \"fxdis\",\n"
+            "          \"rules\": [";
+        for (uint32_t r = 0; r < LINT_RULE_COUNT; r++)
+        {
+            const lint_rule_info& rule = lint_rules[r];
+            out << (r ? "," : "") << "\n            {\"id\": \"" << rule.id << "\", \"name\": \"" << rule.name
+                << "\", \"shortDescription\": {\"text\": ";
+            write_json_string(out, rule.description);
+            out << "}, \"defaultConfiguration\": {\"level\": \"" << lint_level_text[rule.level] << "\"}}";
+        }
+        out << "\n          ]\n        }\n      },\n      \"results\": [";
+    }
+
+    void add_path(const std::string& path)
+    {
+        fxdis_arena& arena = fxdis_thread_arena();
+        if (archive_is_archive(path.c_str()))
+        {
+            archive_reader* reader = archive_open(path.c_str(), std::cerr);
+            if (!reader)
+            {
+                failed_inputs++;
+                return;
+            }
+            std::string name;
+            std::vector<char> data;
+            while (reader->next(name, data))
+            {
+                fxdis_arena_scope scope(arena);
+                add_input(path + ":" + name, data.empty() ? NULL : &data[0], data.size());
+            }
+            if (!reader->error.empty())
+            {
+                std::cerr << path << ": " << reader->error << std::endl;
+                failed_inputs++;
+            }
+            delete reader;
+            return;
+        }
+
+        fxdis_arena_scope scope(arena);
+        size_t size;
+        const void* data = fxdis_read_file(path.c_str(), size, arena, std::cerr);
+        if (!data)
+        {
+            failed_inputs++;
+            return;
+        }
+        add_input(path, data, size);
+    }
+
+    bool end()
+    {
+        if (sarif)
+            out << (first ? "" : "\n      ") << "],\n      \"invocations\": [{\"executionSuccessful\": "
+                << (failed_inputs ? "false" : "true") << "}]\n    }\n  ]\n}\n";
+        else
+            out << (first ? "" : "\n  ") << "],\n  \"shaders\": " << shaders << ",\n  \"failed\": " << failed_inputs << "\n}\n";
+        out.flush();
+        return !failed_inputs && !warnings;
+    }
+
+private:
+    // A DXBC container, or a bare token stream as fxdis_disassemble takes it. Findings before a
+    // decode error are still written.
+    void add_input(const std::string& path, const void* data, size_t size)
+    {
+        dxbc_chunk_header* chunk = data ? dxbc_find_shader_bytecode(data, (int)size) : NULL;
+        const uint32_t* tokens = chunk ? (const uint32_t*)(chunk + 1) : (const uint32_t*)data;
+        uint32_t token_bytes = chunk ? bswap_le32(chunk->size) : (uint32_t)size;
+        size_t base = chunk ? (const char*)tokens - (const char*)data : 0;
+
+        shaders++;
+        fxdis_arena& arena = fxdis_thread_arena();
+        TokenDecoder decoder(tokens, token_bytes, &arena);
+        DecodedOperandPool operands(&arena);
+        DECODE_STATUS status = data ? decoder.DecodeHeader() : DECODE_STATUS::TRUNCATED;
+        lint_begin(checker);
+        if (status == DECODE_STATUS::OK)
+        {
+            DecodedInstruction inst;
+            while ((status = decoder.Next(inst, operands)) == DECODE_STATUS::OK)
+            {
+                lint_instruction(checker, inst, operands.data());
+                operands.clear();
+            }
+        }
+        lint_end(checker);
+        if (status != DECODE_STATUS::END)
+        {
+            std::cerr << path << ": " << DecodeStatusText[(int)status] << std::endl;
+            failed_inputs++;
+        }
+
+        std::string uri;
+        for (const lint_finding& finding : checker.findings)
+        {
+            const lint_rule_info& rule = lint_rules[finding.rule];
+            warnings = warnings || rule.level == LINT_WARNING;
+            size_t byte_offset = base + (size_t)finding.offset * 4;
+            const char* opcode = TokenText(OpcodeText, OpcodeTextCount, finding.opcode);
+            if (sarif)
+            {
+                if (uri.empty())
+                    uri = uri_reference(path);
+                out << (first ? "" : ",") << "\n        {\"ruleId\": \"" << rule.id << "\", \"ruleIndex\": " << finding.rule
+                    << ", \"level\": \"" << lint_level_text[rule.level] << "\", \"message\": {\"text\": ";
+                write_json_string(out, finding_message(finding));
+                out << "}, \"locations\": [{\"physicalLocation\": {\"artifactLocation\": {\"uri\": ";
+                write_json_string(out, uri);
+                out << "}, \"region\": {\"byteOffset\": " << byte_offset << ", \"byteLength\": " << finding.length * 4
+                    << "}}}], \"properties\": {\"instruction\": " << finding.instruction << ", \"offset\": " << finding.offset
+                    << ", \"opcode\": \"" << opcode << "\"}}";
+            }
+            else
+            {
+                out << (first ? "" : ",") << "\n    {\"path\": ";
+                write_json_string(out, path);
+                out << ", \"rule\": \"" << rule.id << "\", \"name\": \"" << rule.name << "\", \"level\": \""
+                    << lint_level_text[rule.level] << "\", \"instruction\": " << finding.instruction << ", \"offset\": "
+                    << finding.offset << ", \"byte_offset\": " << byte_offset << ", \"opcode\": \"" << opcode
+                    << "\", \"message\": ";
+                write_json_string(out, finding_message(finding));
+                out << "}";
+            }
+            first = false;
+        }
+    }
+
+    bool sarif;
+    std::ostream& out;
+    bool first;                 // no finding written yet
+    uint64_t shaders;
+    uint64_t failed_inputs;
+    bool warnings;
+    lint_checker checker;
+};
+
+} // namespace
+
+int lint_run(const std::vector<std::string>& inputs, bool sarif, std::ostream& out)
+{
+    linter run(sarif, out);
+    run.begin();
+    for (const std::string& input : inputs)
+        run.add_path(input);
+    return run.end() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
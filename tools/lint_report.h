@@ -0,0 +1,16 @@
+#ifndef LINT_REPORT_H_
+#define LINT_REPORT_H_
+
+#include <vector>
+#include <string>
+#include <iostream>
+
+// Checks every input against the lint rules while decoding it once, without formatting it, and
+// writes the findings to out as they are found: as one JSON object with a findings array, or as a
+// SARIF 2.1.0 log for code scanning tools. Findings point at the instruction's bytes in the input
+// file. Archives are read entry by entry. Inputs that cannot be read or decoded are reported on
+// stderr. Returns EXIT_FAILURE if any input failed or any finding is a warning, so a commit hook
+// can gate on it; notes alone do not fail the run.
+int lint_run(const std::vector<std::string>& inputs, bool sarif, std::ostream& out);
+
+#endif /* LINT_REPORT_H_ */
@@ -0,0 +1,291 @@
+#include "shard.h"
+#include "histogram.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+
+static const char shard_header_prefix[] = "# SHARD ";
+static const char shard_input_prefix[] = "# INPUT ";
+static const char shard_histogram_marker[] = "# HISTOGRAM";
+
+bool shard_parse(const char* text, shard_spec& shard)
+{
+    unsigned index, count;
+    char tail;
+    if (sscanf(text, "%u/%u%c", &index, &count, &tail) != 2 || count == 0 || index >= count)
+    {
+        return false;
+    }
+    shard.index = index;
+    shard.count = count;
+    return true;
+}
+
+uint64_t shard_hash(const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::vector<size_t> shard_select(const std::vector<std::string>& inputs, const shard_spec& shard)
+{
+    std::vector<size_t> selected;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (shard_hash(inputs[i].data(), inputs[i].size()) % shard.count == shard.index)
+        {
+            selected.push_back(i);
+        }
+    }
+    return selected;
+}
+
+std::string shard_header(const shard_spec& shard, size_t inputs, bool histogram, bool json)
+{
+    std::ostringstream header;
+    header << shard_header_prefix << shard.index << "/" << shard.count << " INPUTS " << inputs << "\n";
+    if (histogram)
+    {
+        header << shard_histogram_marker << (json ? " JSON" : "") << "\n";
+    }
+    return header.str();
+}
+
+std::string shard_input_header(size_t position)
+{
+    std::ostringstream header;
+    shard_write_input_header(header, position);
+    return header.str();
+}
+
+void shard_write_input_header(std::ostream& out, size_t position)
+{
+    out << shard_input_prefix << position << "\n";
+}
+
+namespace {
+
+struct shard_reader
+{
+    std::ifstream in;
+    std::string line;
+    bool pending;     // line holds the header of the next unread record
+    size_t position;  // that record's position in the full input list
+    bool stats;       // the records are done and line is the header of the stats rows
+};
+
+// Parses "# SHARD i/N INPUTS total".
+bool is_shard_header(const std::string& line, shard_spec& shard, size_t& inputs)
+{
+    size_t prefix = sizeof(shard_header_prefix) - 1;
+    unsigned long long total;
+    char tail;
+    if (line.compare(0, prefix, shard_header_prefix)
+        || sscanf(line.c_str() + prefix, "%u/%u INPUTS %llu%c", &shard.index, &shard.count, &total, &tail) != 3
+        || shard.count == 0 || shard.index >= shard.count)
+    {
+        return false;
+    }
+    inputs = (size_t)total;
+    return true;
+}
+
+bool is_input_header(const std::string& line, size_t& position)
+{
+    size_t prefix = sizeof(shard_input_prefix) - 1;
+    if (line.compare(0, prefix, shard_input_prefix))
+    {
+        return false;
+    }
+    char* end;
+    position = strtoull(line.c_str() + prefix, &end, 10);
+    return *end == '\0';
+}
+
+bool is_stats_header(const std::string& line)
+{
+    return line == STATS_ROWS_HEADER || line == STATS_ROWS_HEADER " JSON";
+}
+
+// Classifies the line just read as a record header, a stats header or neither.
+bool at_header(shard_reader& reader)
+{
+    reader.pending = is_input_header(reader.line, reader.position);
+    reader.stats = !reader.pending && is_stats_header(reader.line);
+    return reader.pending || reader.stats;
+}
+
+// Reads up to the next record header or the stats rows, copying the lines before it to body if
+// that is given. Returns false if no record follows.
+bool next_record(shard_reader& reader, std::ostream* body)
+{
+    reader.pending = false;
+    reader.stats = false;
+    while (std::getline(reader.in, reader.line))
+    {
+        if (at_header(reader))
+        {
+            break;
+        }
+        if (body)
+        {
+            *body << reader.line << "\n";
+        }
+    }
+    return reader.pending;
+}
+
+} // namespace
+
+int shard_merge(const std::vector<std::string>& shard_paths, std::ostream& out)
+{
+    std::vector<shard_reader> readers(shard_paths.size());
+    std::vector<bool> seen;
+    size_t inputs = 0;
+    bool histograms = false;
+    bool histogram_json = false;
+    for (size_t i = 0; i < shard_paths.size(); i++)
+    {
+        readers[i].in.open(shard_paths[i].c_str(), std::ios::binary);
+        if (!readers[i].in)
+        {
+            std::cerr << "Could not open shard output: " << shard_paths[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+        shard_spec shard;
+        size_t shard_inputs;
+        if (!std::getline(readers[i].in, readers[i].line) || !is_shard_header(readers[i].line, shard, shard_inputs))
+        {
+            std::cerr << "fxdis merge: " << shard_paths[i] << " is not shard output" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (i == 0)
+        {
+            seen.assign(shard.count, false);
+            inputs = shard_inputs;
+        }
+        if (shard.count != seen.size() || shard_inputs != inputs)
+        {
+            std::cerr << "fxdis merge: " << shard_paths[i] << " is from a different run" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (seen[shard.index])
+        {
+            std::cerr << "fxdis merge: shard " << shard.index << "/" << shard.count << " is given twice" << std::endl;
+            return EXIT_FAILURE;
+        }
+        seen[shard.index] = true;
+
+        shard_reader& reader = readers[i];
+        bool line = (bool)std::getline(reader.in, reader.line);
+        bool histogram = line && !reader.line.compare(0, sizeof(shard_histogram_marker) - 1, shard_histogram_marker);
+        bool json = histogram && reader.line != shard_histogram_marker;
+        if (i == 0)
+        {
+            histograms = histogram;
+            histogram_json = json;
+        }
+        if (histogram != histograms || json != histogram_json)
+        {
+            std::cerr << "fxdis merge: " << shard_paths[i] << " is from a different run" << std::endl;
+            return EXIT_FAILURE;
+        }
+        reader.pending = false;
+        reader.stats = false;
+        if (!histogram && !(line && at_header(reader)))
+        {
+            next_record(reader, NULL);
+        }
+    }
+    for (size_t s = 0; s < seen.size(); s++)
+    {
+        if (!seen[s])
+        {
+            std::cerr << "fxdis merge: shard " << s << "/" << seen.size() << " is missing" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (histograms)
+    {
+        histogram total;
+        memset(&total, 0, sizeof(total));
+        for (size_t i = 0; i < readers.size(); i++)
+        {
+            if (!histogram_read(readers[i].in, total))
+            {
+                std::cerr << "fxdis merge: " << shard_paths[i] << " holds a malformed histogram" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        histogram_write(total, histogram_json, out);
+        out.flush();
+        return EXIT_SUCCESS;
+    }
+
+    // Each shard is already in input order, so a k-way merge on the recorded position suffices.
+    size_t expected = 0;
+    for (;;)
+    {
+        shard_reader* next = NULL;
+        for (size_t i = 0; i < readers.size(); i++)
+        {
+            if (readers[i].pending && (!next || readers[i].position < next->position))
+            {
+                next = &readers[i];
+            }
+        }
+        if (!next)
+        {
+            break;
+        }
+        if (next->position != expected || next->position >= inputs)
+        {
+            std::cerr << "fxdis merge: input " << expected << " is "
+                << (next->position < expected ? "duplicated" : expected < inputs ? "missing" : "not in the input list")
+                << std::endl;
+            return EXIT_FAILURE;
+        }
+        expected++;
+
+        // Copy the record body, dropping the position header the single-machine run never wrote.
+        next_record(*next, &out);
+    }
+    if (expected != inputs)
+    {
+        std::cerr << "fxdis merge: input " << expected << " is missing" << std::endl;
+        return EXIT_FAILURE;
+    }
+    out.flush();
+
+    // Either every shard ran with --stats, and of the same kind, or none did.
+    fxdis_stats total;
+    memset(&total, 0, sizeof(total));
+    for (size_t i = 0; i < readers.size(); i++)
+    {
+        if (readers[i].stats != readers[0].stats || (readers[i].stats && readers[i].line != readers[0].line))
+        {
+            std::cerr << "fxdis merge: " << shard_paths[i] << " is from a different run" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (readers[i].stats && !stats_read(readers[i].in, total))
+        {
+            std::cerr << "fxdis merge: " << shard_paths[i] << " holds malformed statistics" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (readers[0].stats)
+    {
+        stats_report(total, readers[0].line != STATS_ROWS_HEADER, std::cerr);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,47 @@
+#ifndef SHARD_H_
+#define SHARD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <iostream>
+
+// One slice of a corpus run. Inputs are assigned to shards by the hash of their path as listed, so
+// every machine given the same input list agrees on the split without talking to the others, and
+// without reading any input that is not its own.
+struct shard_spec
+{
+    unsigned index;
+    unsigned count;
+};
+
+// Parses "i/N".
+bool shard_parse(const char* text, shard_spec& shard);
+
+// 64-bit FNV-1a.
+uint64_t shard_hash(const void* data, size_t size);
+
+// Returns the positions in inputs that belong to this shard. Only the paths are looked at.
+std::vector<size_t> shard_select(const std::vector<std::string>& inputs, const shard_spec& shard);
+
+// First line of every shard output, naming the shard and the length of the full input list, so
+// that shard_merge can tell when a shard or the inputs at the end of the list are missing. A
+// histogram's header has a second line, saying whether the merged counts are to be JSON, after which
+// the shard's histogram_write rows follow.
+std::string shard_header(const shard_spec& shard, size_t inputs, bool histogram = false, bool json = false);
+
+// Header line recording an input's position in the full list, written ahead of "# FILE:" in
+// shard output so that shard_merge can restore the single-machine order.
+std::string shard_input_header(size_t position);
+// Writes the same line to out without building a string.
+void shard_write_input_header(std::ostream& out, size_t position);
+
+// Streams per-shard outputs into the output a single run over the whole list would have produced.
+// Each shard is read one record at a time, so memory does not grow with shard size; histograms are
+// summed instead. So are the statistics of --stats runs, which each shard appends as stats_write
+// rows and the merge reports on stderr as a single run would. Fails unless the outputs are every
+// shard of one run, each once, and together hold every input exactly once.
+int shard_merge(const std::vector<std::string>& shard_paths, std::ostream& out);
+
+#endif /* SHARD_H_ */
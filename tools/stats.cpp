@@ -0,0 +1,248 @@
+#include "stats.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <new>
+#include <string>
+#include "fxdis.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef FXDIS_STATS
+// Every allocation of the tool through operator new goes through here, including those of the
+// standard library. The few direct malloc calls, arena blocks and containers and signatures
+// built without an arena, count themselves where they are made.
+void* operator new(size_t size)
+{
+    FXDIS_STATS_ADD(FXDIS_STATS_ALLOCATIONS, 1);
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+#endif
+
+static uint64_t peak_rss_kb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+stats_streambuf::stats_streambuf(std::streambuf* target)
+    : target(target), buffer(1 << 16)
+{
+    setp(&buffer[0], &buffer[0] + buffer.size());
+}
+
+stats_streambuf::~stats_streambuf()
+{
+    drain();
+}
+
+bool stats_streambuf::drain()
+{
+    std::streamsize size = pptr() - pbase();
+    if (!size)
+        return true;
+    FXDIS_STATS_TIME(FXDIS_STATS_WRITE);
+    FXDIS_STATS_ADD(FXDIS_STATS_BYTES_EMITTED, size);
+    bool ok = target->sputn(pbase(), size) == size;
+    setp(&buffer[0], &buffer[0] + buffer.size());
+    return ok;
+}
+
+stats_streambuf::int_type stats_streambuf::overflow(int_type c)
+{
+    if (!drain())
+        return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int stats_streambuf::sync()
+{
+    if (!drain())
+        return -1;
+    FXDIS_STATS_TIME(FXDIS_STATS_WRITE);
+    return target->pubsync();
+}
+
+#ifdef FXDIS_STATS
+stats_session::stats_session(std::ostream& out, std::ostream& report, bool json, bool rows)
+    : stats(), scope(&stats), buffer(out.rdbuf()), out(out), original(out.rdbuf(&buffer)), report(report), json(json),
+      rows(rows)
+{
+}
+
+stats_session::~stats_session()
+{
+    out.flush();
+    out.rdbuf(original);
+    stats.arena_high_water = fxdis_thread_arena().high_water();
+    stats.arena_reserved = fxdis_thread_arena().reserved();
+    stats.peak_rss_kb = peak_rss_kb();
+    if (rows)
+    {
+        report << STATS_ROWS_HEADER << (json ? " JSON" : "") << "\n";
+        stats_write(stats, report);
+        report.flush();
+    }
+    else
+    {
+        stats_report(stats, json, report);
+    }
+}
+#endif
+
+void stats_report(const fxdis_stats& stats, bool json, std::ostream& out)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < FXDIS_STATS_PHASE_COUNT; i++)
+        total += stats.ns[i];
+
+    char line[128];
+    if (json)
+    {
+        out << "{\n  \"phases_ms\": {";
+        for (int i = 0; i < FXDIS_STATS_PHASE_COUNT; i++)
+        {
+            snprintf(line, sizeof(line), "%s\"%s\": %.3f", i ? ", " : "", FxdisStatsPhaseText[i], stats.ns[i] / 1e6);
+            out << line;
+        }
+        snprintf(line, sizeof(line), "},\n  \"total_ms\": %.3f,\n  \"counters\": {", total / 1e6);
+        out << line;
+        for (int i = 0; i < FXDIS_STATS_COUNTER_COUNT; i++)
+            out << (i ? ", " : "") << "\"" << FxdisStatsCounterText[i] << "\": " << stats.counters[i];
+        out << "},\n  \"memory\": {\"arena_high_water\": " << stats.arena_high_water
+            << ", \"arena_reserved\": " << stats.arena_reserved << ", \"peak_rss_kb\": " << stats.peak_rss_kb << "}\n}\n";
+        return;
+    }
+
+    out << "phase                 ms      share\n";
+    for (int i = 0; i < FXDIS_STATS_PHASE_COUNT; i++)
+    {
+        snprintf(line, sizeof(line), "%-12s %11.3f %9.1f%%\n", FxdisStatsPhaseText[i], stats.ns[i] / 1e6,
+            total ? stats.ns[i] * 100.0 / total : 0.0);
+        out << line;
+    }
+    snprintf(line, sizeof(line), "%-12s %11.3f\n\n", "total", total / 1e6);
+    out << line;
+    for (int i = 0; i < FXDIS_STATS_COUNTER_COUNT; i++)
+    {
+        snprintf(line, sizeof(line), "%-18s %12llu\n", FxdisStatsCounterText[i], (unsigned long long)stats.counters[i]);
+        out << line;
+    }
+    snprintf(line, sizeof(line), "\n%-18s %12llu\n%-18s %12llu\n%-18s %12llu\n",
+        "arena_high_water", (unsigned long long)stats.arena_high_water,
+        "arena_reserved", (unsigned long long)stats.arena_reserved,
+        "peak_rss_kb", (unsigned long long)stats.peak_rss_kb);
+    out << line;
+}
+
+void stats_write(const fxdis_stats& stats, std::ostream& out)
+{
+    out << "category,name,value\n";
+    for (int i = 0; i < FXDIS_STATS_PHASE_COUNT; i++)
+        out << "phase_ns," << FxdisStatsPhaseText[i] << "," << stats.ns[i] << "\n";
+    for (int i = 0; i < FXDIS_STATS_COUNTER_COUNT; i++)
+        out << "counter," << FxdisStatsCounterText[i] << "," << stats.counters[i] << "\n";
+    out << "memory,arena_high_water," << stats.arena_high_water << "\n"
+        << "memory,arena_reserved," << stats.arena_reserved << "\n"
+        << "memory,peak_rss_kb," << stats.peak_rss_kb << "\n";
+}
+
+static bool read_value(const std::string& name, uint64_t value, uint64_t* values, const char** names, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (name == names[i])
+        {
+            values[i] += value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool stats_read(std::istream& in, fxdis_stats& stats)
+{
+    std::string line;
+    if (!std::getline(in, line) || line != "category,name,value")
+        return false;
+    while (std::getline(in, line))
+    {
+        size_t first = line.find(','), last = line.rfind(',');
+        if (first == std::string::npos || first == last || last + 1 == line.size())
+            return false;
+        char* end;
+        uint64_t value = strtoull(line.c_str() + last + 1, &end, 10);
+        if (*end)
+            return false;
+        std::string category = line.substr(0, first);
+        std::string name = line.substr(first + 1, last - first - 1);
+        bool known;
+        if (category == "phase_ns")
+            known = read_value(name, value, stats.ns, FxdisStatsPhaseText, FXDIS_STATS_PHASE_COUNT);
+        else if (category == "counter")
+            known = read_value(name, value, stats.counters, FxdisStatsCounterText, FXDIS_STATS_COUNTER_COUNT);
+        else if (category == "memory")
+        {
+            uint64_t* peak = name == "arena_high_water" ? &stats.arena_high_water
+                : name == "arena_reserved" ? &stats.arena_reserved
+                : name == "peak_rss_kb" ? &stats.peak_rss_kb : NULL;
+            known = peak != NULL;
+            if (peak && value > *peak)
+                *peak = value;
+        }
+        else
+            known = false;
+        if (!known)
+            return false;
+    }
+    return true;
+}
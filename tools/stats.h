@@ -0,0 +1,60 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "fxdis_stats.h"
+#include <iostream>
+#include <vector>
+
+// First line of the statistics a sharded run appends to its output, followed by " JSON" when the
+// merged report is to be JSON.
+#define STATS_ROWS_HEADER "# STATS"
+
+// Output buffer for --stats. Formatting fills a private buffer; handing it on to the real output
+// is timed as the write phase and counted as bytes emitted.
+class stats_streambuf : public std::streambuf
+{
+public:
+    explicit stats_streambuf(std::streambuf* target);
+    ~stats_streambuf();
+protected:
+    int_type overflow(int_type c);
+    int sync();
+private:
+    bool drain();
+    std::streambuf* target;
+    std::vector<char> buffer;
+};
+
+// Prints the phase times and counters, as a table or as a JSON object.
+void stats_report(const fxdis_stats& stats, bool json, std::ostream& out);
+
+// Writes "category,name,value" rows with the exact times and counts, for fxdis merge to combine.
+void stats_write(const fxdis_stats& stats, std::ostream& out);
+
+// Reads the rows stats_write writes, up to the end of in, and adds their times and counts to stats.
+// The memory figures are peaks of separate processes and keep the largest instead. Returns false on
+// a row it did not write.
+bool stats_read(std::istream& in, fxdis_stats& stats);
+
+#ifdef FXDIS_STATS
+// Collects statistics on the calling thread and routes out through a stats_streambuf until it is
+// destroyed, then reports on report. With rows, the report is a STATS_ROWS_HEADER line and the
+// stats_write rows, to be merged with other shards' before it is printed.
+class stats_session
+{
+public:
+    stats_session(std::ostream& out, std::ostream& report, bool json, bool rows = false);
+    ~stats_session();
+private:
+    fxdis_stats stats;
+    fxdis_stats_scope scope;
+    stats_streambuf buffer;
+    std::ostream& out;
+    std::streambuf* original;
+    std::ostream& report;
+    bool json;
+    bool rows;
+};
+#endif
+
+#endif /* STATS_H_ */
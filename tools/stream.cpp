@@ -0,0 +1,78 @@
+#include "stream.h"
+#include "fxdis.h"
+#include "dxbc.h"
+#include "fxdis_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// Anything larger is taken to be a corrupt header rather than a shader.
+static const uint32_t stream_max_container = 256 << 20;
+
+int stream_disassemble(FILE* in, std::ostream& out)
+{
+#ifdef _WIN32
+    _setmode(_fileno(in), _O_BINARY);
+#endif
+    int result = EXIT_SUCCESS;
+    std::vector<char> data(sizeof(dxbc_container_header));
+    size_t have = 0;
+    unsigned index = 0;
+    for (;;)
+    {
+        {
+            FXDIS_STATS_TIME(FXDIS_STATS_READ);
+            have += fread(&data[have], 1, sizeof(dxbc_container_header) - have, in);
+        }
+        if (have < sizeof(dxbc_container_header))
+        {
+            if (have)
+            {
+                out << "// stream ended inside a container header\n";
+                result = EXIT_FAILURE;
+            }
+            break;
+        }
+
+        dxbc_container_header* header = (dxbc_container_header*)&data[0];
+        uint32_t total_size = bswap_le32(header->total_size);
+        if (bswap_le32(header->fourcc) != FOURCC_DXBC || total_size < sizeof(dxbc_container_header) || total_size > stream_max_container)
+        {
+            // Resynchronize on the next "DXBC" tag.
+            size_t skip = 1;
+            while (skip + 4 <= have && memcmp(&data[skip], "DXBC", 4))
+                skip++;
+            out << "// skipped " << skip << " bytes of non-DXBC data\n";
+            memmove(&data[0], &data[skip], have - skip);
+            have -= skip;
+            result = EXIT_FAILURE;
+            continue;
+        }
+
+        data.resize(total_size);
+        {
+            FXDIS_STATS_TIME(FXDIS_STATS_READ);
+            have += fread(&data[have], 1, total_size - have, in);
+        }
+        out << "# FILE: -:" << index++ << "\n";
+        if (have < total_size)
+        {
+            out << "// stream ended inside a container\n";
+            result = EXIT_FAILURE;
+            break;
+        }
+        if (fxdis_disassemble(&data[0], total_size, out) != EXIT_SUCCESS)
+        {
+            result = EXIT_FAILURE;
+        }
+        out.flush();
+        have = 0;
+    }
+    out.flush();
+    return result;
+}
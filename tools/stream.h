@@ -0,0 +1,12 @@
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <stdio.h>
+#include <iostream>
+
+// Disassembles a continuous stream of DXBC containers, such as a compiler piping its output.
+// Containers are framed by dxbc_container_header::total_size, so each is written out, tagged
+// "# FILE: -:N", as soon as its last byte arrives. Only one container is held in memory at a time.
+int stream_disassemble(FILE* in, std::ostream& out);
+
+#endif /* STREAM_H_ */
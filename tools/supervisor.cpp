@@ -0,0 +1,371 @@
+#include "supervisor.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+namespace {
+
+void quarantine(const supervisor_options& options, const std::string& input, const std::string& reason)
+{
+    std::cerr << "fxdis: quarantined " << input << " (" << reason << ")" << std::endl;
+    if (!options.quarantine_path)
+    {
+        return;
+    }
+    FILE* file = fopen(options.quarantine_path, "a");
+    if (file)
+    {
+        fprintf(file, "%s\t%s\n", input.c_str(), reason.c_str());
+        fclose(file);
+    }
+}
+
+} // namespace
+
+#ifdef _WIN32
+
+// There is no fork() here, so inputs are decoded in-process and a crash still ends the batch.
+unsigned supervisor_run(const std::vector<std::string>& inputs, const std::vector<std::string>& headers,
+    const supervisor_options& options, supervisor_work_fn work, std::ostream& out)
+{
+    unsigned failed = 0;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        out << headers[i];
+        if (work(inputs[i].c_str(), out) != EXIT_SUCCESS)
+        {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+#else
+
+namespace {
+
+// Header of a worker's slot in the shared result ring. The output text follows it.
+struct result_slot
+{
+    uint32_t job;
+    uint32_t size;
+    uint32_t truncated;
+    int32_t status;
+};
+
+// Fixed-size sink over a result slot. Output that does not fit is dropped and flagged.
+class slot_streambuf : public std::streambuf
+{
+public:
+    slot_streambuf(char* begin, size_t size) : truncated(false) { setp(begin, begin + size); }
+    size_t used() const { return pptr() - pbase(); }
+    bool truncated;
+protected:
+    int_type overflow(int_type c)
+    {
+        truncated = true;
+        return traits_type::not_eof(c);
+    }
+};
+
+struct worker
+{
+    pid_t pid;
+    int job_fd;     // supervisor -> worker: index of the next input
+    int result_fd;  // worker -> supervisor: index of the finished input
+    bool busy;
+    uint32_t job;
+    uint64_t deadline_ms;
+};
+
+uint64_t now_ms()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+bool read_all(int fd, void* buf, size_t size)
+{
+    char* p = (char*)buf;
+    while (size)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool write_all(int fd, const void* buf, size_t size)
+{
+    const char* p = (const char*)buf;
+    while (size)
+    {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+void worker_main(int job_fd, int result_fd, char* slot_base, size_t slot_size,
+    const std::vector<std::string>& inputs, supervisor_work_fn work)
+{
+    result_slot* slot = (result_slot*)slot_base;
+    uint32_t job;
+    while (read_all(job_fd, &job, sizeof(job)))
+    {
+        slot_streambuf buf(slot_base + sizeof(result_slot), slot_size - sizeof(result_slot));
+        std::ostream out(&buf);
+        int status = work(inputs[job].c_str(), out);
+        out.flush();
+        slot->job = job;
+        slot->size = (uint32_t)buf.used();
+        slot->truncated = buf.truncated;
+        slot->status = status;
+        if (!write_all(result_fd, &job, sizeof(job)))
+            break;
+    }
+    _exit(0);
+}
+
+bool spawn(std::vector<worker>& workers, size_t index, char* ring, size_t slot_size,
+    const std::vector<std::string>& inputs, supervisor_work_fn work)
+{
+    int job_pipe[2];
+    int result_pipe[2];
+    if (pipe(job_pipe))
+        return false;
+    if (pipe(result_pipe))
+    {
+        close(job_pipe[0]);
+        close(job_pipe[1]);
+        return false;
+    }
+
+    fflush(stdout);
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(job_pipe[0]);
+        close(job_pipe[1]);
+        close(result_pipe[0]);
+        close(result_pipe[1]);
+        return false;
+    }
+    if (pid == 0)
+    {
+        // Drop the supervisor's ends of every other worker's pipes so they still see EOF.
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            if (i != index && workers[i].pid > 0)
+            {
+                close(workers[i].job_fd);
+                close(workers[i].result_fd);
+            }
+        }
+        close(job_pipe[1]);
+        close(result_pipe[0]);
+        worker_main(job_pipe[0], result_pipe[1], ring + index * slot_size, slot_size, inputs, work);
+    }
+
+    close(job_pipe[0]);
+    close(result_pipe[1]);
+    worker& w = workers[index];
+    w.pid = pid;
+    w.job_fd = job_pipe[1];
+    w.result_fd = result_pipe[0];
+    w.busy = false;
+    return true;
+}
+
+// Kills a worker if needed and reaps it. Returns a description of how it ended.
+std::string reap(worker& w, bool kill_it)
+{
+    if (kill_it)
+        kill(w.pid, SIGKILL);
+    close(w.job_fd);
+    close(w.result_fd);
+    int status = 0;
+    while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    w.pid = -1;
+    w.busy = false;
+
+    char reason[64];
+    if (kill_it)
+        snprintf(reason, sizeof(reason), "timeout");
+    else if (WIFSIGNALED(status))
+        snprintf(reason, sizeof(reason), "crashed with signal %d", WTERMSIG(status));
+    else
+        snprintf(reason, sizeof(reason), "exited with status %d", WEXITSTATUS(status));
+    return reason;
+}
+
+} // namespace
+
+unsigned supervisor_run(const std::vector<std::string>& inputs, const std::vector<std::string>& headers,
+    const supervisor_options& options, supervisor_work_fn work, std::ostream& out)
+{
+    unsigned jobs = options.jobs ? options.jobs : 1;
+    if (jobs > inputs.size())
+        jobs = inputs.size() ? (unsigned)inputs.size() : 1;
+    size_t slot_size = (options.slot_size + 4095) & ~(size_t)4095;
+    if (slot_size < 4096)
+        slot_size = 4096;
+
+    char* ring = (char*)mmap(NULL, slot_size * jobs, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+    {
+        std::cerr << "fxdis: failed to map the result ring" << std::endl;
+        return (unsigned)inputs.size();
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<worker> workers(jobs);
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].pid = -1;
+    }
+
+    // Results complete out of order; they are held here until every earlier input has been written.
+    std::vector<std::string> pending(inputs.size());
+    std::vector<bool> done(inputs.size(), false);
+    size_t next_job = 0;
+    size_t next_emit = 0;
+    unsigned failed = 0;
+
+    auto finish = [&](uint32_t job, const std::string& text, bool ok) {
+        pending[job] = text;
+        done[job] = true;
+        if (!ok)
+            failed++;
+        while (next_emit < inputs.size() && done[next_emit])
+        {
+            out << headers[next_emit] << pending[next_emit];
+            std::string().swap(pending[next_emit]);
+            next_emit++;
+        }
+    };
+
+    while (next_emit < inputs.size())
+    {
+        // Hand out work to idle workers, replacing any that died.
+        for (size_t i = 0; i < workers.size() && next_job < inputs.size(); i++)
+        {
+            worker& w = workers[i];
+            if (w.pid < 0 && !spawn(workers, i, ring, slot_size, inputs, work))
+                continue;
+            if (w.busy)
+                continue;
+            uint32_t job = (uint32_t)next_job;
+            if (!write_all(w.job_fd, &job, sizeof(job)))
+            {
+                reap(w, true);
+                continue;
+            }
+            w.busy = true;
+            w.job = job;
+            w.deadline_ms = options.timeout_ms ? now_ms() + options.timeout_ms : 0;
+            next_job++;
+        }
+
+        std::vector<pollfd> fds;
+        std::vector<size_t> owners;
+        uint64_t now = now_ms();
+        int timeout = -1;
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            if (!workers[i].busy)
+                continue;
+            pollfd fd = { workers[i].result_fd, POLLIN, 0 };
+            fds.push_back(fd);
+            owners.push_back(i);
+            if (workers[i].deadline_ms)
+            {
+                int remaining = workers[i].deadline_ms > now ? (int)(workers[i].deadline_ms - now) : 0;
+                if (timeout < 0 || remaining < timeout)
+                    timeout = remaining;
+            }
+        }
+        if (fds.empty())
+        {
+            std::cerr << "fxdis: unable to start worker processes" << std::endl;
+            break;
+        }
+
+        int ready = poll(&fds[0], fds.size(), timeout);
+        if (ready < 0 && errno != EINTR)
+            break;
+
+        now = now_ms();
+        for (size_t f = 0; f < fds.size(); f++)
+        {
+            worker& w = workers[owners[f]];
+            uint32_t job = w.job;
+            if (fds[f].revents)
+            {
+                uint32_t finished;
+                if (read_all(w.result_fd, &finished, sizeof(finished)))
+                {
+                    const result_slot* slot = (const result_slot*)(ring + owners[f] * slot_size);
+                    std::string text((const char*)(slot + 1), slot->size);
+                    // Output that overflowed the slot is incomplete, so the input fails.
+                    if (slot->truncated)
+                    {
+                        if (!text.empty() && text.back() != '\n')
+                            text += '\n';
+                        text += "// output truncated: larger than the result slot\n";
+                    }
+                    w.busy = false;
+                    finish(job, text, slot->status == EXIT_SUCCESS && !slot->truncated);
+                }
+                else
+                {
+                    std::string reason = reap(w, false);
+                    quarantine(options, inputs[job], reason);
+                    finish(job, "// quarantined: " + reason + "\n", false);
+                }
+            }
+            else if (w.deadline_ms && now >= w.deadline_ms)
+            {
+                std::string reason = reap(w, true);
+                quarantine(options, inputs[job], reason);
+                finish(job, "// quarantined: " + reason + "\n", false);
+            }
+        }
+    }
+
+    failed += (unsigned)(inputs.size() - next_emit);
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        if (workers[i].pid > 0)
+            reap(workers[i], false);
+    }
+    munmap(ring, slot_size * jobs);
+    out.flush();
+    return failed;
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef SUPERVISOR_H_
+#define SUPERVISOR_H_
+
+#include <stddef.h>
+#include <vector>
+#include <string>
+#include <iostream>
+
+// Work done for a single input inside a worker process. The return value is the input's exit code.
+typedef int (*supervisor_work_fn)(const char* input, std::ostream& out);
+
+struct supervisor_options
+{
+    unsigned jobs;               // number of worker processes
+    unsigned timeout_ms;         // per-input time limit, 0 disables it
+    size_t slot_size;            // bytes of shared memory each worker may fill with output; an input
+                                 // whose output does not fit fails
+    const char* quarantine_path; // inputs that crash or time out are appended here, may be NULL
+};
+
+// Runs work for every input in long-lived forked workers. Output is written to out in input order,
+// each input's output preceded by its entry in headers. A worker that crashes or runs past its time
+// limit is replaced, and the input it was decoding is quarantined instead of taking down the batch.
+// Returns the number of inputs that failed, crashed, timed out or overflowed their slot.
+unsigned supervisor_run(const std::vector<std::string>& inputs, const std::vector<std::string>& headers,
+    const supervisor_options& options, supervisor_work_fn work, std::ostream& out);
+
+#endif /* SUPERVISOR_H_ */
@@ -0,0 +1,313 @@
+#include "table_export.h"
+#include "arrow.h"
+#include "archive.h"
+#include "fxdis.h"
+#include "dxbc.h"
+#include "D3D11TokenParser.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+
+namespace {
+
+// Column positions, in the order the columns are added below.
+enum { S_ID, S_PATH, S_STAGE, S_MAJOR, S_MINOR, S_TOKENS, S_INSTRUCTIONS, S_DECLARATIONS, S_TEMPS,
+    S_GROUP_X, S_GROUP_Y, S_GROUP_Z, S_STATUS };
+enum { I_SHADER, I_INDEX, I_OFFSET, I_OPCODE, I_NAME, I_LENGTH, I_OPERANDS, I_SATURATE, I_DEST_TYPE,
+    I_DEST_MASK, I_RESOURCE, I_SAMPLER };
+enum { D_SHADER, D_INDEX, D_OFFSET, D_OPCODE, D_NAME, D_REGISTER_TYPE, D_REGISTER, D_REGISTER_INDEX1,
+    D_DIMENSION, D_DATA0 };
+
+class exporter
+{
+public:
+    explicit exporter(const std::string& dir)
+        : shader_file((dir + "/shaders.arrow").c_str(), std::ios::binary),
+          instruction_file((dir + "/instructions.arrow").c_str(), std::ios::binary),
+          declaration_file((dir + "/declarations.arrow").c_str(), std::ios::binary),
+          shaders(shader_file), instructions(instruction_file), declarations(declaration_file),
+          next_id(0), failed(false)
+    {
+        shaders.add_column("shader_id", arrow_writer::UINT32);
+        shaders.add_column("path", arrow_writer::UTF8);
+        shaders.add_column("stage", arrow_writer::UTF8);
+        shaders.add_column("major", arrow_writer::UINT8);
+        shaders.add_column("minor", arrow_writer::UINT8);
+        shaders.add_column("token_count", arrow_writer::UINT32);
+        shaders.add_column("instruction_count", arrow_writer::UINT32);
+        shaders.add_column("declaration_count", arrow_writer::UINT32);
+        shaders.add_column("temp_registers", arrow_writer::UINT32);
+        shaders.add_column("thread_group_x", arrow_writer::UINT32);
+        shaders.add_column("thread_group_y", arrow_writer::UINT32);
+        shaders.add_column("thread_group_z", arrow_writer::UINT32);
+        shaders.add_column("status", arrow_writer::UTF8);
+
+        instructions.add_column("shader_id", arrow_writer::UINT32);
+        instructions.add_column("index", arrow_writer::UINT32);
+        instructions.add_column("offset", arrow_writer::UINT32);
+        instructions.add_column("opcode", arrow_writer::UINT16);
+        instructions.add_column("name", arrow_writer::UTF8);
+        instructions.add_column("length", arrow_writer::UINT32);
+        instructions.add_column("operand_count", arrow_writer::UINT8);
+        instructions.add_column("saturate", arrow_writer::UINT8);
+        instructions.add_column("dest_type", arrow_writer::UTF8);
+        instructions.add_column("dest_mask", arrow_writer::UINT8);
+        instructions.add_column("resource_slot", arrow_writer::UINT32);
+        instructions.add_column("sampler_slot", arrow_writer::UINT32);
+
+        declarations.add_column("shader_id", arrow_writer::UINT32);
+        declarations.add_column("index", arrow_writer::UINT32);
+        declarations.add_column("offset", arrow_writer::UINT32);
+        declarations.add_column("opcode", arrow_writer::UINT16);
+        declarations.add_column("name", arrow_writer::UTF8);
+        declarations.add_column("register_type", arrow_writer::UTF8);
+        declarations.add_column("register", arrow_writer::UINT32);
+        declarations.add_column("register_index1", arrow_writer::UINT32);
+        declarations.add_column("dimension", arrow_writer::UINT8);
+        declarations.add_column("data0", arrow_writer::UINT32);
+        declarations.add_column("data1", arrow_writer::UINT32);
+        declarations.add_column("data2", arrow_writer::UINT32);
+    }
+
+    bool opened() const
+    {
+        return shader_file && instruction_file && declaration_file;
+    }
+
+    void add_path(const std::string& path)
+    {
+        fxdis_arena& arena = fxdis_thread_arena();
+        if (archive_is_archive(path.c_str()))
+        {
+            archive_reader* reader = archive_open(path.c_str(), std::cerr);
+            if (!reader)
+            {
+                add_unreadable(path);
+                return;
+            }
+            std::string name;
+            std::vector<char> data;
+            while (reader->next(name, data))
+            {
+                fxdis_arena_scope scope(arena);
+                add_input(path + ":" + name, data.empty() ? NULL : &data[0], data.size());
+            }
+            if (!reader->error.empty())
+            {
+                std::cerr << path << ": " << reader->error << std::endl;
+                failed = true;
+            }
+            delete reader;
+            return;
+        }
+
+        fxdis_arena_scope scope(arena);
+        size_t size;
+        const void* data = fxdis_read_file(path.c_str(), size, arena, std::cerr);
+        if (!data)
+        {
+            add_unreadable(path);
+            return;
+        }
+        add_input(path, data, size);
+    }
+
+    bool finish()
+    {
+        bool written = shaders.finish();
+        written = instructions.finish() && written;
+        written = declarations.finish() && written;
+        if (!written)
+            std::cerr << "Could not write the exported tables" << std::endl;
+        return written && !failed;
+    }
+
+private:
+    void add_unreadable(const std::string& path)
+    {
+        shaders.set(S_ID, next_id++);
+        shaders.set(S_PATH, path);
+        shaders.set(S_STATUS, "could not read", strlen("could not read"));
+        shaders.end_row();
+        failed = true;
+    }
+
+    // A DXBC container, or a bare token stream as fxdis_disassemble takes it.
+    void add_input(const std::string& path, const void* data, size_t size)
+    {
+        dxbc_chunk_header* chunk = data ? dxbc_find_shader_bytecode(data, (int)size) : NULL;
+        const uint32_t* tokens = chunk ? (const uint32_t*)(chunk + 1) : (const uint32_t*)data;
+        uint32_t token_bytes = chunk ? bswap_le32(chunk->size) : (uint32_t)size;
+
+        uint32_t id = next_id++;
+        fxdis_arena& arena = fxdis_thread_arena();
+        TokenDecoder decoder(tokens, token_bytes, &arena);
+        DecodedOperandPool operands(&arena);
+        DECODE_STATUS status = data ? decoder.DecodeHeader() : DECODE_STATUS::TRUNCATED;
+        uint32_t index = 0;
+        uint32_t instruction_count = 0;
+        uint32_t declaration_count = 0;
+        uint32_t temps = 0;
+        const uint32_t* thread_group = NULL;
+        DecodedInstruction inst;
+        DecodedInstruction group;
+        if (status == DECODE_STATUS::OK)
+        {
+            while ((status = decoder.Next(inst, operands)) == DECODE_STATUS::OK)
+            {
+                if (IsDeclaration(inst.opcode))
+                {
+                    add_declaration(id, index++, inst, operands.data());
+                    declaration_count++;
+                    if (inst.opcode == D3D10_SB_OPCODE_DCL_TEMPS)
+                        temps = inst.data[0];
+                    if (inst.opcode == D3D11_SB_OPCODE_DCL_THREAD_GROUP)
+                    {
+                        group = inst;
+                        thread_group = group.data;
+                    }
+                }
+                else
+                {
+                    add_instruction(id, index++, inst, operands.data());
+                    instruction_count++;
+                }
+                operands.clear();
+            }
+        }
+
+        shaders.set(S_ID, id);
+        shaders.set(S_PATH, path);
+        if (decoder.Version())
+        {
+            uint32_t type = DECODE_D3D10_SB_TOKENIZED_PROGRAM_TYPE(decoder.Version());
+            const char* stage = TokenText(ShaderTypeText, ShaderTypeTextCount, type);
+            shaders.set(S_STAGE, stage, type < ShaderTypeTextCount ? strlen(stage) - 1 : strlen(stage));
+            shaders.set(S_MAJOR, DECODE_D3D10_SB_TOKENIZED_PROGRAM_MAJOR_VERSION(decoder.Version()));
+            shaders.set(S_MINOR, DECODE_D3D10_SB_TOKENIZED_PROGRAM_MINOR_VERSION(decoder.Version()));
+        }
+        shaders.set(S_TOKENS, token_bytes / 4);
+        shaders.set(S_INSTRUCTIONS, instruction_count);
+        shaders.set(S_DECLARATIONS, declaration_count);
+        shaders.set(S_TEMPS, temps);
+        if (thread_group)
+        {
+            shaders.set(S_GROUP_X, thread_group[0]);
+            shaders.set(S_GROUP_Y, thread_group[1]);
+            shaders.set(S_GROUP_Z, thread_group[2]);
+        }
+        const char* text = status == DECODE_STATUS::END ? "ok" : DecodeStatusText[(int)status];
+        shaders.set(S_STATUS, text, strlen(text));
+        shaders.end_row();
+        if (status != DECODE_STATUS::END)
+            failed = true;
+    }
+
+    void set_name(arrow_writer& table, size_t column, const char* names[], uint32_t count, uint32_t value)
+    {
+        const char* name = TokenText(names, count, value);
+        table.set(column, name, strlen(name));
+    }
+
+    void add_instruction(uint32_t id, uint32_t index, const DecodedInstruction& inst, const DecodedOperand* operands)
+    {
+        instructions.set(I_SHADER, id);
+        instructions.set(I_INDEX, index);
+        instructions.set(I_OFFSET, inst.offset);
+        instructions.set(I_OPCODE, inst.opcode);
+        set_name(instructions, I_NAME, OpcodeText, OpcodeTextCount, inst.opcode);
+        instructions.set(I_LENGTH, inst.length);
+        instructions.set(I_OPERANDS, inst.operandCount);
+        instructions.set(I_SATURATE, DECODE_IS_D3D10_SB_INSTRUCTION_SATURATE_ENABLED(inst.opcodeToken));
+        if (DestinationCount(inst.opcode) && inst.operandCount)
+        {
+            set_name(instructions, I_DEST_TYPE, OperandText, OperandTextCount, operands[inst.firstOperand].type);
+            if (operands[inst.firstOperand].selectionMode == D3D10_SB_OPERAND_4_COMPONENT_MASK_MODE
+                && operands[inst.firstOperand].numComponents == 4)
+                instructions.set(I_DEST_MASK, operands[inst.firstOperand].mask);
+        }
+        bool resource = false;
+        bool sampler = false;
+        for (uint32_t i = 0; i < inst.operandCount; i++)
+        {
+            const DecodedOperand& operand = operands[inst.firstOperand + i];
+            if (!operand.indexDim)
+                continue;
+            if (!resource && (operand.type == D3D10_SB_OPERAND_TYPE_RESOURCE || operand.type == D3D11_SB_OPERAND_TYPE_UNORDERED_ACCESS_VIEW))
+            {
+                instructions.set(I_RESOURCE, operand.index[0].value);
+                resource = true;
+            }
+            else if (!sampler && operand.type == D3D10_SB_OPERAND_TYPE_SAMPLER)
+            {
+                instructions.set(I_SAMPLER, operand.index[0].value);
+                sampler = true;
+            }
+        }
+        instructions.end_row();
+    }
+
+    void add_declaration(uint32_t id, uint32_t index, const DecodedInstruction& inst, const DecodedOperand* operands)
+    {
+        declarations.set(D_SHADER, id);
+        declarations.set(D_INDEX, index);
+        declarations.set(D_OFFSET, inst.offset);
+        declarations.set(D_OPCODE, inst.opcode);
+        set_name(declarations, D_NAME, OpcodeText, OpcodeTextCount, inst.opcode);
+        if (inst.operandCount)
+        {
+            const DecodedOperand& operand = operands[inst.firstOperand];
+            set_name(declarations, D_REGISTER_TYPE, OperandText, OperandTextCount, operand.type);
+            if (operand.indexDim > 0)
+                declarations.set(D_REGISTER, operand.index[0].value);
+            if (operand.indexDim > 1)
+                declarations.set(D_REGISTER_INDEX1, operand.index[1].value);
+        }
+        switch (inst.opcode)
+        {
+        case D3D10_SB_OPCODE_DCL_RESOURCE:
+        case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_TYPED:
+            declarations.set(D_DIMENSION, DECODE_D3D10_SB_RESOURCE_DIMENSION(inst.opcodeToken));
+            break;
+        // Raw and structured views are told apart by opcode; their dimension field is not reliable.
+        case D3D11_SB_OPCODE_DCL_RESOURCE_RAW:
+        case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_RAW:
+            declarations.set(D_DIMENSION, D3D11_SB_RESOURCE_DIMENSION_RAW_BUFFER);
+            break;
+        case D3D11_SB_OPCODE_DCL_RESOURCE_STRUCTURED:
+        case D3D11_SB_OPCODE_DCL_UNORDERED_ACCESS_VIEW_STRUCTURED:
+            declarations.set(D_DIMENSION, D3D11_SB_RESOURCE_DIMENSION_STRUCTURED_BUFFER);
+            break;
+        default:
+            break;
+        }
+        // Custom data keeps its class and length in data; its payload stays out of the table.
+        for (uint32_t i = 0; i < inst.dataCount && i < 3; i++)
+            declarations.set(D_DATA0 + i, inst.data[i]);
+        declarations.end_row();
+    }
+
+    std::ofstream shader_file;
+    std::ofstream instruction_file;
+    std::ofstream declaration_file;
+    arrow_writer shaders;
+    arrow_writer instructions;
+    arrow_writer declarations;
+    uint32_t next_id;
+    bool failed;
+};
+
+} // namespace
+
+int table_export(const std::vector<std::string>& inputs, const std::string& dir)
+{
+    exporter tables(dir);
+    if (!tables.opened())
+    {
+        std::cerr << "Could not create the tables in " << dir << std::endl;
+        return EXIT_FAILURE;
+    }
+    for (const std::string& input : inputs)
+        tables.add_path(input);
+    return tables.finish() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
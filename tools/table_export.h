@@ -0,0 +1,18 @@
+#ifndef TABLE_EXPORT_H_
+#define TABLE_EXPORT_H_
+
+#include <vector>
+#include <string>
+
+// Decodes every input without formatting it and writes what it finds as three Arrow IPC files in
+// dir, for querying a corpus with DuckDB, pandas or anything else that reads Arrow or Feather:
+//   shaders.arrow        one row per input: path, stage, shader model, sizes, decode status
+//   instructions.arrow   one row per executable instruction
+//   declarations.arrow   one row per declaration
+// The tables join on shader_id, and instructions and declarations share one index sequence in
+// program order. Archives are read entry by entry. Rows are written in batches as inputs are
+// decoded, so memory does not grow with the corpus. Returns EXIT_FAILURE if any input could not
+// be read or decoded to the end; such inputs still get their shaders row.
+int table_export(const std::vector<std::string>& inputs, const std::string& dir);
+
+#endif /* TABLE_EXPORT_H_ */